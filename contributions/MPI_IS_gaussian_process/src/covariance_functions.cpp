@@ -47,6 +47,34 @@
 namespace covariance_functions
 {
 
+/* CovFunc */
+void CovFunc::computeFeatures(const Eigen::VectorXd& x, Eigen::MatrixXd& features) const
+{
+    features.resize(x.rows(), 1);
+    features.col(0) = x;
+}
+
+void CovFunc::evaluateFeatures(const Eigen::MatrixXd& features1, const Eigen::MatrixXd& features2, Eigen::MatrixXd& result)
+{
+    result = evaluate(features1.col(0), features2.col(0));
+}
+
+/*
+ * Stores the locations and the sine and cosine of their phase, the periodic
+ * distance follows from sin(a - b) = sin(a) * cos(b) - cos(a) * sin(b).
+ */
+static void computePeriodicFeatures(const Eigen::VectorXd& x, double period_length, Eigen::MatrixXd& features)
+{
+    features.resize(x.rows(), 3);
+    for (int i = 0; i < x.rows(); ++i)
+    {
+        double phase = (M_PI / period_length) * x(i);
+        features(i, 0) = x(i);
+        features(i, 1) = std::sin(phase);
+        features(i, 2) = std::cos(phase);
+    }
+}
+
 /* PeriodicSquareExponential */
 PeriodicSquareExponential::PeriodicSquareExponential()
     : hyperParameters(Eigen::VectorXd::Zero(4)), extraParameters(Eigen::VectorXd::Ones(1) * std::numeric_limits<double>::max())
@@ -95,6 +123,36 @@ Eigen::MatrixXd PeriodicSquareExponential::evaluate(const Eigen::VectorXd& x, co
     */
 }
 
+void PeriodicSquareExponential::computeFeatures(const Eigen::VectorXd& x, Eigen::MatrixXd& features) const
+{
+    computePeriodicFeatures(x, exp(extraParameters(0)), features);
+}
+
+void PeriodicSquareExponential::evaluateFeatures(const Eigen::MatrixXd& features1, const Eigen::MatrixXd& features2,
+                                                 Eigen::MatrixXd& result)
+{
+    assert(features1.cols() == 3 && features2.cols() == 3);
+
+    double lsSE0 = exp(hyperParameters(0));
+    double svSE0 = exp(2 * hyperParameters(1));
+    double lsP = exp(hyperParameters(2));
+    double svP = exp(2 * hyperParameters(3));
+
+    double factorSE0 = -0.5 / std::pow(lsSE0, 2);
+    double factorP = -2 / std::pow(lsP, 2);
+
+    result.resize(features1.rows(), features2.rows());
+    for (int j = 0; j < features2.rows(); ++j)
+    {
+        for (int i = 0; i < features1.rows(); ++i)
+        {
+            double distance = features1(i, 0) - features2(j, 0);
+            double sine = features1(i, 1) * features2(j, 2) - features1(i, 2) * features2(j, 1);
+            result(i, j) = svSE0 * std::exp(factorSE0 * distance * distance) + svP * std::exp(factorP * sine * sine);
+        }
+    }
+}
+
 void PeriodicSquareExponential::setParameters(const Eigen::VectorXd& params)
 {
     this->hyperParameters = params;
@@ -180,6 +238,41 @@ Eigen::MatrixXd PeriodicSquareExponential2::evaluate(const Eigen::VectorXd& x, c
     */
 }
 
+void PeriodicSquareExponential2::computeFeatures(const Eigen::VectorXd& x, Eigen::MatrixXd& features) const
+{
+    computePeriodicFeatures(x, exp(extraParameters(0)), features);
+}
+
+void PeriodicSquareExponential2::evaluateFeatures(const Eigen::MatrixXd& features1, const Eigen::MatrixXd& features2,
+                                                  Eigen::MatrixXd& result)
+{
+    assert(features1.cols() == 3 && features2.cols() == 3);
+
+    double lsSE0 = exp(hyperParameters(0));
+    double svSE0 = exp(2 * hyperParameters(1));
+    double lsP = exp(hyperParameters(2));
+    double svP = exp(2 * hyperParameters(3));
+    double lsSE1 = exp(hyperParameters(4));
+    double svSE1 = exp(2 * hyperParameters(5));
+
+    double factorSE0 = -0.5 / std::pow(lsSE0, 2);
+    double factorP = -2 / std::pow(lsP, 2);
+    double factorSE1 = -0.5 / std::pow(lsSE1, 2);
+
+    result.resize(features1.rows(), features2.rows());
+    for (int j = 0; j < features2.rows(); ++j)
+    {
+        for (int i = 0; i < features1.rows(); ++i)
+        {
+            double distance = features1(i, 0) - features2(j, 0);
+            double square_distance = distance * distance;
+            double sine = features1(i, 1) * features2(j, 2) - features1(i, 2) * features2(j, 1);
+            result(i, j) = svSE0 * std::exp(factorSE0 * square_distance) + svP * std::exp(factorP * sine * sine) +
+                svSE1 * std::exp(factorSE1 * square_distance);
+        }
+    }
+}
+
 void PeriodicSquareExponential2::setParameters(const Eigen::VectorXd& params)
 {
     this->hyperParameters = params;
@@ -66,6 +66,24 @@ public:
      */
     virtual Eigen::MatrixXd evaluate(const Eigen::VectorXd& x1, const Eigen::VectorXd& x2) = 0;
 
+    /*!
+     * Computes the features of the given locations, one row per location.
+     * Evaluating the covariance function on precomputed features avoids
+     * recomputing location dependent terms for locations that are used
+     * repeatedly, like the datapoints of a GP. The features are only valid
+     * until the hyper-parameters change.
+     *
+     * The default features are the locations themselves.
+     */
+    virtual void computeFeatures(const Eigen::VectorXd& x, Eigen::MatrixXd& features) const;
+
+    /*!
+     * Evaluates the covariance function on precomputed features and writes it
+     * to \a result, which is only reallocated if its size changes.
+     */
+    virtual void evaluateFeatures(const Eigen::MatrixXd& features1, const Eigen::MatrixXd& features2,
+                                  Eigen::MatrixXd& result);
+
     //! Method to set the hyper-parameters.
     virtual void setParameters(const Eigen::VectorXd& params) = 0;
     virtual void setExtraParameters(const Eigen::VectorXd& params) = 0;
@@ -128,6 +146,14 @@ public:
      */
     Eigen::MatrixXd evaluate(const Eigen::VectorXd& x1, const Eigen::VectorXd& x2);
 
+    /*!
+     * The features are the locations and the sine and cosine of their phase
+     * in the period, so that no trigonometric function has to be evaluated
+     * per pair of locations.
+     */
+    void computeFeatures(const Eigen::VectorXd& x, Eigen::MatrixXd& features) const;
+    void evaluateFeatures(const Eigen::MatrixXd& features1, const Eigen::MatrixXd& features2, Eigen::MatrixXd& result);
+
     //! Method to set the hyper-parameters.
     void setParameters(const Eigen::VectorXd& params);
     void setExtraParameters(const Eigen::VectorXd& params);
@@ -190,6 +216,14 @@ public:
 
     Eigen::MatrixXd evaluate(const Eigen::VectorXd& x1, const Eigen::VectorXd& x2);
 
+    /*!
+     * The features are the locations and the sine and cosine of their phase
+     * in the period, so that no trigonometric function has to be evaluated
+     * per pair of locations.
+     */
+    void computeFeatures(const Eigen::VectorXd& x, Eigen::MatrixXd& features) const;
+    void evaluateFeatures(const Eigen::MatrixXd& features1, const Eigen::MatrixXd& features2, Eigen::MatrixXd& result);
+
     //! Method to set the hyper-parameters.
     void setParameters(const Eigen::VectorXd& params);
     void setExtraParameters(const Eigen::VectorXd& params);
@@ -41,7 +41,9 @@
  * @brief     The GP class implements the Gaussian Process functionality.
  */
 
+#include <algorithm>
 #include <cstdint>
+#include <numeric>
 
 #include "gaussian_process.h"
 #include "math_tools.h"
@@ -55,13 +57,25 @@ struct covariance_ordering
     Eigen::VectorXd const& covariance_;
 };
 
+// A functor for ordering indices by location, also usable for looking up a location
+struct location_ordering
+{
+    location_ordering(Eigen::VectorXd const& loc) : location_(loc) { }
+    bool operator()(int a, int b) const { return location_[a] < location_[b]; }
+    bool operator()(int a, double b) const { return location_[a] < b; }
+    bool operator()(double a, int b) const { return a < location_[b]; }
+    Eigen::VectorXd const& location_;
+};
+
 GP::GP()
     : covFunc_(nullptr), // initialize pointer to null
       covFuncProj_(nullptr), // initialize pointer to null
       data_loc_(Eigen::VectorXd()), data_out_(Eigen::VectorXd()), data_var_(Eigen::VectorXd()), gram_matrix_(Eigen::MatrixXd()),
       alpha_(Eigen::VectorXd()), chol_gram_matrix_(Eigen::LDLT<Eigen::MatrixXd>()), log_noise_sd_(-1E20),
       use_explicit_trend_(false), feature_vectors_(Eigen::MatrixXd()), feature_matrix_(Eigen::MatrixXd()),
-      chol_feature_matrix_(Eigen::LDLT<Eigen::MatrixXd>()), beta_(Eigen::VectorXd())
+      chol_feature_matrix_(Eigen::LDLT<Eigen::MatrixXd>()), beta_(Eigen::VectorXd()), use_incremental_inference_(false),
+      chol_factor_(Eigen::MatrixXd()), chol_factor_valid_(false), data_features_(Eigen::MatrixXd()),
+      data_features_proj_(Eigen::MatrixXd()), mean_weights_(Eigen::VectorXd())
 {
 }
 
@@ -70,7 +84,9 @@ GP::GP(const covariance_functions::CovFunc& covFunc)
       data_var_(Eigen::VectorXd()), gram_matrix_(Eigen::MatrixXd()), alpha_(Eigen::VectorXd()),
       chol_gram_matrix_(Eigen::LDLT<Eigen::MatrixXd>()), log_noise_sd_(-1E20), use_explicit_trend_(false),
       feature_vectors_(Eigen::MatrixXd()), feature_matrix_(Eigen::MatrixXd()),
-      chol_feature_matrix_(Eigen::LDLT<Eigen::MatrixXd>()), beta_(Eigen::VectorXd())
+      chol_feature_matrix_(Eigen::LDLT<Eigen::MatrixXd>()), beta_(Eigen::VectorXd()), use_incremental_inference_(false),
+      chol_factor_(Eigen::MatrixXd()), chol_factor_valid_(false), data_features_(Eigen::MatrixXd()),
+      data_features_proj_(Eigen::MatrixXd()), mean_weights_(Eigen::VectorXd())
 {
 }
 
@@ -79,7 +95,9 @@ GP::GP(const double noise_variance, const covariance_functions::CovFunc& covFunc
       data_var_(Eigen::VectorXd()), gram_matrix_(Eigen::MatrixXd()), alpha_(Eigen::VectorXd()),
       chol_gram_matrix_(Eigen::LDLT<Eigen::MatrixXd>()), log_noise_sd_(std::log(noise_variance)), use_explicit_trend_(false),
       feature_vectors_(Eigen::MatrixXd()), feature_matrix_(Eigen::MatrixXd()),
-      chol_feature_matrix_(Eigen::LDLT<Eigen::MatrixXd>()), beta_(Eigen::VectorXd())
+      chol_feature_matrix_(Eigen::LDLT<Eigen::MatrixXd>()), beta_(Eigen::VectorXd()), use_incremental_inference_(false),
+      chol_factor_(Eigen::MatrixXd()), chol_factor_valid_(false), data_features_(Eigen::MatrixXd()),
+      data_features_proj_(Eigen::MatrixXd()), mean_weights_(Eigen::VectorXd())
 {
 }
 
@@ -95,10 +113,19 @@ GP::GP(const GP& that)
       data_loc_(that.data_loc_), data_out_(that.data_out_), data_var_(that.data_var_), gram_matrix_(that.gram_matrix_),
       alpha_(that.alpha_), chol_gram_matrix_(that.chol_gram_matrix_), log_noise_sd_(that.log_noise_sd_),
       use_explicit_trend_(that.use_explicit_trend_), feature_vectors_(that.feature_vectors_),
-      feature_matrix_(that.feature_matrix_), chol_feature_matrix_(that.chol_feature_matrix_), beta_(that.beta_)
+      feature_matrix_(that.feature_matrix_), chol_feature_matrix_(that.chol_feature_matrix_), beta_(that.beta_),
+      use_incremental_inference_(that.use_incremental_inference_), chol_factor_(that.chol_factor_),
+      chol_factor_valid_(that.chol_factor_valid_), data_features_(that.data_features_),
+      data_features_proj_(that.data_features_proj_), mean_weights_(that.mean_weights_)
 {
-    covFunc_ = that.covFunc_->clone();
-    covFuncProj_ = that.covFuncProj_->clone();
+    if (that.covFunc_ != nullptr)
+    {
+        covFunc_ = that.covFunc_->clone();
+    }
+    if (that.covFuncProj_ != nullptr)
+    {
+        covFuncProj_ = that.covFuncProj_->clone();
+    }
 }
 
 bool GP::setCovarianceFunction(const covariance_functions::CovFunc& covFunc)
@@ -116,12 +143,14 @@ void GP::enableOutputProjection(const covariance_functions::CovFunc& covFuncProj
 {
     delete covFuncProj_; // initialized to zero, so delete is safe
     covFuncProj_ = covFuncProj.clone();
+    updateDataFeatures();
 }
 
 void GP::disableOutputProjection()
 {
     delete covFuncProj_; // initialized to zero, so delete is safe
     covFuncProj_ = nullptr;
+    data_features_proj_ = Eigen::MatrixXd();
 }
 
 GP& GP::operator=(const GP& that)
@@ -140,6 +169,12 @@ GP& GP::operator=(const GP& that)
         alpha_ = that.alpha_;
         chol_gram_matrix_ = that.chol_gram_matrix_;
         log_noise_sd_ = that.log_noise_sd_;
+        use_incremental_inference_ = that.use_incremental_inference_;
+        chol_factor_ = that.chol_factor_;
+        chol_factor_valid_ = that.chol_factor_valid_;
+        data_features_ = that.data_features_;
+        data_features_proj_ = that.data_features_proj_;
+        mean_weights_ = that.mean_weights_;
     }
     return *this;
 }
@@ -169,7 +204,7 @@ Eigen::VectorXd GP::drawSample(const Eigen::VectorXd& locations, const Eigen::Ve
         Eigen::MatrixXd mixed_covariance;
         mixed_covariance = covFunc_->evaluate(locations, data_loc_);
         Eigen::MatrixXd posterior_covariance;
-        posterior_covariance = prior_covariance - mixed_covariance * (chol_gram_matrix_.solve(mixed_covariance.transpose()));
+        posterior_covariance = prior_covariance - mixed_covariance * solveGram(mixed_covariance.transpose());
         kernel_matrix =
             posterior_covariance + JITTER * Eigen::MatrixXd::Identity(posterior_covariance.rows(), posterior_covariance.cols());
     }
@@ -202,10 +237,32 @@ void GP::infer()
     }
 
     // compute the Cholesky decomposition of the Gram matrix
+    factorizeGramMatrix();
+
+    computeWeights();
+}
+
+void GP::factorizeGramMatrix()
+{
+    chol_factor_valid_ = false;
+    if (use_incremental_inference_)
+    {
+        // the incremental updates need the plain LL^T form of the decomposition
+        Eigen::LLT<Eigen::MatrixXd> chol(gram_matrix_);
+        if (chol.info() == Eigen::Success)
+        {
+            chol_factor_ = chol.matrixL();
+            chol_factor_valid_ = true;
+            return;
+        }
+    }
     chol_gram_matrix_ = gram_matrix_.ldlt();
+}
 
+void GP::computeWeights()
+{
     // pre-compute the alpha, which is the solution of the chol to the data
-    alpha_ = chol_gram_matrix_.solve(data_out_);
+    alpha_ = solveGram(data_out_);
 
     if (use_explicit_trend_)
     {
@@ -214,11 +271,233 @@ void GP::infer()
         feature_vectors_.row(0) = Eigen::MatrixXd::Ones(1, data_loc_.rows()); // instead of pow(0)
         feature_vectors_.row(1) = data_loc_.array(); // instead of pow(1)
 
-        feature_matrix_ = feature_vectors_ * chol_gram_matrix_.solve(feature_vectors_.transpose());
+        Eigen::MatrixXd gram_solved_features = solveGram(feature_vectors_.transpose());
+        feature_matrix_ = feature_vectors_ * gram_solved_features;
         chol_feature_matrix_ = feature_matrix_.ldlt();
 
         beta_ = chol_feature_matrix_.solve(feature_vectors_) * alpha_;
+
+        // the trend part of the mean that depends on the data: -mixed_cov * K^{-1} * H^T * beta
+        mean_weights_ = alpha_ - gram_solved_features * beta_;
+    }
+    else
+    {
+        mean_weights_ = alpha_;
+    }
+
+    updateDataFeatures();
+}
+
+void GP::updateDataFeatures()
+{
+    if (data_loc_.rows() == 0)
+    {
+        return;
+    }
+    covFunc_->computeFeatures(data_loc_, data_features_);
+    if (covFuncProj_ != nullptr)
+    {
+        covFuncProj_->computeFeatures(data_loc_, data_features_proj_);
+    }
+}
+
+Eigen::MatrixXd GP::solveGram(const Eigen::MatrixXd& rhs) const
+{
+    if (!chol_factor_valid_)
+    {
+        return chol_gram_matrix_.solve(rhs);
+    }
+
+    // forward and back substitution with the Cholesky factor
+    Eigen::MatrixXd result = chol_factor_.triangularView<Eigen::Lower>().solve(rhs);
+    chol_factor_.triangularView<Eigen::Lower>().transpose().solveInPlace(result);
+    return result;
+}
+
+void GP::solveGramInPlace(Eigen::MatrixXd& rhs) const
+{
+    if (!chol_factor_valid_)
+    {
+        chol_gram_matrix_.solveInPlace(rhs);
+        return;
+    }
+
+    chol_factor_.triangularView<Eigen::Lower>().solveInPlace(rhs);
+    chol_factor_.triangularView<Eigen::Lower>().transpose().solveInPlace(rhs);
+}
+
+void GP::downdateCholeskyFactor(const std::vector<int>& removed)
+{
+    int n = static_cast<int>(chol_factor_.rows());
+
+    // Removing point j leaves the leading block of the factor untouched, the trailing block changes to
+    // chol(L*L^T + x*x^T) where x is the column of L below the removed diagonal element. The rank-1 update
+    // is done in place with Givens rotations, the rows and columns of the removed points are dropped later.
+    for (int j : removed)
+    {
+        Eigen::VectorXd update = chol_factor_.col(j).tail(n - j - 1);
+        for (int p = j + 1; p < n; ++p)
+        {
+            int k = p - j - 1;
+            double diagonal = chol_factor_(p, p);
+            double r = std::sqrt(diagonal * diagonal + update(k) * update(k));
+            double c = r / diagonal;
+            double s = update(k) / diagonal;
+            chol_factor_(p, p) = r;
+
+            int rest = n - p - 1;
+            if (rest > 0)
+            {
+                auto column = chol_factor_.col(p).tail(rest);
+                auto x = update.segment(k + 1, rest);
+                column = (column + s * x) / c;
+                x = c * x - s * column;
+            }
+        }
+    }
+}
+
+void GP::inferIncremental(const Eigen::VectorXd& data_loc, const Eigen::VectorXd& data_out, const Eigen::VectorXd& data_var)
+{
+    bool use_var = data_var.rows() > 0; // true means heteroscedastic noise
+    int n_old = static_cast<int>(data_loc_.rows());
+    int n_new = static_cast<int>(data_loc.rows());
+
+    // look up which of the stored points are part of the new subset
+    std::vector<int> order(n_old);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), location_ordering(data_loc_));
+
+    std::vector<int> source(n_old, -1); // index of the stored point in the new data, -1 if it is removed
+    std::vector<bool> is_new(n_new, true);
+    int n_kept = 0;
+    if (chol_factor_valid_ && use_var == (data_var_.rows() > 0))
+    {
+        for (int i = 0; i < n_new; ++i)
+        {
+            auto range = std::equal_range(order.begin(), order.end(), data_loc[i], location_ordering(data_loc_));
+            for (auto it = range.first; it != range.second; ++it)
+            {
+                if (source[*it] < 0 && (!use_var || data_var_[*it] == data_var[i]))
+                {
+                    source[*it] = i;
+                    is_new[i] = false;
+                    ++n_kept;
+                    break;
+                }
+            }
+        }
+    }
+
+    // if a large part of the subset changes, a new decomposition is cheaper
+    int n_add = n_new - n_kept;
+    int changes = (n_old - n_kept) + n_add;
+    if (n_kept > 0 && 4 * changes <= n_new)
+    {
+        // the kept points stay in their order, the new ones are appended
+        std::vector<int> removed;
+        std::vector<int> kept;
+        std::vector<int> index; // index of each point in the new data
+        index.reserve(n_new);
+        for (int j = 0; j < n_old; ++j)
+        {
+            if (source[j] < 0)
+            {
+                removed.push_back(j);
+            }
+            else
+            {
+                kept.push_back(j);
+                index.push_back(source[j]);
+            }
+        }
+        for (int i = 0; i < n_new; ++i)
+        {
+            if (is_new[i])
+            {
+                index.push_back(i);
+            }
+        }
+
+        downdateCholeskyFactor(removed);
+
+        // only the lower triangle of the factor is used
+        Eigen::MatrixXd factor = Eigen::MatrixXd::Zero(n_new, n_new);
+        Eigen::MatrixXd gram(n_new, n_new);
+        Eigen::VectorXd loc(n_new);
+        for (int q = 0; q < n_kept; ++q)
+        {
+            for (int k = 0; k < n_kept; ++k)
+            {
+                gram(k, q) = gram_matrix_(kept[k], kept[q]);
+            }
+            for (int k = q; k < n_kept; ++k)
+            {
+                factor(k, q) = chol_factor_(kept[k], kept[q]);
+            }
+            loc(q) = data_loc_(kept[q]);
+        }
+
+        bool success = true;
+        if (n_add > 0)
+        {
+            Eigen::VectorXd new_loc(n_add);
+            Eigen::VectorXd new_var(n_add);
+            for (int k = 0; k < n_add; ++k)
+            {
+                new_loc(k) = data_loc[index[n_kept + k]];
+                new_var(k) = use_var ? data_var[index[n_kept + k]] : std::exp(2 * log_noise_sd_) + JITTER;
+            }
+            loc.tail(n_add) = new_loc;
+
+            // the covariance columns of the new points are evaluated once and cached in the Gram matrix
+            Eigen::MatrixXd cross_cov = covFunc_->evaluate(loc.head(n_kept), new_loc);
+            Eigen::MatrixXd new_cov = covFunc_->evaluate(new_loc, new_loc);
+            new_cov += new_var.asDiagonal();
+
+            // extend the factor with the new rows L21 = C^T * L11^-T and the decomposition of the Schur complement
+            Eigen::MatrixXd new_rows = factor.topLeftCorner(n_kept, n_kept).triangularView<Eigen::Lower>().solve(cross_cov);
+            Eigen::LLT<Eigen::MatrixXd> chol_schur(new_cov - new_rows.transpose() * new_rows);
+            success = chol_schur.info() == Eigen::Success;
+
+            factor.bottomLeftCorner(n_add, n_kept) = new_rows.transpose();
+            factor.bottomRightCorner(n_add, n_add) = chol_schur.matrixL();
+            gram.topRightCorner(n_kept, n_add) = cross_cov;
+            gram.bottomLeftCorner(n_add, n_kept) = cross_cov.transpose();
+            gram.bottomRightCorner(n_add, n_add) = new_cov;
+        }
+
+        if (success)
+        {
+            chol_factor_.swap(factor);
+            gram_matrix_.swap(gram);
+            data_loc_.swap(loc);
+            data_out_.resize(n_new);
+            if (use_var)
+            {
+                data_var_.resize(n_new);
+            }
+            for (int k = 0; k < n_new; ++k)
+            {
+                data_out_[k] = data_out[index[k]];
+                if (use_var)
+                {
+                    data_var_[k] = data_var[index[k]];
+                }
+            }
+            computeWeights();
+            return;
+        }
+    }
+
+    // fall back to the full inference
+    data_loc_ = data_loc;
+    data_out_ = data_out;
+    if (use_var)
+    {
+        data_var_ = data_var;
     }
+    infer();
 }
 
 void GP::infer(const Eigen::VectorXd& data_loc, const Eigen::VectorXd& data_out,
@@ -281,6 +560,19 @@ void GP::inferSD(const Eigen::VectorXd& data_loc, const Eigen::VectorXd& data_ou
             }
         }
 
+        if (use_incremental_inference_)
+        {
+            Eigen::VectorXd loc = Eigen::Map<Eigen::VectorXd>(loc_arr.data(), n, 1);
+            Eigen::VectorXd out = Eigen::Map<Eigen::VectorXd>(out_arr.data(), n, 1);
+            Eigen::VectorXd var;
+            if (use_var)
+            {
+                var = Eigen::Map<Eigen::VectorXd>(var_arr.data(), n, 1);
+            }
+            inferIncremental(loc, out, var);
+            return;
+        }
+
         data_loc_ = Eigen::Map<Eigen::VectorXd>(loc_arr.data(), n, 1);
         data_out_ = Eigen::Map<Eigen::VectorXd>(out_arr.data(), n, 1);
         if (use_var)
@@ -290,6 +582,12 @@ void GP::inferSD(const Eigen::VectorXd& data_loc, const Eigen::VectorXd& data_ou
     }
     else // we can use all points and don't neet to select
     {
+        if (use_incremental_inference_)
+        {
+            inferIncremental(data_loc, data_out, use_var ? data_var : Eigen::VectorXd());
+            return;
+        }
+
         data_loc_ = data_loc;
         data_out_ = data_out;
         if (use_var)
@@ -304,8 +602,13 @@ void GP::clearData()
 {
     gram_matrix_ = Eigen::MatrixXd();
     chol_gram_matrix_ = Eigen::LDLT<Eigen::MatrixXd>();
+    chol_factor_ = Eigen::MatrixXd();
+    chol_factor_valid_ = false;
     data_loc_ = Eigen::VectorXd();
     data_out_ = Eigen::VectorXd();
+    data_features_ = Eigen::MatrixXd();
+    data_features_proj_ = Eigen::MatrixXd();
+    mean_weights_ = Eigen::VectorXd();
 }
 
 Eigen::VectorXd GP::predict(const Eigen::VectorXd& locations, Eigen::VectorXd *variances /*=nullptr*/) const
@@ -392,7 +695,7 @@ Eigen::VectorXd GP::predict(const Eigen::MatrixXd& prior_cov, const Eigen::Matri
     Eigen::VectorXd m = mixed_cov * alpha_;
 
     // precompute K^{-1} * mixed_cov
-    Eigen::MatrixXd gamma = chol_gram_matrix_.solve(mixed_cov.transpose());
+    Eigen::MatrixXd gamma = solveGram(mixed_cov.transpose());
 
     Eigen::MatrixXd R;
 
@@ -421,6 +724,92 @@ Eigen::VectorXd GP::predict(const Eigen::MatrixXd& prior_cov, const Eigen::Matri
     return m;
 }
 
+const Eigen::VectorXd& GP::predict(const Eigen::VectorXd& locations, PredictionWorkspace& workspace,
+                                   Eigen::VectorXd *variances /*=nullptr*/) const
+{
+    return predict(covFunc_, data_features_, locations, workspace, variances);
+}
+
+const Eigen::VectorXd& GP::predictProjected(const Eigen::VectorXd& locations, PredictionWorkspace& workspace,
+                                            Eigen::VectorXd *variances /*=nullptr*/) const
+{
+    // use the suitable covariance function, depending on whether an
+    // output projection is used or not.
+    if (covFuncProj_ == nullptr)
+    {
+        return predict(covFunc_, data_features_, locations, workspace, variances);
+    }
+    return predict(covFuncProj_, data_features_proj_, locations, workspace, variances);
+}
+
+const Eigen::VectorXd& GP::predict(covariance_functions::CovFunc *covFunc, const Eigen::MatrixXd& data_features,
+                                   const Eigen::VectorXd& locations, PredictionWorkspace& workspace,
+                                   Eigen::VectorXd *variances) const
+{
+    assert(covFunc != nullptr);
+
+    covFunc->computeFeatures(locations, workspace.features);
+
+    // The prior covariance matrix (evaluated on test points), only needed for the variances
+    if (variances != nullptr)
+    {
+        covFunc->evaluateFeatures(workspace.features, workspace.features, workspace.prior_cov);
+    }
+
+    if (data_loc_.rows() == 0) // check if the data is empty
+    {
+        if (variances != nullptr)
+        {
+            (*variances) = workspace.prior_cov.diagonal();
+        }
+        workspace.mean.setZero(locations.rows());
+        return workspace.mean;
+    }
+
+    // The mixed covariance matrix (test and data points)
+    covFunc->evaluateFeatures(workspace.features, data_features, workspace.mixed_cov);
+
+    // GP mean from the precomputed weights, which already contain the data part of the explicit trend
+    workspace.mean.resize(locations.rows());
+    workspace.mean.noalias() = workspace.mixed_cov * mean_weights_;
+    if (use_explicit_trend_)
+    {
+        workspace.mean.array() += beta_(0) + beta_(1) * locations.array();
+    }
+
+    if (variances != nullptr)
+    {
+        // precompute K^{-1} * mixed_cov
+        workspace.gamma = workspace.mixed_cov.transpose();
+        solveGramInPlace(workspace.gamma);
+
+        variances->resize(locations.rows());
+        for (int i = 0; i < locations.rows(); ++i)
+        {
+            (*variances)(i) = workspace.prior_cov(i, i) - workspace.mixed_cov.row(i).dot(workspace.gamma.col(i));
+        }
+
+        // include fixed-features in the calculations
+        if (use_explicit_trend_)
+        {
+            // R = phi - H * gamma
+            workspace.trend_residual.resize(2, locations.rows());
+            workspace.trend_residual.noalias() = -feature_vectors_ * workspace.gamma;
+            workspace.trend_residual.row(0).array() += 1.0;
+            workspace.trend_residual.row(1) += locations.transpose();
+
+            workspace.trend_solved = workspace.trend_residual;
+            chol_feature_matrix_.solveInPlace(workspace.trend_solved);
+
+            for (int i = 0; i < locations.rows(); ++i)
+            {
+                (*variances)(i) += workspace.trend_residual.col(i).dot(workspace.trend_solved.col(i));
+            }
+        }
+    }
+    return workspace.mean;
+}
+
 void GP::setHyperParameters(const Eigen::VectorXd& hyperParameters)
 {
     assert(hyperParameters.rows() == covFunc_->getParameterCount() + covFunc_->getExtraParameterCount() + 1 &&
@@ -438,6 +827,7 @@ void GP::setHyperParameters(const Eigen::VectorXd& hyperParameters)
     {
         covFuncProj_->setParameters(hyperParameters.segment(1, covFunc_->getParameterCount()));
         covFuncProj_->setExtraParameters(hyperParameters.tail(covFunc_->getExtraParameterCount()));
+        updateDataFeatures(); // the features of the projection depend on its parameters
     }
 }
 
@@ -457,3 +847,19 @@ void GP::disableExplicitTrend()
 {
     use_explicit_trend_ = false;
 }
+
+void GP::enableIncrementalInference()
+{
+    use_incremental_inference_ = true;
+}
+
+void GP::disableIncrementalInference()
+{
+    if (chol_factor_valid_)
+    {
+        // the regular path needs the LDL^T decomposition of the current Gram matrix
+        chol_gram_matrix_ = gram_matrix_.ldlt();
+        chol_factor_valid_ = false;
+    }
+    use_incremental_inference_ = false;
+}
@@ -61,6 +61,23 @@
 
 class GP
 {
+public:
+    /*!
+     * Buffers for predictions. Repeated predictions with the same workspace
+     * don't allocate memory as long as the number of prediction locations
+     * and datapoints stays the same.
+     */
+    struct PredictionWorkspace
+    {
+        Eigen::MatrixXd features; // covariance function features of the prediction locations
+        Eigen::MatrixXd prior_cov;
+        Eigen::MatrixXd mixed_cov;
+        Eigen::MatrixXd gamma; // K^{-1} * mixed_cov^T, only needed for the variances
+        Eigen::MatrixXd trend_residual; // feature vectors not explained by the data, only needed for the variances
+        Eigen::MatrixXd trend_solved;
+        Eigen::VectorXd mean;
+    };
+
 private:
     covariance_functions::CovFunc *covFunc_;
     covariance_functions::CovFunc *covFuncProj_;
@@ -76,6 +93,62 @@ private:
     Eigen::MatrixXd feature_matrix_;
     Eigen::LDLT<Eigen::MatrixXd> chol_feature_matrix_;
     Eigen::VectorXd beta_;
+    bool use_incremental_inference_;
+    Eigen::MatrixXd chol_factor_; // lower Cholesky factor of the Gram matrix for incremental inference
+    bool chol_factor_valid_;
+    Eigen::MatrixXd data_features_; // covariance function features of the data locations
+    Eigen::MatrixXd data_features_proj_; // same for the output projection
+    Eigen::VectorXd mean_weights_; // weights of the mixed covariance in the posterior mean, including the trend
+
+    /*!
+     * Solves the Gram matrix system for the given right hand side, using the
+     * incrementally maintained Cholesky factor if it is valid.
+     */
+    Eigen::MatrixXd solveGram(const Eigen::MatrixXd& rhs) const;
+
+    /*!
+     * Same as solveGram(), but overwrites the right hand side with the
+     * solution instead of allocating a new matrix.
+     */
+    void solveGramInPlace(Eigen::MatrixXd& rhs) const;
+
+    /*!
+     * Computes the covariance function features of the data locations.
+     */
+    void updateDataFeatures();
+
+    /*!
+     * Computes the Cholesky decomposition of the current Gram matrix.
+     */
+    void factorizeGramMatrix();
+
+    /*!
+     * Computes alpha and the explicit trend from the decomposed Gram matrix.
+     */
+    void computeWeights();
+
+    /*!
+     * Removes the given datapoints (sorted indices) from the Cholesky factor
+     * with rank-1 updates of the trailing blocks. The rows and columns of the
+     * removed points are left in place and have to be dropped by the caller.
+     */
+    void downdateCholeskyFactor(const std::vector<int>& removed);
+
+    /*!
+     * Updates the inference to the given datapoints by removing the stored
+     * points that are not part of the new set and appending the new ones.
+     * Falls back to a full infer() if too many points change.
+     */
+    void inferIncremental(const Eigen::VectorXd& data_loc, const Eigen::VectorXd& data_out,
+                          const Eigen::VectorXd& data_var);
+
+    /*!
+     * Does the real work for the workspace based predictions, using the given
+     * covariance function and the matching features of the data.
+     */
+    const Eigen::VectorXd& predict(covariance_functions::CovFunc *covFunc, const Eigen::MatrixXd& data_features,
+                                   const Eigen::VectorXd& locations, PredictionWorkspace& workspace,
+                                   Eigen::VectorXd *variances) const;
 
 public:
     typedef std::pair<Eigen::VectorXd, Eigen::MatrixXd> VectorMatrixPair;
@@ -176,6 +249,22 @@ public:
     Eigen::VectorXd predict(const Eigen::MatrixXd& prior_cov, const Eigen::MatrixXd& mixed_cov,
                             const Eigen::MatrixXd& phi = Eigen::MatrixXd(), Eigen::VectorXd *variances = nullptr) const;
 
+    /*!
+     * Predicts the mean and, if requested, the variances for a vector of
+     * locations like predict(), but keeps all intermediate results in the
+     * given workspace. The covariances are computed from features of the
+     * data that are cached with every inference. The returned mean is
+     * stored in the workspace and is valid until its next use.
+     */
+    const Eigen::VectorXd& predict(const Eigen::VectorXd& locations, PredictionWorkspace& workspace,
+                                   Eigen::VectorXd *variances = nullptr) const;
+
+    /*!
+     * Same as predict() with a workspace, but based on the output projection.
+     */
+    const Eigen::VectorXd& predictProjected(const Eigen::VectorXd& locations, PredictionWorkspace& workspace,
+                                            Eigen::VectorXd *variances = nullptr) const;
+
     /*!
      * Sets the hyperparameters to the given vector.
      */
@@ -195,6 +284,20 @@ public:
      * Disables the use of a explicit linear basis function.
      */
     void disableExplicitTrend();
+
+    /*!
+     * Enables incremental inference for inferSD(). Instead of rebuilding the
+     * Gram matrix and its decomposition on every call, the points that left
+     * the subset are removed with Cholesky downdates and the new points are
+     * appended, so the cost per call is quadratic in the number of points as
+     * long as the hyperparameters stay the same.
+     */
+    void enableIncrementalInference();
+
+    /*!
+     * Disables incremental inference, every inferSD() call does a full infer().
+     */
+    void disableIncrementalInference();
 };
 
 #endif // ifndef GAUSSIAN_PROCESS_H
@@ -47,29 +47,35 @@
 #include <iomanip>
 #include <fstream>
 
-#define SAVE_FFT_DATA_ 0
 #define PRINT_TIMINGS_ 0
 
 #define CIRCULAR_BUFFER_SIZE 8192 // for the raw data storage
 #define REGULAR_BUFFER_SIZE 2048 // for the regularized data storage
 #define FFT_SIZE 4096 // for zero-padding the FFT, >= REGULAR_BUFFER_SIZE!
+#define MAX_PERIOD_LENGTH 1500.0 // longer periods are ignored by the period estimation
 #define GRID_INTERVAL 5.0
 #define MAX_DITHER_STEPS 10 // for our fallback dithering
 
 #define DEFAULT_LEARNING_RATE 0.01 // for a smooth parameter adaptation
+#define PERIOD_UPDATE_TOLERANCE 1e-4 // relative period change that is passed on to the GP with incremental inference
 
 #define HYSTERESIS 0.1 // for the hybrid mode
 
 GaussianProcessGuider::GaussianProcessGuider(guide_parameters parameters)
     : start_time_(clock::now()), last_time_(clock::now()), control_signal_(0), prediction_(0), last_prediction_end_(0),
       dither_steps_(0), dithering_active_(false), dither_offset_(0.0), circular_buffer_data_(CIRCULAR_BUFFER_SIZE),
-      covariance_function_(), output_covariance_function_(), gp_(covariance_function_), learning_rate_(DEFAULT_LEARNING_RATE),
-      parameters(parameters)
+      covariance_function_(), output_covariance_function_(), gp_(covariance_function_),
+      period_estimator_(FFT_SIZE, MAX_PERIOD_LENGTH), prediction_locations_(2), learning_rate_(DEFAULT_LEARNING_RATE),
+      pending_period_length_(std::numeric_limits<double>::quiet_NaN()), parameters(parameters)
 {
     circular_buffer_data_.push_front(data_point()); // add first point
     circular_buffer_data_[0].control = 0; // set first control to zero
     gp_.enableExplicitTrend(); // enable the explicit basis function for the linear drift
     gp_.enableOutputProjection(output_covariance_function_); // for prediction
+    if (parameters.incremental_inference_)
+    {
+        gp_.enableIncrementalInference();
+    }
 
     std::vector<double> hyperparameters(NumParameters);
     hyperparameters[SE0KLengthScale] = parameters.SE0KLengthScale_;
@@ -155,7 +161,6 @@ void GaussianProcessGuider::UpdateGP(double prediction_point /*= std::numeric_li
     }
 
     Eigen::VectorXd gear_error(N - 1);
-    Eigen::VectorXd linear_fit(N - 1);
 
     // calculate the accumulated gear error
     gear_error = sum_controls + measurements; // for each time step, add the residual error
@@ -190,12 +195,6 @@ void GaussianProcessGuider::UpdateGP(double prediction_point /*= std::numeric_li
                                   .ldlt()
                                   .solve(feature_matrix * gear_error);
 
-    // calculate the linear regression for all datapoints
-    linear_fit = weights.transpose() * feature_matrix;
-
-    // subtract polynomial fit from the data points
-    Eigen::VectorXd gear_error_detrend = gear_error - linear_fit;
-
 #if PRINT_TIMINGS_
     end = std::clock();
     double time_detrend = double(end - begin) / CLOCKS_PER_SEC;
@@ -207,8 +206,8 @@ void GaussianProcessGuider::UpdateGP(double prediction_point /*= std::numeric_li
     double period_length = GetGPHyperparameters()[PKPeriodLength];
     if (GetBoolComputePeriod() && get_last_point().timestamp > parameters.min_periods_for_period_estimation_ * period_length)
     {
-        // find periodicity parameter with FFT
-        period_length = EstimatePeriodLength(timestamps, gear_error_detrend);
+        // find periodicity parameter from the spectrum of the de-trended data
+        period_length = period_estimator_.Estimate(timestamps, gear_error, weights);
         UpdatePeriodLength(period_length);
 
 #if PRINT_TIMINGS_
@@ -242,16 +241,15 @@ double GaussianProcessGuider::PredictGearError(double prediction_location)
     }
 
     // prediction from the last endpoint to the prediction point
-    Eigen::VectorXd next_location(2);
-    next_location << last_prediction_end_, prediction_location + dither_offset_;
-    Eigen::VectorXd prediction = gp_.predictProjected(next_location);
+    prediction_locations_ << last_prediction_end_, prediction_location + dither_offset_;
+    const Eigen::VectorXd& prediction = gp_.predictProjected(prediction_locations_, prediction_workspace_);
 
     double p1 = prediction(1);
     double p0 = prediction(0);
 
     assert(!math_tools::isNaN(p1 - p0));
 
-    last_prediction_end_ = next_location(1); // store current endpoint
+    last_prediction_end_ = prediction_locations_(1); // store current endpoint
 
     // we are interested in the error introduced by the gear over the next time step
     return p1 - p0;
@@ -409,6 +407,7 @@ void GaussianProcessGuider::reset()
 {
     circular_buffer_data_.clear();
     gp_.clearData();
+    period_estimator_.Reset();
 
     // We need to add a first data point because the measurements are always relative to the control.
     // For the first measurement, we therefore need to add a point with zero control.
@@ -471,6 +470,32 @@ bool GaussianProcessGuider::SetBoolComputePeriod(bool active)
     return false;
 }
 
+bool GaussianProcessGuider::GetBoolIncrementalInference() const
+{
+    return parameters.incremental_inference_;
+}
+
+bool GaussianProcessGuider::SetBoolIncrementalInference(bool active)
+{
+    parameters.incremental_inference_ = active;
+    if (active)
+    {
+        gp_.enableIncrementalInference();
+    }
+    else
+    {
+        gp_.disableIncrementalInference();
+        if (!math_tools::isNaN(pending_period_length_))
+        {
+            // pass on the collected period update
+            std::vector<double> hypers = GetGPHyperparameters();
+            hypers[PKPeriodLength] = pending_period_length_;
+            SetGPHyperparameters(hypers);
+        }
+    }
+    return false;
+}
+
 std::vector<double> GaussianProcessGuider::GetGPHyperparameters() const
 {
     // since the GP class works in log space, we have to exp() the parameters first.
@@ -508,6 +533,7 @@ bool GaussianProcessGuider::SetGPHyperparameters(std::vector<double> const& hype
 
     // the GP works in log space, therefore we need to convert
     gp_.setHyperParameters(hyperparameters_full.array().log());
+    pending_period_length_ = std::numeric_limits<double>::quiet_NaN(); // the GP is up to date
     return false;
 }
 
@@ -579,93 +605,16 @@ void GaussianProcessGuider::inject_data_point(double timestamp, double input, do
     HandleControls(control); // already store control signal
 }
 
-double GaussianProcessGuider::EstimatePeriodLength(const Eigen::VectorXd& time, const Eigen::VectorXd& data)
+void GaussianProcessGuider::UpdatePeriodLength(double period_length)
 {
-    // compute Hamming window to reduce spectral leakage
-    Eigen::VectorXd windowed_data = data.array() * math_tools::hamming_window(data.rows()).array();
-
-    // compute the spectrum
-    std::pair<Eigen::VectorXd, Eigen::VectorXd> result = math_tools::compute_spectrum(windowed_data, FFT_SIZE);
-
-    Eigen::ArrayXd amplitudes = result.first;
-    Eigen::ArrayXd frequencies = result.second;
-
-    double dt = (time(time.rows() - 1) - time(0)) / (time.rows() - 1); // (t_end - t_begin) / num_t
-
-    frequencies /= dt; // correct for the average time step width
-
-    Eigen::ArrayXd periods = 1 / frequencies.array();
-    amplitudes = (periods > 1500.0).select(0, amplitudes); // set amplitudes to zero for too large periods
-
-    assert(amplitudes.size() == frequencies.size());
-
-    Eigen::VectorXd::Index maxIndex;
-    amplitudes.maxCoeff(&maxIndex);
-
-    double max_frequency = frequencies(maxIndex);
-
-    // quadratic interpolation to find maximum
-    // check if we can interpolate
-    if (maxIndex < frequencies.size() - 1 && maxIndex > 0)
-    {
-        double spread = std::abs(frequencies(maxIndex - 1) - frequencies(maxIndex + 1));
-
-        Eigen::VectorXd interp_loc(3);
-        interp_loc << frequencies(maxIndex - 1), frequencies(maxIndex), frequencies(maxIndex + 1);
-        interp_loc = interp_loc.array() - max_frequency; // centering for numerical stability
-        interp_loc = interp_loc.array() / spread; // normalize for numerical stability
-
-        Eigen::VectorXd interp_dat(3);
-        interp_dat << amplitudes(maxIndex - 1), amplitudes(maxIndex), amplitudes(maxIndex + 1);
-        interp_dat = interp_dat.array() / amplitudes(maxIndex); // normalize for numerical stability
-
-        // we need to handle the case where all amplitudes are equal
-        // the linear regression would be unstable in this case
-        if (interp_dat.maxCoeff() - interp_dat.minCoeff() < 1e-10)
-        {
-            return 1 / max_frequency; // don't do the linear regression
-        }
-
-        // building feature matrix
-        Eigen::MatrixXd phi(3, 3);
-        phi.row(0) = interp_loc.array().pow(2);
-        phi.row(1) = interp_loc.array().pow(1);
-        phi.row(2) = interp_loc.array().pow(0);
-
-        // standard equation for linear regression
-        Eigen::VectorXd w = (phi * phi.transpose()).ldlt().solve(phi * interp_dat);
-
-        // recovering the maximum from the weights relative to the frequency of the maximum
-        max_frequency = max_frequency - w(1) / (2 * w(0)) * spread; // note the de-normalization
-    }
+    std::vector<double> hypers = GetGPHyperparameters();
+    double gp_period_length = hypers[PKPeriodLength];
 
-#if SAVE_FFT_DATA_
+    // continue from the collected period update, if there is one
+    if (!math_tools::isNaN(pending_period_length_))
     {
-        std::ofstream outfile;
-        outfile.open("spectrum_data.csv", std::ios_base::out);
-        if (outfile)
-        {
-            outfile << "period, amplitude\n";
-            for (int i = 0; i < amplitudes.size(); ++i)
-            {
-                outfile << std::setw(8) << periods[i] << "," << std::setw(8) << amplitudes[i] << "\n";
-            }
-        }
-        else
-        {
-            std::cout << "unable to write to file" << std::endl;
-        }
-        outfile.close();
+        hypers[PKPeriodLength] = pending_period_length_;
     }
-#endif
-
-    double period_length = 1 / max_frequency; // we return the period length!
-    return period_length;
-}
-
-void GaussianProcessGuider::UpdatePeriodLength(double period_length)
-{
-    std::vector<double> hypers = GetGPHyperparameters();
 
     // assert for the developers...
     assert(!math_tools::isNaN(period_length));
@@ -679,6 +628,14 @@ void GaussianProcessGuider::UpdatePeriodLength(double period_length)
     // we just apply a simple learning rate to slow down parameter jumps
     hypers[PKPeriodLength] = (1 - learning_rate_) * hypers[PKPeriodLength] + learning_rate_ * period_length;
 
+    // with incremental inference, small changes are collected to keep the decomposition of the GP
+    if (parameters.incremental_inference_ &&
+        std::abs(hypers[PKPeriodLength] - gp_period_length) < PERIOD_UPDATE_TOLERANCE * gp_period_length)
+    {
+        pending_period_length_ = hypers[PKPeriodLength];
+        return;
+    }
+
     SetGPHyperparameters(hypers); // the setter function is needed to convert parameters
 }
 
@@ -46,6 +46,7 @@
 #include "gaussian_process.h"
 #include "covariance_functions.h"
 #include "math_tools.h"
+#include "period_estimator.h"
 
 #include <chrono>
 
@@ -96,6 +97,7 @@ public:
         int points_for_approximation_;
 
         bool compute_period_;
+        bool incremental_inference_;
 
         double SE0KLengthScale_;
         double SE0KSignalVariance_;
@@ -108,8 +110,8 @@ public:
         guide_parameters()
             : control_gain_(0.0), min_move_(0.0), prediction_gain_(0.0), min_periods_for_inference_(0.0),
               min_periods_for_period_estimation_(0.0), points_for_approximation_(0), compute_period_(false),
-              SE0KLengthScale_(0.0), SE0KSignalVariance_(0.0), PKLengthScale_(0.0), PKSignalVariance_(0.0),
-              SE1KLengthScale_(0.0), SE1KSignalVariance_(0.0), PKPeriodLength_(0.0)
+              incremental_inference_(false), SE0KLengthScale_(0.0), SE0KSignalVariance_(0.0), PKLengthScale_(0.0),
+              PKSignalVariance_(0.0), SE1KLengthScale_(0.0), SE1KSignalVariance_(0.0), PKPeriodLength_(0.0)
         {
         }
     };
@@ -133,12 +135,28 @@ private:
     covariance_functions::PeriodicSquareExponential2 covariance_function_; // for inference
     covariance_functions::PeriodicSquareExponential output_covariance_function_; // for prediction
     GP gp_;
+    PeriodEstimator period_estimator_;
+
+    /**
+     * Buffers for the prediction in every guiding step, to avoid allocating
+     * memory for the two prediction locations and the covariances each time.
+     */
+    Eigen::VectorXd prediction_locations_;
+    GP::PredictionWorkspace prediction_workspace_;
 
     /**
      * Learning rate for smooth parameter adaptation.
      */
     double learning_rate_;
 
+    /**
+     * Filtered period length that has not been passed to the GP yet, NaN if
+     * the GP is up to date. With incremental inference, small period updates
+     * are collected here because every parameter change of the GP needs a new
+     * decomposition of the Gram matrix.
+     */
+    double pending_period_length_;
+
     /**
      * Guiding parameters of this instance.
      */
@@ -170,11 +188,6 @@ private:
      */
     double CalculateVariance(double SNR);
 
-    /**
-     * Estimates the main period length for a given dataset.
-     */
-    double EstimatePeriodLength(const Eigen::VectorXd& time, const Eigen::VectorXd& data);
-
     /**
      * Calculates the difference in gear error for the time between the last
      * prediction point and the current prediction point, which lies one
@@ -201,6 +214,9 @@ public:
     bool GetBoolComputePeriod() const;
     bool SetBoolComputePeriod(bool active);
 
+    bool GetBoolIncrementalInference() const;
+    bool SetBoolIncrementalInference(bool active);
+
     std::vector<double> GetGPHyperparameters() const;
     bool SetGPHyperparameters(const std::vector<double>& hyperparameters);
 
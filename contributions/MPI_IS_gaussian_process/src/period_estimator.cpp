@@ -0,0 +1,180 @@
+/**
+ * PHD2 Guiding
+ *
+ * @file
+ * @date      2026
+ * @copyright openphdguiding.org
+ *
+ * @brief     Estimates the main period length of the gear error
+ */
+
+/*
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "period_estimator.h"
+#include "math_tools.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#define SAVE_FFT_DATA_ 0
+
+PeriodEstimator::PeriodEstimator(int fft_size, double max_period)
+    : fft_size_(fft_size), max_period_(max_period), fft_length_(0), period_length_(0.0)
+{
+    fft_.SetFlag(Eigen::FFT<double>::HalfSpectrum);
+}
+
+int PeriodEstimator::FFTLength(int N) const
+{
+    int length = std::max(N, fft_size_);
+    return static_cast<int>(std::pow(2, std::ceil(std::log(length) / std::log(2)))); // map to nearest power of 2
+}
+
+double PeriodEstimator::EstimateFull(const Eigen::VectorXd& time, const Eigen::VectorXd& data, const Eigen::Vector2d& trend)
+{
+    int N = data.rows();
+    fft_length_ = FFTLength(N);
+
+    // compute Hamming window to reduce spectral leakage
+    if (window_.rows() != N)
+    {
+        window_ = math_tools::hamming_window(N);
+    }
+
+    // zero-padded, detrended and windowed data
+    fft_input_.assign(fft_length_, 0.0);
+    for (int n = 0; n < N; ++n)
+    {
+        fft_input_[n] = window_(n) * (data(n) - trend(0) - trend(1) * time(n));
+    }
+    fft_.fwd(fft_output_, fft_input_);
+
+    // the low_index is the lowest useful frequency, depending on the number of actual datapoints
+    int low_index = static_cast<int>(std::ceil(static_cast<double>(fft_length_) / N));
+    int high_index = fft_length_ / 2;
+    double dt = (time(N - 1) - time(0)) / (N - 1); // (t_end - t_begin) / num_t
+
+    amplitudes_.resize(high_index - low_index + 1);
+    for (int k = low_index; k <= high_index; ++k)
+    {
+        amplitudes_[k - low_index] = std::norm(fft_output_[k]);
+        if (fft_length_ * dt / k > max_period_)
+        {
+            amplitudes_[k - low_index] = 0; // set amplitudes to zero for too large periods
+        }
+    }
+
+#if SAVE_FFT_DATA_
+    {
+        std::ofstream outfile;
+        outfile.open("spectrum_data.csv", std::ios_base::out);
+        if (outfile)
+        {
+            outfile << "period, amplitude\n";
+            for (int k = low_index; k <= high_index; ++k)
+            {
+                outfile << std::setw(8) << fft_length_ * dt / k << "," << std::setw(8) << amplitudes_[k - low_index] << "\n";
+            }
+        }
+        else
+        {
+            std::cout << "unable to write to file" << std::endl;
+        }
+        outfile.close();
+    }
+#endif
+
+    int max_index = static_cast<int>(std::max_element(amplitudes_.begin(), amplitudes_.end()) - amplitudes_.begin());
+
+    bool has_neighbors = max_index > 0 && max_index < static_cast<int>(amplitudes_.size()) - 1;
+    return InterpolatePeak(&amplitudes_[max_index], low_index + max_index, has_neighbors, dt);
+}
+
+double PeriodEstimator::InterpolatePeak(const double *amplitudes, int bin, bool has_neighbors, double dt) const
+{
+    double max_frequency = static_cast<double>(bin) / fft_length_ / dt;
+
+    // quadratic interpolation to find maximum
+    if (has_neighbors)
+    {
+        double spread = 2.0 / fft_length_ / dt;
+
+        Eigen::Vector3d interp_loc(-0.5, 0.0, 0.5); // centered and normalized for numerical stability
+
+        Eigen::Vector3d interp_dat(amplitudes[-1], amplitudes[0], amplitudes[1]);
+        interp_dat = interp_dat.array() / amplitudes[0]; // normalize for numerical stability
+
+        // we need to handle the case where all amplitudes are equal
+        // the linear regression would be unstable in this case
+        if (interp_dat.maxCoeff() - interp_dat.minCoeff() < 1e-10)
+        {
+            return 1 / max_frequency; // don't do the linear regression
+        }
+
+        // building feature matrix
+        Eigen::Matrix3d phi;
+        phi.row(0) = interp_loc.array().pow(2);
+        phi.row(1) = interp_loc.array().pow(1);
+        phi.row(2) = interp_loc.array().pow(0);
+
+        // standard equation for linear regression
+        Eigen::Vector3d w = (phi * phi.transpose()).ldlt().solve(phi * interp_dat);
+
+        // recovering the maximum from the weights relative to the frequency of the maximum
+        max_frequency = max_frequency - w(1) / (2 * w(0)) * spread; // note the de-normalization
+    }
+
+    return 1 / max_frequency; // we return the period length!
+}
+
+double PeriodEstimator::Estimate(const Eigen::VectorXd& time, const Eigen::VectorXd& data, const Eigen::Vector2d& trend)
+{
+    // the regularized grid of the GP guider only grows every few seconds, so most calls see the same data
+    bool unchanged = data.rows() > 0 && data.rows() == data_.rows() && time.rows() == time_.rows() && trend == trend_ &&
+        time == time_ && data == data_;
+    if (unchanged)
+    {
+        return period_length_;
+    }
+
+    time_ = time;
+    data_ = data;
+    trend_ = trend;
+    period_length_ = EstimateFull(time, data, trend);
+    return period_length_;
+}
+
+void PeriodEstimator::Reset()
+{
+    time_.resize(0);
+    data_.resize(0);
+    trend_.setZero();
+    period_length_ = 0.0;
+}
@@ -0,0 +1,107 @@
+/**
+ * PHD2 Guiding
+ *
+ * @file
+ * @date      2026
+ * @copyright openphdguiding.org
+ *
+ * @brief     Estimates the main period length of the gear error
+ */
+
+/*
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PERIOD_ESTIMATOR_H
+#define PERIOD_ESTIMATOR_H
+
+#include <Eigen/Dense>
+#include <unsupported/Eigen/FFT>
+
+#include <complex>
+#include <vector>
+
+/**
+ * Estimates the main period length of a regularly sampled dataset from the
+ * maximum of its Hamming-windowed, zero-padded spectrum.
+ *
+ * The spectrum is computed with an FFT whose plan and buffers are reused
+ * between calls, and the period of the previous call is returned if the data
+ * hasn't changed. Any other call scans the whole spectrum.
+ */
+class PeriodEstimator
+{
+private:
+    int fft_size_;
+    double max_period_;
+
+    Eigen::FFT<double> fft_;
+    int fft_length_;
+    std::vector<double> fft_input_;
+    std::vector<std::complex<double>> fft_output_;
+    std::vector<double> amplitudes_;
+    Eigen::VectorXd window_; // Hamming window for the current data length
+
+    // the data of the previous call
+    Eigen::VectorXd time_;
+    Eigen::VectorXd data_;
+    Eigen::Vector2d trend_;
+    double period_length_;
+
+    /**
+     * Returns the zero-padded FFT length for N samples.
+     */
+    int FFTLength(int N) const;
+
+    /**
+     * Returns the period length of the spectral maximum at the given bin,
+     * refined by quadratic interpolation with the neighboring bins if they
+     * are given.
+     */
+    double InterpolatePeak(const double *amplitudes, int bin, bool has_neighbors, double dt) const;
+
+public:
+    PeriodEstimator(int fft_size, double max_period);
+
+    /**
+     * Returns the main period length of the data after removing the linear
+     * trend trend(0) + trend(1) * time. The timestamps have to be regularly
+     * spaced. The result is the same as EstimateFull.
+     */
+    double Estimate(const Eigen::VectorXd& time, const Eigen::VectorXd& data, const Eigen::Vector2d& trend);
+
+    /**
+     * Returns the period length from a full scan of the spectrum. The result
+     * doesn't depend on previous calls, which makes it useful as a reference.
+     */
+    double EstimateFull(const Eigen::VectorXd& time, const Eigen::VectorXd& data, const Eigen::Vector2d& trend);
+
+    /**
+     * Forgets the data seen so far.
+     */
+    void Reset();
+};
+
+#endif // PERIOD_ESTIMATOR_H
@@ -38,6 +38,7 @@
 #include <gtest/gtest.h>
 #include <vector>
 #include <iostream>
+#include <chrono>
 #include "math_tools.h"
 #include "gaussian_process.h"
 #include "covariance_functions.h"
@@ -357,6 +358,180 @@ TEST_F(GPTest, CovarianceTest3)
     }
 }
 
+// Builds a GP like the one of the GP guider, on a dataset of regularly spaced points
+static GP make_guider_like_gp(Eigen::VectorXd *locations, Eigen::VectorXd *outputs, Eigen::VectorXd *variances, int N)
+{
+    Eigen::VectorXd hyperParams(8);
+    hyperParams << 1.0, 700, 20, 4 * std::sin(10 * M_PI / 200), 20, 25, 10, 200;
+    hyperParams = hyperParams.array().log();
+
+    covariance_functions::PeriodicSquareExponential2 covFunc;
+    GP gp(covFunc);
+    gp.enableExplicitTrend();
+    gp.setHyperParameters(hyperParams);
+
+    *locations = Eigen::VectorXd(N);
+    *outputs = Eigen::VectorXd(N);
+    *variances = Eigen::VectorXd(N);
+    for (int i = 0; i < N; ++i)
+    {
+        double t = 2.5 + 5.0 * i;
+        (*locations)(i) = t;
+        (*outputs)(i) = 5.0 * std::sin(2 * M_PI * t / 200) + 0.01 * t + 0.3 * std::sin(0.7 * t);
+        (*variances)(i) = 0.5 + 0.25 * std::cos(0.3 * t);
+    }
+    return gp;
+}
+
+// The incremental inference has to give the same predictions as the full inference
+TEST_F(GPTest, incremental_inferSD_matches_full)
+{
+    Eigen::VectorXd locations, outputs, variances;
+    GP full_gp = make_guider_like_gp(&locations, &outputs, &variances, 300);
+    GP incremental_gp = full_gp;
+    incremental_gp.enableIncrementalInference();
+
+    int n = 60;
+    Eigen::VectorXd test_locations(3);
+    for (int N = 5; N <= 300; ++N)
+    {
+        Eigen::VectorXd loc = locations.head(N);
+        Eigen::VectorXd out = outputs.head(N);
+        Eigen::VectorXd var = variances.head(N);
+        out.array() += 0.1 * N; // the outputs of kept points change as well
+        if (N % 50 == 0)
+        {
+            var(N - 1) *= 2; // the variance of a kept point changes
+        }
+        if (N == 150)
+        {
+            // a parameter change needs a new decomposition
+            Eigen::VectorXd hyperParams = full_gp.getHyperParameters();
+            hyperParams(7) = std::log(210);
+            full_gp.setHyperParameters(hyperParams);
+            incremental_gp.setHyperParameters(hyperParams);
+        }
+
+        double prediction_point = loc(N - 1) + 3.0;
+        full_gp.inferSD(loc, out, n, var, prediction_point);
+        incremental_gp.inferSD(loc, out, n, var, prediction_point);
+
+        test_locations << loc(N - 1), prediction_point, prediction_point + 100;
+        Eigen::VectorXd full_variances, incremental_variances;
+        Eigen::VectorXd full_prediction = full_gp.predict(test_locations, &full_variances);
+        Eigen::VectorXd incremental_prediction = incremental_gp.predict(test_locations, &incremental_variances);
+        for (int i = 0; i < test_locations.rows(); ++i)
+        {
+            EXPECT_NEAR(full_prediction(i), incremental_prediction(i), 1e-6 * (1 + std::abs(full_prediction(i))));
+            EXPECT_NEAR(full_variances(i), incremental_variances(i), 1e-6 * (1 + std::abs(full_variances(i))));
+        }
+    }
+
+    // switching back to the regular inference keeps the current model
+    Eigen::VectorXd before = incremental_gp.predict(test_locations);
+    incremental_gp.disableIncrementalInference();
+    Eigen::VectorXd after = incremental_gp.predict(test_locations);
+    for (int i = 0; i < test_locations.rows(); ++i)
+    {
+        EXPECT_NEAR(before(i), after(i), 1e-6 * (1 + std::abs(before(i))));
+    }
+}
+
+// Reports the time of the incremental inference against rebuilding the decomposition on every step,
+// both have to give the same predictions
+TEST_F(GPTest, incremental_inferSD_timing)
+{
+    Eigen::VectorXd locations, outputs, variances;
+    GP full_gp = make_guider_like_gp(&locations, &outputs, &variances, 600);
+    GP incremental_gp = full_gp;
+    incremental_gp.enableIncrementalInference();
+
+    typedef std::chrono::steady_clock clock;
+    clock::duration full_time(0), incremental_time(0);
+
+    int n = 400;
+    for (int N = 500; N <= 600; ++N)
+    {
+        Eigen::VectorXd loc = locations.head(N);
+        Eigen::VectorXd out = outputs.head(N);
+        Eigen::VectorXd var = variances.head(N);
+        double prediction_point = loc(N - 1) + 3.0;
+
+        clock::time_point start = clock::now();
+        full_gp.inferSD(loc, out, n, var, prediction_point);
+        clock::time_point middle = clock::now();
+        incremental_gp.inferSD(loc, out, n, var, prediction_point);
+        clock::time_point end = clock::now();
+
+        if (N > 500) // the first step builds the decomposition in both cases
+        {
+            full_time += middle - start;
+            incremental_time += end - middle;
+        }
+    }
+
+    std::cout << "inferSD with " << n << " points: full "
+              << std::chrono::duration_cast<std::chrono::microseconds>(full_time).count() / 100 << " us, incremental "
+              << std::chrono::duration_cast<std::chrono::microseconds>(incremental_time).count() / 100 << " us per step"
+              << std::endl;
+
+    Eigen::VectorXd test_locations = Eigen::VectorXd::LinSpaced(50, locations(0), locations(599) + 600.0);
+    Eigen::VectorXd full_prediction = full_gp.predict(test_locations);
+    Eigen::VectorXd incremental_prediction = incremental_gp.predict(test_locations);
+    for (int i = 0; i < test_locations.rows(); ++i)
+    {
+        EXPECT_NEAR(full_prediction(i), incremental_prediction(i), 1e-6 * (1 + std::abs(full_prediction(i))));
+    }
+}
+
+// The workspace based prediction has to give the same results as the regular prediction
+TEST_F(GPTest, predict_workspace_matches_predict)
+{
+    Eigen::VectorXd locations, outputs, variances;
+    GP gp = make_guider_like_gp(&locations, &outputs, &variances, 300);
+    gp.enableOutputProjection(covariance_functions::PeriodicSquareExponential());
+    gp.setHyperParameters(gp.getHyperParameters()); // also sets the parameters of the projection
+
+    GP::PredictionWorkspace workspace;
+    Eigen::VectorXd test_locations(3);
+    Eigen::VectorXd expected_variances, workspace_variances;
+
+    // prior only
+    test_locations << 10, 20, 30;
+    EXPECT_EQ(gp.predict(test_locations, workspace, &workspace_variances), Eigen::VectorXd::Zero(3));
+    gp.predict(test_locations, &expected_variances);
+    EXPECT_LT((workspace_variances - expected_variances).norm(), 1e-10);
+
+    for (int incremental = 0; incremental < 2; ++incremental)
+    {
+        if (incremental)
+        {
+            gp.enableIncrementalInference();
+        }
+        for (int N = 5; N <= 300; N += 15)
+        {
+            gp.inferSD(locations.head(N), outputs.head(N), 100, variances.head(N), locations(N - 1) + 3.0);
+            test_locations << locations(N - 1), locations(N - 1) + 3.0, locations(N - 1) + 100;
+
+            Eigen::VectorXd expected = gp.predict(test_locations, &expected_variances);
+            Eigen::VectorXd prediction = gp.predict(test_locations, workspace, &workspace_variances);
+            EXPECT_LT((prediction - expected).norm(), 1e-8 * (1 + expected.norm()));
+            EXPECT_LT((workspace_variances - expected_variances).norm(), 1e-8);
+
+            expected = gp.predictProjected(test_locations, &expected_variances);
+            prediction = gp.predictProjected(test_locations, workspace, &workspace_variances);
+            EXPECT_LT((prediction - expected).norm(), 1e-8 * (1 + expected.norm()));
+            EXPECT_LT((workspace_variances - expected_variances).norm(), 1e-8);
+        }
+    }
+
+    // a parameter change has to update the cached features
+    Eigen::VectorXd hyperParams = gp.getHyperParameters();
+    hyperParams(7) = std::log(230);
+    gp.setHyperParameters(hyperParams);
+    EXPECT_LT((gp.predictProjected(test_locations, workspace) - gp.predictProjected(test_locations)).norm(), 1e-8);
+}
+
 int main(int argc, char **argv)
 {
     ::testing::InitGoogleTest(&argc, argv);
@@ -39,6 +39,7 @@
 #include <vector>
 #include <iostream>
 #include "gaussian_process_guider.h"
+#include "period_estimator.h"
 
 #include <fstream>
 #include <thread>
@@ -415,6 +416,108 @@ TEST_F(GPGTest, real_data_test)
     GPG->save_gp_data();
 }
 
+// Incremental inference has to keep up with the data stream at a fraction of the cost of the full inference
+TEST_F(GPGTest, incremental_inference_test)
+{
+    std::vector<double> times, measurements, SNRs, controls;
+
+    std::ifstream file("dataset01.csv");
+    CSVRow row;
+    while (file >> row)
+    {
+        // ignore special lines: "INFO", "Frame", "DROP"
+        if (row[0][0] == 'I' || row[0][0] == 'F' || row[2][1] == 'D')
+        {
+            continue;
+        }
+        times.push_back(std::stod(row[1]));
+        measurements.push_back(std::stod(row[5]));
+        controls.push_back(std::stod(row[7]));
+        SNRs.push_back(std::stod(row[16]));
+    }
+
+    ASSERT_GT(times.size(), 100) << "dataset01.csv was empty or not present";
+
+    // a large point budget, the period is fixed to compare the inference alone
+    GPG->SetNumPointsForApproximation(300);
+    GPG->SetBoolComputePeriod(false);
+    std::vector<double> hypers = GPG->GetGPHyperparameters();
+    hypers[PKPeriodLength] = 483;
+    GPG->SetGPHyperparameters(hypers);
+
+    double update_time[2] = { 0.0, 0.0 };
+    for (int incremental = 0; incremental < 2; ++incremental)
+    {
+        GPG->reset();
+        GPG->SetBoolIncrementalInference(incremental != 0);
+        EXPECT_EQ(GPG->GetBoolIncrementalInference(), incremental != 0);
+
+        for (size_t i = 0; i < times.size(); ++i)
+        {
+            GPG->inject_data_point(times[i], measurements[i], SNRs[i], controls[i]);
+            if (i < 10)
+            {
+                continue;
+            }
+            auto start = GaussianProcessGuider::clock::now();
+            GPG->UpdateGP(times[i] + 3.0);
+            update_time[incremental] += std::chrono::duration<double>(GaussianProcessGuider::clock::now() - start).count();
+        }
+    }
+
+    std::cout << "UpdateGP: full " << 1e3 * update_time[0] << " ms, incremental " << 1e3 * update_time[1] << " ms"
+              << std::endl;
+    EXPECT_NEAR(GPG->GetGPHyperparameters()[PKPeriodLength], 483, 1e-6);
+}
+
+TEST_F(GPGTest, prediction_timing_test)
+{
+    // a GP with the kernels, the output projection and the number of points of the guider
+    covariance_functions::PeriodicSquareExponential2 covariance_function;
+    covariance_functions::PeriodicSquareExponential output_covariance_function;
+    GP gp(covariance_function);
+    gp.enableExplicitTrend();
+    gp.enableOutputProjection(output_covariance_function);
+
+    Eigen::VectorXd hyperparameters(8);
+    hyperparameters << 1.0, 700, 20, 10, 20, 25, 10, 483;
+    gp.setHyperParameters(hyperparameters.array().log());
+
+    Eigen::VectorXd timestamps = 5.0 * Eigen::VectorXd::LinSpaced(300, 0, 299);
+    Eigen::VectorXd gear_error = 20 * (timestamps.array() * 2 * M_PI / 483).sin() + 0.01 * timestamps.array();
+    gp.inferSD(timestamps, gear_error, DefaultNumPointsForApproximation, Eigen::VectorXd(), timestamps(299));
+
+    // the two point prediction of every guiding step
+    int num_steps = 2000;
+    Eigen::VectorXd next_location(2);
+    GP::PredictionWorkspace workspace;
+    double sum_regular = 0.0;
+    double sum_workspace = 0.0;
+
+    auto start = GaussianProcessGuider::clock::now();
+    for (int i = 0; i < num_steps; ++i)
+    {
+        next_location << timestamps(299) + 0.01 * i, timestamps(299) + 0.01 * i + 3.0;
+        Eigen::VectorXd prediction = gp.predictProjected(next_location);
+        sum_regular += prediction(1) - prediction(0);
+    }
+    auto middle = GaussianProcessGuider::clock::now();
+    for (int i = 0; i < num_steps; ++i)
+    {
+        next_location << timestamps(299) + 0.01 * i, timestamps(299) + 0.01 * i + 3.0;
+        const Eigen::VectorXd& prediction = gp.predictProjected(next_location, workspace);
+        sum_workspace += prediction(1) - prediction(0);
+    }
+    auto end = GaussianProcessGuider::clock::now();
+
+    double time_regular = std::chrono::duration<double>(middle - start).count();
+    double time_workspace = std::chrono::duration<double>(end - middle).count();
+    std::cout << "prediction: regular " << 1e6 * time_regular / num_steps << " us, workspace "
+              << 1e6 * time_workspace / num_steps << " us" << std::endl;
+
+    EXPECT_NEAR(sum_workspace, sum_regular, 1e-8 * num_steps);
+}
+
 TEST_F(GPGTest, parameter_filter_test)
 {
     double period_length = 0.0;
@@ -485,6 +588,38 @@ TEST_F(GPGTest, period_interpolation_test)
     GPG->save_gp_data();
 }
 
+TEST_F(GPGTest, period_estimator_test)
+{
+    // a sine wave with a linear drift on the regular grid of the GP guider
+    double period_length = 483;
+    int N = 1000;
+    Eigen::VectorXd timestamps = 5.0 * Eigen::VectorXd::LinSpaced(N, 0, N - 1);
+    Eigen::VectorXd gear_error = 20 * (timestamps.array() * 2 * M_PI / period_length).sin() + 0.01 * timestamps.array() + 3;
+    Eigen::Vector2d trend(3, 0.01);
+
+    PeriodEstimator estimator(4096, 1500.0);
+    PeriodEstimator reference(4096, 1500.0);
+
+    // the samples are appended one by one, the estimate has to match the full spectrum, also when
+    // the data doesn't change between two calls
+    for (int n = static_cast<int>(2 * period_length / 5); n <= N; ++n)
+    {
+        double full = reference.EstimateFull(timestamps.head(n), gear_error.head(n), trend);
+        EXPECT_EQ(estimator.Estimate(timestamps.head(n), gear_error.head(n), trend), full);
+        EXPECT_EQ(estimator.Estimate(timestamps.head(n), gear_error.head(n), trend), full);
+    }
+    EXPECT_NEAR(estimator.Estimate(timestamps, gear_error, trend), period_length, 1e0);
+
+    // dropping samples at the front changes the data, the estimator has to notice
+    double full = reference.EstimateFull(timestamps.tail(N - 10), gear_error.tail(N - 10), trend);
+    EXPECT_EQ(estimator.Estimate(timestamps.tail(N - 10), gear_error.tail(N - 10), trend), full);
+
+    // so does a change of the trend alone
+    Eigen::Vector2d other_trend(3, 0.02);
+    full = reference.EstimateFull(timestamps.tail(N - 10), gear_error.tail(N - 10), other_trend);
+    EXPECT_EQ(estimator.Estimate(timestamps.tail(N - 10), gear_error.tail(N - 10), other_trend), full);
+}
+
 TEST_F(GPGTest, data_regularization_test)
 {
     // first: prepare a nice GP with a sine wave
@@ -40,7 +40,9 @@
 #include <iostream>
 #include "gaussian_process_guider.h"
 #include "guide_performance_tools.h"
+#include "period_estimator.h"
 
+#include <chrono>
 #include <fstream>
 #include <thread>
 
@@ -176,6 +178,162 @@ TEST_F(GuidePerformanceTest, performance_dataset08)
     EXPECT_GT(improvement, 0);
 }
 
+/*
+ * Reads the accumulated gear error of a dataset, linearly interpolated to a
+ * regular grid like the regularization of the GP guider.
+ */
+static void read_regular_gear_error(const std::string& filename, Eigen::VectorXd *grid_times, Eigen::VectorXd *grid_data)
+{
+    Eigen::ArrayXXd data = read_data_from_file(filename);
+    Eigen::ArrayXd times = data.row(0);
+    Eigen::ArrayXd measurements = data.row(1);
+    Eigen::ArrayXd controls = data.row(2);
+
+    // accumulated gear error as seen by the GP guider
+    Eigen::ArrayXd gear_error(times.size());
+    double sum_controls = 0.0;
+    for (int i = 0; i < times.size(); ++i)
+    {
+        gear_error(i) = sum_controls + measurements(i);
+        sum_controls += controls(i);
+    }
+
+    double grid_interval = 5.0;
+    int N = std::min(2048, static_cast<int>((times(times.size() - 1) - times(0)) / grid_interval));
+    grid_times->resize(N);
+    grid_data->resize(N);
+    int j = 0;
+    for (int n = 0; n < N; ++n)
+    {
+        (*grid_times)(n) = times(0) + n * grid_interval;
+        while (times(j + 1) < (*grid_times)(n))
+        {
+            ++j;
+        }
+        double ratio = ((*grid_times)(n) - times(j)) / (times(j + 1) - times(j));
+        (*grid_data)(n) = (1 - ratio) * gear_error(j) + ratio * gear_error(j + 1);
+    }
+}
+
+/*
+ * Feeds the gear error of a dataset sample by sample to the period estimator
+ * and compares the period length with a full scan of the spectrum.
+ */
+static void compare_period_estimation(const std::string& filename)
+{
+    Eigen::VectorXd grid_times;
+    Eigen::VectorXd grid_data;
+    read_regular_gear_error(filename, &grid_times, &grid_data);
+    int N = grid_times.rows();
+
+    PeriodEstimator estimator(4096, 1500.0);
+    PeriodEstimator reference(4096, 1500.0);
+
+    double time_estimator = 0.0;
+    int num_mismatches = 0;
+    int num_estimates = 0;
+    for (int n = 40; n <= N; ++n)
+    {
+        Eigen::VectorXd time = grid_times.head(n);
+        Eigen::VectorXd gear = grid_data.head(n);
+
+        Eigen::MatrixXd feature_matrix(2, n);
+        feature_matrix.row(0) = Eigen::MatrixXd::Ones(1, n);
+        feature_matrix.row(1) = time.transpose();
+        Eigen::Vector2d trend = (feature_matrix * feature_matrix.transpose() + 1e-3 * Eigen::Matrix2d::Identity())
+                                    .ldlt()
+                                    .solve(feature_matrix * gear);
+
+        auto begin = std::chrono::steady_clock::now();
+        double estimated = estimator.Estimate(time, gear, trend);
+        auto end = std::chrono::steady_clock::now();
+        time_estimator += std::chrono::duration<double>(end - begin).count();
+
+        double full = reference.EstimateFull(time, gear, trend);
+
+        // the second call with the same data returns the cached period
+        ++num_estimates;
+        if (estimated != full || estimator.Estimate(time, gear, trend) != full)
+        {
+            ++num_mismatches;
+        }
+    }
+
+    std::cout << filename << ": " << 1e6 * time_estimator / num_estimates << " us per period estimate" << std::endl;
+
+    EXPECT_EQ(num_mismatches, 0);
+}
+
+TEST_F(GuidePerformanceTest, period_estimation)
+{
+    for (int i = 1; i <= 8; ++i)
+    {
+        compare_period_estimation("performance_dataset0" + std::to_string(i) + ".txt");
+    }
+}
+
+/*
+ * Times the two point prediction of every guiding step with a GP like the one
+ * of the guider, once with the regular prediction and once with a workspace.
+ */
+static void compare_prediction_timing(const std::string& filename)
+{
+    Eigen::VectorXd grid_times;
+    Eigen::VectorXd grid_data;
+    read_regular_gear_error(filename, &grid_times, &grid_data);
+    int N = grid_times.rows();
+
+    covariance_functions::PeriodicSquareExponential2 covariance_function;
+    covariance_functions::PeriodicSquareExponential output_covariance_function;
+    GP gp(covariance_function);
+    gp.enableExplicitTrend();
+    gp.enableOutputProjection(output_covariance_function);
+
+    Eigen::VectorXd hyperparameters(8);
+    hyperparameters << 1.0, GuidePerformanceTest::DefaultLengthScaleSE0Ker, GuidePerformanceTest::DefaultSignalVarianceSE0Ker,
+        GuidePerformanceTest::DefaultLengthScalePerKer, GuidePerformanceTest::DefaultSignalVariancePerKer,
+        GuidePerformanceTest::DefaultLengthScaleSE1Ker, GuidePerformanceTest::DefaultSignalVarianceSE1Ker,
+        GuidePerformanceTest::DefaultPeriodLengthPerKer;
+    gp.setHyperParameters(hyperparameters.array().log());
+
+    GP::PredictionWorkspace workspace;
+    Eigen::VectorXd next_location(2);
+    double time_regular = 0.0;
+    double time_workspace = 0.0;
+    double max_deviation = 0.0;
+    int num_predictions = 0;
+    for (int n = 10; n <= N; ++n)
+    {
+        gp.inferSD(grid_times.head(n), grid_data.head(n), GuidePerformanceTest::DefaultNumPointsForApproximation,
+                   Eigen::VectorXd(), grid_times(n - 1) + 3.0);
+        next_location << grid_times(n - 1), grid_times(n - 1) + 3.0;
+
+        auto begin = std::chrono::steady_clock::now();
+        Eigen::VectorXd regular = gp.predictProjected(next_location);
+        auto middle = std::chrono::steady_clock::now();
+        const Eigen::VectorXd& prediction = gp.predictProjected(next_location, workspace);
+        auto end = std::chrono::steady_clock::now();
+
+        time_regular += std::chrono::duration<double>(middle - begin).count();
+        time_workspace += std::chrono::duration<double>(end - middle).count();
+        max_deviation = std::max(max_deviation, std::abs((prediction(1) - prediction(0)) - (regular(1) - regular(0))));
+        ++num_predictions;
+    }
+
+    std::cout << filename << ": prediction regular " << 1e6 * time_regular / num_predictions << " us, workspace "
+              << 1e6 * time_workspace / num_predictions << " us" << std::endl;
+
+    EXPECT_LT(max_deviation, 1e-8);
+}
+
+TEST_F(GuidePerformanceTest, prediction_timing)
+{
+    for (int i = 1; i <= 8; ++i)
+    {
+        compare_prediction_timing("performance_dataset0" + std::to_string(i) + ".txt");
+    }
+}
+
 int main(int argc, char **argv)
 {
     ::testing::InitGoogleTest(&argc, argv);
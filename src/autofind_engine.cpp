@@ -0,0 +1,372 @@
+/*
+ *  autofind_engine.cpp
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "autofind_engine.h"
+
+#include <algorithm>
+#include <string.h>
+
+namespace
+{
+// images smaller than this are not worth splitting
+const unsigned int MIN_PARALLEL_PIXELS = 512 * 1024;
+const int MIN_BAND_ROWS = 32;
+const int MAX_BANDS = 64;
+
+const int SEARCH_SIZE = 2 * AutoFindEngine::SEARCH_RADIUS + 1;
+const int LOCAL_SIZE = 2 * AutoFindEngine::LOCAL_RADIUS + 1;
+
+unsigned int BandCount(unsigned int concurrency, AutoFindEngine::ParallelForFn pfor, int w, int h)
+{
+    if (!pfor || concurrency <= 1 || w <= 0 || h <= 0 || (unsigned int) w * (unsigned int) h < MIN_PARALLEL_PIXELS)
+        return 1;
+    return std::min(std::min(concurrency, (unsigned int) MAX_BANDS), (unsigned int) std::max(h / MIN_BAND_ROWS, 1));
+}
+
+void ForEachBand(unsigned int nbands, AutoFindEngine::ParallelForFn pfor, const std::function<void(unsigned int)>& fn)
+{
+    if (nbands > 1)
+        (*pfor)(nbands, fn);
+    else
+        fn(0);
+}
+
+// PSF filter of row y for x in [x0, x1). The terms are accumulated in exactly the order of the
+// original per-pixel implementation so that the result does not change.
+void PsfConvRow(float *dst, const float *src, int width, int y, int x0, int x1)
+{
+    //                       A      B1     B2    C1     C2    C3     D1     D2     D3
+    const double PSF[] = { 0.906, 0.584, 0.365, .117, .049, -0.05, -.064, -.074, -.094 };
+
+    /* PSF Grid is:
+    D3 D3 D3 D3 D3 D3 D3 D3 D3
+    D3 D3 D3 D2 D1 D2 D3 D3 D3
+    D3 D3 C3 C2 C1 C2 C3 D3 D3
+    D3 D2 C2 B2 B1 B2 C2 D2 D3
+    D3 D1 C1 B1 A  B1 C1 D1 D3
+    D3 D2 C2 B2 B1 B2 C2 D2 D3
+    D3 D3 C3 C2 C1 C2 C3 D3 D3
+    D3 D3 D3 D2 D1 D2 D3 D3 D3
+    D3 D3 D3 D3 D3 D3 D3 D3 D3
+
+    1@A
+    4@B1, B2, C1, C3, D1
+    8@C2, D2
+    44 * D3
+    */
+
+    const float *const rm4 = src + (size_t) width * (y - 4);
+    const float *const rm3 = src + (size_t) width * (y - 3);
+    const float *const rm2 = src + (size_t) width * (y - 2);
+    const float *const rm1 = src + (size_t) width * (y - 1);
+    const float *const r0 = src + (size_t) width * y;
+    const float *const rp1 = src + (size_t) width * (y + 1);
+    const float *const rp2 = src + (size_t) width * (y + 2);
+    const float *const rp3 = src + (size_t) width * (y + 3);
+    const float *const rp4 = src + (size_t) width * (y + 4);
+    float *const out = dst + (size_t) width * y;
+
+    for (int x = x0; x < x1; x++)
+    {
+        float A, B1, B2, C1, C2, C3, D1, D2, D3;
+
+        A = r0[x];
+        B1 = rm1[x] + rp1[x] + r0[x + 1] + r0[x - 1];
+        B2 = rm1[x - 1] + rm1[x + 1] + rp1[x - 1] + rp1[x + 1];
+        C1 = rm2[x] + r0[x - 2] + r0[x + 2] + rp2[x];
+        C2 = rm2[x - 1] + rm2[x + 1] + rm1[x - 2] + rm1[x + 2] + rp1[x - 2] + rp1[x + 2] + rp2[x - 1] + rp2[x + 1];
+        C3 = rm2[x - 2] + rm2[x + 2] + rp2[x - 2] + rp2[x + 2];
+        D1 = rm3[x] + r0[x - 3] + r0[x + 3] + rp3[x];
+        D2 = rm3[x - 1] + rm3[x + 1] + rm1[x - 3] + rm1[x + 3] + rp1[x - 3] + rp1[x + 3] + rp3[x - 1] + rp3[x + 1];
+        D3 = rm2[x - 4] + rm2[x - 3] + rm2[x + 3] + rm2[x + 4] + rm1[x - 4] + rm1[x + 4] + r0[x - 4] + r0[x + 4] + rp1[x - 4] +
+            rp1[x + 4] + rp2[x - 4] + rp2[x - 3] + rp2[x + 3] + rp2[x + 4];
+
+        D3 += rm4[x - 4];
+        D3 += rm4[x - 3];
+        D3 += rm4[x - 2];
+        D3 += rm4[x - 1];
+        D3 += rm4[x];
+        D3 += rm4[x + 1];
+        D3 += rm4[x + 2];
+        D3 += rm4[x + 3];
+        D3 += rm4[x + 4];
+
+        D3 += rm3[x - 4];
+        D3 += rm3[x - 3];
+        D3 += rm3[x - 2];
+        D3 += rm3[x + 2];
+        D3 += rm3[x + 3];
+        D3 += rm3[x + 4];
+
+        D3 += rp3[x - 4];
+        D3 += rp3[x - 3];
+        D3 += rp3[x - 2];
+        D3 += rp3[x + 2];
+        D3 += rp3[x + 3];
+        D3 += rp3[x + 4];
+
+        D3 += rp4[x - 4];
+        D3 += rp4[x - 3];
+        D3 += rp4[x - 2];
+        D3 += rp4[x - 1];
+        D3 += rp4[x];
+        D3 += rp4[x + 1];
+        D3 += rp4[x + 2];
+        D3 += rp4[x + 3];
+        D3 += rp4[x + 4];
+
+        double mean = (A + B1 + B2 + C1 + C2 + C3 + D1 + D2 + D3) / 81.0;
+        double PSF_fit = PSF[0] * (A - mean) + PSF[1] * (B1 - 4.0 * mean) + PSF[2] * (B2 - 4.0 * mean) +
+            PSF[3] * (C1 - 4.0 * mean) + PSF[4] * (C2 - 8.0 * mean) + PSF[5] * (C3 - 4.0 * mean) +
+            PSF[6] * (D1 - 4.0 * mean) + PSF[7] * (D2 - 8.0 * mean) + PSF[8] * (D3 - 44.0 * mean);
+
+        out[x] = (float) PSF_fit;
+    }
+}
+
+// van Herk/Gil-Werman running maximum: out[i] = max(in[i .. i + SEARCH_SIZE - 1]) for 0 <= i < n.
+// in must hold n + SEARCH_SIZE - 1 values; g and h are scratch of the same size.
+void RunningMax(float *out, const float *in, int n, float *g, float *h)
+{
+    int const len = n + SEARCH_SIZE - 1;
+
+    // prefix maxima (g) and suffix maxima (h) within blocks of SEARCH_SIZE values
+    for (int b = 0; b < len; b += SEARCH_SIZE)
+    {
+        int const e = std::min(b + SEARCH_SIZE, len);
+        g[b] = in[b];
+        for (int i = b + 1; i < e; i++)
+            g[i] = std::max(g[i - 1], in[i]);
+        h[e - 1] = in[e - 1];
+        for (int i = e - 2; i >= b; i--)
+            h[i] = std::max(h[i + 1], in[i]);
+    }
+
+    // a window starting at i spans the tail of one block and the head of the next
+    for (int i = 0; i < n; i++)
+        out[i] = std::max(h[i], g[i + SEARCH_SIZE - 1]);
+}
+
+// Running sums of the rows of the valid region: Row(r)[c] is the sum of the pixels of rows
+// [origin, r) and columns [rx, rx + c). Only the last LOCAL_SIZE + 1 rows are kept.
+class RowSums
+{
+    const float *m_conv;
+    int m_width;
+    int m_rx;
+    int m_rw;
+    int m_next; // next row to be added
+    std::vector<double> m_ring;
+
+    double *Slot(int r) { return &m_ring[(size_t) (r % (LOCAL_SIZE + 1)) * (m_rw + 1)]; }
+
+public:
+    RowSums(const float *conv, int width, int rx, int rw, int origin)
+        : m_conv(conv), m_width(width), m_rx(rx), m_rw(rw), m_next(origin), m_ring((size_t) (LOCAL_SIZE + 1) * (rw + 1))
+    {
+        std::fill_n(Slot(origin), rw + 1, 0.0);
+    }
+
+    const double *Row(int r) const { return &m_ring[(size_t) (r % (LOCAL_SIZE + 1)) * (m_rw + 1)]; }
+
+    // make Row(r) available for rows up to and including end
+    void Advance(int end)
+    {
+        for (; m_next < end; m_next++)
+        {
+            const double *prev = Row(m_next);
+            double *cur = Slot(m_next + 1);
+            const float *px = m_conv + (size_t) m_width * m_next + m_rx;
+            double rowsum = 0.0;
+            cur[0] = 0.0;
+            for (int c = 0; c < m_rw; c++)
+            {
+                rowsum += (double) px[c];
+                cur[c + 1] = prev[c + 1] + rowsum;
+            }
+        }
+    }
+};
+
+// find the candidates on rows [y0, y1) of the search area
+void FindPeaksBand(std::vector<AutoFindEngine::Candidate> *peaks, const float *conv, int width, int rx, int ry, int rw,
+                   int rh, int y0, int y1, double globalStdev, double threshold)
+{
+    using namespace AutoFindEngine;
+
+    int const xs = rx + SEARCH_RADIUS; // search area columns
+    int const n = rw - 2 * SEARCH_RADIUS;
+    int const len = n + SEARCH_SIZE - 1;
+
+    std::vector<float> g(len), h(len);
+    // horizontal maxima of a block of rows starting at the window start row (cur) and of the
+    // following block (next), and the vertical suffix (sfx) and prefix (pfx) maxima of those blocks
+    std::vector<float> cur((size_t) SEARCH_SIZE * n), next((size_t) SEARCH_SIZE * n);
+    std::vector<float> sfx((size_t) SEARCH_SIZE * n), pfx((size_t) SEARCH_SIZE * n);
+
+    auto hmax = [&](std::vector<float>& blk, int first, int count) {
+        for (int i = 0; i < count; i++)
+            RunningMax(&blk[(size_t) i * n], conv + (size_t) width * (first + i) + xs - SEARCH_RADIUS, n, &g[0], &h[0]);
+    };
+
+    int const last = y1 - 1 + SEARCH_RADIUS; // last row needed
+
+    int const origin = std::max(y0 - LOCAL_RADIUS, ry);
+    RowSums sums(conv, width, rx, rw, origin);
+
+    int bs = y0 - SEARCH_RADIUS;
+    hmax(cur, bs, std::min(SEARCH_SIZE, last - bs + 1));
+
+    for (; bs + SEARCH_RADIUS < y1; bs += SEARCH_SIZE)
+    {
+        int const curRows = std::min(SEARCH_SIZE, last - bs + 1);
+        int const nextRows = std::min(SEARCH_SIZE, last - (bs + SEARCH_SIZE) + 1);
+        if (nextRows > 0)
+            hmax(next, bs + SEARCH_SIZE, nextRows);
+
+        std::copy_n(&cur[(size_t) (curRows - 1) * n], n, &sfx[(size_t) (curRows - 1) * n]);
+        for (int j = curRows - 2; j >= 0; j--)
+        {
+            const float *a = &cur[(size_t) j * n];
+            const float *b = &sfx[(size_t) (j + 1) * n];
+            float *o = &sfx[(size_t) j * n];
+            for (int i = 0; i < n; i++)
+                o[i] = std::max(a[i], b[i]);
+        }
+        if (nextRows > 0)
+        {
+            std::copy_n(&next[0], n, &pfx[0]);
+            for (int j = 1; j < nextRows; j++)
+            {
+                const float *a = &next[(size_t) j * n];
+                const float *b = &pfx[(size_t) (j - 1) * n];
+                float *o = &pfx[(size_t) j * n];
+                for (int i = 0; i < n; i++)
+                    o[i] = std::max(a[i], b[i]);
+            }
+        }
+
+        for (int j = 0; j < SEARCH_SIZE; j++)
+        {
+            int const y = bs + j + SEARCH_RADIUS;
+            if (y >= y1)
+                break;
+
+            // maximum of the window starting at row bs + j: the tail of this block and the head of the next
+            const float *s = &sfx[(size_t) j * n];
+            const float *p = j > 0 ? &pfx[(size_t) (j - 1) * n] : s;
+            const float *row = conv + (size_t) width * y + xs;
+
+            // local background window, clipped to the valid region
+            int const top = std::max(y - LOCAL_RADIUS, ry);
+            int const bottom = std::min(y + LOCAL_RADIUS, ry + rh - 1);
+            sums.Advance(bottom + 1);
+            const double *st = sums.Row(top);
+            const double *sb = sums.Row(bottom + 1);
+
+            for (int i = 0; i < n; i++)
+            {
+                float const val = row[i];
+                // val is a local maximum if no pixel in the window is greater
+                if (!(val > 0.0f) || val < std::max(s[i], p[i]))
+                    continue;
+
+                int const x = xs + i;
+                int const left = std::max(x - LOCAL_RADIUS, rx) - rx;
+                int const right = std::min(x + LOCAL_RADIUS, rx + rw - 1) - rx + 1;
+                double const sum = sb[right] - st[right] - sb[left] + st[left];
+                double const count = (double) (bottom - top + 1) * (right - left);
+                double const local_mean = sum / count;
+
+                // this is our measure of star intensity
+                double const hval = (val - local_mean) / globalStdev;
+                if (hval < threshold)
+                    continue;
+
+                AutoFindEngine::Candidate c;
+                c.x = x;
+                c.y = y;
+                c.val = val;
+                c.h = hval;
+                peaks->push_back(c);
+            }
+        }
+
+        cur.swap(next);
+    }
+}
+} // namespace
+
+void AutoFindEngine::PsfConv(float *dst, const float *src, int width, int height, unsigned int concurrency,
+                             ParallelForFn pfor)
+{
+    memset(dst, 0, (size_t) width * height * sizeof(float));
+
+    int const rows = height - 2 * CONV_RADIUS;
+    if (rows <= 0 || width <= 2 * CONV_RADIUS)
+        return;
+
+    unsigned int const nbands = BandCount(concurrency, pfor, width, rows);
+
+    ForEachBand(nbands, pfor, [&](unsigned int i) {
+        int y0 = CONV_RADIUS + (int) ((long long) rows * i / nbands);
+        int y1 = CONV_RADIUS + (int) ((long long) rows * (i + 1) / nbands);
+        for (int y = y0; y < y1; y++)
+            PsfConvRow(dst, src, width, y, CONV_RADIUS, width - CONV_RADIUS);
+    });
+}
+
+void AutoFindEngine::FindPeaks(std::vector<Candidate> *peaks, const float *conv, int width, int rx, int ry, int rw, int rh,
+                               double globalStdev, double threshold, unsigned int concurrency, ParallelForFn pfor)
+{
+    peaks->clear();
+
+    // the search area
+    int const sw = rw - 2 * SEARCH_RADIUS;
+    int const sh = rh - 2 * SEARCH_RADIUS;
+    if (sw <= 0 || sh <= 0)
+        return;
+
+    unsigned int const nbands = BandCount(concurrency, pfor, sw, sh);
+    std::vector<std::vector<Candidate>> found(nbands);
+
+    ForEachBand(nbands, pfor, [&](unsigned int i) {
+        int y0 = ry + SEARCH_RADIUS + (int) ((long long) sh * i / nbands);
+        int y1 = ry + SEARCH_RADIUS + (int) ((long long) sh * (i + 1) / nbands);
+        FindPeaksBand(&found[i], conv, width, rx, ry, rw, rh, y0, y1, globalStdev, threshold);
+    });
+
+    for (unsigned int i = 0; i < nbands; i++)
+        peaks->insert(peaks->end(), found[i].begin(), found[i].end());
+}
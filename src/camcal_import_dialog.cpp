@@ -222,6 +222,7 @@ void CamCalImportDialog::OnOk(wxCommandEvent& evt)
     {
         sourceName = MyFrame::DarkLibFileName(m_sourceDarksProfileId);
         destName = MyFrame::DarkLibFileName(m_thisProfileId);
+        DarkCache::Remove(destName);
         if (wxCopyFile(sourceName, destName, true))
         {
             Debug.Write(wxString::Format("Dark library imported from profile %d to profile %d\n", m_sourceDarksProfileId,
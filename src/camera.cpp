@@ -229,6 +229,11 @@ GuideCamera::GuideCamera()
     Binning = pConfig->Profile.GetInt("/camera/binning", 1);
     CurrentDarkFrame = nullptr;
     CurrentDefectMap = nullptr;
+    m_darkMedianFrame = nullptr;
+    m_darkMedian = 0;
+    m_scaledDark = nullptr;
+    m_scaledDarkGeneration = 0;
+    m_darkLibGeneration = 0;
 }
 
 GuideCamera::~GuideCamera()
@@ -1365,25 +1370,117 @@ void GuideCamera::AddDark(usImage *dark)
             delete prior;
         }
 
+        // the new dark may be allocated where a freed one was
+        m_darkMedianFrame = nullptr;
+        ++m_darkLibGeneration;
+
     } // lock scope
 
     Darks[expdur] = dark;
 }
 
+// Synthesize a dark frame for the given exposure from the library darks (see DarkModel).
+// Returns null if the library cannot be fitted or the exposure is outside the library's range.
+// Only called on the main thread, which is the only thread that modifies Darks.
+usImage *GuideCamera::BuildScaledDark(int exposureDuration)
+{
+    if (Darks.size() < 2)
+        return nullptr;
+
+    const usImage *first = Darks.begin()->second;
+
+    std::vector<const unsigned short *> pixels;
+    std::vector<double> exposures;
+    for (ExposureImgMap::const_iterator it = Darks.begin(); it != Darks.end(); ++it)
+    {
+        if (it->second->Size != first->Size || !it->second->ImageData)
+            return nullptr;
+        pixels.push_back(it->second->ImageData);
+        exposures.push_back((double) it->first);
+    }
+
+    if (!DarkModel::CanSynthesize(&exposures[0], (int) exposures.size(), (double) exposureDuration))
+        return nullptr;
+
+    std::vector<double> weights(exposures.size());
+    if (DarkModel::Weights(&weights[0], &exposures[0], (int) exposures.size(), (double) exposureDuration))
+        return nullptr;
+
+    usImage *dark = new usImage();
+    if (dark->Init(first->Size))
+    {
+        delete dark;
+        return nullptr;
+    }
+
+    DarkModel::Synthesize(dark->ImageData, &pixels[0], &weights[0], (int) pixels.size(), dark->NPixels,
+                          WorkerPool::Concurrency(), &WorkerPool::ParallelFor);
+
+    dark->ImgExpDur = exposureDuration;
+    dark->BitsPerPixel = first->BitsPerPixel;
+    dark->CalcStats();
+
+    Debug.Write(wxString::Format("Synthesized a %d ms dark from %u library darks (%d - %d ms), median = %hu\n",
+                                 exposureDuration, (unsigned int) Darks.size(), Darks.begin()->first, Darks.rbegin()->first,
+                                 dark->MedianADU));
+
+    return dark;
+}
+
 void GuideCamera::SelectDark(int exposureDuration)
 {
-    // select the dark frame with the smallest exposure >= the requested exposure.
-    // if there are no darks with exposures > the select exposure, select the dark with the greatest exposure
+    // Use the library dark with the requested exposure if there is one. Otherwise, if scaled darks
+    // are enabled in the dark library dialog and the requested exposure lies between the shortest and
+    // longest library darks, use a dark synthesized for the exact exposure. Failing that, select the
+    // dark frame with the smallest exposure >= the requested exposure, or the dark with the greatest
+    // exposure if there is none.
+
+    bool exact = Darks.find(exposureDuration) != Darks.end();
+    bool scaleEnabled = pConfig->Profile.GetBoolean("/camera/ScaleDarks", false);
+    bool scale = !exact && scaleEnabled;
+    bool haveScaled =
+        m_scaledDark && m_scaledDark->ImgExpDur == exposureDuration && m_scaledDarkGeneration == m_darkLibGeneration;
+
+    usImage *scaled = nullptr;
+    if (scale && !haveScaled)
+    {
+        scaled = BuildScaledDark(exposureDuration);
+        if (!scaled)
+            scale = false;
+    }
 
     wxCriticalSectionLocker lck(DarkFrameLock);
 
+    if (scaled)
+    {
+        if (CurrentDarkFrame == m_scaledDark)
+            CurrentDarkFrame = nullptr;
+        delete m_scaledDark;
+        m_scaledDark = scaled;
+        m_scaledDarkGeneration = m_darkLibGeneration;
+        m_darkMedianFrame = nullptr; // the new dark may be allocated where the old one was
+    }
+
+    if (scale)
+    {
+        Debug.Write(wxString::Format("SelectDark: using a synthesized dark for %d ms\n", exposureDuration));
+        CurrentDarkFrame = m_scaledDark;
+        return;
+    }
+
     CurrentDarkFrame = 0;
+    int darkExposure = 0;
     for (ExposureImgMap::const_iterator it = Darks.begin(); it != Darks.end(); ++it)
     {
         CurrentDarkFrame = it->second;
+        darkExposure = it->first;
         if (it->first >= exposureDuration)
             break;
     }
+
+    if (CurrentDarkFrame && !exact)
+        Debug.Write(wxString::Format("SelectDark: using the %d ms library dark for %d ms (scaled darks %s)\n", darkExposure,
+                                     exposureDuration, scaleEnabled ? "unavailable" : "disabled"));
 }
 
 void GuideCamera::GetDarklibProperties(int *pNumDarks, double *pMinExp, double *pMaxExp)
@@ -1439,6 +1536,10 @@ void GuideCamera::ClearDarks()
         Darks.erase(it);
     }
     CurrentDarkFrame = nullptr;
+    m_darkMedianFrame = nullptr;
+    delete m_scaledDark;
+    m_scaledDark = nullptr;
+    ++m_darkLibGeneration;
 }
 
 void GuideCamera::SubtractDark(usImage& img)
@@ -1455,7 +1556,17 @@ void GuideCamera::SubtractDark(usImage& img)
     }
     else if (CurrentDarkFrame)
     {
-        Subtract(img, *CurrentDarkFrame);
+        const usImage& dark = *CurrentDarkFrame;
+
+        // a size mismatch makes Subtract fail without using the median
+        if (img.Size == dark.Size && (m_darkMedianFrame != &dark || m_darkMedianSubframe != img.Subframe))
+        {
+            m_darkMedian = DarkMedian(dark, img.Subframe);
+            m_darkMedianFrame = &dark;
+            m_darkMedianSubframe = img.Subframe;
+        }
+
+        Subtract(img, dark, m_darkMedian);
     }
 }
 
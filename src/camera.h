@@ -111,6 +111,20 @@ class GuideCamera : public wxMessageBoxProxy, public OnboardST4
 
     double m_pixelSize;
 
+    // median of a dark frame within a subframe, remembered from the last dark subtraction since
+    // the subframe rarely changes; protected by DarkFrameLock
+    const usImage *m_darkMedianFrame;
+    wxRect m_darkMedianSubframe;
+    unsigned short m_darkMedian;
+
+    // dark synthesized by SelectDark for an exposure that is not in the library, and the library
+    // generation it was built from; replaced under DarkFrameLock
+    usImage *m_scaledDark;
+    unsigned int m_scaledDarkGeneration;
+    unsigned int m_darkLibGeneration; // incremented whenever darks are added or cleared
+
+    usImage *BuildScaledDark(int exposureDuration);
+
 protected:
     bool m_hasGuideOutput;
     int m_timeoutMs;
@@ -0,0 +1,212 @@
+/*
+ *  client_output_queue.h
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef CLIENT_OUTPUT_QUEUE_H_INCLUDED
+#define CLIENT_OUTPUT_QUEUE_H_INCLUDED
+
+// The unsent output of one event server client: the messages that could not be written without
+// blocking, oldest first, and the rules for admitting new ones. Events count towards the client's
+// high-water mark; once it is reached they are dropped until the client catches up. Replies to
+// the client's own requests are always queued and do not count towards the mark, since the client
+// is waiting for them; if the events ahead of a reply would exceed the mark, the oldest of them
+// are discarded instead. Image stream messages do not count either, and at most one is queued.
+// Buf is wxCharBuffer in the event server, and the class does not depend on wxWidgets so that
+// tests/client_output_queue_test.cpp can exercise it with std::string.
+
+#include <deque>
+#include <stddef.h>
+
+template <typename Buf>
+class ClientOutputQueue
+{
+public:
+    enum Kind
+    {
+        EVENT,
+        RESPONSE,
+        IMAGE,
+    };
+
+    struct Msg
+    {
+        Buf buf;
+        size_t offset; // bytes already written
+        long long queued; // when the message was queued
+        Kind kind;
+
+        Msg(const Buf& buf_, long long queued_, Kind kind_) : buf(buf_), offset(0), queued(queued_), kind(kind_) { }
+    };
+
+    enum EventResult
+    {
+        QUEUED,
+        DROPPED, // over the high-water mark
+        STARTED_DROPPING, // dropped, and the first event dropped since the client last caught up
+    };
+
+private:
+    std::deque<Msg> m_q;
+    size_t m_bytes; // unsent bytes of all messages
+    size_t m_eventBytes; // unsent bytes of event messages
+    size_t m_peakBytes;
+    unsigned int m_images;
+    bool m_dropping; // dropping events since the high-water mark was reached
+    unsigned long long m_droppedInBurst;
+
+    void Push(const Buf& buf, long long now, Kind kind)
+    {
+        m_q.push_back(Msg(buf, now, kind));
+        m_bytes += buf.length();
+        if (kind == EVENT)
+            m_eventBytes += buf.length();
+        else if (kind == IMAGE)
+            ++m_images;
+        if (m_bytes > m_peakBytes)
+            m_peakBytes = m_bytes;
+    }
+
+    void Dropped(unsigned long long n)
+    {
+        m_dropping = true;
+        m_droppedInBurst += n;
+    }
+
+public:
+    ClientOutputQueue()
+        : m_bytes(0), m_eventBytes(0), m_peakBytes(0), m_images(0), m_dropping(false), m_droppedInBurst(0)
+    {
+    }
+
+    bool Empty() const { return m_q.empty(); }
+    size_t Count() const { return m_q.size(); }
+    size_t Bytes() const { return m_bytes; }
+    size_t EventBytes() const { return m_eventBytes; }
+    size_t PeakBytes() const { return m_peakBytes; }
+    bool Dropping() const { return m_dropping; }
+    const Msg& Front() const { return m_q.front(); }
+
+    // An event is always accepted when nothing is queued, however large it is
+    EventResult PushEvent(const Buf& buf, long long now, size_t highWater)
+    {
+        if (!m_q.empty() && (m_dropping || m_eventBytes + buf.length() > highWater))
+        {
+            bool const started = !m_dropping;
+            Dropped(1);
+            return started ? STARTED_DROPPING : DROPPED;
+        }
+
+        Push(buf, now, EVENT);
+        return QUEUED;
+    }
+
+    // Queue a reply to a request, discarding the oldest unsent events if the events ahead of it
+    // would exceed the high-water mark. Returns the number of events discarded.
+    unsigned int PushResponse(const Buf& buf, long long now, size_t highWater)
+    {
+        unsigned int evicted = 0;
+
+        if (m_eventBytes + buf.length() > highWater)
+        {
+            size_t const target = buf.length() < highWater ? highWater - buf.length() : 0;
+            std::deque<Msg> kept;
+            for (typename std::deque<Msg>::iterator it = m_q.begin(); it != m_q.end(); ++it)
+            {
+                // a partly written message must be finished to keep the stream intact
+                if (m_eventBytes > target && it->kind == EVENT && it->offset == 0)
+                {
+                    m_bytes -= it->buf.length();
+                    m_eventBytes -= it->buf.length();
+                    ++evicted;
+                }
+                else
+                    kept.push_back(*it);
+            }
+            m_q.swap(kept);
+
+            if (evicted)
+                Dropped(evicted);
+        }
+
+        Push(buf, now, RESPONSE);
+        return evicted;
+    }
+
+    // Returns false, and does not queue the image, if the previous image has not been sent yet
+    bool PushImage(const Buf& buf, long long now)
+    {
+        if (m_images)
+            return false;
+        Push(buf, now, IMAGE);
+        return true;
+    }
+
+    // Write as much as possible. write(const char *, size_t) returns the number of bytes it took,
+    // and sent(const Msg&) is called for each message once it has been written completely.
+    // Returns the number of events dropped in the burst that ends when the unsent events fall
+    // below half the high-water mark, or 0 if no burst ended.
+    template <typename WriteFn, typename SentFn>
+    unsigned long long Flush(WriteFn write, SentFn sent, size_t highWater)
+    {
+        while (!m_q.empty())
+        {
+            Msg& msg = m_q.front();
+            size_t const len = msg.buf.length() - msg.offset;
+
+            size_t const n = write(msg.buf.data() + msg.offset, len);
+            msg.offset += n;
+            m_bytes -= n;
+            if (msg.kind == EVENT)
+                m_eventBytes -= n;
+
+            if (n < len)
+                break;
+
+            sent(msg);
+            if (msg.kind == IMAGE)
+                --m_images;
+            m_q.pop_front();
+        }
+
+        if (m_dropping && m_eventBytes < highWater / 2)
+        {
+            unsigned long long const dropped = m_droppedInBurst;
+            m_dropping = false;
+            m_droppedInBurst = 0;
+            return dropped;
+        }
+
+        return 0;
+    }
+};
+
+#endif // CLIENT_OUTPUT_QUEUE_H_INCLUDED
@@ -0,0 +1,515 @@
+/*
+ *  dark_cache.cpp
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "phd.h"
+
+#ifndef __WINDOWS__
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+#include <map>
+#include <memory>
+#include <stdint.h>
+
+// Cache file layout, in native byte order (a file written on a machine with a different byte
+// order fails the byte order check and is rebuilt):
+//
+//   CacheHeader
+//   DarkEntry[count] or DefectEntry[count]
+//   dark frame pixels, each frame starting on a DATA_ALIGN boundary
+//
+// The header checksum covers the entry table; each dark entry carries the checksum of its pixels.
+
+static const char CACHE_MAGIC[8] = { 'P', 'H', 'D', '2', 'C', 'A', 'C', 'H' };
+static const uint32_t CACHE_VERSION = 1;
+static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+static const size_t DATA_ALIGN = 64;
+
+enum CacheKind
+{
+    KIND_DARKS = 1,
+    KIND_DEFECTS = 2,
+};
+
+struct CacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t kind;
+    uint32_t count;
+    uint64_t sourceSize;
+    int64_t sourceMtime; // milliseconds since the epoch
+    uint64_t checksum;
+};
+
+struct DarkEntry
+{
+    int32_t width;
+    int32_t height;
+    int32_t expDur;
+    int32_t stackCnt;
+    uint16_t minADU;
+    uint16_t maxADU;
+    uint16_t medianADU;
+    uint16_t filtMin;
+    uint16_t filtMax;
+    uint16_t reserved1;
+    uint32_t reserved2;
+    uint64_t offset; // from the start of the file
+    uint64_t checksum;
+};
+
+struct DefectEntry
+{
+    int32_t x;
+    int32_t y;
+};
+
+// Fletcher-style checksum, 32 bits at a time
+static uint64_t Checksum(const void *data, size_t len)
+{
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    uint64_t a = 1, b = 0;
+
+    size_t const nwords = len / 4;
+    for (size_t i = 0; i < nwords; i++, p += 4)
+    {
+        uint32_t w;
+        memcpy(&w, p, sizeof(w));
+        a += w;
+        b += a;
+    }
+    for (size_t i = nwords * 4; i < len; i++)
+    {
+        a += *p++;
+        b += a;
+    }
+
+    return (b * 0x9E3779B97F4A7C15ULL) ^ a ^ (uint64_t) len;
+}
+
+static size_t AlignUp(size_t n)
+{
+    return (n + DATA_ALIGN - 1) & ~(DATA_ALIGN - 1);
+}
+
+// read-only memory mapping of a whole file
+class MappedFile
+{
+    const unsigned char *m_data;
+    size_t m_size;
+
+public:
+    MappedFile() : m_data(nullptr), m_size(0) { }
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // returns true on error
+    bool Open(const wxString& path);
+    const unsigned char *Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+};
+
+#ifdef __WINDOWS__
+
+bool MappedFile::Open(const wxString& path)
+{
+    HANDLE file = CreateFileW(path.wc_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                              nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return true;
+
+    LARGE_INTEGER size;
+    HANDLE mapping = nullptr;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+        mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping)
+        return true;
+
+    // the view keeps the mapping alive
+    m_data = static_cast<const unsigned char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    CloseHandle(mapping);
+    if (!m_data)
+        return true;
+
+    m_size = (size_t) size.QuadPart;
+    return false;
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_data)
+        UnmapViewOfFile(m_data);
+}
+
+#else // __WINDOWS__
+
+bool MappedFile::Open(const wxString& path)
+{
+    int fd = open(path.fn_str(), O_RDONLY);
+    if (fd == -1)
+        return true;
+
+    struct stat st;
+    void *addr = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        addr = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+        return true;
+
+    m_data = static_cast<const unsigned char *>(addr);
+    m_size = (size_t) st.st_size;
+    return false;
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_data)
+        munmap(const_cast<unsigned char *>(m_data), m_size);
+}
+
+#endif // __WINDOWS__
+
+// size and modification time of a file; returns true on error
+static bool FileStamp(const wxString& file, uint64_t *size, int64_t *mtime)
+{
+    wxFileName fn(file);
+    if (!fn.FileExists())
+        return true;
+
+    wxULongLong sz = fn.GetSize();
+    wxDateTime mt = fn.GetModificationTime();
+    if (sz == wxInvalidSize || !mt.IsValid())
+        return true;
+
+    *size = sz.GetValue();
+    *mtime = mt.GetValue().GetValue();
+    return false;
+}
+
+static bool InitHeader(CacheHeader *hdr, const wxString& sourceFile, uint32_t kind, size_t count)
+{
+    memset(hdr, 0, sizeof(*hdr));
+    memcpy(hdr->magic, CACHE_MAGIC, sizeof(hdr->magic));
+    hdr->version = CACHE_VERSION;
+    hdr->byteOrder = BYTE_ORDER_MARK;
+    hdr->kind = kind;
+    hdr->count = (uint32_t) count;
+    return FileStamp(sourceFile, &hdr->sourceSize, &hdr->sourceMtime);
+}
+
+// map the cache file for sourceFile and validate its header and entry table; returns null if the
+// cache is missing, stale or corrupt
+static const CacheHeader *OpenCache(MappedFile& map, const wxString& sourceFile, uint32_t kind, size_t entrySize)
+{
+    uint64_t sourceSize;
+    int64_t sourceMtime;
+    if (FileStamp(sourceFile, &sourceSize, &sourceMtime))
+        return nullptr;
+
+    wxString cacheFile = DarkCache::CacheFileName(sourceFile);
+    if (!wxFileExists(cacheFile))
+        return nullptr;
+
+    if (map.Open(cacheFile))
+    {
+        Debug.Write(wxString::Format("DarkCache: could not map %s\n", cacheFile));
+        return nullptr;
+    }
+
+    const CacheHeader *hdr = reinterpret_cast<const CacheHeader *>(map.Data());
+
+    if (map.Size() < sizeof(CacheHeader) || memcmp(hdr->magic, CACHE_MAGIC, sizeof(hdr->magic)) != 0 ||
+        hdr->version != CACHE_VERSION || hdr->byteOrder != BYTE_ORDER_MARK || hdr->kind != kind)
+    {
+        Debug.Write(wxString::Format("DarkCache: ignoring %s, unrecognized format\n", cacheFile));
+        return nullptr;
+    }
+
+    if (hdr->sourceSize != sourceSize || hdr->sourceMtime != sourceMtime)
+    {
+        Debug.Write(wxString::Format("DarkCache: ignoring %s, out of date\n", cacheFile));
+        return nullptr;
+    }
+
+    size_t const tableSize = (size_t) hdr->count * entrySize;
+    if (tableSize / entrySize != hdr->count || tableSize > map.Size() - sizeof(CacheHeader) ||
+        Checksum(hdr + 1, tableSize) != hdr->checksum)
+    {
+        Debug.Write(wxString::Format("DarkCache: ignoring %s, checksum mismatch\n", cacheFile));
+        return nullptr;
+    }
+
+    return hdr;
+}
+
+// Dark cache files whose frame checksums have been verified, with the size and modification time
+// they had then. The frames of a cache file are checksummed when it is first loaded and again only
+// if the file changes, rather than on every load. Only used on the main thread.
+struct CacheStamp
+{
+    uint64_t size;
+    int64_t mtime;
+};
+static std::map<wxString, CacheStamp> s_verifiedDarks;
+
+static bool IsVerified(const wxString& cacheFile)
+{
+    CacheStamp st;
+    auto it = s_verifiedDarks.find(cacheFile);
+    return it != s_verifiedDarks.end() && !FileStamp(cacheFile, &st.size, &st.mtime) && st.size == it->second.size &&
+        st.mtime == it->second.mtime;
+}
+
+static void SetVerified(const wxString& cacheFile)
+{
+    CacheStamp st;
+    if (FileStamp(cacheFile, &st.size, &st.mtime))
+        s_verifiedDarks.erase(cacheFile);
+    else
+        s_verifiedDarks[cacheFile] = st;
+}
+
+// write the cache file through a temporary file so that a partial write never replaces a good
+// cache; returns true on error
+static bool WriteCache(const wxString& sourceFile, const CacheHeader& hdr, const void *table, size_t tableSize,
+                       const std::vector<std::pair<const void *, size_t>>& blocks)
+{
+    wxString cacheFile = DarkCache::CacheFileName(sourceFile);
+    wxString tmpFile = cacheFile + ".tmp";
+
+    bool ok;
+    {
+        wxFile file;
+        ok = file.Create(tmpFile, true);
+        ok = ok && file.Write(&hdr, sizeof(hdr)) == sizeof(hdr);
+        ok = ok && file.Write(table, tableSize) == tableSize;
+
+        size_t pos = sizeof(hdr) + tableSize;
+        static const char zeros[DATA_ALIGN] = { };
+        for (auto it = blocks.begin(); ok && it != blocks.end(); ++it)
+        {
+            size_t pad = AlignUp(pos) - pos;
+            ok = file.Write(zeros, pad) == pad && file.Write(it->first, it->second) == it->second;
+            pos += pad + it->second;
+        }
+
+        ok = ok && file.Close();
+    }
+
+    if (ok && wxRenameFile(tmpFile, cacheFile, true))
+    {
+        Debug.Write(wxString::Format("DarkCache: saved %s\n", cacheFile));
+        return false;
+    }
+
+    Debug.Write(wxString::Format("DarkCache: failed to save %s\n", cacheFile));
+    if (wxFileExists(tmpFile))
+        wxRemoveFile(tmpFile);
+    return true;
+}
+
+wxString DarkCache::CacheFileName(const wxString& sourceFile)
+{
+    return sourceFile + ".cache";
+}
+
+bool DarkCache::LoadDarks(const wxString& sourceFile, std::vector<usImage *> *darks)
+{
+    darks->clear();
+
+    MappedFile map;
+    const CacheHeader *hdr = OpenCache(map, sourceFile, KIND_DARKS, sizeof(DarkEntry));
+    if (!hdr)
+        return true;
+
+    const DarkEntry *entries = reinterpret_cast<const DarkEntry *>(hdr + 1);
+    std::vector<std::unique_ptr<usImage>> imgs;
+    wxString const cacheFile = CacheFileName(sourceFile);
+    bool const verify = !IsVerified(cacheFile);
+
+    for (uint32_t i = 0; i < hdr->count; i++)
+    {
+        const DarkEntry& e = entries[i];
+
+        size_t const bytes = (size_t) e.width * e.height * sizeof(unsigned short);
+        if (e.width <= 0 || e.height <= 0 || e.offset > map.Size() || bytes > map.Size() - e.offset)
+        {
+            Debug.Write(wxString::Format("DarkCache: ignoring %s, bad frame table\n", cacheFile));
+            return true;
+        }
+
+        const unsigned char *pixels = map.Data() + e.offset;
+        if (verify && Checksum(pixels, bytes) != e.checksum)
+        {
+            Debug.Write(wxString::Format("DarkCache: ignoring %s, frame %u checksum mismatch\n", cacheFile, i));
+            return true;
+        }
+
+        // The darks are copied out of the mapping: the camera owns its darks as ordinary usImages
+        // (their buffers come from FrameBufferPool) and keeps them after the cache file is
+        // rewritten or removed. The mapping still saves decoding FITS and reading into a buffer.
+        std::unique_ptr<usImage> img(new usImage());
+        if (img->Init(e.width, e.height))
+            return true;
+
+        memcpy(img->ImageData, pixels, bytes);
+        img->ImgExpDur = e.expDur;
+        img->ImgStackCnt = e.stackCnt;
+        img->MinADU = e.minADU;
+        img->MaxADU = e.maxADU;
+        img->MedianADU = e.medianADU;
+        img->FiltMin = e.filtMin;
+        img->FiltMax = e.filtMax;
+
+        imgs.push_back(std::move(img));
+    }
+
+    for (auto it = imgs.begin(); it != imgs.end(); ++it)
+        darks->push_back(it->release());
+
+    if (verify)
+        SetVerified(cacheFile);
+
+    Debug.Write(wxString::Format("DarkCache: loaded %u dark frames from %s\n", hdr->count, cacheFile));
+    return false;
+}
+
+bool DarkCache::GetDarkFrameSize(const wxString& sourceFile, wxSize *size)
+{
+    MappedFile map;
+    const CacheHeader *hdr = OpenCache(map, sourceFile, KIND_DARKS, sizeof(DarkEntry));
+    if (!hdr || hdr->count == 0)
+        return true;
+
+    const DarkEntry *entries = reinterpret_cast<const DarkEntry *>(hdr + 1);
+    size->Set(entries[0].width, entries[0].height);
+    return false;
+}
+
+void DarkCache::SaveDarks(const wxString& sourceFile, const std::map<int, usImage *>& darks)
+{
+    CacheHeader hdr;
+    if (InitHeader(&hdr, sourceFile, KIND_DARKS, darks.size()))
+        return;
+
+    std::vector<DarkEntry> entries;
+    std::vector<std::pair<const void *, size_t>> blocks;
+    size_t offset = sizeof(hdr) + darks.size() * sizeof(DarkEntry);
+
+    for (auto it = darks.begin(); it != darks.end(); ++it)
+    {
+        const usImage *img = it->second;
+        size_t const bytes = img->NPixels * sizeof(unsigned short);
+
+        DarkEntry e;
+        memset(&e, 0, sizeof(e));
+        e.width = img->Size.GetWidth();
+        e.height = img->Size.GetHeight();
+        e.expDur = img->ImgExpDur;
+        e.stackCnt = img->ImgStackCnt;
+        e.minADU = img->MinADU;
+        e.maxADU = img->MaxADU;
+        e.medianADU = img->MedianADU;
+        e.filtMin = img->FiltMin;
+        e.filtMax = img->FiltMax;
+        offset = AlignUp(offset);
+        e.offset = offset;
+        e.checksum = Checksum(img->ImageData, bytes);
+        offset += bytes;
+
+        entries.push_back(e);
+        blocks.push_back(std::make_pair(img->ImageData, bytes));
+    }
+
+    hdr.checksum = Checksum(entries.data(), entries.size() * sizeof(DarkEntry));
+
+    // the checksums were computed from the frames just written
+    if (!WriteCache(sourceFile, hdr, entries.data(), entries.size() * sizeof(DarkEntry), blocks))
+        SetVerified(CacheFileName(sourceFile));
+}
+
+bool DarkCache::LoadDefects(const wxString& sourceFile, std::vector<wxPoint> *defects)
+{
+    MappedFile map;
+    const CacheHeader *hdr = OpenCache(map, sourceFile, KIND_DEFECTS, sizeof(DefectEntry));
+    if (!hdr)
+        return true;
+
+    const DefectEntry *entries = reinterpret_cast<const DefectEntry *>(hdr + 1);
+
+    defects->clear();
+    defects->reserve(hdr->count);
+    for (uint32_t i = 0; i < hdr->count; i++)
+        defects->push_back(wxPoint(entries[i].x, entries[i].y));
+
+    return false;
+}
+
+void DarkCache::SaveDefects(const wxString& sourceFile, const std::vector<wxPoint>& defects)
+{
+    CacheHeader hdr;
+    if (InitHeader(&hdr, sourceFile, KIND_DEFECTS, defects.size()))
+        return;
+
+    std::vector<DefectEntry> entries(defects.size());
+    for (size_t i = 0; i < defects.size(); i++)
+    {
+        entries[i].x = defects[i].x;
+        entries[i].y = defects[i].y;
+    }
+
+    hdr.checksum = Checksum(entries.data(), entries.size() * sizeof(DefectEntry));
+
+    WriteCache(sourceFile, hdr, entries.data(), entries.size() * sizeof(DefectEntry),
+               std::vector<std::pair<const void *, size_t>>());
+}
+
+void DarkCache::Remove(const wxString& sourceFile)
+{
+    wxString cacheFile = CacheFileName(sourceFile);
+    if (wxFileExists(cacheFile))
+    {
+        Debug.Write(wxString::Format("Removing cache file: %s\n", cacheFile));
+        wxRemoveFile(cacheFile);
+    }
+    s_verifiedDarks.erase(cacheFile);
+}
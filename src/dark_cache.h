@@ -0,0 +1,66 @@
+/*
+ *  dark_cache.h
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef DARK_CACHE_INCLUDED
+#define DARK_CACHE_INCLUDED
+
+// Binary cache of the dark library and the defect map.
+//
+// The FITS dark library and the text defect map remain the interchange format; each one gets a
+// versioned binary companion file (<source>.cache) holding the data in a form that can be
+// memory-mapped and used without parsing: the darks with their precomputed statistics and the
+// defect list in row order. A cache file records the size and modification time of the source it
+// was built from and a checksum of its contents, and is ignored when either no longer matches.
+// The dark frame checksums are verified the first time a cache file is loaded and again only
+// when the file changes.
+class DarkCache
+{
+public:
+    static wxString CacheFileName(const wxString& sourceFile);
+
+    // Load the darks cached for sourceFile; the caller owns the returned images. Returns true
+    // on error (no cache, stale cache or corrupt cache), in which case darks is left empty
+    static bool LoadDarks(const wxString& sourceFile, std::vector<usImage *> *darks);
+    // frame size of the darks cached for sourceFile; returns true on error
+    static bool GetDarkFrameSize(const wxString& sourceFile, wxSize *size);
+    static void SaveDarks(const wxString& sourceFile, const std::map<int, usImage *>& darks);
+
+    // load the defect list cached for sourceFile; returns true on error
+    static bool LoadDefects(const wxString& sourceFile, std::vector<wxPoint> *defects);
+    static void SaveDefects(const wxString& sourceFile, const std::vector<wxPoint>& defects);
+
+    static void Remove(const wxString& sourceFile);
+};
+
+#endif // DARK_CACHE_INCLUDED
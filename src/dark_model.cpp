@@ -0,0 +1,135 @@
+/*
+ *  dark_model.cpp
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "dark_model.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+// frames smaller than this are not worth splitting
+const size_t MIN_PARALLEL_PIXELS = 1024 * 1024;
+// pixels accumulated at a time, small enough for the accumulator to stay in L1 cache
+const size_t BLOCK_PIXELS = 2048;
+
+void SynthesizeRange(unsigned short *out, const unsigned short *const *darks, const float *weights, int n, size_t begin,
+                     size_t end)
+{
+    float acc[BLOCK_PIXELS];
+
+    for (size_t b0 = begin; b0 < end; b0 += BLOCK_PIXELS)
+    {
+        size_t const cnt = std::min(BLOCK_PIXELS, end - b0);
+
+        std::fill(acc, acc + cnt, 0.5f); // round to nearest on conversion
+        for (int i = 0; i < n; i++)
+        {
+            const unsigned short *p = darks[i] + b0;
+            float const w = weights[i];
+            for (size_t k = 0; k < cnt; k++)
+                acc[k] += w * (float) p[k];
+        }
+
+        unsigned short *o = out + b0;
+        for (size_t k = 0; k < cnt; k++)
+        {
+            float const v = acc[k];
+            o[k] = v <= 0.f ? 0 : v >= 65535.f ? 65535 : (unsigned short) v;
+        }
+    }
+}
+} // namespace
+
+bool DarkModel::CanSynthesize(const double *exposures, int n, double t)
+{
+    if (n < 2)
+        return false;
+
+    double tmin = exposures[0];
+    double tmax = exposures[0];
+    for (int i = 1; i < n; i++)
+    {
+        tmin = std::min(tmin, exposures[i]);
+        tmax = std::max(tmax, exposures[i]);
+    }
+
+    return tmin < tmax && t >= tmin && t <= tmax;
+}
+
+bool DarkModel::Weights(double *weights, const double *exposures, int n, double t)
+{
+    if (n < 2)
+        return true;
+
+    double tmean = 0.;
+    for (int i = 0; i < n; i++)
+        tmean += exposures[i];
+    tmean /= n;
+
+    double sxx = 0.;
+    for (int i = 0; i < n; i++)
+        sxx += (exposures[i] - tmean) * (exposures[i] - tmean);
+
+    if (sxx <= 0.)
+        return true; // all the same exposure
+
+    for (int i = 0; i < n; i++)
+        weights[i] = 1. / n + (exposures[i] - tmean) * (t - tmean) / sxx;
+
+    return false;
+}
+
+void DarkModel::Synthesize(unsigned short *out, const unsigned short *const *darks, const double *weights, int n,
+                           size_t npixels, unsigned int concurrency, ParallelForFn pfor)
+{
+    std::vector<float> w(weights, weights + n);
+
+    unsigned int nblocks = 1;
+    if (pfor && concurrency > 1 && npixels >= MIN_PARALLEL_PIXELS)
+        nblocks = concurrency;
+
+    if (nblocks > 1)
+    {
+        (*pfor)(nblocks,
+                [&](unsigned int i)
+                {
+                    size_t begin = npixels * i / nblocks;
+                    size_t end = npixels * (i + 1) / nblocks;
+                    SynthesizeRange(out, darks, w.data(), n, begin, end);
+                });
+    }
+    else
+        SynthesizeRange(out, darks, w.data(), n, 0, npixels);
+}
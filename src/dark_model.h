@@ -0,0 +1,69 @@
+/*
+ *  dark_model.h
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef DARK_MODEL_H_INCLUDED
+#define DARK_MODEL_H_INCLUDED
+
+#include <functional>
+#include <stddef.h>
+
+// Dark frames for exposures that are not in the dark library. Each pixel is modelled as
+// bias + rate * exposure, fitted by least squares across the library darks. The fitted value at
+// exposure t is a fixed linear combination of the library darks,
+//
+//     dark(t) = sum_i w_i(t) * dark_i,  w_i(t) = 1/n + (t_i - tmean) * (t - tmean) / sum_j (t_j - tmean)^2
+//
+// so the model needs no storage of its own: the weights take O(n) to compute and synthesizing a
+// dark is a single pass over the library pixels.
+
+namespace DarkModel
+{
+typedef void (*ParallelForFn)(unsigned int count, const std::function<void(unsigned int)>& fn);
+
+// True if a dark of exposure t can be synthesized from library darks with the given exposures:
+// there are at least two distinct exposures and t is within their range. The fit is not used to
+// extrapolate beyond the library.
+extern bool CanSynthesize(const double *exposures, int n, double t);
+
+// Least squares weights of n library darks with the given exposures for a dark of exposure t.
+// Returns true (error) if there are fewer than two distinct exposures.
+extern bool Weights(double *weights, const double *exposures, int n, double t);
+
+// out[p] = sum of weights[i] * darks[i][p], rounded and clamped to 0..65535, for npixels pixels.
+// pfor (may be null) is used to process up to concurrency blocks of pixels at once.
+extern void Synthesize(unsigned short *out, const unsigned short *const *darks, const double *weights, int n, size_t npixels,
+                       unsigned int concurrency = 1, ParallelForFn pfor = nullptr);
+}
+
+#endif // DARK_MODEL_H_INCLUDED
@@ -0,0 +1,179 @@
+/*
+ *  dark_stack.cpp
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "dark_stack.h"
+
+#include <algorithm>
+#include <math.h>
+
+namespace
+{
+// values are integers, so a pixel whose other values are all equal has zero deviation; treat its
+// deviation as at least this to avoid rejecting values that differ by a count or two
+const double MIN_SIGMA = 1.;
+// never reject values from a pixel with this few values left
+const unsigned int MIN_KEEP = 3;
+} // namespace
+
+DarkStack::DarkStack() : m_count(0) { }
+
+void DarkStack::Reset(size_t npixels)
+{
+    m_sum.assign(npixels, 0);
+    m_sumsq.assign(npixels, 0);
+    m_hi0.assign(npixels, 0);
+    m_hi1.assign(npixels, 0);
+    m_lo.assign(npixels, 65535);
+    m_count = 0;
+}
+
+void DarkStack::Add(const unsigned short *frame)
+{
+    size_t const n = m_sum.size();
+    unsigned int *sum = m_sum.data();
+    unsigned long long *sumsq = m_sumsq.data();
+    unsigned short *hi0 = m_hi0.data();
+    unsigned short *hi1 = m_hi1.data();
+    unsigned short *lo = m_lo.data();
+
+    for (size_t i = 0; i < n; i++)
+    {
+        unsigned int const v = frame[i];
+        sum[i] += v;
+        sumsq[i] += v * v;
+        if (v > hi0[i])
+        {
+            hi1[i] = hi0[i];
+            hi0[i] = (unsigned short) v;
+        }
+        else if (v > hi1[i])
+            hi1[i] = (unsigned short) v;
+        if (v < lo[i])
+            lo[i] = (unsigned short) v;
+    }
+
+    ++m_count;
+}
+
+namespace
+{
+// The values of a pixel other than its extremes, used as the reference for rejecting the
+// extremes: with at least six values, all but the two highest and the lowest; with four or five,
+// all but the highest.
+struct Core
+{
+    double mean;
+    double sigma;
+};
+
+inline Core core_stats(double s, double ss, unsigned int n, unsigned short hi0, unsigned short hi1, unsigned short lo)
+{
+    double v[3] = { (double) hi0, (double) hi1, (double) lo };
+    int const nx = n >= 6 ? 3 : 1;
+    for (int i = 0; i < nx; i++)
+    {
+        s -= v[i];
+        ss -= v[i] * v[i];
+    }
+    unsigned int const m = n - nx;
+    Core c;
+    c.mean = s / m;
+    double const var = (ss - c.mean * c.mean * m) / (m - 1);
+    c.sigma = var > 0. ? sqrt(var) : 0.;
+    return c;
+}
+} // namespace
+
+size_t DarkStack::Result(unsigned short *out, double kappa) const
+{
+    size_t const npixels = m_sum.size();
+    unsigned int const n = m_count;
+
+    if (n <= MIN_KEEP)
+    {
+        for (size_t i = 0; i < npixels; i++)
+            out[i] = (unsigned short) ((m_sum[i] + n / 2) / n);
+        return 0;
+    }
+
+    // The core of a pixel has as few as three values, and trimming its extremes makes its standard
+    // deviation an underestimate. Use the typical standard deviation of all the values of a pixel
+    // over the frame as a lower bound, so that good values are not rejected from pixels whose
+    // core happens to be tight. Few pixels have outliers, so they do not affect the median.
+    double frameSigma;
+    {
+        size_t const step = std::max(npixels / 65536, (size_t) 1);
+        std::vector<double> sig;
+        sig.reserve(npixels / step + 1);
+        for (size_t i = 0; i < npixels; i += step)
+        {
+            double const mean = (double) m_sum[i] / n;
+            double const var = ((double) m_sumsq[i] - mean * mean * n) / (n - 1);
+            sig.push_back(var > 0. ? sqrt(var) : 0.);
+        }
+        std::nth_element(sig.begin(), sig.begin() + sig.size() / 2, sig.end());
+        frameSigma = sig[sig.size() / 2];
+    }
+
+    double const minSigma = std::max(frameSigma, MIN_SIGMA);
+    size_t rejected = 0;
+
+    for (size_t i = 0; i < npixels; i++)
+    {
+        double s = m_sum[i];
+        unsigned int cnt = n;
+
+        Core const c = core_stats(s, (double) m_sumsq[i], n, m_hi0[i], m_hi1[i], m_lo[i]);
+        double const limit = kappa * std::max(c.sigma, minSigma);
+
+        // candidates for rejection, most extreme first
+        unsigned short const cand[3] = { m_hi0[i], m_hi1[i], m_lo[i] };
+        int const ncand = n >= 6 ? 3 : 1;
+
+        for (int k = 0; k < ncand && cnt > MIN_KEEP; k++)
+        {
+            double const v = cand[k];
+            if (fabs(v - c.mean) > limit)
+            {
+                s -= v;
+                --cnt;
+                ++rejected;
+            }
+        }
+
+        out[i] = (unsigned short) std::min(floor(s / cnt + 0.5), 65535.);
+    }
+
+    return rejected;
+}
@@ -0,0 +1,78 @@
+/*
+ *  dark_stack.h
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef DARK_STACK_H_INCLUDED
+#define DARK_STACK_H_INCLUDED
+
+#include <stddef.h>
+#include <vector>
+
+// Streaming sigma-clipped stacking of dark frames. Frames are accumulated as they arrive and are
+// not kept: for each pixel the stack holds the sum and sum of squares of its values, its two
+// highest values and its lowest value, 18 bytes per pixel however many frames are stacked.
+//
+// When the stack is finished, the extreme values of each pixel are compared with the mean of its
+// other values (its core) and rejected if they lie more than kappa sigma away, where sigma is the
+// larger of the core's standard deviation and the typical standard deviation of a pixel over the
+// frame. With six or more frames the two highest and the lowest values are candidates for
+// rejection, with four or five frames only the highest, and with fewer frames the result is a
+// plain average. The result is the mean of the values that are kept. This removes cosmic ray hits
+// and other transients that a plain average smears into the master dark.
+
+class DarkStack
+{
+    std::vector<unsigned int> m_sum;
+    std::vector<unsigned long long> m_sumsq;
+    std::vector<unsigned short> m_hi0; // highest value
+    std::vector<unsigned short> m_hi1; // second highest value
+    std::vector<unsigned short> m_lo; // lowest value
+    unsigned int m_count;
+
+public:
+    DarkStack();
+
+    // start a new stack of frames of npixels pixels
+    void Reset(size_t npixels);
+    // add a frame of npixels pixels
+    void Add(const unsigned short *frame);
+
+    unsigned int Count() const { return m_count; }
+    size_t Pixels() const { return m_sum.size(); }
+
+    // Write the clipped mean of the frames to out (npixels pixels); returns the number of values
+    // rejected. There must be at least one frame.
+    size_t Result(unsigned short *out, double kappa = 3.) const;
+};
+
+#endif // DARK_STACK_H_INCLUDED
@@ -0,0 +1,145 @@
+/*
+ *  dark_subtract.cpp
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "dark_subtract.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define DARK_SUBTRACT_X86 1
+# include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+# define DARK_SUBTRACT_NEON 1
+# include <arm_neon.h>
+#endif
+
+namespace
+{
+// regions smaller than this are not worth splitting
+const unsigned int MIN_PARALLEL_PIXELS = 1024 * 1024;
+const int MIN_BAND_ROWS = 64;
+} // namespace
+
+// With saturating unsigned arithmetic the result is exact without widening to 32 bits:
+//
+//     u = light -sat dark, v = dark -sat light  (at most one is non-zero)
+//     result = (u +sat pedestal) -sat v
+//
+// When light >= dark this is min(light - dark + pedestal, 65535), otherwise it is
+// max(pedestal - (dark - light), 0).
+
+void DarkSubtract::SubtractRowScalar(unsigned short *light, const unsigned short *dark, int n, unsigned short pedestal)
+{
+    for (int i = 0; i < n; i++)
+    {
+        int newval = (int) light[i] + pedestal - (int) dark[i];
+        if (newval < 0)
+            newval = 0; // hot pixel in dark frame isn't present in light frame
+        else if (newval > 65535)
+            newval = 65535;
+        light[i] = (unsigned short) newval;
+    }
+}
+
+void DarkSubtract::SubtractRow(unsigned short *light, const unsigned short *dark, int n, unsigned short pedestal)
+{
+    int i = 0;
+
+#if defined(DARK_SUBTRACT_X86)
+
+    const __m128i ped = _mm_set1_epi16((short) pedestal);
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i l0 = _mm_loadu_si128((const __m128i *) (light + i));
+        __m128i l1 = _mm_loadu_si128((const __m128i *) (light + i + 8));
+        __m128i d0 = _mm_loadu_si128((const __m128i *) (dark + i));
+        __m128i d1 = _mm_loadu_si128((const __m128i *) (dark + i + 8));
+        __m128i r0 = _mm_subs_epu16(_mm_adds_epu16(_mm_subs_epu16(l0, d0), ped), _mm_subs_epu16(d0, l0));
+        __m128i r1 = _mm_subs_epu16(_mm_adds_epu16(_mm_subs_epu16(l1, d1), ped), _mm_subs_epu16(d1, l1));
+        _mm_storeu_si128((__m128i *) (light + i), r0);
+        _mm_storeu_si128((__m128i *) (light + i + 8), r1);
+    }
+
+#elif defined(DARK_SUBTRACT_NEON)
+
+    const uint16x8_t ped = vdupq_n_u16(pedestal);
+    for (; i + 16 <= n; i += 16)
+    {
+        uint16x8_t l0 = vld1q_u16(light + i);
+        uint16x8_t l1 = vld1q_u16(light + i + 8);
+        uint16x8_t d0 = vld1q_u16(dark + i);
+        uint16x8_t d1 = vld1q_u16(dark + i + 8);
+        vst1q_u16(light + i, vqsubq_u16(vqaddq_u16(vqsubq_u16(l0, d0), ped), vqsubq_u16(d0, l0)));
+        vst1q_u16(light + i + 8, vqsubq_u16(vqaddq_u16(vqsubq_u16(l1, d1), ped), vqsubq_u16(d1, l1)));
+    }
+
+#endif
+
+    if (i < n)
+        SubtractRowScalar(light + i, dark + i, n - i, pedestal);
+}
+
+void DarkSubtract::Subtract(unsigned short *light, const unsigned short *dark, int width, int rx, int ry, int rw, int rh,
+                            unsigned short pedestal, unsigned int concurrency, ParallelForFn pfor)
+{
+    if (rw <= 0 || rh <= 0)
+        return;
+
+    size_t const offset = (size_t) ry * width + rx;
+    unsigned short *const light0 = light + offset;
+    const unsigned short *const dark0 = dark + offset;
+
+    auto subtract_rows = [&](int y0, int y1)
+    {
+        for (int y = y0; y < y1; y++)
+            SubtractRow(light0 + (size_t) y * width, dark0 + (size_t) y * width, rw, pedestal);
+    };
+
+    unsigned int nbands = 1;
+    if (pfor && concurrency > 1 && (unsigned int) rw * (unsigned int) rh >= MIN_PARALLEL_PIXELS)
+        nbands = std::min(concurrency, (unsigned int) std::max(rh / MIN_BAND_ROWS, 1));
+
+    if (nbands > 1)
+    {
+        (*pfor)(nbands,
+                [&](unsigned int i)
+                {
+                    int y0 = (int) ((long long) rh * i / nbands);
+                    int y1 = (int) ((long long) rh * (i + 1) / nbands);
+                    subtract_rows(y0, y1);
+                });
+    }
+    else
+        subtract_rows(0, rh);
+}
@@ -0,0 +1,63 @@
+/*
+ *  dark_subtract.h
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef DARK_SUBTRACT_H_INCLUDED
+#define DARK_SUBTRACT_H_INCLUDED
+
+#include <functional>
+
+// Dark frame subtraction. Each pixel of the light frame becomes
+//
+//     min(max(light + pedestal - dark, 0), 65535)
+//
+// computed with saturating 16-bit operations (SSE2 or NEON when available). Large regions are
+// split into bands of rows that are processed concurrently.
+
+namespace DarkSubtract
+{
+typedef void (*ParallelForFn)(unsigned int count, const std::function<void(unsigned int)>& fn);
+
+// subtract n dark pixels from n light pixels
+extern void SubtractRow(unsigned short *light, const unsigned short *dark, int n, unsigned short pedestal);
+// the portable reference version of SubtractRow
+extern void SubtractRowScalar(unsigned short *light, const unsigned short *dark, int n, unsigned short pedestal);
+
+// Subtract the rectangle (rx, ry, rw, rh) of the dark frame from the same rectangle of the light
+// frame; both images have the given width. pfor (may be null) is used to process up to
+// concurrency bands at once.
+extern void Subtract(unsigned short *light, const unsigned short *dark, int width, int rx, int ry, int rw, int rh,
+                     unsigned short pedestal, unsigned int concurrency = 1, ParallelForFn pfor = nullptr);
+}
+
+#endif // DARK_SUBTRACT_H_INCLUDED
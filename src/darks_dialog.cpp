@@ -38,6 +38,7 @@
 #include <wx/valnum.h>
 
 #include <algorithm>
+#include <deque>
 #include <sstream>
 
 static const int DefDarkCount = 5;
@@ -167,10 +168,18 @@ DarksDialog::DarksDialog(wxWindow *parent, bool darkLib)
             m_rbNewDarkLib->SetValue(true);
         }
 
+        m_cbScaleDarks = new wxCheckBox(this, wxID_ANY, _("Synthesize darks for exposure times between library darks"));
+        m_cbScaleDarks->SetToolTip(
+            _("For an exposure time without a matching dark, fit the library darks and build a dark for the exact exposure "
+              "time instead of using the next longer dark. Needs at least two darks in the library."));
+        m_cbScaleDarks->SetValue(pConfig->Profile.GetBoolean("/camera/ScaleDarks", false));
+        m_cbScaleDarks->Bind(wxEVT_CHECKBOX, &DarksDialog::OnScaleDarks, this);
+
         hSizer->Add(m_rbModifyDarkLib, wxSizerFlags().Border(wxALL, 10));
         hSizer->Add(m_rbNewDarkLib, wxSizerFlags().Border(wxALL, 10));
         pBuildOptions->Add(pInfo, wxSizerFlags().Border(wxALL, 10).Border(wxLEFT, 25));
         pBuildOptions->Add(hSizer, wxSizerFlags().Border(wxALL, 10));
+        pBuildOptions->Add(m_cbScaleDarks, wxSizerFlags().Border(wxALL, 10).Border(wxLEFT, 25));
         pvSizer->Add(pBuildOptions, wxSizerFlags().Expand());
     }
     else
@@ -402,6 +411,13 @@ void DarksDialog::OnStop(wxCommandEvent& evt)
         wxDialog::Close();
 }
 
+// Applies without building darks; the caller selects the dark for the current exposure when the dialog closes
+void DarksDialog::OnScaleDarks(wxCommandEvent& evt)
+{
+    Debug.Write(wxString::Format("Scaled darks %s\n", m_cbScaleDarks->GetValue() ? "enabled" : "disabled"));
+    pConfig->Profile.SetBoolean("/camera/ScaleDarks", m_cbScaleDarks->GetValue());
+}
+
 void DarksDialog::OnReset(wxCommandEvent& evt)
 {
     if (buildDarkLib)
@@ -495,15 +511,117 @@ struct Histogram
     }
 };
 
+// frames captured but not yet stacked; beyond this the capture loop waits for the stacker
+static const unsigned int MAX_QUEUED_DARKS = 2;
+
+// Stacks dark frames (see DarkStack) on a background thread so that each frame is added to the
+// stack while the next one is being exposed
+class DarkStackerThread : public wxThread
+{
+    wxMutex m_lock; // protects the state below
+    wxCondition m_wake; // a frame was queued or stop was requested
+    wxCondition m_done; // a frame was stacked
+    std::deque<usImage *> m_queue;
+    bool m_stop;
+
+    DarkStack m_stack;
+    wxSize m_size; // frame size of the stack
+    unsigned int m_skipped; // frames of another size, left out of the stack
+
+public:
+    DarkStackerThread(const wxSize& size)
+        : wxThread(wxTHREAD_JOINABLE), m_wake(m_lock), m_done(m_lock), m_stop(false), m_size(size), m_skipped(0)
+    {
+        m_stack.Reset((size_t) size.GetWidth() * size.GetHeight());
+    }
+
+    ~DarkStackerThread()
+    {
+        for (usImage *img : m_queue)
+            delete img;
+    }
+
+    // queue a frame for stacking, taking ownership of it; waits if too many frames are queued
+    void Add(usImage *frame)
+    {
+        wxMutexLocker lck(m_lock);
+        while (m_queue.size() >= MAX_QUEUED_DARKS)
+            m_done.Wait();
+        m_queue.push_back(frame);
+        m_wake.Signal();
+    }
+
+    // stack the queued frames and stop the thread; afterwards the stack can be read
+    const DarkStack& Finish()
+    {
+        {
+            wxMutexLocker lck(m_lock);
+            m_stop = true;
+            m_wake.Signal();
+        }
+        Wait();
+        return m_stack;
+    }
+
+    // valid after Finish()
+    const wxSize& FrameSize() const { return m_size; }
+    unsigned int Skipped() const { return m_skipped; }
+
+    ExitCode Entry() override
+    {
+        while (true)
+        {
+            usImage *frame;
+
+            {
+                wxMutexLocker lck(m_lock);
+                while (m_queue.empty() && !m_stop)
+                    m_wake.Wait();
+                if (m_queue.empty())
+                    break;
+                frame = m_queue.front();
+            }
+
+            frame->CalcStats();
+
+            Debug.Write(wxString::Format("dark frame stats: bpp %u min %u max %u med %u filtmin %u filtmax %u\n",
+                                         frame->BitsPerPixel, frame->MinADU, frame->MaxADU, frame->MedianADU, frame->FiltMin,
+                                         frame->FiltMax));
+
+            Histogram h(*frame);
+            h.Dump();
+
+            if (frame->Size == m_size)
+                m_stack.Add(frame->ImageData);
+            else
+            {
+                Debug.Write(wxString::Format("dark frame size %dx%d does not match %dx%d, frame skipped\n",
+                                             frame->Size.GetWidth(), frame->Size.GetHeight(), m_size.GetWidth(),
+                                             m_size.GetHeight()));
+                ++m_skipped;
+            }
+
+            {
+                wxMutexLocker lck(m_lock);
+                m_queue.pop_front();
+                m_done.Signal();
+            }
+
+            delete frame;
+        }
+
+        return (ExitCode) 0;
+    }
+};
+
 bool DarksDialog::CreateMasterDarkFrame(usImage& darkFrame, int expTime, int frameCount)
 {
     bool err = false;
 
     pCamera->InitCapture();
     darkFrame.ImgExpDur = expTime;
-    darkFrame.ImgStackCnt = frameCount;
 
-    unsigned int *avgimg = 0;
+    DarkStackerThread *stacker = nullptr;
 
     for (int j = 1; j <= frameCount; j++)
     {
@@ -522,44 +640,65 @@ bool DarksDialog::CreateMasterDarkFrame(usImage& darkFrame, int expTime, int fra
         }
 
         m_pProgress->SetValue(m_pProgress->GetValue() + expTime);
-        wxYield();
-
-        darkFrame.CalcStats();
-
-        Debug.Write(wxString::Format("dark frame stats: bpp %u min %u max %u med %u filtmin %u filtmax %u\n",
-                                     darkFrame.BitsPerPixel, darkFrame.MinADU, darkFrame.MaxADU, darkFrame.MedianADU,
-                                     darkFrame.FiltMin, darkFrame.FiltMax));
-
-        Histogram h(darkFrame);
-        h.Dump();
-        wxYield();
 
-        if (!avgimg)
+        if (!stacker)
         {
-            avgimg = new unsigned int[darkFrame.NPixels];
-            memset(avgimg, 0, darkFrame.NPixels * sizeof(*avgimg));
+            stacker = new DarkStackerThread(darkFrame.Size);
+            if (stacker->Create() != wxTHREAD_NO_ERROR || stacker->Run() != wxTHREAD_NO_ERROR)
+            {
+                Debug.Write("could not start dark stacking thread\n");
+                delete stacker;
+                stacker = nullptr;
+                err = true;
+                break;
+            }
         }
 
-        unsigned int *iptr = avgimg;
-        const unsigned short *usptr = darkFrame.ImageData;
-        for (unsigned int i = 0; i < darkFrame.NPixels; i++)
-            *iptr++ += *usptr++;
+        // hand the captured pixels to the stacker and capture the next frame into a new buffer
+        usImage *frame = new usImage();
+        if (frame->Init(darkFrame.Size))
+        {
+            delete frame;
+            err = true;
+            break;
+        }
+        frame->SwapImageData(darkFrame);
+        frame->BitsPerPixel = darkFrame.BitsPerPixel;
+        stacker->Add(frame);
     }
 
-    if (!m_cancelling && !err)
+    if (stacker)
     {
-        ShowStatus(_("Dark frames complete"), true);
-        const unsigned int *iptr = avgimg;
-        unsigned short *usptr = darkFrame.ImageData;
-        for (unsigned int i = 0; i < darkFrame.NPixels; i++)
-            *usptr++ = (unsigned short) (*iptr++ / frameCount);
+        const DarkStack& stack = stacker->Finish();
+
+        if (!m_cancelling && !err && stack.Count() == 0)
+            err = true; // every frame had the wrong size
+
+        // the last frame captured may not have had the size of the stack
+        if (!m_cancelling && !err && darkFrame.Size != stacker->FrameSize())
+            err = darkFrame.Init(stacker->FrameSize());
+
+        if (!m_cancelling && !err)
+        {
+            if (stacker->Skipped())
+                ShowStatus(wxString::Format(_("Dark frames complete, %u of %u skipped (frame size changed)"),
+                                            stacker->Skipped(), stack.Count() + stacker->Skipped()),
+                           true);
+            else
+                ShowStatus(_("Dark frames complete"), true);
+            size_t rejected = stack.Result(darkFrame.ImageData);
+            darkFrame.ImgStackCnt = stack.Count();
+            darkFrame.CalcStats();
+            Debug.Write(wxString::Format("stacked %u dark frames, %u skipped, %lu outlier values rejected\n", stack.Count(),
+                                         stacker->Skipped(), (unsigned long) rejected));
+        }
+
+        delete stacker;
     }
 
     m_pProgress->SetValue(m_pProgress->GetValue() + expTime);
     wxYield();
 
-    delete[] avgimg;
-
     return err;
 }
 
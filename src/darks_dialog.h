@@ -49,6 +49,7 @@ private:
     wxSpinCtrl *m_pNumDefExposures;
     wxRadioButton *m_rbModifyDarkLib;
     wxRadioButton *m_rbNewDarkLib;
+    wxCheckBox *m_cbScaleDarks;
     wxTextCtrl *m_pNotes;
     wxGauge *m_pProgress;
     wxButton *m_pStartBtn;
@@ -59,6 +60,7 @@ private:
     void OnStart(wxCommandEvent& evt);
     void OnStop(wxCommandEvent& evt);
     void OnReset(wxCommandEvent& evt);
+    void OnScaleDarks(wxCommandEvent& evt);
     void SaveProfileInfo();
     void ShowStatus(const wxString msg, bool appending);
     bool CreateMasterDarkFrame(usImage& dark, int expTime, int frameCount);
@@ -37,15 +37,163 @@
 
 #include <wx/dir.h>
 
+#ifndef __WINDOWS__
+# include <unistd.h>
+#endif
+
+#include <climits>
+#include <cstring>
+#include <string>
+
 #define ALWAYS_FLUSH_DEBUGLOG
 const int RetentionPeriod = 30;
 
-DebugLog::DebugLog() : m_enabled(false), m_lastWriteTime(wxDateTime::UNow()) { }
+// While the writer thread is running, Write() stamps the line and appends it to a bounded
+// lock-free queue; the writer thread formats the queued lines and writes them to the file in
+// batches, flushing once per batch rather than once per line. When the queue is full the line is
+// dropped and counted. Without the writer thread (at startup and shutdown) lines are written
+// and flushed synchronously as before.
+//
+// Error lines (ERROR_INFO, THROW_INFO and "Error..." messages) are always written synchronously,
+// after the lines queued ahead of them, so the file is up to date when something goes wrong.
+// If the app crashes, PhdApp::OnFatalException calls FlushOnCrash() to write out whatever is
+// still queued (on Windows; elsewhere it runs in a signal handler and can only record how many
+// lines were lost). The total number of dropped lines is logged when the writer thread stops.
+
+static const unsigned int QUEUE_SIZE = 4096; // must be a power of 2
+static const unsigned int WAKE_THRESHOLD = QUEUE_SIZE / 4; // wake the writer early when this many lines are queued
+static const unsigned int MAX_BATCH_LINES = 256; // lines written per acquisition of the log lock
+static const int WRITER_INTERVAL_MS = 100;
+
+struct DebugLog::LogQueue
+{
+    struct Slot
+    {
+        std::atomic<size_t> seq;
+        wxDateTime time;
+        unsigned long threadId;
+        std::string text; // UTF-8
+    };
+
+    Slot m_slots[QUEUE_SIZE];
+    std::atomic<size_t> m_head; // position of the next line to be queued
+    std::atomic<size_t> m_tail; // position of the next line to be written
+    std::atomic<unsigned long long> m_dropped;
+    unsigned long long m_droppedReported;
+    wxSemaphore m_wake;
+
+    LogQueue() : m_droppedReported(0)
+    {
+        for (unsigned int i = 0; i < QUEUE_SIZE; i++)
+            m_slots[i].seq.store(i, std::memory_order_relaxed);
+        m_head.store(0, std::memory_order_relaxed);
+        m_tail.store(0, std::memory_order_relaxed);
+        m_dropped.store(0, std::memory_order_relaxed);
+    }
+
+    // multiple producers
+    void Push(const wxDateTime& time, unsigned long threadId, const char *text, size_t len)
+    {
+        size_t pos = m_head.load(std::memory_order_relaxed);
+        Slot *slot;
+
+        while (true)
+        {
+            slot = &m_slots[pos & (QUEUE_SIZE - 1)];
+            size_t seq = slot->seq.load(std::memory_order_acquire);
+            ptrdiff_t dif = (ptrdiff_t) seq - (ptrdiff_t) pos;
+            if (dif == 0)
+            {
+                if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (dif < 0)
+            {
+                // full
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            else
+                pos = m_head.load(std::memory_order_relaxed);
+        }
+
+        slot->time = time;
+        slot->threadId = threadId;
+        slot->text.assign(text, len);
+        slot->seq.store(pos + 1, std::memory_order_release);
+
+        if (pos - m_tail.load(std::memory_order_relaxed) == WAKE_THRESHOLD)
+            m_wake.Post();
+    }
+
+    // single consumer (the caller holds the log lock). Returns the next line in order, or null if
+    // the queue is empty or the next line is still being queued
+    Slot *Front()
+    {
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+        Slot *slot = &m_slots[pos & (QUEUE_SIZE - 1)];
+        return slot->seq.load(std::memory_order_acquire) == pos + 1 ? slot : nullptr;
+    }
+
+    void Pop(Slot *slot)
+    {
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+        slot->seq.store(pos + QUEUE_SIZE, std::memory_order_release);
+        m_tail.store(pos + 1, std::memory_order_relaxed);
+    }
+};
+
+class DebugLog::WriterThread : public wxThread
+{
+    DebugLog *m_log;
+
+public:
+    std::atomic<bool> m_stop;
+
+    WriterThread(DebugLog *log) : wxThread(wxTHREAD_JOINABLE), m_log(log) { m_stop = false; }
+    ExitCode Entry() override;
+};
+
+wxThread::ExitCode DebugLog::WriterThread::Entry()
+{
+    while (true)
+    {
+        m_log->m_queue->m_wake.WaitTimeout(WRITER_INTERVAL_MS);
+
+        bool stop = m_stop.load();
+        unsigned int count = 0;
+        unsigned int n;
+
+        do
+        {
+            wxCriticalSectionLocker lock(m_log->m_criticalSection);
+            n = m_log->DrainQueue(MAX_BATCH_LINES);
+            count += n;
+            if (n < MAX_BATCH_LINES && count > 0 && m_log->IsOpened())
+                m_log->wxFFile::Flush();
+        } while (n == MAX_BATCH_LINES);
+
+        if (stop)
+            break;
+    }
+
+    return (wxThread::ExitCode) 0;
+}
+
+DebugLog::DebugLog()
+    : m_enabled(false), m_lastWriteTime(wxDateTime::UNow()), m_queue(new LogQueue()), m_writerThread(nullptr), m_crashFd(-1)
+{
+    m_async = false;
+}
 
 DebugLog::~DebugLog()
 {
+    // the writer thread must have been stopped by now; write anything still queued
+    DrainQueue(UINT_MAX);
+    m_crashFd = -1;
     wxFFile::Flush();
     wxFFile::Close();
+    delete m_queue;
 }
 
 static bool ParseLogTimestamp(wxDateTime *p, const wxString& s)
@@ -99,27 +247,162 @@ void DebugLog::InitDebugLog(bool enable, bool forceOpen)
 {
     const wxDateTime& logFileTime = wxGetApp().GetLogFileTime();
 
-    wxCriticalSectionLocker lock(m_criticalSection);
-
-    if (m_enabled)
     {
-        wxFFile::Flush();
-        wxFFile::Close();
+        wxCriticalSectionLocker lock(m_criticalSection);
 
-        m_enabled = false;
-    }
+        if (m_enabled)
+        {
+            // lines queued before the change belong in the old file
+            DrainQueue(UINT_MAX);
 
-    if (enable && (m_path.IsEmpty() || forceOpen))
-    {
-        m_path = GetLogDir() + PATHSEPSTR + logFileTime.Format(_T("PHD2_DebugLog_%Y-%m-%d_%H%M%S.txt"));
+            m_crashFd = -1;
+            wxFFile::Flush();
+            wxFFile::Close();
 
-        if (!wxFFile::Open(m_path, "a"))
+            m_enabled = false;
+        }
+
+        if (enable && (m_path.IsEmpty() || forceOpen))
         {
-            wxMessageBox(wxString::Format(_("unable to open file %s"), m_path));
+            m_path = GetLogDir() + PATHSEPSTR + logFileTime.Format(_T("PHD2_DebugLog_%Y-%m-%d_%H%M%S.txt"));
+
+            if (!wxFFile::Open(m_path, "a"))
+            {
+                wxMessageBox(wxString::Format(_("unable to open file %s"), m_path));
+            }
+#ifndef __WINDOWS__
+            else
+                m_crashFd = fileno(fp());
+#endif
         }
+
+        m_enabled = enable;
     }
 
-    m_enabled = enable;
+    if (enable)
+        StartWriter();
+}
+
+void DebugLog::StartWriter()
+{
+    if (m_writerThread)
+        return;
+
+    WriterThread *thread = new WriterThread(this);
+    if (thread->Create() != wxTHREAD_NO_ERROR || thread->Run() != wxTHREAD_NO_ERROR)
+    {
+        delete thread;
+        Write("DebugLog: could not start writer thread, writing synchronously\n");
+        return;
+    }
+
+    m_writerThread = thread;
+    m_async = true;
+}
+
+void DebugLog::StopWriter()
+{
+    WriterThread *thread = m_writerThread;
+    if (!thread)
+        return;
+
+    // subsequent lines are written synchronously, after the queued lines
+    m_async = false;
+
+    thread->m_stop = true;
+    m_queue->m_wake.Post();
+    thread->Wait();
+    delete thread;
+    m_writerThread = nullptr;
+
+    Flush();
+
+    unsigned long long dropped = DroppedLines();
+    if (dropped)
+        Write(wxString::Format("DebugLog: writer stopped, %llu lines dropped in total\n", dropped));
+}
+
+#ifndef __WINDOWS__
+
+// Called from the fatal exception handler, which on these platforms is a signal handler: nothing
+// here may allocate, take a lock or use stdio, and the writer thread may still be running. The
+// queued lines are left alone and only their number is written, with write(2). Lines still in
+// the stdio buffer are lost
+void DebugLog::FlushOnCrash()
+{
+    int fd = m_crashFd.load();
+    if (fd < 0)
+        return;
+
+    // the tail first, the head never falls behind it
+    size_t tailPos = m_queue->m_tail.load();
+    size_t queued = m_queue->m_head.load() - tailPos;
+
+    static const char head[] = "DebugLog: fatal signal, ";
+    static const char tail[] = " queued lines not written\n";
+    char msg[sizeof(head) + 20 + sizeof(tail)];
+    char digits[20];
+    int ndigits = 0;
+    do
+    {
+        digits[ndigits++] = (char) ('0' + queued % 10);
+        queued /= 10;
+    } while (queued && ndigits < (int) sizeof(digits));
+
+    size_t len = 0;
+    memcpy(msg, head, sizeof(head) - 1);
+    len += sizeof(head) - 1;
+    while (ndigits)
+        msg[len++] = digits[--ndigits];
+    memcpy(msg + len, tail, sizeof(tail) - 1);
+    len += sizeof(tail) - 1;
+
+    ssize_t ret = write(fd, msg, len);
+    (void) ret;
+}
+
+#else // __WINDOWS__
+
+// Called from the fatal exception handler, which on Windows is an exception filter running on the
+// crashing thread rather than a signal handler. The writer thread may be part way through a batch,
+// or the crashing thread may itself have been writing, so wait only briefly for the log lock.
+// The queue has a single consumer, so the queued lines are only written out if we get the lock;
+// otherwise just the crash marker is written
+void DebugLog::FlushOnCrash()
+{
+    if (!m_enabled || !IsOpened())
+        return;
+
+    // anything logged from here on is written directly
+    m_async = false;
+
+    bool locked = false;
+    for (int i = 0; i < 50 && !(locked = m_criticalSection.TryEnter()); i++)
+        wxMilliSleep(2);
+
+    if (locked)
+    {
+        DrainQueue(UINT_MAX);
+
+        static const char msg[] = "DebugLog: fatal exception, flushed queued lines\n";
+        WriteLine(wxDateTime::UNow(), (unsigned long) wxThread::GetCurrentId(), msg, sizeof(msg) - 1);
+    }
+    else
+    {
+        static const char msg[] = "DebugLog: fatal exception, log busy, queued lines not flushed\n";
+        WriteLine(wxDateTime::UNow(), (unsigned long) wxThread::GetCurrentId(), msg, sizeof(msg) - 1);
+    }
+    wxFFile::Flush();
+
+    if (locked)
+        m_criticalSection.Leave();
+}
+
+#endif // __WINDOWS__
+
+unsigned long long DebugLog::DroppedLines() const
+{
+    return m_queue->m_dropped.load(std::memory_order_relaxed);
 }
 
 bool DebugLog::ChangeDirLog(const wxString& newdir)
@@ -171,31 +454,91 @@ bool DebugLog::Flush()
     {
         wxCriticalSectionLocker lock(m_criticalSection);
 
+        DrainQueue(UINT_MAX);
         ret = wxFFile::Flush();
     }
 
     return ret;
 }
 
+// caller must hold m_criticalSection
+void DebugLog::WriteLine(const wxDateTime& time, unsigned long threadId, const char *text, size_t len)
+{
+    // lines from different threads can be queued slightly out of timestamp order; keep the
+    // timestamps in the file monotonic as they were when the time was taken under the lock
+    wxDateTime now = time.IsEarlierThan(m_lastWriteTime) ? m_lastWriteTime : time;
+    wxTimeSpan deltaTime = now - m_lastWriteTime;
+    m_lastWriteTime = now;
+    wxString prefix = wxString::Format("%s %s %lu ", now.Format("%H:%M:%S.%l"), deltaTime.Format("%S.%l"), threadId);
+
+    // the text is already UTF-8, the same encoding wxFFile::Write(wxString) produces
+    wxFFile::Write(prefix);
+    wxFFile::Write(text, len);
+#if defined(__WINDOWS__) && defined(_DEBUG)
+    OutputDebugString((prefix + wxString::FromUTF8(text, len)).c_str());
+#endif
+}
+
+// caller must hold m_criticalSection. Returns the number of lines written
+unsigned int DebugLog::DrainQueue(unsigned int maxLines)
+{
+    unsigned int count = 0;
+    LogQueue::Slot *slot;
+
+    while (count < maxLines && (slot = m_queue->Front()) != nullptr)
+    {
+        if (IsOpened())
+            WriteLine(slot->time, slot->threadId, slot->text.data(), slot->text.size());
+        m_queue->Pop(slot);
+        ++count;
+    }
+
+    unsigned long long dropped = m_queue->m_dropped.load(std::memory_order_relaxed);
+    if (dropped != m_queue->m_droppedReported && IsOpened())
+    {
+        wxString msg = wxString::Format("DebugLog: log queue full, %llu lines dropped\n", dropped - m_queue->m_droppedReported);
+        const wxScopedCharBuffer text = msg.utf8_str();
+        m_queue->m_droppedReported = dropped;
+        WriteLine(wxDateTime::UNow(), (unsigned long) wxThread::GetCurrentId(), text.data(), text.length());
+    }
+
+    return count;
+}
+
+// lines that are written synchronously even while the writer thread is running
+static bool IsErrorLine(const char *text, size_t len)
+{
+    static const char ERROR_PREFIX[] = "Error"; // ERROR_INFO and "Error: ..." messages
+    static const char THROW_PREFIX[] = "Throw from"; // THROW_INFO
+
+    return (len >= sizeof(ERROR_PREFIX) - 1 && memcmp(text, ERROR_PREFIX, sizeof(ERROR_PREFIX) - 1) == 0) ||
+        (len >= sizeof(THROW_PREFIX) - 1 && memcmp(text, THROW_PREFIX, sizeof(THROW_PREFIX) - 1) == 0);
+}
+
 wxString DebugLog::Write(const wxString& str)
 {
     if (m_enabled)
     {
-        wxCriticalSectionLocker lock(m_criticalSection);
-
         wxDateTime now = wxDateTime::UNow();
-        wxTimeSpan deltaTime = now - m_lastWriteTime;
-        m_lastWriteTime = now;
-        wxString outputLine = wxString::Format("%s %s %lu %s", now.Format("%H:%M:%S.%l"), deltaTime.Format("%S.%l"),
-                                               (unsigned long) wxThread::GetCurrentId(), str);
+        unsigned long threadId = (unsigned long) wxThread::GetCurrentId();
+        const wxScopedCharBuffer text = str.utf8_str();
+
+        if (m_async && !IsErrorLine(text.data(), text.length()))
+        {
+            m_queue->Push(now, threadId, text.data(), text.length());
+        }
+        else
+        {
+            wxCriticalSectionLocker lock(m_criticalSection);
+
+            // keep the file in order: lines queued by the writer thread go first
+            DrainQueue(UINT_MAX);
 
-        wxFFile::Write(outputLine);
+            WriteLine(now, threadId, text.data(), text.length());
 #if defined(ALWAYS_FLUSH_DEBUGLOG)
-        wxFFile::Flush();
-#endif
-#if defined(__WINDOWS__) && defined(_DEBUG)
-        OutputDebugString(outputLine.c_str());
+            wxFFile::Flush();
 #endif
+        }
     }
 
     return str;
@@ -38,12 +38,24 @@
 
 #include "logger.h"
 
+#include <atomic>
+
 class DebugLog : public wxFFile, public Logger
 {
+    struct LogQueue;
+    class WriterThread;
+
     bool m_enabled;
     wxCriticalSection m_criticalSection;
     wxDateTime m_lastWriteTime;
     wxString m_path;
+    LogQueue *m_queue; // lines waiting to be written by the writer thread
+    std::atomic<bool> m_async; // the writer thread is running, Write() queues lines
+    WriterThread *m_writerThread;
+    std::atomic<int> m_crashFd; // descriptor of the open log file for FlushOnCrash, -1 if none
+
+    void WriteLine(const wxDateTime& time, unsigned long threadId, const char *text, size_t len);
+    unsigned int DrainQueue(unsigned int maxLines);
 
 public:
     DebugLog();
@@ -59,6 +71,11 @@ public:
     wxString Write(const wxString& str);
     bool Flush();
 
+    void StartWriter();
+    void StopWriter();
+    void FlushOnCrash();
+    unsigned long long DroppedLines() const;
+
     bool ChangeDirLog(const wxString& newdir) override;
     void RemoveOldFiles();
 };
@@ -33,9 +33,12 @@
  */
 
 #include "phd.h"
+#include "json_writer.h"
+#include "client_output_queue.h"
 
 #include <wx/sstream.h>
 #include <wx/sckstrm.h>
+#include <limits>
 #include <sstream>
 #include <string.h>
 
@@ -53,9 +56,76 @@ enum
     MSG_PROTOCOL_VERSION = 1,
 };
 
-static const wxString literal_null("null");
-static const wxString literal_true("true");
-static const wxString literal_false("false");
+// the events clients can subscribe to; see set_event_subscriptions
+enum EventId
+{
+    EV_VERSION,
+    EV_LOCK_POSITION_SET,
+    EV_CALIBRATING,
+    EV_CALIBRATION_COMPLETE,
+    EV_STAR_SELECTED,
+    EV_START_GUIDING,
+    EV_PAUSED,
+    EV_START_CALIBRATION,
+    EV_APP_STATE,
+    EV_CALIBRATION_FAILED,
+    EV_CALIBRATION_DATA_FLIPPED,
+    EV_LOOPING_EXPOSURES,
+    EV_LOOPING_EXPOSURES_STOPPED,
+    EV_SETTLE_BEGIN,
+    EV_SETTLING,
+    EV_SETTLE_DONE,
+    EV_STAR_LOST,
+    EV_GUIDING_STOPPED,
+    EV_RESUMED,
+    EV_GUIDE_STEP,
+    EV_GUIDING_DITHERED,
+    EV_LOCK_POSITION_LOST,
+    EV_LOCK_POSITION_SHIFT_LIMIT_REACHED,
+    EV_ALERT,
+    EV_GUIDE_PARAM_CHANGE,
+    EV_CONFIGURATION_CHANGE,
+    EV_IMAGE_SAVED,
+    NUM_EVENTS
+};
+
+static const unsigned long long ALL_EVENTS = (1ULL << NUM_EVENTS) - 1;
+static_assert(NUM_EVENTS <= 64, "event mask too small");
+
+static const char *const s_eventNames[NUM_EVENTS] = {
+    "Version",
+    "LockPositionSet",
+    "Calibrating",
+    "CalibrationComplete",
+    "StarSelected",
+    "StartGuiding",
+    "Paused",
+    "StartCalibration",
+    "AppState",
+    "CalibrationFailed",
+    "CalibrationDataFlipped",
+    "LoopingExposures",
+    "LoopingExposuresStopped",
+    "SettleBegin",
+    "Settling",
+    "SettleDone",
+    "StarLost",
+    "GuidingStopped",
+    "Resumed",
+    "GuideStep",
+    "GuidingDithered",
+    "LockPositionLost",
+    "LockPositionShiftLimitReached",
+    "Alert",
+    "GuideParamChange",
+    "ConfigurationChange",
+    "ImageSaved",
+};
+
+enum
+{
+    EV_BUF_RESERVE = 512, // typical event size, so that building an event rarely reallocates
+};
 
 static wxString state_name(EXPOSED_STATE st)
 {
@@ -80,163 +150,232 @@ static wxString state_name(EXPOSED_STATE st)
     }
 }
 
-static wxString json_escape(const wxString& s)
+// JSON values are formatted directly into UTF-8 std::string buffers using JsonWriter, which
+// matches the printf formats used before; a message is converted to a wxCharBuffer once, when it
+// is sent, and that buffer is shared by all clients.
+
+static void json_quote(std::string& out, const wxString& s)
+{
+    out += '"';
+    JsonWriter::AppendEscaped(out, s.wc_str(), s.length());
+    out += '"';
+}
+
+static void json_quote(std::string& out, const char *s, size_t len)
+{
+    out += '"';
+    JsonWriter::AppendEscaped(out, s, len);
+    out += '"';
+}
+
+static void json_quote(std::string& out, const wchar_t *s)
 {
-    wxString t(s);
-    static const wxString BACKSLASH("\\");
-    static const wxString BACKSLASHBACKSLASH("\\\\");
-    static const wxString DQUOT("\"");
-    static const wxString BACKSLASHDQUOT("\\\"");
-    static const wxString CR("\r");
-    static const wxString BACKSLASHCR("\\r");
-    static const wxString LF("\n");
-    static const wxString BACKSLASHLF("\\n");
-    t.Replace(BACKSLASH, BACKSLASHBACKSLASH);
-    t.Replace(DQUOT, BACKSLASHDQUOT);
-    t.Replace(CR, BACKSLASHCR);
-    t.Replace(LF, BACKSLASHLF);
+    out += '"';
+    JsonWriter::AppendEscaped(out, s, wcslen(s));
+    out += '"';
+}
+
+static std::string json_string(const wxString& s)
+{
+    std::string t;
+    json_quote(t, s);
     return t;
 }
 
 template<char LDELIM, char RDELIM>
 struct JSeq
 {
-    wxString m_s;
+    std::string m_s; // UTF-8
     bool m_first;
     bool m_closed;
-    JSeq() : m_first(true), m_closed(false) { m_s << LDELIM; }
+    JSeq() : m_first(true), m_closed(false) { m_s += LDELIM; }
     void close()
     {
-        m_s << RDELIM;
+        m_s += RDELIM;
         m_closed = true;
     }
-    wxString str()
+    const std::string& utf8()
     {
         if (!m_closed)
             close();
         return m_s;
     }
+    wxString str()
+    {
+        const std::string& s = utf8();
+        return wxString::FromUTF8(s.data(), s.size());
+    }
+    // the message as sent to clients, terminated by CRLF
+    wxCharBuffer wire() const
+    {
+        size_t const len = m_s.size() + (m_closed ? 0 : 1);
+        wxCharBuffer buf(len + 2);
+        char *p = buf.data();
+        memcpy(p, m_s.data(), m_s.size());
+        if (!m_closed)
+            p[m_s.size()] = RDELIM;
+        p[len] = '\r';
+        p[len + 1] = '\n';
+        return buf;
+    }
 };
 
 typedef JSeq<'[', ']'> JAry;
 typedef JSeq<'{', '}'> JObj;
 
-static JAry& operator<<(JAry& a, const wxString& str)
+// append a JSON value
+static JAry& operator<<(JAry& a, const std::string& json)
 {
     if (a.m_first)
         a.m_first = false;
     else
-        a.m_s << ',';
-    a.m_s << str;
+        a.m_s += ',';
+    a.m_s += json;
     return a;
 }
 
+static JAry& operator<<(JAry& a, const wxString& json)
+{
+    const wxScopedCharBuffer u(json.utf8_str());
+    return a << std::string(u.data(), u.length());
+}
+
 static JAry& operator<<(JAry& a, double d)
 {
-    return a << wxString::Format("%.2f", d);
+    if (a.m_first)
+        a.m_first = false;
+    else
+        a.m_s += ',';
+    JsonWriter::AppendFixed(a.m_s, d, 2);
+    return a;
 }
 
 static JAry& operator<<(JAry& a, int i)
 {
-    return a << wxString::Format("%d", i);
+    if (a.m_first)
+        a.m_first = false;
+    else
+        a.m_s += ',';
+    JsonWriter::AppendInt(a.m_s, i);
+    return a;
 }
 
-static wxString json_format(const json_value *j)
+static void json_append(std::string& out, const json_value *j)
 {
     if (!j)
-        return literal_null;
+    {
+        out += "null";
+        return;
+    }
 
     switch (j->type)
     {
     default:
     case JSON_NULL:
-        return literal_null;
+        out += "null";
+        break;
     case JSON_OBJECT:
     {
-        wxString ret("{");
+        out += '{';
         bool first = true;
         json_for_each(jj, j)
         {
             if (first)
                 first = false;
             else
-                ret << ",";
-            ret << '"' << jj->name << "\":" << json_format(jj);
+                out += ',';
+            out += '"';
+            out += jj->name;
+            out += "\":";
+            json_append(out, jj);
         }
-        ret << "}";
-        return ret;
+        out += '}';
+        break;
     }
     case JSON_ARRAY:
     {
-        wxString ret("[");
+        out += '[';
         bool first = true;
         json_for_each(jj, j)
         {
             if (first)
                 first = false;
             else
-                ret << ",";
-            ret << json_format(jj);
+                out += ',';
+            json_append(out, jj);
         }
-        ret << "]";
-        return ret;
+        out += ']';
+        break;
     }
     case JSON_STRING:
-        return '"' + json_escape(j->string_value) + '"';
+        json_quote(out, j->string_value, strlen(j->string_value));
+        break;
     case JSON_INT:
-        return wxString::Format("%d", j->int_value);
+        JsonWriter::AppendInt(out, j->int_value);
+        break;
     case JSON_FLOAT:
-        return wxString::Format("%g", (double) j->float_value);
+        JsonWriter::AppendGeneral(out, (double) j->float_value);
+        break;
     case JSON_BOOL:
-        return j->int_value ? literal_true : literal_false;
+        out += j->int_value ? "true" : "false";
+        break;
     }
 }
 
+static wxString json_format(const json_value *j)
+{
+    std::string s;
+    json_append(s, j);
+    return wxString::FromUTF8(s.data(), s.size());
+}
+
 struct NULL_TYPE
 {
 } NULL_VALUE;
 
-// name-value pair
+// name-value pair; the value is held in its JSON form
 struct NV
 {
-    wxString n;
-    wxString v;
-    NV(const wxString& n_, const wxString& v_) : n(n_), v('"' + json_escape(v_) + '"') { }
-    NV(const wxString& n_, const char *v_) : n(n_), v('"' + json_escape(v_) + '"') { }
-    NV(const wxString& n_, const wchar_t *v_) : n(n_), v('"' + json_escape(v_) + '"') { }
-    NV(const wxString& n_, int v_) : n(n_), v(wxString::Format("%d", v_)) { }
-    NV(const wxString& n_, unsigned int v_) : n(n_), v(wxString::Format("%u", v_)) { }
-    NV(const wxString& n_, double v_) : n(n_), v(wxString::Format("%g", v_)) { }
-    NV(const wxString& n_, double v_, int prec) : n(n_), v(wxString::Format("%.*f", prec, v_)) { }
-    NV(const wxString& n_, bool v_) : n(n_), v(v_ ? literal_true : literal_false) { }
+    const char *n;
+    std::string v;
+    NV(const char *n_, const wxString& v_) : n(n_) { json_quote(v, v_); }
+    NV(const char *n_, const std::string& v_) : n(n_) { json_quote(v, v_.data(), v_.size()); }
+    NV(const char *n_, const char *v_) : n(n_) { json_quote(v, v_, strlen(v_)); }
+    NV(const char *n_, const wchar_t *v_) : n(n_) { json_quote(v, v_); }
+    NV(const char *n_, int v_) : n(n_) { JsonWriter::AppendInt(v, v_); }
+    NV(const char *n_, unsigned int v_) : n(n_) { JsonWriter::AppendUInt(v, v_); }
+    NV(const char *n_, unsigned long long v_) : n(n_) { JsonWriter::AppendUInt(v, v_); }
+    NV(const char *n_, double v_) : n(n_) { JsonWriter::AppendGeneral(v, v_); }
+    NV(const char *n_, double v_, int prec) : n(n_) { JsonWriter::AppendFixed(v, v_, prec); }
+    NV(const char *n_, bool v_) : n(n_), v(v_ ? "true" : "false") { }
     template<typename T>
-    NV(const wxString& n_, const std::vector<T>& vec);
-    NV(const wxString& n_, JAry& ary) : n(n_), v(ary.str()) { }
-    NV(const wxString& n_, JObj& obj) : n(n_), v(obj.str()) { }
-    NV(const wxString& n_, const json_value *v_) : n(n_), v(json_format(v_)) { }
-    NV(const wxString& n_, const PHD_Point& p) : n(n_)
+    NV(const char *n_, const std::vector<T>& vec);
+    NV(const char *n_, JAry& ary) : n(n_), v(ary.utf8()) { }
+    NV(const char *n_, JObj& obj) : n(n_), v(obj.utf8()) { }
+    NV(const char *n_, const json_value *v_) : n(n_) { json_append(v, v_); }
+    NV(const char *n_, const PHD_Point& p) : n(n_)
     {
         JAry ary;
         ary << p.X << p.Y;
-        v = ary.str();
+        v = ary.utf8();
     }
-    NV(const wxString& n_, const wxPoint& p) : n(n_)
+    NV(const char *n_, const wxPoint& p) : n(n_)
     {
         JAry ary;
         ary << p.x << p.y;
-        v = ary.str();
+        v = ary.utf8();
     }
-    NV(const wxString& n_, const wxSize& s) : n(n_)
+    NV(const char *n_, const wxSize& s) : n(n_)
     {
         JAry ary;
         ary << s.x << s.y;
-        v = ary.str();
+        v = ary.utf8();
     }
-    NV(const wxString& n_, const NULL_TYPE& nul) : n(n_), v(literal_null) { }
+    NV(const char *n_, const NULL_TYPE& nul) : n(n_), v("null") { }
 };
 
 template<typename T>
-NV::NV(const wxString& n_, const std::vector<T>& vec) : n(n_)
+NV::NV(const char *n_, const std::vector<T>& vec) : n(n_)
 {
     std::ostringstream os;
     os << '[';
@@ -255,8 +394,11 @@ static JObj& operator<<(JObj& j, const NV& nv)
     if (j.m_first)
         j.m_first = false;
     else
-        j.m_s << ',';
-    j.m_s << '"' << nv.n << "\":" << nv.v;
+        j.m_s += ',';
+    j.m_s += '"';
+    j.m_s += nv.n;
+    j.m_s += "\":";
+    j.m_s += nv.v;
     return j;
 }
 
@@ -272,22 +414,36 @@ static JObj& operator<<(JObj& j, const PHD_Point& pt)
 
 static JAry& operator<<(JAry& a, JObj& j)
 {
-    return a << j.str();
+    return a << j.utf8();
+}
+
+// the Host and Inst fields, which are the same for every event
+static const std::string& ev_host_fields()
+{
+    static const std::string s = [] {
+        JObj j;
+        j << NV("Host", wxGetHostName()) << NV("Inst", wxGetApp().GetInstanceNumber());
+        return "," + j.m_s.substr(1);
+    }();
+    return s;
 }
 
 struct Ev : public JObj
 {
-    Ev(const wxString& event)
+    EventId m_id;
+
+    Ev(EventId id) : m_id(id)
     {
+        m_s.reserve(EV_BUF_RESERVE);
         double const now = ::wxGetUTCTimeMillis().ToDouble() / 1000.0;
-        *this << NV("Event", event) << NV("Timestamp", now, 3) << NV("Host", wxGetHostName())
-              << NV("Inst", wxGetApp().GetInstanceNumber());
+        *this << NV("Event", s_eventNames[id]) << NV("Timestamp", now, 3);
+        m_s += ev_host_fields();
     }
 };
 
 static Ev ev_message_version()
 {
-    Ev ev("Version");
+    Ev ev(EV_VERSION);
     ev << NV("PHDVersion", PHDVERSION) << NV("PHDSubver", PHDSUBVER) << NV("OverlapSupport", true)
        << NV("MsgVersion", MSG_PROTOCOL_VERSION);
     return ev;
@@ -295,14 +451,14 @@ static Ev ev_message_version()
 
 static Ev ev_set_lock_position(const PHD_Point& xy)
 {
-    Ev ev("LockPositionSet");
+    Ev ev(EV_LOCK_POSITION_SET);
     ev << xy;
     return ev;
 }
 
 static Ev ev_calibration_complete(const Mount *mount)
 {
-    Ev ev("CalibrationComplete");
+    Ev ev(EV_CALIBRATION_COMPLETE);
     ev << NVMount(mount);
 
     if (mount->IsStepGuider())
@@ -315,38 +471,38 @@ static Ev ev_calibration_complete(const Mount *mount)
 
 static Ev ev_star_selected(const PHD_Point& pos)
 {
-    Ev ev("StarSelected");
+    Ev ev(EV_STAR_SELECTED);
     ev << pos;
     return ev;
 }
 
 static Ev ev_start_guiding()
 {
-    return Ev("StartGuiding");
+    return Ev(EV_START_GUIDING);
 }
 
 static Ev ev_paused()
 {
-    return Ev("Paused");
+    return Ev(EV_PAUSED);
 }
 
 static Ev ev_start_calibration(const Mount *mount)
 {
-    Ev ev("StartCalibration");
+    Ev ev(EV_START_CALIBRATION);
     ev << NVMount(mount);
     return ev;
 }
 
 static Ev ev_app_state(EXPOSED_STATE st = Guider::GetExposedState())
 {
-    Ev ev("AppState");
+    Ev ev(EV_APP_STATE);
     ev << NV("State", state_name(st));
     return ev;
 }
 
 static Ev ev_settling(double distance, double time, double settleTime, bool starLocked)
 {
-    Ev ev("Settling");
+    Ev ev(EV_SETTLING);
 
     ev << NV("Distance", distance, 2) << NV("Time", time, 1) << NV("SettleTime", settleTime, 1) << NV("StarLocked", starLocked);
 
@@ -355,7 +511,7 @@ static Ev ev_settling(double distance, double time, double settleTime, bool star
 
 static Ev ev_settle_done(const wxString& errorMsg, int settleFrames, int droppedFrames)
 {
-    Ev ev("SettleDone");
+    Ev ev(EV_SETTLE_DONE);
 
     int status = errorMsg.IsEmpty() ? 0 : 1;
 
@@ -371,20 +527,94 @@ static Ev ev_settle_done(const wxString& errorMsg, int settleFrames, int dropped
     return ev;
 }
 
+// Requests are parsed in place in the read buffer. While a request is handled, the buffer holding
+// it belongs to the handler and further input goes to another buffer, since handlers can run the
+// event loop and read more input from the same client reentrantly.
 struct ClientReadBuf
 {
     enum
     {
         SIZE = 1024
     };
-    char m_buf[SIZE];
+    char *m_buf;
     char *dest;
+    std::vector<char *> m_spare; // buffers returned by release()
+
+    ClientReadBuf() : m_buf(new char[SIZE]) { reset(); }
+    ~ClientReadBuf()
+    {
+        delete[] m_buf;
+        for (auto it = m_spare.begin(); it != m_spare.end(); ++it)
+            delete[] *it;
+    }
+    char *buf() { return m_buf; }
+    size_t len() const { return dest - m_buf; }
+    size_t avail() const { return m_buf + SIZE - dest; }
+    void reset() { dest = m_buf; }
+
+    // Take the buffer holding the line that ends at end, NUL-terminated, for parsing in place.
+    // The input after the line, usually none, moves to a new read buffer. The line must be
+    // given back with release().
+    char *detach(char *end)
+    {
+        char *const line = m_buf;
+        *end = 0;
+
+        char *const next = end + 1;
+        size_t const len2 = dest - next;
+        if (m_spare.empty())
+            m_buf = new char[SIZE];
+        else
+        {
+            m_buf = m_spare.back();
+            m_spare.pop_back();
+        }
+        memcpy(m_buf, next, len2);
+        dest = m_buf + len2;
+
+        return line;
+    }
+    void release(char *line) { m_spare.push_back(line); }
+};
+
+// Output that could not be written without blocking is queued per client and written when the
+// socket becomes writable again, so a slow client never stalls the guide loop. Each client may
+// hold up to highWater bytes of unsent events; beyond that the policy decides whether new events
+// are dropped or the client is disconnected. Replies to requests are never dropped, see
+// ClientOutputQueue.
+struct OutputLimits
+{
+    size_t highWater;
+    EventServer::OverflowPolicy policy;
+};
+
+static OutputLimits s_outputLimits = { 1024 * 1024, EventServer::OVERFLOW_DROP };
 
-    ClientReadBuf() { reset(); }
-    char *buf() { return &m_buf[0]; }
-    size_t len() const { return dest - &m_buf[0]; }
-    size_t avail() const { return &m_buf[SIZE] - dest; }
-    void reset() { dest = &m_buf[0]; }
+typedef ClientOutputQueue<wxCharBuffer> OutQueue; // message times are GuideLatency::Now()
+
+// A client can ask (set_image_stream) to be sent each new frame's star cutout, or the whole frame
+// optionally downsampled, as binary messages interleaved with its JSON messages. Binary messages
+// start with a NUL byte, which never starts a JSON message, followed by "IMG" and the length of
+// the rest of the message; see image_stream_msg. At most one image is queued per client: a frame
+// that arrives while the previous one is still being sent is skipped.
+enum ImageStreamMode
+{
+    STREAM_OFF,
+    STREAM_STAR,
+    STREAM_FRAME,
+};
+
+struct ImageStream
+{
+    ImageStreamMode mode;
+    int size; // cutout size for STREAM_STAR
+    int downsample; // for STREAM_FRAME
+
+    ImageStream() : mode(STREAM_OFF), size(15), downsample(1) { }
+    bool operator==(const ImageStream& rhs) const
+    {
+        return mode == rhs.mode && (mode == STREAM_STAR ? size == rhs.size : downsample == rhs.downsample);
+    }
 };
 
 struct ClientData
@@ -393,8 +623,41 @@ struct ClientData
     int refcnt;
     ClientReadBuf rdbuf;
     wxMutex wrlock;
+    wxString peer;
+
+    // output state, protected by wrlock
+    OutQueue outq;
+    bool closing; // disconnect pending
+    EventServer::ClientStats stats;
+    double totalLatencyMs;
+    ImageStream stream; // only accessed by the main thread
+    unsigned long long eventMask; // bit (1 << EventId) set for each subscribed event
+    unsigned short decimate[NUM_EVENTS]; // send only every Nth event of each type
+    unsigned short decimateCount[NUM_EVENTS];
+
+    ClientData(wxSocketClient *cli_) : cli(cli_), refcnt(1), closing(false), totalLatencyMs(0.), eventMask(ALL_EVENTS)
+    {
+        for (unsigned int i = 0; i < NUM_EVENTS; i++)
+        {
+            decimate[i] = 1;
+            decimateCount[i] = 0;
+        }
+
+        stats.queuedMsgs = 0;
+        stats.queuedBytes = stats.peakQueuedBytes = 0;
+        stats.sentMsgs = stats.sentBytes = stats.droppedMsgs = 0;
+        stats.avgLatencyMs = stats.maxLatencyMs = 0.;
+        stats.streamFrames = stats.streamDropped = 0;
 
-    ClientData(wxSocketClient *cli_) : cli(cli_), refcnt(1) { }
+        wxIPV4address addr;
+        if (cli->GetPeer(addr))
+            peer = wxString::Format("%s:%u", addr.IPAddress(), (unsigned int) addr.Service());
+    }
+    ~ClientData()
+    {
+        for (auto it = parsers.begin(); it != parsers.end(); ++it)
+            delete *it;
+    }
     void AddRef() { ++refcnt; }
     void RemoveRef()
     {
@@ -404,6 +667,19 @@ struct ClientData
             delete this;
         }
     }
+
+    // parsers are reused so that their allocators keep their memory between requests; a request
+    // handled reentrantly gets a parser of its own
+    std::vector<JsonParser *> parsers;
+    JsonParser *AcquireParser()
+    {
+        if (parsers.empty())
+            return new JsonParser();
+        JsonParser *p = parsers.back();
+        parsers.pop_back();
+        return p;
+    }
+    void ReleaseParser(JsonParser *p) { parsers.push_back(p); }
 };
 
 struct ClientDataGuard
@@ -414,11 +690,6 @@ struct ClientDataGuard
     ClientData *operator->() const { return cd; }
 };
 
-inline static wxMutex *client_wrlock(wxSocketClient *cli)
-{
-    return &((ClientData *) cli->GetClientData())->wrlock;
-}
-
 static wxString SockErrStr(wxSocketError e)
 {
     switch (e)
@@ -448,52 +719,193 @@ static wxString SockErrStr(wxSocketError e)
     }
 }
 
+// write as much of the queued output as the socket will take without blocking; the caller holds
+// the client's wrlock
+static void flush_output(ClientData *cd)
+{
+    wxSocketClient *client = cd->cli;
+
+    auto write = [client](const char *p, size_t len) -> size_t {
+        client->Write(p, len);
+        size_t const n = client->LastWriteCount();
+        if (n < len && client->Error() && client->LastError() != wxSOCKET_WOULDBLOCK)
+        {
+            Debug.Write(wxString::Format("evsrv: cli %p write error %s\n", client, SockErrStr(client->LastError())));
+        }
+        return n;
+    };
+
+    auto sent = [cd](const OutQueue::Msg& msg) {
+        double const latency = (GuideLatency::Now() - msg.queued) / 1000.;
+        ++cd->stats.sentMsgs;
+        cd->stats.sentBytes += msg.buf.length();
+        cd->totalLatencyMs += latency;
+        if (latency > cd->stats.maxLatencyMs)
+            cd->stats.maxLatencyMs = latency;
+        if (msg.kind == OutQueue::IMAGE)
+            ++cd->stats.streamFrames;
+    };
+
+    unsigned long long const dropped = cd->outq.Flush(write, sent, s_outputLimits.highWater);
+    if (dropped)
+        Debug.Write(wxString::Format("evsrv: cli %p caught up, %llu events were dropped\n", client, dropped));
+}
+
 static void send_buf(wxSocketClient *client, const wxCharBuffer& buf)
 {
-    wxMutexLocker lock(*client_wrlock(client));
-    client->Write(buf.data(), buf.length());
-    if (client->LastWriteCount() != buf.length())
+    ClientData *cd = (ClientData *) client->GetClientData();
+    wxMutexLocker lock(cd->wrlock);
+
+    if (cd->closing)
+        return;
+
+    // catch up on older output first so that events are delivered in order
+    flush_output(cd);
+
+    OutQueue::EventResult const res = cd->outq.PushEvent(buf, GuideLatency::Now(), s_outputLimits.highWater);
+    if (res != OutQueue::QUEUED)
+    {
+        ++cd->stats.droppedMsgs;
+
+        if (s_outputLimits.policy == EventServer::OVERFLOW_DISCONNECT)
+        {
+            Debug.Write(wxString::Format("evsrv: cli %p has %u bytes of unsent output, disconnecting\n", client,
+                                         (unsigned int) cd->outq.Bytes()));
+            cd->closing = true;
+            cd->AddRef(); // released by CloseClient
+            EvtServer.CallAfter(&EventServer::CloseClient, client);
+        }
+        else if (res == OutQueue::STARTED_DROPPING)
+        {
+            Debug.Write(wxString::Format("evsrv: cli %p has %u bytes of unsent output, dropping events\n", client,
+                                         (unsigned int) cd->outq.Bytes()));
+        }
+        return;
+    }
+
+    cd->stats.peakQueuedBytes = cd->outq.PeakBytes();
+
+    flush_output(cd);
+}
+
+// send the reply to a client's request; unlike events, replies are never dropped
+static void send_response(wxSocketClient *client, const wxCharBuffer& buf)
+{
+    ClientData *cd = (ClientData *) client->GetClientData();
+    wxMutexLocker lock(cd->wrlock);
+
+    if (cd->closing)
+        return;
+
+    flush_output(cd);
+
+    // a client that asked to be disconnected rather than lose events gets its reply after all of them
+    size_t const limit = s_outputLimits.policy == EventServer::OVERFLOW_DISCONNECT ? std::numeric_limits<size_t>::max()
+                                                                                    : s_outputLimits.highWater;
+    unsigned int const evicted = cd->outq.PushResponse(buf, GuideLatency::Now(), limit);
+    if (evicted)
+    {
+        cd->stats.droppedMsgs += evicted;
+        Debug.Write(wxString::Format("evsrv: cli %p has %u bytes of unsent output, dropped %u events before a reply\n",
+                                     client, (unsigned int) cd->outq.Bytes(), evicted));
+    }
+    cd->stats.peakQueuedBytes = cd->outq.PeakBytes();
+
+    flush_output(cd);
+}
+
+static void send_image(wxSocketClient *client, const wxCharBuffer& buf)
+{
+    ClientData *cd = (ClientData *) client->GetClientData();
+    wxMutexLocker lock(cd->wrlock);
+
+    if (cd->closing)
+        return;
+
+    flush_output(cd);
+
+    if (!cd->outq.PushImage(buf, GuideLatency::Now()))
     {
-        Debug.Write(wxString::Format("evsrv: cli %p short write %u/%u %s\n", client, client->LastWriteCount(),
-                                     (unsigned int) buf.length(),
-                                     SockErrStr(client->Error() ? client->LastError() : wxSOCKET_NOERROR)));
+        // the client has not received the previous frame yet
+        ++cd->stats.streamDropped;
+        return;
     }
+    cd->stats.peakQueuedBytes = cd->outq.PeakBytes();
+
+    flush_output(cd);
 }
 
 static void do_notify1(wxSocketClient *client, const JAry& ary)
 {
-    send_buf(client, (JAry(ary).str() + "\r\n").ToUTF8());
+    send_buf(client, ary.wire());
 }
 
 static void do_notify1(wxSocketClient *client, const JObj& j)
 {
-    send_buf(client, (JObj(j).str() + "\r\n").ToUTF8());
+    send_buf(client, j.wire());
 }
 
-static void do_notify(const EventServer::CliSockSet& cli, const JObj& jj)
+static void do_respond(wxSocketClient *client, const JAry& ary)
 {
-    wxCharBuffer buf = (JObj(jj).str() + "\r\n").ToUTF8();
+    send_response(client, ary.wire());
+}
 
+static void do_respond(wxSocketClient *client, const JObj& j)
+{
+    send_response(client, j.wire());
+}
+
+// true if any client subscribes to the event, so that events nobody wants are not even built
+static bool subscribed(const EventServer::CliSockSet& cli, EventId id)
+{
     for (EventServer::CliSockSet::const_iterator it = cli.begin(); it != cli.end(); ++it)
     {
-        send_buf(*it, buf);
+        if (((ClientData *) (*it)->GetClientData())->eventMask & (1ULL << id))
+            return true;
     }
+    return false;
 }
 
-inline static void simple_notify(const EventServer::CliSockSet& cli, const wxString& ev)
+// apply the client's subscription and decimation to an event
+static bool client_wants(ClientData *cd, EventId id)
 {
-    if (!cli.empty())
-        do_notify(cli, Ev(ev));
+    if (!(cd->eventMask & (1ULL << id)))
+        return false;
+
+    unsigned short& count = cd->decimateCount[id];
+    bool const send = count == 0;
+    if (++count >= cd->decimate[id])
+        count = 0;
+    return send;
 }
 
-inline static void simple_notify_ev(const EventServer::CliSockSet& cli, const Ev& ev)
+static void do_notify(const EventServer::CliSockSet& cli, const Ev& ev)
 {
-    if (!cli.empty())
-        do_notify(cli, ev);
+    wxCharBuffer buf;
+
+    for (EventServer::CliSockSet::const_iterator it = cli.begin(); it != cli.end(); ++it)
+    {
+        if (!client_wants((ClientData *) (*it)->GetClientData(), ev.m_id))
+            continue;
+        if (!buf.length())
+            buf = ev.wire();
+        send_buf(*it, buf);
+    }
 }
 
-#define SIMPLE_NOTIFY(s) simple_notify(m_eventServerClients, s)
-#define SIMPLE_NOTIFY_EV(ev) simple_notify_ev(m_eventServerClients, ev)
+inline static void simple_notify(const EventServer::CliSockSet& cli, EventId id)
+{
+    if (subscribed(cli, id))
+        do_notify(cli, Ev(id));
+}
+
+#define SIMPLE_NOTIFY(id) simple_notify(m_eventServerClients, id)
+#define SIMPLE_NOTIFY_EV(id, ev)                                                                                               \
+    do                                                                                                                         \
+    {                                                                                                                          \
+        if (subscribed(m_eventServerClients, id))                                                                              \
+            do_notify(m_eventServerClients, ev);                                                                               \
+    } while (0)
 
 static void send_catchup_events(wxSocketClient *cli)
 {
@@ -728,7 +1140,7 @@ static void set_exposure(JObj& response, const json_value *params)
         return;
     }
 
-    bool ok = pFrame->SetExposureDuration(exp->int_value);
+    bool ok = pFrame->SetExposureDuration((int) exp->int_value);
     if (ok)
     {
         response << jrpc_result(0);
@@ -799,7 +1211,7 @@ static void set_profile(JObj& response, const json_value *params)
     VERIFY_GUIDER(response);
 
     wxString errMsg;
-    bool error = pFrame->pGearDialog->SetProfile(id->int_value, &errMsg);
+    bool error = pFrame->pGearDialog->SetProfile((int) id->int_value, &errMsg);
 
     if (error)
     {
@@ -956,7 +1368,7 @@ static bool parse_rect(wxRect *r, const json_value *j)
     {
         if (!jv || jv->type != JSON_INT)
             return false;
-        a[i] = jv->int_value;
+        a[i] = (int) jv->int_value;
         jv = jv->next_sibling;
     }
     if (jv)
@@ -1342,7 +1754,21 @@ static void save_image(JObj& response, const json_value *params)
 {
     VERIFY_GUIDER(response);
 
-    if (!pFrame->pGuider->CurrentImage()->ImageData)
+    Params p("async", params);
+
+    // with async the response is sent once the image is queued and an ImageSaved event is sent
+    // when the file has been written
+    bool async = false;
+    const json_value *jv = p.param("async");
+    if (jv && !bool_param(jv, &async))
+    {
+        response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected bool value for async");
+        return;
+    }
+
+    const usImage *img = pFrame->pGuider->CurrentImage();
+
+    if (!img->ImageData)
     {
         response << jrpc_error(2, "no image available");
         return;
@@ -1350,7 +1776,14 @@ static void save_image(JObj& response, const json_value *params)
 
     wxString fname = wxFileName::CreateTempFileName(MyFrame::GetDefaultFileDir() + PATHSEPSTR + "save_image_");
 
-    if (pFrame->pGuider->SaveCurrentImage(fname))
+    FITSHdrCards hdr;
+    img->GetFITSHeader(&hdr);
+
+    if (async)
+    {
+        FitsWriter::Save(fname, *img, &hdr, FitsWriter::COMPRESS_NONE, "save_image");
+    }
+    else if (FitsWriter::SaveAndWait(fname, *img, &hdr, FitsWriter::COMPRESS_NONE, "save_image"))
     {
         ::wxRemove(fname);
         response << jrpc_error(3, "error saving image");
@@ -1380,7 +1813,7 @@ static void capture_single_frame(JObj& response, const json_value *params)
             response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected exposure param");
             return;
         }
-        exposure = j->int_value;
+        exposure = (int) j->int_value;
     }
     else
     {
@@ -1458,6 +1891,21 @@ struct B64Encode
 };
 const char *const B64Encode::E = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
+// the region around the star sent by get_star_image and by the star image stream
+static wxRect star_cutout(const usImage *img, const PHD_Point& star, int reqsize)
+{
+    int const halfw = wxMin((reqsize - 1) / 2, 31);
+    int const fullw = 2 * halfw + 1;
+    int const sx = (int) rint(star.X);
+    int const sy = (int) rint(star.Y);
+    wxRect rect(sx - halfw, sy - halfw, fullw, fullw);
+    if (img->Subframe.IsEmpty())
+        rect.Intersect(wxRect(img->Size));
+    else
+        rect.Intersect(img->Subframe);
+    return rect;
+}
+
 static void get_star_image(JObj& response, const json_value *params)
 {
     int reqsize = 15;
@@ -1465,7 +1913,7 @@ static void get_star_image(JObj& response, const json_value *params)
     const json_value *val = p.param("size");
     if (val)
     {
-        if (val->type != JSON_INT || (reqsize = val->int_value) < 15)
+        if (val->type != JSON_INT || (reqsize = (int) wxMin(val->int_value, 1000LL)) < 15)
         {
             response << jrpc_error(JSONRPC_INVALID_PARAMS, "invalid image size param");
             return;
@@ -1484,15 +1932,7 @@ static void get_star_image(JObj& response, const json_value *params)
         return;
     }
 
-    int const halfw = wxMin((reqsize - 1) / 2, 31);
-    int const fullw = 2 * halfw + 1;
-    int const sx = (int) rint(star.X);
-    int const sy = (int) rint(star.Y);
-    wxRect rect(sx - halfw, sy - halfw, fullw, fullw);
-    if (img->Subframe.IsEmpty())
-        rect.Intersect(wxRect(img->Size));
-    else
-        rect.Intersect(img->Subframe);
+    wxRect const rect = star_cutout(img, star, reqsize);
 
     B64Encode enc;
     for (int y = rect.GetTop(); y <= rect.GetBottom(); y++)
@@ -1512,6 +1952,291 @@ static void get_star_image(JObj& response, const json_value *params)
     response << jrpc_result(rslt);
 }
 
+// the client whose request is being handled, for the methods that change per-client state
+static wxSocketClient *s_rpcClient;
+
+enum
+{
+    IMAGE_MSG_VERSION = 1,
+    IMAGE_MSG_HEADER_SIZE = 40,
+    IMAGE_STREAM_MAX_DOWNSAMPLE = 16,
+};
+
+inline static void put_le16(unsigned char *p, unsigned int v)
+{
+    p[0] = (unsigned char) v;
+    p[1] = (unsigned char) (v >> 8);
+}
+
+inline static void put_le32(unsigned char *p, unsigned int v)
+{
+    p[0] = (unsigned char) v;
+    p[1] = (unsigned char) (v >> 8);
+    p[2] = (unsigned char) (v >> 16);
+    p[3] = (unsigned char) (v >> 24);
+}
+
+inline static void put_float(unsigned char *p, float f)
+{
+    unsigned int v;
+    memcpy(&v, &f, sizeof(v));
+    put_le32(p, v);
+}
+
+// Build an image stream message. All fields are little-endian:
+//
+//   0  0x00 'I' 'M' 'G'
+//   4  uint32  length of the rest of the message
+//   8  uint8   version (1)
+//   9  uint8   kind: 1 = star cutout, 2 = full frame
+//  10  uint16  downsampling factor (1 for star cutouts)
+//  12  uint32  frame number
+//  16  uint16  width
+//  18  uint16  height
+//  20  uint16  left edge in the full frame
+//  22  uint16  top edge in the full frame
+//  24  float32 star x position in the image, NaN if there is no star
+//  28  float32 star y position
+//  32  uint32  exposure duration (ms)
+//  36  uint32  reserved (0)
+//  40  uint16  pixels[height][width]
+//
+// Downsampled frames are the average of each block of downsample x downsample pixels.
+// Returns an empty buffer if there is nothing to send.
+static wxCharBuffer image_stream_msg(const usImage *img, const PHD_Point& star, const ImageStream& st)
+{
+    if (!img->ImageData)
+        return wxCharBuffer();
+
+    wxRect rect;
+    int ds = 1;
+    if (st.mode == STREAM_STAR)
+    {
+        if (!star.IsValid())
+            return wxCharBuffer();
+        rect = star_cutout(img, star, st.size);
+    }
+    else
+    {
+        ds = st.downsample;
+        rect = wxRect(0, 0, img->Size.GetWidth() / ds * ds, img->Size.GetHeight() / ds * ds);
+    }
+
+    int const ow = rect.GetWidth() / ds;
+    int const oh = rect.GetHeight() / ds;
+    if (ow <= 0 || oh <= 0 || ow > 65535 || oh > 65535)
+        return wxCharBuffer();
+
+    size_t const len = IMAGE_MSG_HEADER_SIZE + (size_t) ow * oh * sizeof(unsigned short);
+    wxCharBuffer buf(len);
+    unsigned char *p = (unsigned char *) buf.data();
+
+    memset(p, 0, IMAGE_MSG_HEADER_SIZE);
+    memcpy(p + 1, "IMG", 3);
+    put_le32(p + 4, (unsigned int) (len - 8));
+    p[8] = IMAGE_MSG_VERSION;
+    p[9] = st.mode == STREAM_STAR ? 1 : 2;
+    put_le16(p + 10, ds);
+    put_le32(p + 12, img->FrameNum);
+    put_le16(p + 16, ow);
+    put_le16(p + 18, oh);
+    put_le16(p + 20, rect.GetLeft());
+    put_le16(p + 22, rect.GetTop());
+    float const nan = std::numeric_limits<float>::quiet_NaN();
+    put_float(p + 24, star.IsValid() ? (float) ((star.X - rect.GetLeft()) / ds) : nan);
+    put_float(p + 28, star.IsValid() ? (float) ((star.Y - rect.GetTop()) / ds) : nan);
+    put_le32(p + 32, std::max(img->ImgExpDur, 0));
+
+    unsigned char *out = p + IMAGE_MSG_HEADER_SIZE;
+    int const width = img->Size.GetWidth();
+
+    if (ds == 1)
+    {
+        for (int y = rect.GetTop(); y <= rect.GetBottom(); y++)
+        {
+            const unsigned short *row = img->ImageData + (size_t) y * width + rect.GetLeft();
+#if wxBYTE_ORDER == wxLITTLE_ENDIAN
+            memcpy(out, row, ow * sizeof(unsigned short));
+            out += ow * sizeof(unsigned short);
+#else
+            for (int x = 0; x < ow; x++, out += 2)
+                put_le16(out, row[x]);
+#endif
+        }
+        return buf;
+    }
+
+    std::vector<unsigned int> acc(ow);
+    unsigned int const n = ds * ds;
+    for (int oy = 0; oy < oh; oy++)
+    {
+        std::fill(acc.begin(), acc.end(), 0);
+        for (int k = 0; k < ds; k++)
+        {
+            const unsigned short *row = img->ImageData + (size_t) (rect.GetTop() + oy * ds + k) * width + rect.GetLeft();
+            for (int ox = 0; ox < ow; ox++, row += ds)
+            {
+                unsigned int sum = 0;
+                for (int j = 0; j < ds; j++)
+                    sum += row[j];
+                acc[ox] += sum;
+            }
+        }
+        for (int ox = 0; ox < ow; ox++, out += 2)
+            put_le16(out, (acc[ox] + n / 2) / n);
+    }
+
+    return buf;
+}
+
+static void set_image_stream(JObj& response, const json_value *params)
+{
+    Params p("mode", "size", "downsample", params);
+
+    const json_value *jv = p.param("mode");
+    ImageStream st;
+    if (!jv || jv->type != JSON_STRING)
+    {
+        response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected mode param");
+        return;
+    }
+    if (strcmp(jv->string_value, "off") == 0)
+        st.mode = STREAM_OFF;
+    else if (strcmp(jv->string_value, "star") == 0)
+        st.mode = STREAM_STAR;
+    else if (strcmp(jv->string_value, "frame") == 0)
+        st.mode = STREAM_FRAME;
+    else
+    {
+        response << jrpc_error(JSONRPC_INVALID_PARAMS, "mode must be one of off, star, frame");
+        return;
+    }
+
+    if ((jv = p.param("size")) != nullptr)
+    {
+        if (jv->type != JSON_INT || jv->int_value < 15)
+        {
+            response << jrpc_error(JSONRPC_INVALID_PARAMS, "invalid image size param");
+            return;
+        }
+        st.size = (int) wxMin(jv->int_value, 1000LL);
+    }
+
+    if ((jv = p.param("downsample")) != nullptr)
+    {
+        if (jv->type != JSON_INT || jv->int_value < 1 || jv->int_value > IMAGE_STREAM_MAX_DOWNSAMPLE)
+        {
+            response << jrpc_error(JSONRPC_INVALID_PARAMS, "invalid downsample param");
+            return;
+        }
+        st.downsample = (int) jv->int_value;
+    }
+
+    ClientData *cd = (ClientData *) s_rpcClient->GetClientData();
+    cd->stream = st;
+
+    static const char *const MODE_NAMES[] = { "off", "star", "frame" };
+    Debug.Write(wxString::Format("evsrv: cli %p image stream %s size %d downsample %d\n", s_rpcClient, MODE_NAMES[st.mode],
+                                 st.size, st.downsample));
+
+    JObj rslt;
+    rslt << NV("version", (int) IMAGE_MSG_VERSION) << NV("header_size", (int) IMAGE_MSG_HEADER_SIZE);
+    response << jrpc_result(rslt);
+}
+
+static void event_subscriptions_result(JObj& response, const ClientData *cd)
+{
+    JAry events;
+    JObj decimate;
+    for (unsigned int i = 0; i < NUM_EVENTS; i++)
+    {
+        if (!(cd->eventMask & (1ULL << i)))
+            continue;
+        events << json_string(s_eventNames[i]);
+        if (cd->decimate[i] > 1)
+            decimate << NV(s_eventNames[i], (int) cd->decimate[i]);
+    }
+
+    JObj rslt;
+    rslt << NV("events", events) << NV("decimate", decimate);
+    response << jrpc_result(rslt);
+}
+
+static int event_id(const char *name)
+{
+    for (unsigned int i = 0; i < NUM_EVENTS; i++)
+        if (strcmp(s_eventNames[i], name) == 0)
+            return i;
+    return -1;
+}
+
+static void get_event_subscriptions(JObj& response, const json_value *params)
+{
+    event_subscriptions_result(response, (ClientData *) s_rpcClient->GetClientData());
+}
+
+// Choose the events sent to this client. "events" lists the event names to receive (all events
+// if omitted); "decimate" maps event names to N, to receive only every Nth event of that type.
+static void set_event_subscriptions(JObj& response, const json_value *params)
+{
+    Params p("events", "decimate", params);
+
+    unsigned long long mask = ALL_EVENTS;
+    const json_value *jv = p.param("events");
+    if (jv)
+    {
+        if (jv->type != JSON_ARRAY)
+        {
+            response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected events array param");
+            return;
+        }
+        mask = 0;
+        json_for_each(t, jv)
+        {
+            int const id = t->type == JSON_STRING ? event_id(t->string_value) : -1;
+            if (id < 0)
+            {
+                response << jrpc_error(JSONRPC_INVALID_PARAMS, "unknown event name");
+                return;
+            }
+            mask |= 1ULL << id;
+        }
+    }
+
+    unsigned short decimate[NUM_EVENTS];
+    std::fill(decimate, decimate + NUM_EVENTS, 1);
+    if ((jv = p.param("decimate")) != nullptr)
+    {
+        if (jv->type != JSON_OBJECT)
+        {
+            response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected decimate object param");
+            return;
+        }
+        json_for_each(t, jv)
+        {
+            int const id = event_id(t->name);
+            if (id < 0 || t->type != JSON_INT || t->int_value < 1 || t->int_value > 65535)
+            {
+                response << jrpc_error(JSONRPC_INVALID_PARAMS, "invalid decimate param");
+                return;
+            }
+            decimate[id] = (unsigned short) t->int_value;
+        }
+    }
+
+    ClientData *cd = (ClientData *) s_rpcClient->GetClientData();
+    cd->eventMask = mask;
+    for (unsigned int i = 0; i < NUM_EVENTS; i++)
+    {
+        cd->decimate[i] = decimate[i];
+        cd->decimateCount[i] = 0;
+    }
+
+    Debug.Write(wxString::Format("evsrv: cli %p event mask %llx\n", s_rpcClient, mask));
+
+    event_subscriptions_result(response, cd);
+}
+
 static bool parse_settle(SettleParams *settle, const json_value *j, wxString *error)
 {
     bool found_pixels = false, found_time = false, found_timeout = false;
@@ -1778,7 +2503,7 @@ static void get_algo_param_names(JObj& response, const json_value *params)
 
     JAry names;
     for (auto it = ary.begin(); it != ary.end(); ++it)
-        names << ('"' + json_escape(*it) + '"');
+        names << json_string(*it);
 
     response << jrpc_result(names);
 }
@@ -1914,6 +2639,204 @@ static void get_variable_delay_settings(JObj& response, const json_value *params
     response << jrpc_result(rslt);
 }
 
+static void get_frame_buffer_stats(JObj& response, const json_value *params)
+{
+    FrameBufferPool::Stats stats = FrameBufferPool::GetStats();
+
+    JObj rslt;
+    rslt << NV("hits", stats.hits) << NV("misses", stats.misses) << NV("bytes_allocated", stats.bytesAllocated)
+         << NV("frames", stats.frames)
+         << NV("bytes_per_frame", stats.frames ? (double) stats.bytesAllocated / stats.frames : 0., 0);
+    response << jrpc_result(rslt);
+}
+
+// histogram of the time from capture completion to the guide pulse being issued, since guiding
+// started
+static void get_guide_latency(JObj& response, const json_value *params)
+{
+    GuideLatency::Histogram h = GuideLatency::Get();
+
+    JAry buckets;
+    for (int i = 0; i < GuideLatency::NUM_BUCKETS; i++)
+    {
+        JObj t;
+        if (i < GuideLatency::NUM_BUCKETS - 1)
+            t << NV("le_ms", GuideLatency::BucketLimitMs(i));
+        else
+            t << NV("le_ms", NULL_VALUE); // unbounded
+        t << NV("count", h.bucket[i]);
+        buckets << t;
+    }
+
+    JObj rslt;
+    rslt << NV("count", h.count) << NV("avg_ms", h.count ? h.totalMs / h.count : 0., 3) << NV("max_ms", h.maxMs, 3)
+         << NV("buckets", buckets);
+    response << jrpc_result(rslt);
+}
+
+static void get_client_stats(JObj& response, const json_value *params)
+{
+    std::vector<EventServer::ClientStats> stats;
+    EvtServer.GetClientStats(&stats);
+
+    JAry ary;
+    for (std::vector<EventServer::ClientStats>::const_iterator it = stats.begin(); it != stats.end(); ++it)
+    {
+        JObj t;
+        t << NV("peer", it->peer) << NV("queued_msgs", it->queuedMsgs) << NV("queued_bytes", it->queuedBytes)
+          << NV("peak_queued_bytes", it->peakQueuedBytes) << NV("sent_msgs", it->sentMsgs) << NV("sent_bytes", it->sentBytes)
+          << NV("dropped_msgs", it->droppedMsgs) << NV("avg_latency_ms", it->avgLatencyMs, 3)
+          << NV("max_latency_ms", it->maxLatencyMs, 3) << NV("stream_frames", it->streamFrames)
+          << NV("stream_dropped", it->streamDropped);
+        ary << t;
+    }
+
+    JObj rslt;
+    rslt << NV("high_water_bytes", (unsigned long long) s_outputLimits.highWater)
+         << NV("overflow_policy", s_outputLimits.policy == EventServer::OVERFLOW_DISCONNECT ? "disconnect" : "drop")
+         << NV("clients", ary);
+    response << jrpc_result(rslt);
+}
+
+// Service time histogram with fixed memory: values below 16 us have a bucket each, larger values
+// have 4 buckets per power of two, so percentiles are accurate to within about 12%
+struct LatencyHistogram
+{
+    enum
+    {
+        LINEAR = 16,
+        SUB = 4,
+        BUCKETS = LINEAR + (32 - 4) * SUB,
+    };
+
+    unsigned int count[BUCKETS];
+
+    LatencyHistogram() { Reset(); }
+    void Reset() { memset(count, 0, sizeof(count)); }
+
+    static unsigned int Bucket(unsigned long long us)
+    {
+        if (us < LINEAR)
+            return (unsigned int) us;
+        if (us > 0xFFFFFFFFULL)
+            us = 0xFFFFFFFFULL;
+        unsigned int e = 4;
+        while ((us >> (e + 1)) != 0)
+            ++e;
+        return LINEAR + (e - 4) * SUB + (unsigned int) ((us >> (e - 2)) & (SUB - 1));
+    }
+
+    // midpoint of a bucket, in microseconds
+    static double Value(unsigned int b)
+    {
+        if (b < LINEAR)
+            return b;
+        unsigned int const e = 4 + (b - LINEAR) / SUB;
+        unsigned int const k = (b - LINEAR) % SUB;
+        double const width = (double) (1ULL << (e - 2));
+        return (SUB + k) * width + width / 2.;
+    }
+
+    void Add(unsigned long long us) { ++count[Bucket(us)]; }
+
+    // the value below which a fraction q of n samples fall
+    double Percentile(double q, unsigned long long n) const
+    {
+        unsigned long long const rank = std::max(1ULL, (unsigned long long) ceil(q * n));
+        unsigned long long cum = 0;
+        for (unsigned int b = 0; b < BUCKETS; b++)
+        {
+            cum += count[b];
+            if (cum >= rank)
+                return Value(b);
+        }
+        return Value(BUCKETS - 1);
+    }
+};
+
+// call counts and service times of a JSON-RPC method. The service time of handlers that run the
+// event loop (set_connected, for example) includes whatever else runs meanwhile.
+struct RpcMethodStats
+{
+    const char *name;
+    unsigned long long calls;
+    unsigned long long errors;
+    unsigned long long totalUs;
+    unsigned long long maxUs;
+    LatencyHistogram hist;
+
+    RpcMethodStats() : name(nullptr) { Reset(); }
+
+    void Reset()
+    {
+        calls = errors = totalUs = maxUs = 0;
+        hist.Reset();
+    }
+
+    void Record(wxLongLong_t us, bool error)
+    {
+        unsigned long long const t = us > 0 ? (unsigned long long) us : 0;
+        ++calls;
+        if (error)
+            ++errors;
+        totalUs += t;
+        if (t > maxUs)
+            maxUs = t;
+        hist.Add(t);
+    }
+};
+
+static std::vector<RpcMethodStats> s_rpcStats; // parallel to the method table
+static unsigned long long s_rpcUnknownCalls;
+
+static void get_server_stats(JObj& response, const json_value *params)
+{
+    Params p("reset", params);
+    const json_value *jv = p.param("reset");
+    bool reset = false;
+    if (jv && !bool_param(jv, &reset))
+    {
+        response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected reset boolean param");
+        return;
+    }
+
+    // most expensive methods first
+    std::vector<const RpcMethodStats *> active;
+    unsigned long long requests = s_rpcUnknownCalls;
+    for (auto it = s_rpcStats.begin(); it != s_rpcStats.end(); ++it)
+    {
+        requests += it->calls;
+        if (it->calls)
+            active.push_back(&*it);
+    }
+    std::sort(active.begin(), active.end(),
+              [](const RpcMethodStats *a, const RpcMethodStats *b) { return a->totalUs > b->totalUs; });
+
+    JAry ary;
+    for (auto it = active.begin(); it != active.end(); ++it)
+    {
+        const RpcMethodStats& st = **it;
+        double const maxMs = st.maxUs / 1000.;
+        JObj t;
+        t << NV("method", st.name) << NV("calls", st.calls) << NV("errors", st.errors)
+          << NV("total_ms", st.totalUs / 1000., 3) << NV("avg_ms", st.totalUs / 1000. / st.calls, 3)
+          << NV("p50_ms", std::min(st.hist.Percentile(0.5, st.calls) / 1000., maxMs), 3)
+          << NV("p99_ms", std::min(st.hist.Percentile(0.99, st.calls) / 1000., maxMs), 3) << NV("max_ms", maxMs, 3);
+        ary << t;
+    }
+
+    JObj rslt;
+    rslt << NV("requests", requests) << NV("unknown_methods", s_rpcUnknownCalls) << NV("methods", ary);
+    response << jrpc_result(rslt);
+
+    if (reset)
+    {
+        for (auto it = s_rpcStats.begin(); it != s_rpcStats.end(); ++it)
+            it->Reset();
+        s_rpcUnknownCalls = 0;
+    }
+}
+
 // set_variable_delay values are in units of seconds to match the UI convention in the Advanced Settings dialog
 static void set_variable_delay_settings(JObj& response, const json_value *params)
 {
@@ -2020,7 +2943,7 @@ static void guide_pulse(JObj& response, const json_value *params)
         return;
     }
 
-    int duration = amount->int_value;
+    int duration = (int) amount->int_value;
     if (duration < 0)
     {
         duration = -duration;
@@ -2231,6 +3154,111 @@ static void dump_response(const JRpcCall& call)
     Debug.Write(wxString::Format("evsrv: cli %p response: %s\n", call.cli, s));
 }
 
+struct RpcMethod
+{
+    const char *name;
+    void (*fn)(JObj& response, const json_value *params);
+};
+
+static const RpcMethod s_rpcMethods[] = {
+    { "clear_calibration", &clear_calibration },
+    { "deselect_star", &deselect_star },
+    { "get_exposure", &get_exposure },
+    { "set_exposure", &set_exposure },
+    { "get_exposure_durations", &get_exposure_durations },
+    { "get_profiles", &get_profiles },
+    { "get_profile", &get_profile },
+    { "set_profile", &set_profile },
+    { "get_connected", &get_connected },
+    { "set_connected", &set_connected },
+    { "get_calibrated", &get_calibrated },
+    { "get_paused", &get_paused },
+    { "set_paused", &set_paused },
+    { "get_lock_position", &get_lock_position },
+    { "set_lock_position", &set_lock_position },
+    { "loop", &loop },
+    { "stop_capture", &stop_capture },
+    { "guide", &guide },
+    { "dither", &dither },
+    { "find_star", &find_star },
+    { "get_pixel_scale", &get_pixel_scale },
+    { "get_app_state", &get_app_state },
+    { "flip_calibration", &flip_calibration },
+    { "get_lock_shift_enabled", &get_lock_shift_enabled },
+    { "set_lock_shift_enabled", &set_lock_shift_enabled },
+    { "get_lock_shift_params", &get_lock_shift_params },
+    { "set_lock_shift_params", &set_lock_shift_params },
+    { "save_image", &save_image },
+    { "get_star_image", &get_star_image },
+    { "get_use_subframes", &get_use_subframes },
+    { "get_search_region", &get_search_region },
+    { "shutdown", &shutdown },
+    { "get_camera_binning", &get_camera_binning },
+    { "get_camera_frame_size", &get_camera_frame_size },
+    { "get_current_equipment", &get_current_equipment },
+    { "get_guide_output_enabled", &get_guide_output_enabled },
+    { "set_guide_output_enabled", &set_guide_output_enabled },
+    { "get_algo_param_names", &get_algo_param_names },
+    { "get_algo_param", &get_algo_param },
+    { "set_algo_param", &set_algo_param },
+    { "get_dec_guide_mode", &get_dec_guide_mode },
+    { "set_dec_guide_mode", &set_dec_guide_mode },
+    { "get_settling", &get_settling },
+    { "guide_pulse", &guide_pulse },
+    { "get_calibration_data", &get_calibration_data },
+    { "capture_single_frame", &capture_single_frame },
+    { "get_cooler_status", &get_cooler_status },
+    { "set_cooler_state", &set_cooler_state },
+    { "get_ccd_temperature", &get_sensor_temperature },
+    { "export_config_settings", &export_config_settings },
+    { "get_variable_delay_settings", &get_variable_delay_settings },
+    { "set_variable_delay_settings", &set_variable_delay_settings },
+    { "get_frame_buffer_stats", &get_frame_buffer_stats },
+    { "get_guide_latency", &get_guide_latency },
+    { "get_client_stats", &get_client_stats },
+    { "get_server_stats", &get_server_stats },
+    { "set_image_stream", &set_image_stream },
+    { "get_event_subscriptions", &get_event_subscriptions },
+    { "set_event_subscriptions", &set_event_subscriptions },
+};
+
+// the method table is searched by name using this index, sorted by name
+static std::vector<unsigned short> s_rpcIndex;
+
+static void init_rpc_methods()
+{
+    s_rpcIndex.resize(WXSIZEOF(s_rpcMethods));
+    for (unsigned int i = 0; i < WXSIZEOF(s_rpcMethods); i++)
+        s_rpcIndex[i] = i;
+    std::sort(s_rpcIndex.begin(), s_rpcIndex.end(),
+              [](unsigned short a, unsigned short b) { return strcmp(s_rpcMethods[a].name, s_rpcMethods[b].name) < 0; });
+
+    s_rpcStats.resize(WXSIZEOF(s_rpcMethods));
+    for (unsigned int i = 0; i < WXSIZEOF(s_rpcMethods); i++)
+        s_rpcStats[i].name = s_rpcMethods[i].name;
+}
+
+// index of the named method in s_rpcMethods, or -1
+static int find_rpc_method(const char *name)
+{
+    if (s_rpcIndex.empty())
+        init_rpc_methods();
+
+    auto it = std::lower_bound(s_rpcIndex.begin(), s_rpcIndex.end(), name,
+                               [](unsigned short i, const char *n) { return strcmp(s_rpcMethods[i].name, n) < 0; });
+    if (it != s_rpcIndex.end() && strcmp(s_rpcMethods[*it].name, name) == 0)
+        return *it;
+    return -1;
+}
+
+// true if the handler responded with an error; pos is the length of the response before the
+// handler ran, and handlers add either a result or an error first
+static bool is_error_response(const JObj& response, size_t pos)
+{
+    static const char ERR[] = ",\"error\":";
+    return response.m_s.compare(pos, sizeof(ERR) - 1, ERR) == 0;
+}
+
 static bool handle_request(JRpcCall& call)
 {
     const json_value *params;
@@ -2253,230 +3281,33 @@ static bool handle_request(JRpcCall& call)
         return true;
     }
 
-    static struct
-    {
-        const char *name;
-        void (*fn)(JObj& response, const json_value *params);
-    } methods[] = { {
-                        "clear_calibration",
-                        &clear_calibration,
-                    },
-                    {
-                        "deselect_star",
-                        &deselect_star,
-                    },
-                    {
-                        "get_exposure",
-                        &get_exposure,
-                    },
-                    {
-                        "set_exposure",
-                        &set_exposure,
-                    },
-                    {
-                        "get_exposure_durations",
-                        &get_exposure_durations,
-                    },
-                    {
-                        "get_profiles",
-                        &get_profiles,
-                    },
-                    {
-                        "get_profile",
-                        &get_profile,
-                    },
-                    {
-                        "set_profile",
-                        &set_profile,
-                    },
-                    {
-                        "get_connected",
-                        &get_connected,
-                    },
-                    {
-                        "set_connected",
-                        &set_connected,
-                    },
-                    {
-                        "get_calibrated",
-                        &get_calibrated,
-                    },
-                    {
-                        "get_paused",
-                        &get_paused,
-                    },
-                    {
-                        "set_paused",
-                        &set_paused,
-                    },
-                    {
-                        "get_lock_position",
-                        &get_lock_position,
-                    },
-                    {
-                        "set_lock_position",
-                        &set_lock_position,
-                    },
-                    {
-                        "loop",
-                        &loop,
-                    },
-                    {
-                        "stop_capture",
-                        &stop_capture,
-                    },
-                    {
-                        "guide",
-                        &guide,
-                    },
-                    {
-                        "dither",
-                        &dither,
-                    },
-                    {
-                        "find_star",
-                        &find_star,
-                    },
-                    {
-                        "get_pixel_scale",
-                        &get_pixel_scale,
-                    },
-                    {
-                        "get_app_state",
-                        &get_app_state,
-                    },
-                    {
-                        "flip_calibration",
-                        &flip_calibration,
-                    },
-                    {
-                        "get_lock_shift_enabled",
-                        &get_lock_shift_enabled,
-                    },
-                    {
-                        "set_lock_shift_enabled",
-                        &set_lock_shift_enabled,
-                    },
-                    {
-                        "get_lock_shift_params",
-                        &get_lock_shift_params,
-                    },
-                    {
-                        "set_lock_shift_params",
-                        &set_lock_shift_params,
-                    },
-                    {
-                        "save_image",
-                        &save_image,
-                    },
-                    {
-                        "get_star_image",
-                        &get_star_image,
-                    },
-                    {
-                        "get_use_subframes",
-                        &get_use_subframes,
-                    },
-                    {
-                        "get_search_region",
-                        &get_search_region,
-                    },
-                    {
-                        "shutdown",
-                        &shutdown,
-                    },
-                    {
-                        "get_camera_binning",
-                        &get_camera_binning,
-                    },
-                    {
-                        "get_camera_frame_size",
-                        &get_camera_frame_size,
-                    },
-                    {
-                        "get_current_equipment",
-                        &get_current_equipment,
-                    },
-                    {
-                        "get_guide_output_enabled",
-                        &get_guide_output_enabled,
-                    },
-                    {
-                        "set_guide_output_enabled",
-                        &set_guide_output_enabled,
-                    },
-                    {
-                        "get_algo_param_names",
-                        &get_algo_param_names,
-                    },
-                    {
-                        "get_algo_param",
-                        &get_algo_param,
-                    },
-                    {
-                        "set_algo_param",
-                        &set_algo_param,
-                    },
-                    {
-                        "get_dec_guide_mode",
-                        &get_dec_guide_mode,
-                    },
-                    {
-                        "set_dec_guide_mode",
-                        &set_dec_guide_mode,
-                    },
-                    {
-                        "get_settling",
-                        &get_settling,
-                    },
-                    {
-                        "guide_pulse",
-                        &guide_pulse,
-                    },
-                    {
-                        "get_calibration_data",
-                        &get_calibration_data,
-                    },
-                    {
-                        "capture_single_frame",
-                        &capture_single_frame,
-                    },
-                    {
-                        "get_cooler_status",
-                        &get_cooler_status,
-                    },
-                    {
-                        "set_cooler_state",
-                        &set_cooler_state,
-                    },
-                    {
-                        "get_ccd_temperature",
-                        &get_sensor_temperature,
-                    },
-                    {
-                        "export_config_settings",
-                        &export_config_settings,
-                    },
-                    { "get_variable_delay_settings", &get_variable_delay_settings },
-                    { "set_variable_delay_settings", &set_variable_delay_settings } };
-
-    for (unsigned int i = 0; i < WXSIZEOF(methods); i++)
-    {
-        if (strcmp(call.method->string_value, methods[i].name) == 0)
+    int const idx = find_rpc_method(call.method->string_value);
+    if (idx >= 0)
+    {
+        size_t const pos = call.response.m_s.size();
+        wxLongLong_t const t0 = GuideLatency::Now();
+
+        // handlers may run the event loop and handle other requests reentrantly
+        wxSocketClient *const prevClient = s_rpcClient;
+        s_rpcClient = call.cli;
+        (*s_rpcMethods[idx].fn)(call.response, params);
+        s_rpcClient = prevClient;
+
+        s_rpcStats[idx].Record(GuideLatency::Now() - t0, is_error_response(call.response, pos));
+
+        if (id)
         {
-            (*methods[i].fn)(call.response, params);
-            if (id)
-            {
-                call.response << jrpc_id(id);
-                return true;
-            }
-            else
-            {
-                return false;
-            }
+            call.response << jrpc_id(id);
+            return true;
+        }
+        else
+        {
+            return false;
         }
     }
 
+    ++s_rpcUnknownCalls;
+
     if (id)
     {
         call.response << jrpc_error(JSONRPC_METHOD_NOT_FOUND, "method not found") << jrpc_id(id);
@@ -2488,19 +3319,14 @@ static bool handle_request(JRpcCall& call)
     }
 }
 
-static void handle_cli_input_complete(wxSocketClient *cli, char *input)
+static void handle_cli_input_complete(wxSocketClient *cli, char *input, JsonParser& parser)
 {
-    // a dedicated JsonParser instance is used for each line of input since
-    // handle_request can recurse if the request causes the event loop to run and we
-    // don't want the parser to be reused.
-    JsonParser parser;
-
     if (!parser.Parse(input))
     {
         JRpcCall call(cli, nullptr);
         call.response << jrpc_error(JSONRPC_PARSE_ERROR, parser_error(parser)) << jrpc_id(0);
         dump_response(call);
-        do_notify1(cli, call.response);
+        do_respond(cli, call.response);
         return;
     }
 
@@ -2525,7 +3351,7 @@ static void handle_cli_input_complete(wxSocketClient *cli, char *input)
         }
 
         if (found)
-            do_notify1(cli, ary);
+            do_respond(cli, ary);
     }
     else
     {
@@ -2536,7 +3362,7 @@ static void handle_cli_input_complete(wxSocketClient *cli, char *input)
         if (handle_request(call))
         {
             dump_response(call);
-            do_notify1(cli, call.response);
+            do_respond(cli, call.response);
         }
     }
 }
@@ -2563,7 +3389,7 @@ static void handle_cli_input(wxSocketClient *cli)
 
             JRpcResponse response;
             response << jrpc_error(JSONRPC_INTERNAL_ERROR, "too big") << jrpc_id(0);
-            do_notify1(cli, response);
+            do_respond(cli, response);
 
             rdbuf->reset();
             break;
@@ -2577,21 +3403,18 @@ static void handle_cli_input(wxSocketClient *cli)
         char *end;
         while ((end = static_cast<char *>(memchr(rdbuf->buf(), '\n', rdbuf->len()))) != nullptr)
         {
-            // Move the newline-terminated chunk from the read buffer to a temporary
-            // buffer on the stack, and consume the chunk from the read buffer before
-            // processing the line. This leaves the read buffer in the correct state to
-            // be used again if this function is caller reentrantly.
-            char line[ClientReadBuf::SIZE];
-            size_t len1 = end - rdbuf->buf();
-            memcpy(line, rdbuf->buf(), len1);
-            line[len1] = 0;
-
-            char *next = end + 1;
-            size_t len2 = rdbuf->dest - next;
-            memmove(rdbuf->buf(), next, len2);
-            rdbuf->dest = rdbuf->buf() + len2;
-
-            handle_cli_input_complete(cli, line);
+            // Consume the newline-terminated chunk from the read buffer before processing the
+            // line. This leaves the read buffer in the correct state to be used again if this
+            // function is called reentrantly.
+            char *line = rdbuf->detach(end);
+
+            // a dedicated JsonParser instance is used for each line since handle_request can
+            // recurse if the request causes the event loop to run
+            JsonParser *parser = clidata->AcquireParser();
+            handle_cli_input_complete(cli, line, *parser);
+            clidata->ReleaseParser(parser);
+
+            rdbuf->release(line);
         }
     }
 }
@@ -2621,6 +3444,15 @@ bool EventServer::EventServerStart(unsigned int instanceId)
         return true;
     }
 
+    s_outputLimits.highWater = (size_t) std::max(pConfig->Global.GetInt("/EventServer/OutputHighWaterKB", 1024), 16) * 1024;
+    s_outputLimits.policy = pConfig->Global.GetString("/EventServer/OverflowPolicy", "drop") == "disconnect"
+        ? OVERFLOW_DISCONNECT
+        : OVERFLOW_DROP;
+
+    Debug.Write(wxString::Format("event server output limit %u KB per client, %s on overflow\n",
+                                 (unsigned int) (s_outputLimits.highWater / 1024),
+                                 s_outputLimits.policy == OVERFLOW_DISCONNECT ? "disconnect" : "drop events"));
+
     m_serverSocket->SetEventHandler(*this, EVENT_SERVER_ID);
     m_serverSocket->SetNotify(wxSOCKET_CONNECTION_FLAG);
     m_serverSocket->Notify(true);
@@ -2667,7 +3499,7 @@ void EventServer::OnEventServerEvent(wxSocketEvent& event)
     Debug.Write(wxString::Format("evsrv: cli %p connect\n", client));
 
     client->SetEventHandler(*this, EVENT_SERVER_CLIENT_ID);
-    client->SetNotify(wxSOCKET_LOST_FLAG | wxSOCKET_INPUT_FLAG);
+    client->SetNotify(wxSOCKET_LOST_FLAG | wxSOCKET_INPUT_FLAG | wxSOCKET_OUTPUT_FLAG);
     client->SetFlags(wxSOCKET_NOWAIT);
     client->Notify(true);
     client->SetClientData(new ClientData(client));
@@ -2695,23 +3527,83 @@ void EventServer::OnEventServerClientEvent(wxSocketEvent& event)
     {
         handle_cli_input(cli);
     }
+    else if (event.GetSocketEvent() == wxSOCKET_OUTPUT)
+    {
+        // the socket is writable again
+        ClientData *cd = (ClientData *) cli->GetClientData();
+        wxMutexLocker lock(cd->wrlock);
+        flush_output(cd);
+    }
     else
     {
         Debug.Write(wxString::Format("unexpected client socket event %d\n", event.GetSocketEvent()));
     }
 }
 
+// called (via CallAfter) to close a client that exceeded its output limit; the caller took a
+// reference on the client data
+void EventServer::CloseClient(wxSocketClient *cli)
+{
+    if (m_eventServerClients.erase(cli))
+    {
+        Debug.Write(wxString::Format("evsrv: cli %p closed\n", cli));
+        destroy_client(cli);
+    }
+
+    destroy_client(cli);
+}
+
+void EventServer::NotifyNewFrame(const usImage *img, const PHD_Point& star)
+{
+    // build each distinct message once, whatever the number of clients asking for it
+    std::vector<std::pair<ImageStream, wxCharBuffer>> msgs;
+
+    for (CliSockSet::const_iterator it = m_eventServerClients.begin(); it != m_eventServerClients.end(); ++it)
+    {
+        const ImageStream& st = ((ClientData *) (*it)->GetClientData())->stream;
+        if (st.mode == STREAM_OFF)
+            continue;
+
+        auto msg = msgs.begin();
+        while (msg != msgs.end() && !(msg->first == st))
+            ++msg;
+        if (msg == msgs.end())
+            msg = msgs.insert(msgs.end(), std::make_pair(st, image_stream_msg(img, star, st)));
+
+        if (msg->second.length())
+            send_image(*it, msg->second);
+    }
+}
+
+void EventServer::GetClientStats(std::vector<ClientStats> *stats) const
+{
+    stats->clear();
+
+    for (CliSockSet::const_iterator it = m_eventServerClients.begin(); it != m_eventServerClients.end(); ++it)
+    {
+        ClientData *cd = (ClientData *) (*it)->GetClientData();
+        wxMutexLocker lock(cd->wrlock);
+
+        ClientStats s = cd->stats;
+        s.peer = cd->peer;
+        s.queuedMsgs = cd->outq.Count();
+        s.queuedBytes = cd->outq.Bytes();
+        s.avgLatencyMs = s.sentMsgs ? cd->totalLatencyMs / s.sentMsgs : 0.;
+        stats->push_back(s);
+    }
+}
+
 void EventServer::NotifyStartCalibration(const Mount *mount)
 {
-    SIMPLE_NOTIFY_EV(ev_start_calibration(mount));
+    SIMPLE_NOTIFY_EV(EV_START_CALIBRATION, ev_start_calibration(mount));
 }
 
 void EventServer::NotifyCalibrationStep(const CalibrationStepInfo& info)
 {
-    if (m_eventServerClients.empty())
+    if (!subscribed(m_eventServerClients, EV_CALIBRATING))
         return;
 
-    Ev ev("Calibrating");
+    Ev ev(EV_CALIBRATING);
 
     ev << NVMount(info.mount) << NV("dir", info.direction) << NV("dist", info.dist) << NV("dx", info.dx) << NV("dy", info.dy)
        << NV("pos", info.pos) << NV("step", info.stepNumber);
@@ -2724,10 +3616,10 @@ void EventServer::NotifyCalibrationStep(const CalibrationStepInfo& info)
 
 void EventServer::NotifyCalibrationFailed(const Mount *mount, const wxString& msg)
 {
-    if (m_eventServerClients.empty())
+    if (!subscribed(m_eventServerClients, EV_CALIBRATION_FAILED))
         return;
 
-    Ev ev("CalibrationFailed");
+    Ev ev(EV_CALIBRATION_FAILED);
     ev << NVMount(mount) << NV("Reason", msg);
 
     do_notify(m_eventServerClients, ev);
@@ -2735,7 +3627,7 @@ void EventServer::NotifyCalibrationFailed(const Mount *mount, const wxString& ms
 
 void EventServer::NotifyCalibrationComplete(const Mount *mount)
 {
-    if (m_eventServerClients.empty())
+    if (!subscribed(m_eventServerClients, EV_CALIBRATION_COMPLETE))
         return;
 
     do_notify(m_eventServerClients, ev_calibration_complete(mount));
@@ -2743,10 +3635,10 @@ void EventServer::NotifyCalibrationComplete(const Mount *mount)
 
 void EventServer::NotifyCalibrationDataFlipped(const Mount *mount)
 {
-    if (m_eventServerClients.empty())
+    if (!subscribed(m_eventServerClients, EV_CALIBRATION_DATA_FLIPPED))
         return;
 
-    Ev ev("CalibrationDataFlipped");
+    Ev ev(EV_CALIBRATION_DATA_FLIPPED);
     ev << NVMount(mount);
 
     do_notify(m_eventServerClients, ev);
@@ -2754,10 +3646,10 @@ void EventServer::NotifyCalibrationDataFlipped(const Mount *mount)
 
 void EventServer::NotifyLooping(unsigned int exposure, const Star *star, const FrameDroppedInfo *info)
 {
-    if (m_eventServerClients.empty())
+    if (!subscribed(m_eventServerClients, EV_LOOPING_EXPOSURES))
         return;
 
-    Ev ev("LoopingExposures");
+    Ev ev(EV_LOOPING_EXPOSURES);
     ev << NV("Frame", exposure);
 
     double mass = 0., snr, hfd;
@@ -2799,20 +3691,20 @@ void EventServer::NotifyLooping(unsigned int exposure, const Star *star, const F
 
 void EventServer::NotifyLoopingStopped()
 {
-    SIMPLE_NOTIFY("LoopingExposuresStopped");
+    SIMPLE_NOTIFY(EV_LOOPING_EXPOSURES_STOPPED);
 }
 
 void EventServer::NotifyStarSelected(const PHD_Point& pt)
 {
-    SIMPLE_NOTIFY_EV(ev_star_selected(pt));
+    SIMPLE_NOTIFY_EV(EV_STAR_SELECTED, ev_star_selected(pt));
 }
 
 void EventServer::NotifyStarLost(const FrameDroppedInfo& info)
 {
-    if (m_eventServerClients.empty())
+    if (!subscribed(m_eventServerClients, EV_STAR_LOST))
         return;
 
-    Ev ev("StarLost");
+    Ev ev(EV_STAR_LOST);
 
     ev << NV("Frame", info.frameNumber) << NV("Time", info.time, 3) << NV("StarMass", info.starMass, 0)
        << NV("SNR", info.starSNR, 2) << NV("HFD", info.starHFD, 2) << NV("AvgDist", info.avgDist, 2);
@@ -2828,30 +3720,30 @@ void EventServer::NotifyStarLost(const FrameDroppedInfo& info)
 
 void EventServer::NotifyGuidingStarted()
 {
-    SIMPLE_NOTIFY_EV(ev_start_guiding());
+    SIMPLE_NOTIFY_EV(EV_START_GUIDING, ev_start_guiding());
 }
 
 void EventServer::NotifyGuidingStopped()
 {
-    SIMPLE_NOTIFY("GuidingStopped");
+    SIMPLE_NOTIFY(EV_GUIDING_STOPPED);
 }
 
 void EventServer::NotifyPaused()
 {
-    SIMPLE_NOTIFY_EV(ev_paused());
+    SIMPLE_NOTIFY_EV(EV_PAUSED, ev_paused());
 }
 
 void EventServer::NotifyResumed()
 {
-    SIMPLE_NOTIFY("Resumed");
+    SIMPLE_NOTIFY(EV_RESUMED);
 }
 
 void EventServer::NotifyGuideStep(const GuideStepInfo& step)
 {
-    if (m_eventServerClients.empty())
+    if (!subscribed(m_eventServerClients, EV_GUIDE_STEP))
         return;
 
-    Ev ev("GuideStep");
+    Ev ev(EV_GUIDE_STEP);
 
     ev << NV("Frame", step.frameNumber) << NV("Time", step.time, 3) << NVMount(step.mount) << NV("dx", step.cameraOffset.X, 3)
        << NV("dy", step.cameraOffset.Y, 3) << NV("RADistanceRaw", step.mountOffset.X, 3)
@@ -2892,10 +3784,10 @@ void EventServer::NotifyGuideStep(const GuideStepInfo& step)
 
 void EventServer::NotifyGuidingDithered(double dx, double dy)
 {
-    if (m_eventServerClients.empty())
+    if (!subscribed(m_eventServerClients, EV_GUIDING_DITHERED))
         return;
 
-    Ev ev("GuidingDithered");
+    Ev ev(EV_GUIDING_DITHERED);
     ev << NV("dx", dx, 3) << NV("dy", dy, 3);
 
     do_notify(m_eventServerClients, ev);
@@ -2903,7 +3795,7 @@ void EventServer::NotifyGuidingDithered(double dx, double dy)
 
 void EventServer::NotifySetLockPosition(const PHD_Point& xy)
 {
-    if (m_eventServerClients.empty())
+    if (!subscribed(m_eventServerClients, EV_LOCK_POSITION_SET))
         return;
 
     do_notify(m_eventServerClients, ev_set_lock_position(xy));
@@ -2911,17 +3803,17 @@ void EventServer::NotifySetLockPosition(const PHD_Point& xy)
 
 void EventServer::NotifyLockPositionLost()
 {
-    SIMPLE_NOTIFY("LockPositionLost");
+    SIMPLE_NOTIFY(EV_LOCK_POSITION_LOST);
 }
 
 void EventServer::NotifyLockShiftLimitReached()
 {
-    SIMPLE_NOTIFY("LockPositionShiftLimitReached");
+    SIMPLE_NOTIFY(EV_LOCK_POSITION_SHIFT_LIMIT_REACHED);
 }
 
 void EventServer::NotifyAppState()
 {
-    if (m_eventServerClients.empty())
+    if (!subscribed(m_eventServerClients, EV_APP_STATE))
         return;
 
     do_notify(m_eventServerClients, ev_app_state());
@@ -2929,12 +3821,12 @@ void EventServer::NotifyAppState()
 
 void EventServer::NotifySettleBegin()
 {
-    SIMPLE_NOTIFY("SettleBegin");
+    SIMPLE_NOTIFY(EV_SETTLE_BEGIN);
 }
 
 void EventServer::NotifySettling(double distance, double time, double settleTime, bool starLocked)
 {
-    if (m_eventServerClients.empty())
+    if (!subscribed(m_eventServerClients, EV_SETTLING))
         return;
 
     Ev ev(ev_settling(distance, time, settleTime, starLocked));
@@ -2946,7 +3838,7 @@ void EventServer::NotifySettling(double distance, double time, double settleTime
 
 void EventServer::NotifySettleDone(const wxString& errorMsg, int settleFrames, int droppedFrames)
 {
-    if (m_eventServerClients.empty())
+    if (!subscribed(m_eventServerClients, EV_SETTLE_DONE))
         return;
 
     Ev ev(ev_settle_done(errorMsg, settleFrames, droppedFrames));
@@ -2958,10 +3850,10 @@ void EventServer::NotifySettleDone(const wxString& errorMsg, int settleFrames, i
 
 void EventServer::NotifyAlert(const wxString& msg, int type)
 {
-    if (m_eventServerClients.empty())
+    if (!subscribed(m_eventServerClients, EV_ALERT))
         return;
 
-    Ev ev("Alert");
+    Ev ev(EV_ALERT);
     ev << NV("Msg", msg);
 
     wxString s;
@@ -2990,10 +3882,10 @@ void EventServer::NotifyAlert(const wxString& msg, int type)
 template<typename T>
 static void NotifyGuidingParam(const EventServer::CliSockSet& clients, const wxString& name, T val)
 {
-    if (clients.empty())
+    if (!subscribed(clients, EV_GUIDE_PARAM_CHANGE))
         return;
 
-    Ev ev("GuideParamChange");
+    Ev ev(EV_GUIDE_PARAM_CHANGE);
     ev << NV("Name", name);
     ev << NV("Value", val);
 
@@ -3020,12 +3912,24 @@ void EventServer::NotifyGuidingParam(const wxString& name, const wxString& val)
     ::NotifyGuidingParam(m_eventServerClients, name, val);
 }
 
+void EventServer::NotifyImageSaved(const wxString& filename, const wxString& source, bool error)
+{
+    if (!subscribed(m_eventServerClients, EV_IMAGE_SAVED))
+        return;
+
+    Ev ev(EV_IMAGE_SAVED);
+    ev << NV("Filename", filename) << NV("Source", source) << NV("Error", error);
+
+    do_notify(m_eventServerClients, ev);
+}
+
 void EventServer::NotifyConfigurationChange()
 {
-    if (m_configEventDebouncer == nullptr || m_configEventDebouncer->IsRunning())
+    if (m_configEventDebouncer == nullptr || m_configEventDebouncer->IsRunning() ||
+        !subscribed(m_eventServerClients, EV_CONFIGURATION_CHANGE))
         return;
 
-    Ev ev("ConfigurationChange");
+    Ev ev(EV_CONFIGURATION_CHANGE);
     do_notify(m_eventServerClients, ev);
     m_configEventDebouncer->StartOnce(0);
 }
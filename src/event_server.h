@@ -36,6 +36,7 @@
 #define EVENT_SERVER_INCLUDED
 
 #include <set>
+#include <vector>
 #include "json_parser.h"
 
 class EventServer : public wxEvtHandler
@@ -43,6 +44,29 @@ class EventServer : public wxEvtHandler
 public:
     typedef std::set<wxSocketClient *> CliSockSet;
 
+    // what to do with a client whose unsent events exceed the high-water mark; replies to the
+    // client's requests are always sent
+    enum OverflowPolicy
+    {
+        OVERFLOW_DROP, // drop new events until the client catches up, and old ones ahead of a reply
+        OVERFLOW_DISCONNECT, // close the connection
+    };
+
+    struct ClientStats
+    {
+        wxString peer;
+        unsigned int queuedMsgs;
+        unsigned long long queuedBytes;
+        unsigned long long peakQueuedBytes;
+        unsigned long long sentMsgs;
+        unsigned long long sentBytes;
+        unsigned long long droppedMsgs;
+        double avgLatencyMs; // time from queuing a message to writing its last byte
+        double maxLatencyMs;
+        unsigned long long streamFrames; // binary image stream messages sent
+        unsigned long long streamDropped; // frames skipped because the previous one was still queued
+    };
+
 private:
     wxSocketServer *m_serverSocket;
     CliSockSet m_eventServerClients;
@@ -83,6 +107,11 @@ public:
     void NotifyGuidingParam(const wxString& name, bool val);
     void NotifyGuidingParam(const wxString& name, const wxString& val);
     void NotifyConfigurationChange();
+    void NotifyImageSaved(const wxString& filename, const wxString& source, bool error);
+    void NotifyNewFrame(const usImage *img, const PHD_Point& star);
+
+    void GetClientStats(std::vector<ClientStats> *stats) const;
+    void CloseClient(wxSocketClient *cli);
 
 private:
     void OnEventServerEvent(wxSocketEvent& evt);
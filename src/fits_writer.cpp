@@ -0,0 +1,293 @@
+/*
+ *  fits_writer.cpp
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "phd.h"
+
+#include <deque>
+#include <map>
+
+// queued images are held in memory until written; beyond this the callers wait
+static const size_t MAX_QUEUED_BYTES = 128 * 1024 * 1024;
+
+struct FitsJob
+{
+    unsigned int id;
+    wxString fname;
+    unsigned short *pixels; // from FrameBufferPool
+    wxSize size;
+    FITSHdrCards hdr;
+    FitsWriter::Compression compression;
+    wxString source;
+    bool clobber; // replace an existing file
+    bool waited; // someone is waiting for the result
+
+    size_t Bytes() const { return (size_t) size.GetWidth() * size.GetHeight() * sizeof(unsigned short); }
+};
+
+struct WriterImpl;
+
+struct FitsWriterThread : public wxThread
+{
+    WriterImpl *m_writer;
+
+    FitsWriterThread(WriterImpl *writer) : wxThread(wxTHREAD_JOINABLE), m_writer(writer) { }
+    ExitCode Entry() override;
+};
+
+struct WriterImpl
+{
+    FitsWriterThread *m_thread;
+
+    wxMutex m_lock; // protects the state below
+    wxCondition m_wake; // a job was queued or stop was requested
+    wxCondition m_done; // a job was finished
+    std::deque<FitsJob *> m_queue;
+    size_t m_queuedBytes; // includes the job being written
+    unsigned int m_nextId;
+    unsigned int m_lastDone;
+    std::map<unsigned int, bool> m_results; // error status of finished jobs that are waited for
+    bool m_stop;
+
+    WriterImpl()
+        : m_thread(nullptr), m_wake(m_lock), m_done(m_lock), m_queuedBytes(0), m_nextId(0), m_lastDone(0), m_stop(false)
+    {
+    }
+
+    unsigned int Enqueue(FitsJob *job)
+    {
+        wxMutexLocker lck(m_lock);
+
+        // back-pressure: wait for earlier images to be written rather than let the queue grow
+        // without limit; a single image larger than the limit is still accepted
+        while (m_queuedBytes > 0 && m_queuedBytes + job->Bytes() > MAX_QUEUED_BYTES)
+            m_done.Wait();
+
+        job->id = ++m_nextId;
+        m_queuedBytes += job->Bytes();
+        m_queue.push_back(job);
+        m_wake.Signal();
+
+        return job->id;
+    }
+
+    bool WaitFor(unsigned int id)
+    {
+        wxMutexLocker lck(m_lock);
+
+        while (m_lastDone < id)
+            m_done.Wait();
+
+        bool err = m_results[id];
+        m_results.erase(id);
+        return err;
+    }
+
+    void ThreadLoop()
+    {
+        while (true)
+        {
+            FitsJob *job;
+
+            {
+                wxMutexLocker lck(m_lock);
+                while (m_queue.empty() && !m_stop)
+                    m_wake.Wait();
+                if (m_queue.empty())
+                    return; // stopping and everything has been written
+                job = m_queue.front();
+                m_queue.pop_front();
+            }
+
+            bool err = FitsWriter::WriteFile(job->fname, job->pixels, job->size, job->hdr, job->compression, job->clobber);
+
+            if (err)
+                Debug.Write(wxString::Format("FitsWriter: error writing %s\n", job->fname));
+
+            wxString fname(job->fname);
+            wxString source(job->source);
+            PhdApp::ExecInMainThread([fname, source, err]() { EvtServer.NotifyImageSaved(fname, source, err); });
+
+            FrameBufferPool::Release(job->pixels, job->size.GetWidth() * job->size.GetHeight());
+
+            {
+                wxMutexLocker lck(m_lock);
+                m_queuedBytes -= job->Bytes();
+                m_lastDone = job->id;
+                if (job->waited)
+                    m_results[job->id] = err;
+                m_done.Broadcast();
+            }
+
+            delete job;
+        }
+    }
+};
+
+wxThread::ExitCode FitsWriterThread::Entry()
+{
+    m_writer->ThreadLoop();
+    return (wxThread::ExitCode) 0;
+}
+
+static WriterImpl *s_writer;
+
+void FitsWriter::Init()
+{
+    WriterImpl *writer = new WriterImpl();
+
+    FitsWriterThread *thread = new FitsWriterThread(writer);
+    if (thread->Create() != wxTHREAD_NO_ERROR || thread->Run() != wxTHREAD_NO_ERROR)
+    {
+        Debug.Write("FitsWriter: could not start thread, images will be written synchronously\n");
+        delete thread;
+        delete writer;
+        return;
+    }
+
+    writer->m_thread = thread;
+    s_writer = writer;
+}
+
+void FitsWriter::Destroy()
+{
+    WriterImpl *writer = s_writer;
+    if (!writer)
+        return;
+
+    s_writer = nullptr;
+
+    {
+        wxMutexLocker lck(writer->m_lock);
+        writer->m_stop = true;
+        writer->m_wake.Signal();
+    }
+
+    writer->m_thread->Wait();
+    delete writer->m_thread;
+    delete writer;
+}
+
+static FitsJob *NewJob(const wxString& fname, const usImage& img, FITSHdrCards *hdr, FitsWriter::Compression compression,
+                       const wxString& source, bool clobber, bool waited)
+{
+    FitsJob *job = new FitsJob();
+    job->fname = fname;
+    job->pixels = FrameBufferPool::Alloc(img.NPixels);
+    memcpy(job->pixels, img.ImageData, img.NPixels * sizeof(unsigned short));
+    job->size = img.Size;
+    std::swap(job->hdr, *hdr);
+    job->compression = compression;
+    job->source = source;
+    job->clobber = clobber;
+    job->waited = waited;
+    return job;
+}
+
+void FitsWriter::Save(const wxString& fname, const usImage& img, FITSHdrCards *hdr, Compression compression,
+                      const wxString& source, bool clobber)
+{
+    if (!s_writer)
+    {
+        // take the header keywords as a queued job would
+        FITSHdrCards cards;
+        std::swap(cards, *hdr);
+        bool err = WriteFile(fname, img.ImageData, img.Size, cards, compression, clobber);
+        EvtServer.NotifyImageSaved(fname, source, err);
+        return;
+    }
+
+    s_writer->Enqueue(NewJob(fname, img, hdr, compression, source, clobber, false));
+}
+
+bool FitsWriter::SaveAndWait(const wxString& fname, const usImage& img, FITSHdrCards *hdr, Compression compression,
+                             const wxString& source)
+{
+    if (!s_writer)
+    {
+        // take the header keywords as a queued job would
+        FITSHdrCards cards;
+        std::swap(cards, *hdr);
+        bool err = WriteFile(fname, img.ImageData, img.Size, cards, compression);
+        EvtServer.NotifyImageSaved(fname, source, err);
+        return err;
+    }
+
+    unsigned int id = s_writer->Enqueue(NewJob(fname, img, hdr, compression, source, true, true));
+    return s_writer->WaitFor(id);
+}
+
+bool FitsWriter::WriteFile(const wxString& fname, const unsigned short *pixels, const wxSize& size, const FITSHdrCards& hdr,
+                           Compression compression, bool clobber)
+{
+    fitsfile *fptr; // FITS file pointer
+    int status = 0; // CFITSIO status value MUST be initialized to zero!
+
+    if (PHD_fits_create_file(&fptr, fname, clobber, &status))
+        return true;
+
+    // with tile compression CFITSIO writes an empty primary HDU followed by the compressed image
+    if (compression == COMPRESS_RICE)
+        fits_set_compression_type(fptr, RICE_1, &status);
+    else if (compression == COMPRESS_GZIP)
+        fits_set_compression_type(fptr, GZIP_1, &status);
+
+    long fsize[] = {
+        (long) size.GetWidth(),
+        (long) size.GetHeight(),
+    };
+    fits_create_img(fptr, USHORT_IMG, 2, fsize, &status);
+
+    hdr.Apply(fptr, &status);
+
+    long fpixel[3] = { 1, 1, 1 };
+    fits_write_pix(fptr, TUSHORT, fpixel, (LONGLONG) size.GetWidth() * size.GetHeight(), const_cast<unsigned short *>(pixels),
+                   &status);
+
+    PHD_fits_close_file(fptr);
+
+    return status ? true : false;
+}
+
+FitsWriter::Compression FitsWriter::CompressionFromInt(int val)
+{
+    switch (val)
+    {
+    case COMPRESS_RICE:
+        return COMPRESS_RICE;
+    case COMPRESS_GZIP:
+        return COMPRESS_GZIP;
+    default:
+        return COMPRESS_NONE;
+    }
+}
@@ -0,0 +1,75 @@
+/*
+ *  fits_writer.h
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef FITS_WRITER_INCLUDED
+#define FITS_WRITER_INCLUDED
+
+class FITSHdrCards;
+
+// Writes FITS files on a background thread so that saving images (the image logger, the
+// save_image API, star images) does not stall the main thread. Queued images are copies, the
+// total size of the queued images is bounded and callers block when the limit is reached. Each
+// file written produces an ImageSaved event.
+class FitsWriter
+{
+public:
+    enum Compression
+    {
+        COMPRESS_NONE = 0,
+        COMPRESS_RICE = 1,
+        COMPRESS_GZIP = 2,
+    };
+
+    static void Init();
+    // write any queued images and stop the writer thread
+    static void Destroy();
+
+    // Queue a copy of img to be written to fname with the header keywords in hdr (hdr is left
+    // empty). source identifies the requester in the ImageSaved event. An existing file is only
+    // replaced if clobber is set. If the writer thread is not running the file is written
+    // immediately.
+    static void Save(const wxString& fname, const usImage& img, FITSHdrCards *hdr, Compression compression,
+                     const wxString& source, bool clobber = true);
+    // like Save() but waits for the file to be written; returns true on error
+    static bool SaveAndWait(const wxString& fname, const usImage& img, FITSHdrCards *hdr, Compression compression,
+                            const wxString& source);
+
+    // write a file on the calling thread; returns true on error
+    static bool WriteFile(const wxString& fname, const unsigned short *pixels, const wxSize& size, const FITSHdrCards& hdr,
+                          Compression compression, bool clobber = true);
+
+    static Compression CompressionFromInt(int val);
+};
+
+#endif // FITS_WRITER_INCLUDED
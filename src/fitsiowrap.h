@@ -38,6 +38,9 @@
 
 #include "fitsio.h"
 
+#include <string>
+#include <vector>
+
 extern int PHD_fits_open_diskfile(fitsfile **fptr, const wxString& filename, int iomode, int *status);
 extern int PHD_fits_create_file(fitsfile **fptr, const wxString& filename, bool clobber, int *status);
 extern void PHD_fits_close_file(fitsfile *fptr);
@@ -77,4 +80,77 @@ public:
     }
 };
 
+// Collects header keywords to be written to a FITS file later, possibly on another thread. The
+// write() methods mirror FITSHdrWriter so header code can fill in either.
+class FITSHdrCards
+{
+    struct Card
+    {
+        int type; // TFLOAT, TUINT, TINT or TSTRING
+        std::string key;
+        std::string comment;
+        bool hasComment;
+        std::string strval;
+        union
+        {
+            float fval;
+            unsigned int uval;
+            int ival;
+        };
+    };
+
+    std::vector<Card> m_cards;
+
+    Card& add(int type, const char *key, const char *comment)
+    {
+        m_cards.emplace_back();
+        Card& card = m_cards.back();
+        card.type = type;
+        card.key = key;
+        card.hasComment = comment != nullptr;
+        if (comment)
+            card.comment = comment;
+        return card;
+    }
+
+public:
+    void write(const char *key, float val, const char *comment) { add(TFLOAT, key, comment).fval = val; }
+    void write(const char *key, unsigned int val, const char *comment) { add(TUINT, key, comment).uval = val; }
+    void write(const char *key, int val, const char *comment) { add(TINT, key, comment).ival = val; }
+    void write(const char *key, const char *val, const char *comment) { add(TSTRING, key, comment).strval = val; }
+
+    void write(const char *key, const wxDateTime& t, const wxDateTime::TimeZone& z, const char *comment)
+    {
+        wxString s = t.Format("%Y-%m-%dT%H:%M:%S", z) + wxString::Format(".%03d", t.GetMillisecond(z));
+        write(key, (const char *) s.c_str(), comment);
+    }
+
+    // write the collected keywords to the current HDU of fptr
+    void Apply(fitsfile *fptr, int *status) const
+    {
+        for (const Card& card : m_cards)
+        {
+            char *key = const_cast<char *>(card.key.c_str());
+            char *comment = card.hasComment ? const_cast<char *>(card.comment.c_str()) : nullptr;
+            void *val;
+            switch (card.type)
+            {
+            case TFLOAT:
+                val = const_cast<float *>(&card.fval);
+                break;
+            case TUINT:
+                val = const_cast<unsigned int *>(&card.uval);
+                break;
+            case TINT:
+                val = const_cast<int *>(&card.ival);
+                break;
+            default:
+                val = const_cast<char *>(card.strval.c_str());
+                break;
+            }
+            fits_write_key(fptr, card.type, key, val, comment, status);
+        }
+    }
+};
+
 #endif
@@ -0,0 +1,154 @@
+/*
+ *  frame_buffer_pool.cpp
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "phd.h"
+
+// Steady-state guiding has at most a handful of frames in flight (the frame being captured,
+// the current frame, the frames kept by the image logger and the noise reduction scratch
+// image), so a few buffers are enough.
+static const unsigned int MAX_POOLED_BUFFERS = 6;
+
+struct PooledBuffer
+{
+    unsigned int npixels;
+    unsigned short *buf;
+};
+
+struct BufferPoolState
+{
+    wxCriticalSection lock;
+    std::vector<PooledBuffer> free; // oldest first
+    FrameBufferPool::Stats stats;
+    bool enabled;
+
+    BufferPoolState() : enabled(true) { memset(&stats, 0, sizeof(stats)); }
+};
+
+// usImage instances can outlive static destruction, so the pool state is never destroyed
+static BufferPoolState& State()
+{
+    static BufferPoolState *s_state = new BufferPoolState();
+    return *s_state;
+}
+
+unsigned short *FrameBufferPool::Alloc(unsigned int npixels)
+{
+    BufferPoolState& st = State();
+
+    {
+        wxCriticalSectionLocker lck(st.lock);
+
+        // prefer the most recently released buffer
+        for (auto it = st.free.rbegin(); it != st.free.rend(); ++it)
+        {
+            if (it->npixels == npixels)
+            {
+                unsigned short *buf = it->buf;
+                st.free.erase(std::next(it).base());
+                ++st.stats.hits;
+                return buf;
+            }
+        }
+
+        ++st.stats.misses;
+        st.stats.bytesAllocated += (unsigned long long) npixels * sizeof(unsigned short);
+    }
+
+    return new unsigned short[npixels];
+}
+
+void FrameBufferPool::Release(unsigned short *buf, unsigned int npixels)
+{
+    if (!buf)
+        return;
+
+    BufferPoolState& st = State();
+    unsigned short *evict = nullptr;
+
+    {
+        wxCriticalSectionLocker lck(st.lock);
+
+        if (!st.enabled)
+        {
+            evict = buf;
+        }
+        else
+        {
+            if (st.free.size() >= MAX_POOLED_BUFFERS)
+            {
+                evict = st.free.front().buf;
+                st.free.erase(st.free.begin());
+            }
+            PooledBuffer pb;
+            pb.npixels = npixels;
+            pb.buf = buf;
+            st.free.push_back(pb);
+        }
+    }
+
+    delete[] evict;
+}
+
+void FrameBufferPool::NotifyFrame()
+{
+    BufferPoolState& st = State();
+    wxCriticalSectionLocker lck(st.lock);
+    ++st.stats.frames;
+}
+
+FrameBufferPool::Stats FrameBufferPool::GetStats()
+{
+    BufferPoolState& st = State();
+    wxCriticalSectionLocker lck(st.lock);
+    return st.stats;
+}
+
+void FrameBufferPool::Destroy()
+{
+    BufferPoolState& st = State();
+    std::vector<PooledBuffer> bufs;
+
+    {
+        wxCriticalSectionLocker lck(st.lock);
+        st.enabled = false;
+        bufs.swap(st.free);
+    }
+
+    for (const PooledBuffer& pb : bufs)
+        delete[] pb.buf;
+
+    Stats s = GetStats();
+    Debug.Write(wxString::Format("FrameBufferPool: %llu hits, %llu misses, %llu bytes allocated, %u frames\n", s.hits,
+                                 s.misses, s.bytesAllocated, s.frames));
+}
@@ -0,0 +1,66 @@
+/*
+ *  frame_buffer_pool.h
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef FRAME_BUFFER_POOL_INCLUDED
+#define FRAME_BUFFER_POOL_INCLUDED
+
+// Recycles usImage pixel buffers. Frames are allocated, passed along and freed continuously
+// while looping; the buffers are almost always the same size, so rather than returning them to
+// the heap the most recently released ones are kept and handed out again when a buffer with the
+// same number of pixels is requested.
+class FrameBufferPool
+{
+public:
+    struct Stats
+    {
+        unsigned long long hits; // requests satisfied from the pool
+        unsigned long long misses; // requests that had to allocate
+        unsigned long long bytesAllocated; // total bytes allocated by misses
+        unsigned int frames; // frames captured
+    };
+
+    // returns a buffer of npixels pixels; the contents are undefined
+    static unsigned short *Alloc(unsigned int npixels);
+    // return a buffer obtained from Alloc(npixels) to the pool; buf may be null
+    static void Release(unsigned short *buf, unsigned int npixels);
+
+    // count a captured frame, for the per-frame statistics
+    static void NotifyFrame();
+    static Stats GetStats();
+
+    // free the pooled buffers; buffers released after this are freed immediately
+    static void Destroy();
+};
+
+#endif // FRAME_BUFFER_POOL_INCLUDED
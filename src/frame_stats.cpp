@@ -0,0 +1,427 @@
+/*
+ *  frame_stats.cpp
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "frame_stats.h"
+
+#include <algorithm>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define FRAME_STATS_X86 1
+# include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+# define FRAME_STATS_NEON 1
+# include <arm_neon.h>
+#endif
+
+namespace
+{
+// regions smaller than this are not worth splitting
+const unsigned int MIN_PARALLEL_PIXELS = 512 * 1024;
+const int MIN_BAND_ROWS = 32;
+const unsigned int HISTO_SIZE = 65536;
+
+// median of an even number of values, rounded down like Median3 does at the edges
+template<int N>
+inline unsigned short median_even(unsigned short (&a)[N])
+{
+    std::sort(a, a + N);
+    return (unsigned short) (((unsigned int) a[N / 2 - 1] + (unsigned int) a[N / 2]) / 2);
+}
+
+// Interior rows are filtered with 16-bit min/max operations. SSE2 only has signed 16-bit
+// min/max, so on x86 the pixel values are offset by 0x8000 to make them signed.
+#if defined(FRAME_STATS_X86)
+typedef short Pix;
+const unsigned short PIX_BIAS = 0x8000;
+#else
+typedef unsigned short Pix;
+const unsigned short PIX_BIAS = 0;
+#endif
+
+struct Band
+{
+    unsigned int *histo; // valid in [minADU, maxADU]
+    Pix *lo, *mid, *hi; // per-row scratch
+    unsigned short minADU, maxADU;
+    unsigned short filtMin, filtMax;
+};
+
+// histogram and min/max of one row; only the histogram entries in [minADU, maxADU] are valid,
+// new entries are cleared as the range grows
+inline void ScanRow(Band& b, const unsigned short *p, int n, bool first)
+{
+    unsigned int *const histo = b.histo;
+    unsigned short mn = b.minADU, mx = b.maxADU;
+
+    if (first)
+    {
+        mn = mx = p[0];
+        histo[p[0]] = 0;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        unsigned short v = p[i];
+        if (v < mn)
+        {
+            std::fill(histo + v, histo + mn, 0);
+            mn = v;
+        }
+        else if (v > mx)
+        {
+            std::fill(histo + mx + 1, histo + v + 1, 0);
+            mx = v;
+        }
+        ++histo[v];
+    }
+
+    b.minADU = mn;
+    b.maxADU = mx;
+}
+
+// median filtered first or last row: each pixel is the median of the 2x2 or 3x2 neighborhood
+// made up of this row and the adjacent one
+inline void FilterEdgeRow(Band& b, const unsigned short *r, const unsigned short *a, int n)
+{
+    unsigned short mn = b.filtMin, mx = b.filtMax;
+
+    unsigned short q[4] = { r[0], r[1], a[0], a[1] };
+    unsigned short v = median_even(q);
+    mn = std::min(mn, v);
+    mx = std::max(mx, v);
+
+    for (int x = 1; x <= n - 2; x++)
+    {
+        unsigned short s[6] = { r[x - 1], r[x], r[x + 1], a[x - 1], a[x], a[x + 1] };
+        v = median_even(s);
+        mn = std::min(mn, v);
+        mx = std::max(mx, v);
+    }
+
+    unsigned short t[4] = { r[n - 2], r[n - 1], a[n - 2], a[n - 1] };
+    v = median_even(t);
+
+    b.filtMin = std::min(mn, v);
+    b.filtMax = std::max(mx, v);
+}
+
+// sort each column of three pixels (p, c, n are the rows above, at and below) for x0 <= x < w
+inline void SortColumns(const unsigned short *p, const unsigned short *c, const unsigned short *n, Pix *lo, Pix *mid,
+                        Pix *hi, int x0, int w)
+{
+    for (int x = x0; x < w; x++)
+    {
+        Pix a = (Pix) (p[x] ^ PIX_BIAS), b = (Pix) (c[x] ^ PIX_BIAS), d = (Pix) (n[x] ^ PIX_BIAS);
+        Pix t0 = std::min(a, b);
+        Pix t1 = std::max(a, b);
+        lo[x] = std::min(t0, d);
+        hi[x] = std::max(t1, d);
+        mid[x] = std::max(t0, std::min(t1, d));
+    }
+}
+
+// The median of a 3x3 neighborhood is the median of the largest column minimum, the median
+// column median and the smallest column maximum. Accumulates the range of the medians for
+// x0 <= x < x1
+inline void MedianRange(const Pix *lo, const Pix *mid, const Pix *hi, int x0, int x1, Pix *mn, Pix *mx)
+{
+    for (int x = x0; x < x1; x++)
+    {
+        Pix a = std::max(std::max(lo[x - 1], lo[x]), lo[x + 1]);
+        Pix b = std::max(std::min(mid[x - 1], mid[x]), std::min(std::max(mid[x - 1], mid[x]), mid[x + 1]));
+        Pix c = std::min(std::min(hi[x - 1], hi[x]), hi[x + 1]);
+        Pix v = std::max(std::min(a, b), std::min(std::max(a, b), c));
+        *mn = std::min(*mn, v);
+        *mx = std::max(*mx, v);
+    }
+}
+
+#if defined(FRAME_STATS_X86)
+
+inline __m128i Med3(__m128i a, __m128i b, __m128i c)
+{
+    return _mm_max_epi16(_mm_min_epi16(a, b), _mm_min_epi16(_mm_max_epi16(a, b), c));
+}
+
+inline short HMin(__m128i v)
+{
+    v = _mm_min_epi16(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_min_epi16(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    v = _mm_min_epi16(v, _mm_srli_epi32(v, 16));
+    return (short) _mm_cvtsi128_si32(v);
+}
+
+inline short HMax(__m128i v)
+{
+    v = _mm_max_epi16(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_max_epi16(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    v = _mm_max_epi16(v, _mm_srli_epi32(v, 16));
+    return (short) _mm_cvtsi128_si32(v);
+}
+
+void FilterInterior(const unsigned short *p, const unsigned short *c, const unsigned short *n, int w, Pix *lo, Pix *mid,
+                    Pix *hi, Pix *mn, Pix *mx)
+{
+    const __m128i bias = _mm_set1_epi16((short) PIX_BIAS);
+
+    int x = 0;
+    for (; x + 8 <= w; x += 8)
+    {
+        __m128i a = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (p + x)), bias);
+        __m128i b = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (c + x)), bias);
+        __m128i d = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (n + x)), bias);
+        __m128i t0 = _mm_min_epi16(a, b);
+        __m128i t1 = _mm_max_epi16(a, b);
+        _mm_storeu_si128((__m128i *) (lo + x), _mm_min_epi16(t0, d));
+        _mm_storeu_si128((__m128i *) (hi + x), _mm_max_epi16(t1, d));
+        _mm_storeu_si128((__m128i *) (mid + x), _mm_max_epi16(t0, _mm_min_epi16(t1, d)));
+    }
+    SortColumns(p, c, n, lo, mid, hi, x, w);
+
+    __m128i vmn = _mm_set1_epi16(*mn);
+    __m128i vmx = _mm_set1_epi16(*mx);
+    for (x = 1; x + 8 <= w - 1; x += 8)
+    {
+        __m128i a = _mm_max_epi16(_mm_max_epi16(_mm_loadu_si128((const __m128i *) (lo + x - 1)),
+                                                _mm_loadu_si128((const __m128i *) (lo + x))),
+                                  _mm_loadu_si128((const __m128i *) (lo + x + 1)));
+        __m128i b = Med3(_mm_loadu_si128((const __m128i *) (mid + x - 1)), _mm_loadu_si128((const __m128i *) (mid + x)),
+                         _mm_loadu_si128((const __m128i *) (mid + x + 1)));
+        __m128i d = _mm_min_epi16(_mm_min_epi16(_mm_loadu_si128((const __m128i *) (hi + x - 1)),
+                                                _mm_loadu_si128((const __m128i *) (hi + x))),
+                                  _mm_loadu_si128((const __m128i *) (hi + x + 1)));
+        __m128i v = Med3(a, b, d);
+        vmn = _mm_min_epi16(vmn, v);
+        vmx = _mm_max_epi16(vmx, v);
+    }
+    *mn = HMin(vmn);
+    *mx = HMax(vmx);
+    MedianRange(lo, mid, hi, x, w - 1, mn, mx);
+}
+
+#elif defined(FRAME_STATS_NEON)
+
+inline uint16x8_t Med3(uint16x8_t a, uint16x8_t b, uint16x8_t c)
+{
+    return vmaxq_u16(vminq_u16(a, b), vminq_u16(vmaxq_u16(a, b), c));
+}
+
+void FilterInterior(const unsigned short *p, const unsigned short *c, const unsigned short *n, int w, Pix *lo, Pix *mid,
+                    Pix *hi, Pix *mn, Pix *mx)
+{
+    int x = 0;
+    for (; x + 8 <= w; x += 8)
+    {
+        uint16x8_t a = vld1q_u16(p + x);
+        uint16x8_t b = vld1q_u16(c + x);
+        uint16x8_t d = vld1q_u16(n + x);
+        uint16x8_t t0 = vminq_u16(a, b);
+        uint16x8_t t1 = vmaxq_u16(a, b);
+        vst1q_u16(lo + x, vminq_u16(t0, d));
+        vst1q_u16(hi + x, vmaxq_u16(t1, d));
+        vst1q_u16(mid + x, vmaxq_u16(t0, vminq_u16(t1, d)));
+    }
+    SortColumns(p, c, n, lo, mid, hi, x, w);
+
+    uint16x8_t vmn = vdupq_n_u16(*mn);
+    uint16x8_t vmx = vdupq_n_u16(*mx);
+    for (x = 1; x + 8 <= w - 1; x += 8)
+    {
+        uint16x8_t a = vmaxq_u16(vmaxq_u16(vld1q_u16(lo + x - 1), vld1q_u16(lo + x)), vld1q_u16(lo + x + 1));
+        uint16x8_t b = Med3(vld1q_u16(mid + x - 1), vld1q_u16(mid + x), vld1q_u16(mid + x + 1));
+        uint16x8_t d = vminq_u16(vminq_u16(vld1q_u16(hi + x - 1), vld1q_u16(hi + x)), vld1q_u16(hi + x + 1));
+        uint16x8_t v = Med3(a, b, d);
+        vmn = vminq_u16(vmn, v);
+        vmx = vmaxq_u16(vmx, v);
+    }
+    *mn = vminvq_u16(vmn);
+    *mx = vmaxvq_u16(vmx);
+    MedianRange(lo, mid, hi, x, w - 1, mn, mx);
+}
+
+#else
+
+void FilterInterior(const unsigned short *p, const unsigned short *c, const unsigned short *n, int w, Pix *lo, Pix *mid,
+                    Pix *hi, Pix *mn, Pix *mx)
+{
+    SortColumns(p, c, n, lo, mid, hi, 0, w);
+    MedianRange(lo, mid, hi, 1, w - 1, mn, mx);
+}
+
+#endif
+
+// median filtered interior row (p, c, n are the rows above, at and below)
+inline void FilterRow(Band& b, const unsigned short *p, const unsigned short *c, const unsigned short *n, int w)
+{
+    Pix mn = (Pix) (b.filtMin ^ PIX_BIAS);
+    Pix mx = (Pix) (b.filtMax ^ PIX_BIAS);
+    FilterInterior(p, c, n, w, b.lo, b.mid, b.hi, &mn, &mx);
+    unsigned short fmin = (unsigned short) mn ^ PIX_BIAS;
+    unsigned short fmax = (unsigned short) mx ^ PIX_BIAS;
+
+    // left and right edges: median of the 2x3 neighborhood
+    unsigned short l[6] = { p[0], p[1], c[0], c[1], n[0], n[1] };
+    unsigned short v = median_even(l);
+    fmin = std::min(fmin, v);
+    fmax = std::max(fmax, v);
+
+    unsigned short r[6] = { p[w - 2], p[w - 1], c[w - 2], c[w - 1], n[w - 2], n[w - 1] };
+    v = median_even(r);
+
+    b.filtMin = std::min(fmin, v);
+    b.filtMax = std::max(fmax, v);
+}
+
+// rows [y0, y1) of the region; row r of the region starts at data + r * width
+void ScanBand(Band& b, const unsigned short *data, int width, int rw, int rh, int y0, int y1)
+{
+    b.filtMin = 65535;
+    b.filtMax = 0;
+
+    for (int y = y0; y < y1; y++)
+    {
+        const unsigned short *row = data + (size_t) y * width;
+
+        ScanRow(b, row, rw, y == y0);
+
+        if (rw < 2 || rh < 2)
+            continue;
+
+        if (y == 0)
+            FilterEdgeRow(b, row, row + width, rw);
+        else if (y == rh - 1)
+            FilterEdgeRow(b, row, row - width, rw);
+        else
+            FilterRow(b, row - width, row, row + width, rw);
+    }
+}
+
+// per-thread scratch space, reused from frame to frame
+struct Scratch
+{
+    std::vector<unsigned int> histo;
+    std::vector<Pix> rows;
+};
+} // namespace
+
+void FrameStats::Calc(Result *result, const unsigned short *data, int width, int rx, int ry, int rw, int rh,
+                      unsigned int concurrency, ParallelForFn pfor)
+{
+    static thread_local Scratch s_scratch;
+
+    const unsigned short *const origin = data + (size_t) ry * width + rx;
+
+    unsigned int nbands = 1;
+    if (pfor && concurrency > 1 && (unsigned int) rw * (unsigned int) rh >= MIN_PARALLEL_PIXELS)
+        nbands = std::min(concurrency, (unsigned int) std::max(rh / MIN_BAND_ROWS, 1));
+
+    if (s_scratch.histo.size() < nbands * HISTO_SIZE)
+        s_scratch.histo.resize(nbands * HISTO_SIZE);
+    if (s_scratch.rows.size() < (size_t) nbands * 3 * rw)
+        s_scratch.rows.resize((size_t) nbands * 3 * rw);
+
+    Band bands[64];
+    nbands = std::min(nbands, (unsigned int) (sizeof(bands) / sizeof(bands[0])));
+
+    for (unsigned int i = 0; i < nbands; i++)
+    {
+        Band& b = bands[i];
+        b.histo = &s_scratch.histo[i * HISTO_SIZE];
+        b.lo = &s_scratch.rows[(size_t) i * 3 * rw];
+        b.mid = b.lo + rw;
+        b.hi = b.mid + rw;
+    }
+
+    auto scan = [&](unsigned int i)
+    {
+        int y0 = (int) ((long long) rh * i / nbands);
+        int y1 = (int) ((long long) rh * (i + 1) / nbands);
+        ScanBand(bands[i], origin, width, rw, rh, y0, y1);
+    };
+
+    if (nbands > 1)
+        (*pfor)(nbands, scan);
+    else
+        scan(0);
+
+    // merge the band histograms into the first one
+    Band& acc = bands[0];
+    for (unsigned int i = 1; i < nbands; i++)
+    {
+        const Band& b = bands[i];
+        if (b.minADU < acc.minADU)
+        {
+            std::fill(acc.histo + b.minADU, acc.histo + acc.minADU, 0);
+            acc.minADU = b.minADU;
+        }
+        if (b.maxADU > acc.maxADU)
+        {
+            std::fill(acc.histo + acc.maxADU + 1, acc.histo + b.maxADU + 1, 0);
+            acc.maxADU = b.maxADU;
+        }
+        for (unsigned int v = b.minADU; v <= b.maxADU; v++)
+            acc.histo[v] += b.histo[v];
+        acc.filtMin = std::min(acc.filtMin, b.filtMin);
+        acc.filtMax = std::max(acc.filtMax, b.filtMax);
+    }
+
+    result->MinADU = acc.minADU;
+    result->MaxADU = acc.maxADU;
+
+    // median from the histogram
+    unsigned int pixelsLeft = (unsigned int) rw * (unsigned int) rh / 2;
+    result->MedianADU = acc.maxADU;
+    for (unsigned int i = acc.minADU; i < acc.maxADU; i++)
+    {
+        if (acc.histo[i] > pixelsLeft)
+        {
+            result->MedianADU = i;
+            break;
+        }
+        pixelsLeft -= acc.histo[i];
+    }
+
+    if (rw < 2 || rh < 2)
+    {
+        // too small to filter
+        result->FiltMin = acc.minADU;
+        result->FiltMax = acc.maxADU;
+    }
+    else
+    {
+        result->FiltMin = acc.filtMin;
+        result->FiltMax = acc.filtMax;
+    }
+}
@@ -0,0 +1,66 @@
+/*
+ *  frame_stats.h
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef FRAME_STATS_H_INCLUDED
+#define FRAME_STATS_H_INCLUDED
+
+#include <functional>
+
+// Single pass computation of the statistics usImage::CalcStats reports. The histogram, the
+// min/max and the range of the 3x3 median filtered image are accumulated together, row by row,
+// without making a copy of the image or of the filtered image. Large regions are split into
+// bands of rows that are processed concurrently.
+//
+// The results are identical to building a histogram of the region and taking the min/max of
+// Median3() applied to a copy of the region.
+
+namespace FrameStats
+{
+struct Result
+{
+    unsigned short MinADU;
+    unsigned short MaxADU;
+    unsigned short MedianADU;
+    unsigned short FiltMin;
+    unsigned short FiltMax;
+};
+
+typedef void (*ParallelForFn)(unsigned int count, const std::function<void(unsigned int)>& fn);
+
+// Compute the statistics of the rectangle (rx, ry, rw, rh) of an image of the given width.
+// pfor (may be null) is used to process up to concurrency bands at once.
+extern void Calc(Result *result, const unsigned short *data, int width, int rx, int ry, int rw, int rh,
+                 unsigned int concurrency = 1, ParallelForFn pfor = nullptr);
+}
+
+#endif // FRAME_STATS_H_INCLUDED
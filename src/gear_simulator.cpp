@@ -86,11 +86,13 @@ struct SimCamParams
     static double comet_rate_y;
     static bool allow_async_st4;
     static unsigned int frame_download_ms;
+    static unsigned int seed;
 };
 
 unsigned int SimCamParams::width = 752; // simulated camera image width
 unsigned int SimCamParams::height = 580; // simulated camera image height
 unsigned int SimCamParams::border = 12; // do not place any stars within this size border
+unsigned int SimCamParams::seed; // seed for the image noise and seeing, 0 for a new seed each time
 unsigned int SimCamParams::nr_stars; // number of stars to generate
 unsigned int SimCamParams::nr_hot_pixels; // number of hot pixels to generate
 double SimCamParams::noise_multiplier; // noise factor, increase to increase noise
@@ -146,6 +148,10 @@ unsigned int SimCamParams::frame_download_ms; // frame download time, ms
 # define COMET_RATE_X_DEFAULT 555.0 // pixels per hour
 # define COMET_RATE_Y_DEFAULT -123.4 // pixels per hour
 # define SIM_FILE_DISPLACEMENTS_DEFAULT "star_displacements.csv"
+# define WIDTH_DEFAULT 752
+# define HEIGHT_DEFAULT 580
+# define FRAME_SIZE_MIN 64
+# define FRAME_SIZE_MAX 16384
 
 // Needed to handle legacy registry values that may no longer be in correct units or range
 static double range_check(double thisval, double minval, double maxval)
@@ -189,6 +195,13 @@ static void load_sim_params()
     SimCamParams::comet_rate_y = pConfig->Profile.GetDouble("/SimCam/comet_rate_y", COMET_RATE_Y_DEFAULT);
 
     SimCamParams::frame_download_ms = pConfig->Profile.GetInt("/SimCam/frame_download_ms", 50);
+
+    // not in the setup dialog: large frames are used for load testing, and a fixed seed replays the same image noise
+    SimCamParams::width =
+        (unsigned int) range_check(pConfig->Profile.GetInt("/SimCam/width", WIDTH_DEFAULT), FRAME_SIZE_MIN, FRAME_SIZE_MAX);
+    SimCamParams::height =
+        (unsigned int) range_check(pConfig->Profile.GetInt("/SimCam/height", HEIGHT_DEFAULT), FRAME_SIZE_MIN, FRAME_SIZE_MAX);
+    SimCamParams::seed = (unsigned int) pConfig->Profile.GetInt("/SimCam/seed", 0);
 }
 
 static void save_sim_params()
@@ -549,6 +562,8 @@ struct SimCamState
     long last_exposure_time; // last exposure time, milliseconds
     Cooler cooler; // simulated cooler
     StictionSim stictionSim;
+    unsigned int seed; // random seed for the image noise and seeing
+    unsigned int frame; // frames rendered since Initialize
 
 # ifdef SIMDEBUG
     wxFFile DebugFile;
@@ -571,6 +586,17 @@ struct SimCamState
 
     void Initialize();
     void FillImage(usImage& img, const wxRect& subframe, int exptime, int gain, int offset);
+    // key of a random sequence of the current frame
+    unsigned int FrameKey(unsigned int stream) const { return SimRender::Key(seed, frame, stream); }
+};
+
+// the independent random sequences of a frame
+enum SimRandomStream
+{
+    STREAM_NOISE,
+    STREAM_SEEING,
+    STREAM_STARS,
+    STREAM_CLOUDS,
 };
 
 void SimCamState::Initialize()
@@ -612,6 +638,8 @@ void SimCamState::Initialize()
         hotpx[i].y = rand() % height;
     }
     srand(clock());
+    seed = SimCamParams::seed ? SimCamParams::seed : (unsigned int) wxGetUTCTimeMillis().GetValue();
+    frame = 0;
     ra_ofs = 0.;
     dec_ofs = BacklashVal(SimCamParams::dec_backlash);
     cum_dec_drift = 0.;
@@ -773,17 +801,6 @@ bool SimCamState::ReadNextImage(usImage& img, const wxRect& subframe)
 }
 # endif // SIMMODE == 1
 
-// get a pair of normally-distributed independent random values - Box-Muller algorithm, sigma=1
-static void rand_normal(double r[2])
-{
-    double u = (double) rand() / RAND_MAX;
-    double v = (double) rand() / RAND_MAX;
-    double const a = sqrt(-2.0 * log(u));
-    double const p = 2 * M_PI * v;
-    r[0] = a * cos(p);
-    r[1] = a * sin(p);
-}
-
 inline static unsigned short *pixel_addr(usImage& img, int x, int y)
 {
     if (x < 0 || x >= img.Size.x)
@@ -897,106 +914,16 @@ static void render_comet(usImage& img, int binning, const wxRect& subframe, cons
 
 static void render_star(usImage& img, int binning, const wxRect& subframe, const wxRealPoint& p, double inten)
 {
-    enum
-    {
-        WIDTH = 5
-    };
-    double STAR[][WIDTH] = {
-        {
-            0.0,
-            0.8,
-            2.2,
-            0.8,
-            0.0,
-        },
-        {
-            0.8,
-            16.6,
-            46.1,
-            16.6,
-            0.8,
-        },
-        {
-            2.2,
-            46.1,
-            128.0,
-            46.1,
-            2.2,
-        },
-        {
-            0.8,
-            16.6,
-            46.1,
-            16.6,
-            0.8,
-        },
-        {
-            0.0,
-            0.8,
-            2.2,
-            0.8,
-            0.0,
-        },
-    };
-
-    wxRealPoint intpart;
-    double fx = modf(p.x / (double) binning, &intpart.x);
-    double fy = modf(p.y / (double) binning, &intpart.y);
-    double f00 = (1.0 - fx) * (1.0 - fy);
-    double f01 = (1.0 - fx) * fy;
-    double f10 = fx * (1.0 - fy);
-    double f11 = fx * fy;
-
-    double d[WIDTH + 1][WIDTH + 1] = { { 0.0 } };
-    for (unsigned int i = 0; i < WIDTH; i++)
-        for (unsigned int j = 0; j < WIDTH; j++)
-        {
-            double s = STAR[i][j];
-            if (s > 0.0)
-            {
-                s *= inten / 256.0;
-                d[i][j] += f00 * s;
-                d[i + 1][j] += f10 * s;
-                d[i][j + 1] += f01 * s;
-                d[i + 1][j + 1] += f11 * s;
-            }
-        }
-
-    wxPoint c((int) intpart.x - (WIDTH - 1) / 2, (int) intpart.y - (WIDTH - 1) / 2);
-
-    for (unsigned int i = 0; i < WIDTH + 1; i++)
-    {
-        int const cx = c.x + i;
-        if (cx < subframe.GetLeft() || cx > subframe.GetRight())
-            continue;
-        for (unsigned int j = 0; j < WIDTH + 1; j++)
-        {
-            int const cy = c.y + j;
-            if (cy < subframe.GetTop() || cy > subframe.GetBottom())
-                continue;
-            int incr = (int) d[i][j];
-            if (incr > (unsigned short) -1)
-                incr = (unsigned short) -1;
-            incr_pixel(img, cx, cy, incr);
-        }
-    }
+    SimRender::AddStar(img.ImageData, img.Size.GetWidth(), img.Size.GetHeight(), subframe.GetLeft(), subframe.GetTop(),
+                       subframe.GetRight(), subframe.GetBottom(), p.x / (double) binning, p.y / (double) binning, inten);
 }
 
-static void render_clouds(usImage& img, const wxRect& subframe, int exptime, int gain, int offset)
+static void render_clouds(usImage& img, const wxRect& subframe, int exptime, int gain, int offset, unsigned int key)
 {
-    unsigned short cloud_amt;
-    unsigned short *p0 = &img.Pixel(subframe.GetLeft(), subframe.GetTop());
-    for (int r = 0; r < subframe.GetHeight(); r++, p0 += img.Size.GetWidth())
-    {
-        unsigned short *const end = p0 + subframe.GetWidth();
-        for (unsigned short *p = p0; p < end; p++)
-        {
-            // Compute a randomized brightness contribution from clouds, then overlay that on the guide frame
-            cloud_amt = (unsigned short) (SimCamParams::clouds_inten *
-                                          ((double) gain / 10.0 * offset * exptime / 100.0 + ((rand() % (gain * 100)) / 30.0)));
-            *p = (unsigned short) (SimCamParams::clouds_opacity * cloud_amt + (1 - SimCamParams::clouds_opacity) * *p);
-        }
-    }
+    // randomized brightness contribution from clouds overlaid on the guide frame
+    SimRender::BlendClouds(img.ImageData, img.Size.GetWidth(), subframe.GetLeft(), subframe.GetTop(), subframe.GetWidth(),
+                           subframe.GetHeight(), SimCamParams::clouds_inten, (double) gain / 10.0 * offset * exptime / 100.0,
+                           gain * 100, SimCamParams::clouds_opacity, key, WorkerPool::Concurrency(), &WorkerPool::ParallelFor);
 }
 
 # ifdef SIM_FILE_DISPLACEMENTS
@@ -1158,7 +1085,7 @@ void SimCamState::FillImage(usImage& img, const wxRect& subframe, int exptime, i
     // simulate seeing
     if (SimCamParams::seeing_scale > 0.0)
     {
-        rand_normal(seeing);
+        SimRender::Rng(FrameKey(STREAM_SEEING)).Normal(seeing);
         static const double seeing_adjustment = (2.345 * 1.4 * 2.4); // FWHM, geometry, empirical
         double sigma = SimCamParams::seeing_scale / (seeing_adjustment * SimCamParams::image_scale);
         seeing[0] *= sigma;
@@ -1232,11 +1159,13 @@ void SimCamState::FillImage(usImage& img, const wxRect& subframe, int exptime, i
     // render each star
     if (!pCamera->ShutterClosed)
     {
+        SimRender::Rng rng(FrameKey(STREAM_STARS));
+
         for (unsigned int i = 0; i < nr_stars; i++)
         {
             double star = stars[i].inten * exptime * gain;
             double dark = (double) gain / 10.0 * offset * exptime / 100.0;
-            double noise = (double) (rand() % (gain * 100));
+            double noise = (double) rng.Below(gain * 100);
             double inten = star + dark + noise;
 
             render_star(img, pCamera->Binning, subframe, cc[i], inten);
@@ -1253,7 +1182,7 @@ void SimCamState::FillImage(usImage& img, const wxRect& subframe, int exptime, i
             double inten = 3.0;
             double star = inten * exptime * gain;
             double dark = (double) gain / 10.0 * offset * exptime / 100.0;
-            double noise = (double) (rand() % (gain * 100));
+            double noise = (double) rng.Below(gain * 100);
             inten = star + dark + noise;
 
             render_comet(img, pCamera->Binning, subframe, wxRealPoint(cx, cy), inten);
@@ -1262,7 +1191,7 @@ void SimCamState::FillImage(usImage& img, const wxRect& subframe, int exptime, i
     }
 
     if (SimCamParams::clouds_opacity > 0)
-        render_clouds(img, subframe, exptime, gain, offset);
+        render_clouds(img, subframe, exptime, gain, offset, FrameKey(STREAM_CLOUDS));
 
     // render hot pixels
     for (unsigned int i = 0; i < hotpx.size(); i++)
@@ -1407,16 +1336,11 @@ bool CameraSimulator::Capture(int duration, usImage& img, int options, const wxR
 # endif
 
 # if SIMMODE == 3
-static void fill_noise(usImage& img, const wxRect& subframe, int exptime, int gain, int offset)
+static void fill_noise(usImage& img, const wxRect& subframe, int exptime, int gain, int offset, unsigned int key)
 {
-    unsigned short *p0 = &img.Pixel(subframe.GetLeft(), subframe.GetTop());
-    for (int r = 0; r < subframe.GetHeight(); r++, p0 += img.Size.GetWidth())
-    {
-        unsigned short *const end = p0 + subframe.GetWidth();
-        for (unsigned short *p = p0; p < end; p++)
-            *p = (unsigned short) (SimCamParams::noise_multiplier *
-                                   ((double) gain / 10.0 * offset * exptime / 100.0 + (rand() % (gain * 100))));
-    }
+    SimRender::FillNoise(img.ImageData, img.Size.GetWidth(), subframe.GetLeft(), subframe.GetTop(), subframe.GetWidth(),
+                         subframe.GetHeight(), (double) gain / 10.0 * offset * exptime / 100.0, SimCamParams::noise_multiplier,
+                         gain * 100, key, WorkerPool::Concurrency(), &WorkerPool::ParallelFor);
 }
 # endif // SIMMODE == 3
 
@@ -1474,9 +1398,10 @@ bool CameraSimulator::Capture(int duration, usImage& img, int options, const wxR
     if (usingSubframe)
         img.Clear();
 
-    fill_noise(img, subframe, exptime, gain, offset);
+    fill_noise(img, subframe, exptime, gain, offset, sim.FrameKey(STREAM_NOISE));
 
     sim.FillImage(img, subframe, exptime, gain, offset);
+    ++sim.frame;
 
     if (usingSubframe)
         img.Subframe = subframe;
@@ -72,6 +72,7 @@ static const double DefaultNoresetMaxPctPeriod =
     40.; // max percent of worm period elapsed to skip resetting the model when guiding is stopped and resumed
 
 static const bool DefaultComputePeriod = true;
+static const bool DefaultIncrementalInference = true; // update the GP decomposition instead of rebuilding it
 
 static void MakeBold(wxControl *ctrl)
 {
@@ -455,6 +456,8 @@ GuideAlgorithmGaussianProcess::GuideAlgorithmGaussianProcess(Mount *pMount, Guid
     parameters.points_for_approximation_ = DefaultNumPointsForApproximation;
     parameters.prediction_gain_ = DefaultPredictionGain;
     parameters.compute_period_ = DefaultComputePeriod;
+    parameters.incremental_inference_ =
+        pConfig->Profile.GetBoolean(GetConfigPath() + "/gp_incremental_inference", DefaultIncrementalInference);
 
     // create instance of the worker
     GPG = new GaussianProcessGuider(parameters);
@@ -38,10 +38,11 @@
  */
 
 #include "phd.h"
+#include "guide_hysteresis.h"
 
-static const double DefaultMinMove = 0.2;
-static const double DefaultHysteresis = 0.1;
-static const double DefaultAggression = 0.7;
+static const double DefaultMinMove = GuideHysteresis::DEFAULT_MIN_MOVE;
+static const double DefaultHysteresis = GuideHysteresis::DEFAULT_HYSTERESIS;
+static const double DefaultAggression = GuideHysteresis::DEFAULT_AGGRESSION;
 static const double MaxAggression = 2.0;
 static const double MaxHysteresis = 0.99;
 
@@ -74,14 +75,7 @@ void GuideAlgorithmHysteresis::reset(void)
 
 double GuideAlgorithmHysteresis::result(double input)
 {
-    double dReturn = (1.0 - m_hysteresis) * input + m_hysteresis * m_lastMove;
-
-    dReturn *= m_aggression;
-
-    if (fabs(input) < m_minMove)
-    {
-        dReturn = 0.0;
-    }
+    double dReturn = GuideHysteresis::Result(input, m_lastMove, m_minMove, m_hysteresis, m_aggression);
 
     m_lastMove = dReturn;
 
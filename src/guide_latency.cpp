@@ -0,0 +1,115 @@
+/*
+ *  guide_latency.cpp
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "phd.h"
+
+#include <chrono>
+
+static const double s_limits[GuideLatency::NUM_BUCKETS - 1] = { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000 };
+
+static wxCriticalSection s_lock;
+static GuideLatency::Histogram s_hist;
+
+double GuideLatency::BucketLimitMs(int i)
+{
+    return i < NUM_BUCKETS - 1 ? s_limits[i] : 9e99;
+}
+
+wxLongLong_t GuideLatency::Now()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void GuideLatency::Record(wxLongLong_t captureTime)
+{
+    if (!captureTime)
+        return;
+
+    double ms = (double) (Now() - captureTime) / 1000.0;
+
+    int i = 0;
+    while (i < NUM_BUCKETS - 1 && ms > s_limits[i])
+        ++i;
+
+    bool logit;
+    {
+        wxCriticalSectionLocker lck(s_lock);
+        ++s_hist.count;
+        ++s_hist.bucket[i];
+        s_hist.totalMs += ms;
+        if (ms > s_hist.maxMs)
+            s_hist.maxMs = ms;
+        logit = s_hist.count % LOG_INTERVAL == 0;
+    }
+
+    if (logit)
+        LogSummary();
+}
+
+void GuideLatency::Reset()
+{
+    wxCriticalSectionLocker lck(s_lock);
+    memset(&s_hist, 0, sizeof(s_hist));
+}
+
+GuideLatency::Histogram GuideLatency::Get()
+{
+    wxCriticalSectionLocker lck(s_lock);
+    return s_hist;
+}
+
+wxString GuideLatency::Summary()
+{
+    Histogram h = Get();
+
+    if (!h.count)
+        return "no samples";
+
+    wxString s = wxString::Format("n=%u avg=%.1fms max=%.1fms", h.count, h.totalMs / h.count, h.maxMs);
+    for (int i = 0; i < NUM_BUCKETS; i++)
+    {
+        if (!h.bucket[i])
+            continue;
+        if (i < NUM_BUCKETS - 1)
+            s += wxString::Format(" <=%g:%u", s_limits[i], h.bucket[i]);
+        else
+            s += wxString::Format(" >%g:%u", s_limits[NUM_BUCKETS - 2], h.bucket[i]);
+    }
+    return s;
+}
+
+void GuideLatency::LogSummary()
+{
+    Debug.Write("Capture to pulse latency: " + Summary() + "\n");
+}
@@ -0,0 +1,75 @@
+/*
+ *  guide_latency.h
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef GUIDE_LATENCY_H_INCLUDED
+#define GUIDE_LATENCY_H_INCLUDED
+
+// Histogram of the time from the completion of a camera capture until the guide move computed
+// from that frame has been issued to the mount. Samples are recorded on the worker threads, the
+// summary is written to the debug log every LOG_INTERVAL samples and when guiding stops, and the
+// histogram is available to clients through the get_guide_latency event server method.
+class GuideLatency
+{
+public:
+    enum
+    {
+        NUM_BUCKETS = 12,
+        LOG_INTERVAL = 100,
+    };
+
+    struct Histogram
+    {
+        unsigned int count;
+        unsigned int bucket[NUM_BUCKETS]; // see BucketLimitMs
+        double totalMs;
+        double maxMs;
+    };
+
+    // upper limit of histogram bucket i in milliseconds, the last bucket is unbounded
+    static double BucketLimitMs(int i);
+
+    // monotonic clock used for frame timestamps, in microseconds from an arbitrary origin
+    static wxLongLong_t Now();
+
+    // record a move issued for a frame whose capture completed at captureTime (as returned by
+    // Now()); a captureTime of 0 is ignored
+    static void Record(wxLongLong_t captureTime);
+
+    static void Reset();
+    static Histogram Get();
+    static wxString Summary();
+    static void LogSummary();
+};
+
+#endif // GUIDE_LATENCY_H_INCLUDED
@@ -0,0 +1,91 @@
+/*
+ *  guide_thread.cpp
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "phd.h"
+
+GuideFrameEvent::GuideFrameEvent(usImage *image_, FrameMeasurement *measurement_)
+    : wxThreadEvent(wxEVT_THREAD, MYFRAME_GUIDE_FRAME_COMPLETE), image(image_), measurement(measurement_)
+{
+}
+
+// frees the frame if the event was never handled, for example when it was still pending at shutdown
+GuideFrameEvent::~GuideFrameEvent()
+{
+    delete image;
+    delete measurement;
+}
+
+GuideThread::GuideThread(MyFrame *frame) : wxThread(wxTHREAD_JOINABLE), m_pFrame(frame) { }
+
+GuideThread::~GuideThread() { }
+
+void GuideThread::EnqueueFrame(usImage *image, FrameMeasurement *measurement)
+{
+    GuideFrame frame = { image, measurement };
+    m_queue.Post(frame);
+}
+
+void GuideThread::EnqueueTerminateRequest()
+{
+    GuideFrame frame = { nullptr, nullptr };
+    m_queue.Post(frame);
+}
+
+wxThread::ExitCode GuideThread::Entry()
+{
+    Debug.Write("GuideThread::Entry() begins\n");
+
+    while (true)
+    {
+        GuideFrame frame;
+        if (m_queue.Receive(frame) != wxMSGQUEUE_NO_ERROR || !frame.image)
+            break;
+
+        // the measurement is complete before the event is queued and only read on the main thread
+        frame.measurement->Measure(frame.image);
+        wxQueueEvent(m_pFrame, new GuideFrameEvent(frame.image, frame.measurement));
+    }
+
+    // free any frames that were queued behind the terminate request
+    GuideFrame frame;
+    while (m_queue.ReceiveTimeout(0, frame) == wxMSGQUEUE_NO_ERROR)
+    {
+        delete frame.image;
+        delete frame.measurement;
+    }
+
+    Debug.Write("GuideThread::Entry() ends\n");
+
+    return nullptr;
+}
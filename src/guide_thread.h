@@ -0,0 +1,76 @@
+/*
+ *  guide_thread.h
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef GUIDE_THREAD_H_INCLUDED
+#define GUIDE_THREAD_H_INCLUDED
+
+// sent to the main thread with each frame measured by the guide thread. The event owns the
+// frame and its measurement until the handler takes them
+struct GuideFrameEvent : public wxThreadEvent
+{
+    usImage *image;
+    FrameMeasurement *measurement;
+
+    GuideFrameEvent(usImage *image, FrameMeasurement *measurement);
+    ~GuideFrameEvent();
+};
+
+// The guide thread takes each frame from the worker thread as soon as it has been captured and
+// measures the guide stars (FrameMeasurement::Measure), then passes the frame and the measurement
+// to the main thread. Everything else, including scheduling the guide move, is left to the main
+// thread, which does not schedule the next exposure until it has handled the frame, so there is
+// at most one frame in the pipeline.
+class GuideThread : public wxThread
+{
+    struct GuideFrame
+    {
+        usImage *image; // null to terminate
+        FrameMeasurement *measurement;
+    };
+
+    MyFrame *m_pFrame;
+    wxMessageQueue<GuideFrame> m_queue;
+
+public:
+    GuideThread(MyFrame *frame);
+    ~GuideThread();
+
+    void EnqueueFrame(usImage *image, FrameMeasurement *measurement);
+    void EnqueueTerminateRequest();
+
+protected:
+    ExitCode Entry() override;
+};
+
+#endif // GUIDE_THREAD_H_INCLUDED
@@ -168,6 +168,7 @@ Guider::Guider(wxWindow *parent, int xSize, int ySize)
     m_scaleFactor = 1.0;
     m_showBookmarks = true;
     m_displayedImage = new wxImage(XWinSize, YWinSize, true);
+    m_displayStale = true;
     m_paused = PAUSE_NONE;
     m_starFoundTimestamp = 0;
     m_avgDistanceNeedReset = false;
@@ -246,6 +247,7 @@ void Guider::LoadProfileSettings()
     {
         delete m_displayedImage;
         m_displayedImage = new wxImage(XWinSize, YWinSize, true);
+        m_displayStale = true;
         DisplayImage(new usImage());
     }
 }
@@ -449,15 +451,12 @@ bool Guider::PaintHelper(wxAutoBufferedPaintDCBase& dc, wxMemoryDC& memDC)
         GUIDER_STATE state = GetState();
         GetSize(&XWinSize, &YWinSize);
 
-        if (m_pCurrentImage->ImageData)
-        {
-            int blevel = m_pCurrentImage->FiltMin;
-            int wlevel = m_pCurrentImage->FiltMax;
-            m_pCurrentImage->CopyToImage(&m_displayedImage, blevel, wlevel, pFrame->Stretch_gamma);
-        }
+        bool haveImage = m_pCurrentImage->ImageData != nullptr;
 
-        int imageWidth = m_displayedImage->GetWidth();
-        int imageHeight = m_displayedImage->GetHeight();
+        int imageWidth = haveImage ? m_pCurrentImage->Size.GetWidth() : m_displayedImage->GetWidth();
+        int imageHeight = haveImage ? m_pCurrentImage->Size.GetHeight() : m_displayedImage->GetHeight();
+        int newWidth = imageWidth;
+        int newHeight = imageHeight;
 
         // scale the image if necessary
 
@@ -466,8 +465,6 @@ bool Guider::PaintHelper(wxAutoBufferedPaintDCBase& dc, wxMemoryDC& memDC)
             // The image is not the exact right size -- figure out what to do.
             double xScaleFactor = imageWidth / (double) XWinSize;
             double yScaleFactor = imageHeight / (double) YWinSize;
-            int newWidth = imageWidth;
-            int newHeight = imageHeight;
 
             double newScaleFactor = (xScaleFactor > yScaleFactor) ? xScaleFactor : yScaleFactor;
 
@@ -491,14 +488,10 @@ bool Guider::PaintHelper(wxAutoBufferedPaintDCBase& dc, wxMemoryDC& memDC)
 
                 m_scaleFactor = newScaleFactor;
 
-                if (imageWidth != newWidth || imageHeight != newHeight)
+                if (newWidth <= 0 || newHeight <= 0)
                 {
-                    //                    Debug.Write(wxString::Format("Resizing image to %d,%d\n", newWidth, newHeight));
-
-                    if (newWidth > 0 && newHeight > 0)
-                    {
-                        m_displayedImage->Rescale(newWidth, newHeight, wxIMAGE_QUALITY_BILINEAR);
-                    }
+                    newWidth = imageWidth;
+                    newHeight = imageHeight;
                 }
             }
             else
@@ -507,13 +500,42 @@ bool Guider::PaintHelper(wxAutoBufferedPaintDCBase& dc, wxMemoryDC& memDC)
             }
         }
 
-        // important to provide explicit color for r,g,b, optional args to Size().
-        // If default args are provided wxWidgets performs some expensive histogram
-        // operations.
-        wxBitmap DisplayedBitmap(m_displayedImage->Size(wxSize(XWinSize, YWinSize), wxPoint(0, 0), 0, 0, 0));
-        memDC.SelectObject(DisplayedBitmap);
+        // The stretched image only needs to be rendered again when the image, the stretch or the
+        // window size changes; repaints for overlay updates reuse the bitmap.
+
+        DisplayParams params;
+        params.blevel = haveImage ? m_pCurrentImage->FiltMin : 0;
+        params.wlevel = haveImage ? m_pCurrentImage->FiltMax : 0;
+        params.gamma = pFrame->Stretch_gamma;
+        params.imageSize = wxSize(newWidth, newHeight);
+        params.winSize = wxSize(XWinSize, YWinSize);
+
+        if (m_displayStale || params != m_displayParams || !m_displayedBitmap.IsOk())
+        {
+            if (haveImage)
+            {
+                // resample before stretching so that only the displayed pixels are stretched
+                m_pCurrentImage->CopyToImage(&m_displayedImage, params.imageSize, m_displayStretch, params.blevel,
+                                             params.wlevel, params.gamma);
+            }
+            else if (m_displayedImage->GetWidth() != newWidth || m_displayedImage->GetHeight() != newHeight)
+            {
+                m_displayedImage->Rescale(newWidth, newHeight, wxIMAGE_QUALITY_BILINEAR);
+            }
+
+            // important to provide explicit color for r,g,b, optional args to Size().
+            // If default args are provided wxWidgets performs some expensive histogram
+            // operations.
+            m_displayedBitmap = wxBitmap(m_displayedImage->Size(wxSize(XWinSize, YWinSize), wxPoint(0, 0), 0, 0, 0));
+            m_displayParams = params;
+            m_displayStale = false;
+        }
+
+        memDC.SelectObject(m_displayedBitmap);
 
-        dc.Blit(0, 0, DisplayedBitmap.GetWidth(), DisplayedBitmap.GetHeight(), &memDC, 0, 0, wxCOPY, false);
+        dc.Blit(0, 0, m_displayedBitmap.GetWidth(), m_displayedBitmap.GetHeight(), &memDC, 0, 0, wxCOPY, false);
+
+        memDC.SelectObject(wxNullBitmap);
 
         int XImgSize = m_displayedImage->GetWidth();
         int YImgSize = m_displayedImage->GetHeight();
@@ -744,6 +766,8 @@ void Guider::UpdateImageDisplay(usImage *pImage)
                          pImage->Size.x, pImage->Size.y, pImage->MinADU, pImage->MaxADU, pImage->MedianADU, pImage->FiltMin,
                          pImage->FiltMax, pFrame->Stretch_gamma));
 
+    m_displayStale = true;
+
     Refresh();
     Update();
 }
@@ -1232,6 +1256,7 @@ void Guider::DisplayImage(usImage *img)
     // switch in the new image
     usImage *prev = m_pCurrentImage;
     m_pCurrentImage = img;
+    m_displayStale = true;
 
     ImageLogger::SaveImage(prev);
 
@@ -1261,10 +1286,35 @@ inline static bool IsLoopingState(GUIDER_STATE state)
 
 /*************  A new image is ready ************************/
 
-void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
+// Normally runs on the guide thread
+void FrameMeasurement::Measure(const usImage *pImage)
+{
+    if (!prepared)
+        return;
+
+    primary = primaryIn;
+    primaryFound = primary.Find(pImage, params.searchRegion, params.mode, params.minHFD, params.maxHFD, params.satADU,
+                                Star::FIND_LOGGING_VERBOSE);
+    FindStars(pImage, params, &secondaries);
+}
+
+// Find each star from its search position, spreading the work over the worker pool
+void FrameMeasurement::FindStars(const usImage *pImage, const FindParams& p, std::vector<StarFind> *finds)
+{
+    WorkerPool::ParallelFor(finds->size(),
+                            [&](unsigned int i)
+                            {
+                                StarFind& f = (*finds)[i];
+                                f.found = f.star.Find(pImage, p.searchRegion, f.searchPos.X, f.searchPos.Y, p.mode, p.minHFD,
+                                                      p.maxHFD, p.satADU, Star::FIND_LOGGING_MINIMAL);
+                            });
+}
+
+void Guider::UpdateGuideState(usImage *pImage, bool bStopping, const FrameMeasurement *measurement)
 {
     wxString statusMessage;
     bool someException = false;
+    bool const newImage = pImage != nullptr;
 
     try
     {
@@ -1276,6 +1326,7 @@ void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
 
             usImage *pPrevImage = m_pCurrentImage;
             m_pCurrentImage = pImage;
+            m_displayStale = true;
 
             ImageLogger::SaveImage(pPrevImage);
         }
@@ -1311,7 +1362,7 @@ void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
         GuiderOffset ofs;
         FrameDroppedInfo info;
 
-        if (UpdateCurrentPosition(pImage, &ofs, &info)) // true means error
+        if (UpdateCurrentPosition(pImage, measurement, &ofs, &info)) // true means error
         {
             info.frameNumber = pImage->FrameNum;
             info.time = pFrame->TimeSinceGuidingStarted();
@@ -1349,7 +1400,7 @@ void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
 
                 // allow guide algorithms to attempt dead reckoning
                 static GuiderOffset ZERO_OFS;
-                pFrame->SchedulePrimaryMove(pMount, ZERO_OFS, MOVEOPTS_DEDUCED_MOVE);
+                pFrame->SchedulePrimaryMove(pMount, ZERO_OFS, MOVEOPTS_DEDUCED_MOVE, pImage->CaptureCompleteTime);
 
                 wxColor prevColor = GetBackgroundColour();
                 SetBackgroundColour(wxColour(64, 0, 0));
@@ -1388,7 +1439,7 @@ void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
             {
                 // allow guide algorithms to attempt dead reckoning
                 static GuiderOffset ZERO_OFS;
-                pFrame->SchedulePrimaryMove(pMount, ZERO_OFS, MOVEOPTS_DEDUCED_MOVE);
+                pFrame->SchedulePrimaryMove(pMount, ZERO_OFS, MOVEOPTS_DEDUCED_MOVE, pImage->CaptureCompleteTime);
             }
 
             statusMessage = _("Paused") + (GetPauseType() == PAUSE_FULL ? _("/full") : _("/looping"));
@@ -1509,7 +1560,7 @@ void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
 
                 ofs.mountOfs.SetXY(step.X * m_ditherRecenterDir.x, step.Y * m_ditherRecenterDir.y);
                 pMount->TransformMountCoordinatesToCameraCoordinates(ofs.mountOfs, ofs.cameraOfs);
-                pFrame->SchedulePrimaryMove(pMount, ofs, MOVEOPTS_RECOVERY_MOVE);
+                pFrame->SchedulePrimaryMove(pMount, ofs, MOVEOPTS_RECOVERY_MOVE, pImage->CaptureCompleteTime);
                 // let guide algorithms know about the direct move
                 pMount->NotifyDirectMove(ofs.mountOfs);
             }
@@ -1521,7 +1572,7 @@ void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
             {
                 // ordinary guide step
                 s_deflectionLogger.Log(CurrentPosition());
-                pFrame->SchedulePrimaryMove(pMount, ofs, MOVEOPTS_GUIDE_STEP);
+                pFrame->SchedulePrimaryMove(pMount, ofs, MOVEOPTS_GUIDE_STEP, pImage->CaptureCompleteTime);
             }
             break;
 
@@ -1550,6 +1601,9 @@ void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
 
     pFrame->UpdateButtonsStatus();
 
+    if (newImage)
+        EvtServer.NotifyNewFrame(pImage, m_state >= STATE_SELECTED ? CurrentPosition() : PHD_Point());
+
     UpdateImageDisplay(pImage);
 
     Debug.AddLine("UpdateGuideState exits: " + statusMessage);
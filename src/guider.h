@@ -134,9 +134,75 @@ struct GuiderOffset
     PHD_Point mountOfs;
 };
 
+// Guide star measurements for one frame. The inputs are captured on the main thread when the
+// exposure is scheduled (Guider::PrepareFrameMeasurement) and Measure finds the stars on the guide
+// thread as soon as the frame has been captured. The measurement travels with the frame to the main
+// thread, which only uses it if the guide stars and settings have not changed in the meantime.
+struct FrameMeasurement
+{
+    // settings that determine the outcome of Star::Find
+    struct FindParams
+    {
+        int searchRegion;
+        Star::FindMode mode;
+        double minHFD;
+        double maxHFD;
+        unsigned short satADU;
+
+        bool operator==(const FindParams& rhs) const
+        {
+            return searchRegion == rhs.searchRegion && mode == rhs.mode && minHFD == rhs.minHFD && maxHFD == rhs.maxHFD &&
+                satADU == rhs.satADU;
+        }
+    };
+
+    // search for a star starting from searchPos
+    struct StarFind
+    {
+        Star star;
+        PHD_Point searchPos;
+        bool found;
+    };
+
+    bool prepared; // there is a primary star to look for
+    FindParams params;
+    Star primaryIn;
+    Star primary;
+    bool primaryFound;
+    std::vector<Star> secondaryIn;
+    std::vector<StarFind> secondaries;
+
+    FrameMeasurement() : prepared(false), primaryFound(false) { }
+
+    // does not touch any guider state, so it can be called on any thread
+    void Measure(const usImage *pImage);
+    static void FindStars(const usImage *pImage, const FindParams& params, std::vector<StarFind> *finds);
+};
+
 class Guider : public wxWindow
 {
+    // the parameters m_displayedBitmap was rendered with
+    struct DisplayParams
+    {
+        int blevel;
+        int wlevel;
+        double gamma;
+        wxSize imageSize; // size of the stretched image
+        wxSize winSize;
+
+        bool operator==(const DisplayParams& rhs) const
+        {
+            return blevel == rhs.blevel && wlevel == rhs.wlevel && gamma == rhs.gamma && imageSize == rhs.imageSize &&
+                winSize == rhs.winSize;
+        }
+        bool operator!=(const DisplayParams& rhs) const { return !(*this == rhs); }
+    };
+
     wxImage *m_displayedImage;
+    wxBitmap m_displayedBitmap; // m_displayedImage padded to the window size, without overlays
+    DisplayStretch m_displayStretch;
+    DisplayParams m_displayParams;
+    bool m_displayStale; // the current image changed since m_displayedBitmap was rendered
     OVERLAY_MODE m_overlayMode;
     OverlaySlitCoords m_overlaySlitCoords;
     const DefectMap *m_defectMapPreview;
@@ -246,7 +312,7 @@ public:
 
     void StartGuiding();
     void StopGuiding();
-    void UpdateGuideState(usImage *pImage, bool bStopping = false);
+    void UpdateGuideState(usImage *pImage, bool bStopping = false, const FrameMeasurement *measurement = nullptr);
     void DisplayImage(usImage *img);
 
     bool SetScaleImage(bool newScaleValue);
@@ -289,6 +355,9 @@ private:
 public:
     virtual void LoadProfileSettings();
 
+    // called when an exposure is scheduled to capture what is needed to measure the frame
+    virtual void PrepareFrameMeasurement(FrameMeasurement *measurement) const { }
+
     // pure virtual functions -- these MUST be overridden by a subclass
 public:
     virtual bool IsValidLockPosition(const PHD_Point& pt) = 0;
@@ -296,7 +365,8 @@ public:
     virtual void InvalidateCurrentPosition(bool fullReset = false) = 0;
 
 private:
-    virtual bool UpdateCurrentPosition(const usImage *pImage, GuiderOffset *ofs, FrameDroppedInfo *errorInfo) = 0;
+    virtual bool UpdateCurrentPosition(const usImage *pImage, const FrameMeasurement *measurement, GuiderOffset *ofs,
+                                       FrameDroppedInfo *errorInfo) = 0;
     virtual bool SetCurrentPosition(const usImage *pImage, const PHD_Point& position) = 0;
 
 public:
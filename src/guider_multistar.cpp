@@ -41,6 +41,7 @@
  */
 
 #include "phd.h"
+#include "secondary_stars.h"
 
 #include <wx/dir.h>
 #include <algorithm>
@@ -714,14 +715,96 @@ static void AppendStarUse(wxString& secondaryInfo, int starNum, double dX, doubl
     secondaryInfo += wxString::Format("[#%d %0.2f,%0.2f,%0.2f,%s] ", starNum, dX, dY, weight, flag);
 }
 
+FrameMeasurement::FindParams GuiderMultiStar::GetFindParams() const
+{
+    FrameMeasurement::FindParams params;
+    params.searchRegion = m_searchRegion;
+    params.mode = pFrame->GetStarFindMode();
+    params.minHFD = GetMinStarHFD();
+    params.maxHFD = GetMaxStarHFD();
+    params.satADU = pCamera->GetSaturationADU();
+    return params;
+}
+
+// Set up the search for up to count secondary stars starting at guide star list index first, in list order
+void GuiderMultiStar::InitSecondaryStarFinds(size_t first, size_t count, std::vector<FrameMeasurement::StarFind> *finds) const
+{
+    size_t end = std::min(m_guideStars.size(), first + count);
+    finds->resize(end > first ? end - first : 0);
+
+    for (size_t i = first; i < end; i++)
+    {
+        const GuideStar& gs = m_guideStars[i];
+        FrameMeasurement::StarFind& f = (*finds)[i - first];
+        f.star = gs;
+        double x, y;
+        SecondaryStars::SearchPos(&x, &y, gs.wasLost, gs.X, gs.Y, m_primaryStar.X, m_primaryStar.Y, gs.offsetFromPrimary.X,
+                                  gs.offsetFromPrimary.Y);
+        f.searchPos.SetXY(x, y);
+        f.found = false;
+    }
+}
+
+// true if Star::Find would give the same result starting from either star
+static bool SameFindInput(const Star& a, const Star& b)
+{
+    return a.IsValid() == b.IsValid() && a.X == b.X && a.Y == b.Y && a.Mass == b.Mass && a.SNR == b.SNR && a.HFD == b.HFD &&
+        a.PeakVal == b.PeakVal && a.GetError() == b.GetError();
+}
+
+// Capture the inputs for measuring the next frame. This is called after the previous frame has
+// been processed, so the guide stars are where UpdateCurrentPosition will start looking for them
+void GuiderMultiStar::PrepareFrameMeasurement(FrameMeasurement *m) const
+{
+    m->prepared = m_primaryStar.IsValid() || m_primaryStar.X != 0.0 || m_primaryStar.Y != 0.0;
+    if (!m->prepared)
+        return;
+
+    m->params = GetFindParams();
+    m->primaryIn = m_primaryStar;
+
+    // RefineOffset only measures the secondary stars while guiding, and starts with as many as it can use
+    if (m_multiStarMode && m_guideStars.size() > 1 && m_maxStars > 1 && IsGuiding() && !m_stabilizing)
+    {
+        InitSecondaryStarFinds(1, m_maxStars - 1, &m->secondaries);
+        for (const FrameMeasurement::StarFind& f : m->secondaries)
+            m->secondaryIn.push_back(f.star);
+    }
+}
+
+// Measure up to count secondary stars starting at guide star list index first. The guide star list
+// is not modified; results are returned in list order for RefineOffset to merge
+void GuiderMultiStar::MeasureSecondaryStars(const usImage *pImage, const FrameMeasurement *measurement, size_t first,
+                                            size_t count, std::vector<FrameMeasurement::StarFind> *finds) const
+{
+    InitSecondaryStarFinds(first, count, finds);
+
+    // use the frame measurement if it started from the same place
+    const FrameMeasurement& m = *measurement;
+    if (first == 1 && m.secondaries.size() == finds->size())
+    {
+        bool same = true;
+        for (size_t i = 0; same && i < finds->size(); i++)
+        {
+            const PHD_Point& pos = (*finds)[i].searchPos;
+            same = SameFindInput(m.secondaryIn[i], (*finds)[i].star) && m.secondaries[i].searchPos.X == pos.X &&
+                m.secondaries[i].searchPos.Y == pos.Y;
+        }
+        if (same)
+        {
+            *finds = m.secondaries;
+            return;
+        }
+    }
+
+    FrameMeasurement::FindStars(pImage, m.params, finds);
+}
+
 // Use secondary stars to refine Offset value if appropriate.  Return of true means offset has been adjusted
-bool GuiderMultiStar::RefineOffset(const usImage *pImage, GuiderOffset *pOffset)
+bool GuiderMultiStar::RefineOffset(const usImage *pImage, const FrameMeasurement *measurement, GuiderOffset *pOffset)
 {
     double primaryDistance;
-    double secondaryDistance;
     double primarySigma = 0;
-    bool averaged = false;
-    int validStars = 0;
     GuiderOffset origOffset = *pOffset;
     m_starsUsed = 1;
     bool erasures = false;
@@ -732,7 +815,6 @@ bool GuiderMultiStar::RefineOffset(const usImage *pImage, GuiderOffset *pOffset)
     {
         if (IsGuiding() && m_guideStars.size() > 1 && pMount->GetGuidingEnabled() && !PhdController::IsSettling())
         {
-            double sumWeights = 1;
             double sumX = origOffset.cameraOfs.X;
             double sumY = origOffset.cameraOfs.Y;
             primaryDistance = hypot(sumX, sumY);
@@ -741,79 +823,80 @@ bool GuiderMultiStar::RefineOffset(const usImage *pImage, GuiderOffset *pOffset)
 
 #define Iter_Inx(p) (p - m_guideStars.begin())
 
-            if (m_primaryDistStats->GetCount() > 5)
-            {
+            unsigned int distCount = m_primaryDistStats->GetCount();
+            if (distCount > 5)
                 primarySigma = m_primaryDistStats->GetSigma();
-                if (!m_stabilizing && primaryDistance > m_stabilitySigmaX * primarySigma)
-                {
-                    m_stabilizing = true;
-                    Debug.Write("MultiStar: large primary error, entering stabilization period\n");
-                }
-                else if (m_stabilizing)
+
+            switch (SecondaryStars::UpdateStabilizing(&m_stabilizing, primaryDistance, distCount, primarySigma,
+                                                      m_stabilitySigmaX))
+            {
+            case SecondaryStars::STABILIZING_STARTED:
+                Debug.Write("MultiStar: large primary error, entering stabilization period\n");
+                break;
+            case SecondaryStars::STABILIZING_ENDED:
+                Debug.Write("MultiStar: exiting stabilization period\n");
+                if (m_lockPositionMoved)
                 {
-                    if (primaryDistance <= 2 * primarySigma)
+                    m_lockPositionMoved = false;
+                    Debug.Write("MultiStar: updating star positions after lock position change\n");
+                    for (auto pGS = m_guideStars.begin() + 1; pGS != m_guideStars.end();)
                     {
-                        m_stabilizing = false;
-                        Debug.Write("MultiStar: exiting stabilization period\n");
-                        if (m_lockPositionMoved)
+                        PHD_Point expectedLoc = m_primaryStar + pGS->offsetFromPrimary;
+                        bool found;
+                        if (IsValidSecondaryStarPosition(expectedLoc))
+                            found = pGS->Find(pImage, m_searchRegion, expectedLoc.X, expectedLoc.Y, pFrame->GetStarFindMode(),
+                                              GetMinStarHFD(), GetMaxStarHFD(), pCamera->GetSaturationADU(),
+                                              Star::FIND_LOGGING_VERBOSE);
+                        else
+                            found = pGS->Find(pImage, m_searchRegion, pGS->X, pGS->Y, pFrame->GetStarFindMode(),
+                                              GetMinStarHFD(), GetMaxStarHFD(), pCamera->GetSaturationADU(),
+                                              Star::FIND_LOGGING_VERBOSE);
+                        if (found)
                         {
-                            m_lockPositionMoved = false;
-                            Debug.Write("MultiStar: updating star positions after lock position change\n");
-                            for (auto pGS = m_guideStars.begin() + 1; pGS != m_guideStars.end();)
-                            {
-                                PHD_Point expectedLoc = m_primaryStar + pGS->offsetFromPrimary;
-                                bool found;
-                                if (IsValidSecondaryStarPosition(expectedLoc))
-                                    found = pGS->Find(pImage, m_searchRegion, expectedLoc.X, expectedLoc.Y,
-                                                      pFrame->GetStarFindMode(), GetMinStarHFD(), GetMaxStarHFD(),
-                                                      pCamera->GetSaturationADU(), Star::FIND_LOGGING_VERBOSE);
-                                else
-                                    found = pGS->Find(pImage, m_searchRegion, pGS->X, pGS->Y, pFrame->GetStarFindMode(),
-                                                      GetMinStarHFD(), GetMaxStarHFD(), pCamera->GetSaturationADU(),
-                                                      Star::FIND_LOGGING_VERBOSE);
-                                if (found)
-                                {
-                                    pGS->referencePoint.X = pGS->X;
-                                    pGS->referencePoint.Y = pGS->Y;
-                                    pGS->wasLost = false;
-                                    ++pGS;
-                                }
-                                else
-                                {
-                                    // Don't need to update reference point, lost star will continue to use the
-                                    // offsetFromPrimary location for possible recovery
-                                    pGS->wasLost = true;
-                                    ++pGS;
-                                }
-                            }
-                            return false; // All the secondary stars reference points reflect current positions
+                            pGS->referencePoint.X = pGS->X;
+                            pGS->referencePoint.Y = pGS->Y;
+                            pGS->wasLost = false;
+                            ++pGS;
+                        }
+                        else
+                        {
+                            // Don't need to update reference point, lost star will continue to use the
+                            // offsetFromPrimary location for possible recovery
+                            pGS->wasLost = true;
+                            ++pGS;
                         }
                     }
+                    return false; // All the secondary stars reference points reflect current positions
                 }
+                break;
+            default:
+                break;
             }
-            else
-                m_stabilizing = true; // get some data for primary star movement
 
             if (!m_stabilizing && m_guideStars.size() > 1 && (sumX != 0 || sumY != 0))
             {
+                std::vector<FrameMeasurement::StarFind> finds;
+                auto pFind = finds.end();
+
+                SecondaryStars::WeightedOffset avg(sumX, sumY);
+
                 wxString secondaryInfo = "MultiStar: ";
                 for (auto pGS = m_guideStars.begin() + 1; pGS != m_guideStars.end();)
                 {
                     if (m_starsUsed >= m_maxStars || m_guideStars.size() == 1)
                         break;
-                    bool found = false;
-                    if (pGS->wasLost)
+                    // Measure the stars in batches of as many as can still be used. Lost stars don't
+                    // count toward m_maxStars, so a batch can run out before the limit is reached.
+                    if (pFind == finds.end())
                     {
-                        // Look for it based on its original offset from the primary star
-                        PHD_Point expectedLoc = m_primaryStar + pGS->offsetFromPrimary;
-                        found = pGS->Find(pImage, m_searchRegion, expectedLoc.X, expectedLoc.Y, pFrame->GetStarFindMode(),
-                                          GetMinStarHFD(), GetMaxStarHFD(), pCamera->GetSaturationADU(),
-                                          Star::FIND_LOGGING_MINIMAL);
+                        MeasureSecondaryStars(pImage, measurement, Iter_Inx(pGS), m_maxStars - m_starsUsed, &finds);
+                        pFind = finds.begin();
                     }
-                    else
-                        // Look for it where we last found it
-                        found = pGS->Find(pImage, m_searchRegion, pGS->X, pGS->Y, pFrame->GetStarFindMode(), GetMinStarHFD(),
-                                          GetMaxStarHFD(), pCamera->GetSaturationADU(), Star::FIND_LOGGING_MINIMAL);
+                    // Measurements were made in list order, so the next one belongs to this star.
+                    // Only stars that are visited here take on their new measurement.
+                    static_cast<Star&>(*pGS) = pFind->star;
+                    bool found = pFind->found;
+                    ++pFind;
                     if (found)
                     {
                         double dX = pGS->X - pGS->referencePoint.X;
@@ -822,60 +905,30 @@ bool GuiderMultiStar::RefineOffset(const usImage *pImage, GuiderOffset *pOffset)
                         pGS->wasLost = false;
                         m_starsUsed++;
 
-                        if (dX != 0. || dY != 0.)
-                        {
-                            // Handle zero-counting - suspect results of exactly zero movement
-                            if (dX == 0. || dY == 0.)
-                                ++pGS->zeroCount;
-                            else if (pGS->zeroCount > 0)
-                                --pGS->zeroCount;
-
-                            if (pGS->zeroCount == 5)
-                            {
-                                AppendStarUse(secondaryInfo, Iter_Inx(pGS), 0, 0, 0, "DZ");
-                                pGS = m_guideStars.erase(pGS);
-                                erasures = true;
-                                continue;
-                            }
-
-                            // Handle suspicious excursions - counted as "misses"
-                            secondaryDistance = hypot(dX, dY);
-                            if (secondaryDistance > 2.5 * primarySigma)
-                            {
-                                if (++pGS->missCount > 10)
-                                {
-                                    // Reset the reference point to wherever it is now
-                                    pGS->referencePoint.X = pGS->X;
-                                    pGS->referencePoint.Y = pGS->Y;
-                                    pGS->missCount = 0;
-                                    AppendStarUse(secondaryInfo, Iter_Inx(pGS), dX, dY, 0, "R");
-                                }
-                                else
-                                    AppendStarUse(secondaryInfo, Iter_Inx(pGS), dX, dY, 0,
-                                                  "M" + std::to_string(pGS->missCount));
-                                ++pGS;
-                                continue;
-                            }
-                            else if (pGS->missCount > 0)
-                            {
-                                --pGS->missCount;
-                            }
-
-                            // At this point we have usable data from the secondary star
-                            double wt = (pGS->SNR / m_primaryStar.SNR);
-                            sumX += wt * dX;
-                            sumY += wt * dY;
-                            sumWeights += wt;
-                            averaged = true;
-                            validStars++;
-
-                            AppendStarUse(secondaryInfo, Iter_Inx(pGS), dX, dY, wt, "U");
-                        }
-                        else // exactly zero on both axes, probably a hot pixel, drop it
+                        switch (SecondaryStars::Classify(dX, dY, primarySigma, &pGS->zeroCount, &pGS->missCount))
                         {
+                        case SecondaryStars::DROP:
+                            // exactly zero movement too often, probably a hot pixel
                             AppendStarUse(secondaryInfo, Iter_Inx(pGS), 0, 0, 0, "DZ");
                             pGS = m_guideStars.erase(pGS);
                             erasures = true;
+                            break;
+                        case SecondaryStars::RESET:
+                            // Reset the reference point to wherever it is now
+                            pGS->referencePoint.X = pGS->X;
+                            pGS->referencePoint.Y = pGS->Y;
+                            AppendStarUse(secondaryInfo, Iter_Inx(pGS), dX, dY, 0, "R");
+                            break;
+                        case SecondaryStars::MISS:
+                            AppendStarUse(secondaryInfo, Iter_Inx(pGS), dX, dY, 0, "M" + std::to_string(pGS->missCount));
+                            break;
+                        case SecondaryStars::USE:
+                        {
+                            // At this point we have usable data from the secondary star
+                            double wt = avg.Add(dX, dY, pGS->SNR, m_primaryStar.SNR);
+                            AppendStarUse(secondaryInfo, Iter_Inx(pGS), dX, dY, wt, "U");
+                            break;
+                        }
                         }
                     }
                     else
@@ -891,18 +944,16 @@ bool GuiderMultiStar::RefineOffset(const usImage *pImage, GuiderOffset *pOffset)
                 } // End of looping through secondary stars
                 Debug.Write(secondaryInfo + "\n");
 
-                if (averaged)
+                if (avg.Count() > 0)
                 {
-                    sumX = sumX / sumWeights;
-                    sumY = sumY / sumWeights;
-                    if (hypot(sumX, sumY) < primaryDistance) // Apply average only if its smaller than single-star delta
+                    if (avg.Refines()) // Apply average only if its smaller than single-star delta
                     {
-                        pOffset->cameraOfs.X = sumX;
-                        pOffset->cameraOfs.Y = sumY;
+                        pOffset->cameraOfs.X = avg.X();
+                        pOffset->cameraOfs.Y = avg.Y();
                         refined = true;
                     }
-                    Debug.Write(wxString::Format("%s, %d included, MultiStar: {%0.2f, %0.2f}, one-star: {%0.2f, %0.2f}\n",
-                                                 (refined ? "refined" : "single-star"), validStars, sumX, sumY,
+                    Debug.Write(wxString::Format("%s, %u included, MultiStar: {%0.2f, %0.2f}, one-star: {%0.2f, %0.2f}\n",
+                                                 (refined ? "refined" : "single-star"), avg.Count(), avg.X(), avg.Y(),
                                                  origOffset.cameraOfs.X, origOffset.cameraOfs.Y));
                 }
             }
@@ -920,7 +971,8 @@ bool GuiderMultiStar::RefineOffset(const usImage *pImage, GuiderOffset *pOffset)
 
 static DistanceChecker s_distanceChecker;
 
-bool GuiderMultiStar::UpdateCurrentPosition(const usImage *pImage, GuiderOffset *ofs, FrameDroppedInfo *errorInfo)
+bool GuiderMultiStar::UpdateCurrentPosition(const usImage *pImage, const FrameMeasurement *measurement, GuiderOffset *ofs,
+                                            FrameDroppedInfo *errorInfo)
 {
     if (!m_primaryStar.IsValid() && m_primaryStar.X == 0.0 && m_primaryStar.Y == 0.0)
     {
@@ -938,10 +990,20 @@ bool GuiderMultiStar::UpdateCurrentPosition(const usImage *pImage, GuiderOffset
 
     try
     {
-        Star newStar(m_primaryStar);
+        // the frame is normally measured on the guide thread; measure it here if that measurement
+        // is missing or the guide star or settings have changed since it was prepared
+        FrameMeasurement local;
+        if (!measurement || !measurement->prepared || !(measurement->params == GetFindParams()) ||
+            !SameFindInput(measurement->primaryIn, m_primaryStar))
+        {
+            PrepareFrameMeasurement(&local);
+            local.Measure(pImage);
+            measurement = &local;
+        }
+
+        Star newStar(measurement->primary);
 
-        if (!newStar.Find(pImage, m_searchRegion, pFrame->GetStarFindMode(), GetMinStarHFD(), GetMaxStarHFD(),
-                          pCamera->GetSaturationADU(), Star::FIND_LOGGING_VERBOSE))
+        if (!measurement->primaryFound)
         {
             errorInfo->starError = newStar.GetError();
             errorInfo->starMass = 0.0;
@@ -1029,7 +1091,7 @@ bool GuiderMultiStar::UpdateCurrentPosition(const usImage *pImage, GuiderOffset
             ofs->cameraOfs = m_primaryStar - lockPos;
             if (m_multiStarMode && m_guideStars.size() > 1)
             {
-                if (RefineOffset(pImage, ofs))
+                if (RefineOffset(pImage, measurement, ofs))
                     distance = hypot(ofs->cameraOfs.X, ofs->cameraOfs.Y); // Distance is reported to server clients
             }
             else
@@ -1302,34 +1364,17 @@ void GuiderMultiStar::SaveStarFITS()
         wxFileName::Mkdir(imgLogDirectory, wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL);
     wxString fname = imgLogDirectory + PATHSEPSTR + "PHD_GuideStar" + wxDateTime::Now().Format(_T("_%j_%H%M%S")) + ".fit";
 
-    fitsfile *fptr; // FITS file pointer
-    int status = 0; // CFITSIO status value MUST be initialized to zero!
+    FITSHdrCards hdr;
 
-    PHD_fits_create_file(&fptr, fname, false, &status);
-
-    if (!status)
-    {
-        long fsize[] = { 60, 60 };
-        fits_create_img(fptr, USHORT_IMG, 2, fsize, &status);
-
-        FITSHdrWriter hdr(fptr, &status);
-
-        hdr.write("DATE", wxDateTime::UNow(), wxDateTime::UTC, "file creation time, UTC");
-        hdr.write("DATE-OBS", pImage->ImgStartTime, wxDateTime::UTC, "image capture start time, UTC");
-        hdr.write("EXPOSURE", (float) pImage->ImgExpDur / 1000.0f, "Exposure time [s]");
-        hdr.write("XBINNING", (unsigned int) pCamera->Binning, "Camera X binning");
-        hdr.write("YBINNING", (unsigned int) pCamera->Binning, "Camera Y binning");
-        hdr.write("XORGSUB", start_x, "Subframe x position in binned pixels");
-        hdr.write("YORGSUB", start_y, "Subframe y position in binned pixels");
-
-        if (!status)
-        {
-            long fpixel[] = { 1, 1, 1 };
-            fits_write_pix(fptr, TUSHORT, fpixel, tmpimg.NPixels, tmpimg.ImageData, &status);
-        }
-    }
+    hdr.write("DATE", wxDateTime::UNow(), wxDateTime::UTC, "file creation time, UTC");
+    hdr.write("DATE-OBS", pImage->ImgStartTime, wxDateTime::UTC, "image capture start time, UTC");
+    hdr.write("EXPOSURE", (float) pImage->ImgExpDur / 1000.0f, "Exposure time [s]");
+    hdr.write("XBINNING", (unsigned int) pCamera->Binning, "Camera X binning");
+    hdr.write("YBINNING", (unsigned int) pCamera->Binning, "Camera Y binning");
+    hdr.write("XORGSUB", start_x, "Subframe x position in binned pixels");
+    hdr.write("YORGSUB", start_y, "Subframe y position in binned pixels");
 
-    PHD_fits_close_file(fptr);
+    FitsWriter::Save(fname, tmpimg, &hdr, FitsWriter::COMPRESS_NONE, "StarImage", false);
 }
 
 wxString GuiderMultiStar::GetSettingsSummary() const
@@ -112,7 +112,7 @@ public:
     bool SetMassChangeThreshold(double starMassChangeThreshold);
     bool SetTolerateJumps(bool enable, double threshold);
     bool SetSearchRegion(int searchRegion);
-    bool RefineOffset(const usImage *pImage, GuiderOffset *pOffset);
+    bool RefineOffset(const usImage *pImage, const FrameMeasurement *measurement, GuiderOffset *pOffset);
 
     friend class GuiderMultiStarConfigDialogPane;
     friend class GuiderMultiStarConfigDialogCtrlSet;
@@ -142,15 +142,22 @@ public:
 
     void LoadProfileSettings() override;
 
+    void PrepareFrameMeasurement(FrameMeasurement *measurement) const override;
+
 private:
     bool IsValidLockPosition(const PHD_Point& pt) final;
     bool IsValidSecondaryStarPosition(const PHD_Point& pt) final;
     void InvalidateCurrentPosition(bool fullReset = false) final;
-    bool UpdateCurrentPosition(const usImage *pImage, GuiderOffset *ofs, FrameDroppedInfo *errorInfo) final;
+    bool UpdateCurrentPosition(const usImage *pImage, const FrameMeasurement *measurement, GuiderOffset *ofs,
+                               FrameDroppedInfo *errorInfo) final;
     bool SetCurrentPosition(const usImage *pImage, const PHD_Point& position) final;
 
     void OnLClick(wxMouseEvent& evt);
 
+    FrameMeasurement::FindParams GetFindParams() const;
+    void InitSecondaryStarFinds(size_t first, size_t count, std::vector<FrameMeasurement::StarFind> *finds) const;
+    void MeasureSecondaryStars(const usImage *pImage, const FrameMeasurement *measurement, size_t first, size_t count,
+                               std::vector<FrameMeasurement::StarFind> *finds) const;
     void SaveStarFITS();
 
     wxDECLARE_EVENT_TABLE();
@@ -33,11 +33,14 @@
  *
  */
 
-#include "phd.h"
-#include <math.h>
-#include <algorithm>
 #include "guiding_stats.h"
 
+#include <algorithm>
+#include <assert.h>
+#include <limits>
+#include <math.h>
+#include <vector>
+
 // Descriptive stats and axial stats classes
 
 // All variance calculations use the Knuth algorithm, which is more robust than the naive approach
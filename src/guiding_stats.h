@@ -36,6 +36,7 @@
 #ifndef _GUIDING_STATS_H
 #define _GUIDING_STATS_H
 #include <deque>
+#include <stddef.h>
 
 // DescriptiveStats is used for basic statistics.  Max, min, sigma and variance are computed on-the-fly as values are added to a
 // dataset Applicable to any double values, no semantic assumptions made.  Does not retain a list of values
@@ -34,6 +34,7 @@
 
 #include "phd.h"
 #include "image_math.h"
+#include "noise_reduction.h"
 
 #include <wx/wfstream.h>
 #include <wx/txtstrm.h>
@@ -103,45 +104,7 @@ bool QuickLRecon(usImage& img)
         tmp.Clear();
     }
 
-#define IX(x_, y_) ((RY + (y_)) * W + RX + (x_))
-
-    unsigned short *d;
-    unsigned int t;
-
-    for (int y = 0; y <= RH - 2; y++)
-    {
-        d = &tmp.ImageData[IX(0, y)];
-
-        for (int x = 0; x <= RW - 2; x++)
-        {
-            t = img.ImageData[IX(x, y)];
-            t += img.ImageData[IX(x + 1, y)];
-            t += img.ImageData[IX(x, y + 1)];
-            t += img.ImageData[IX(x + 1, y + 1)];
-            *d++ = (unsigned short) (t >> 2);
-        }
-
-        // last col
-        t = img.ImageData[IX(RW - 1, y)];
-        t += img.ImageData[IX(RW - 1, y + 1)];
-        *d = (unsigned short) (t >> 1);
-    }
-
-    // last row
-
-    d = &tmp.ImageData[IX(0, RH - 1)];
-
-    for (int x = 0; x <= RW - 2; x++)
-    {
-        t = img.ImageData[IX(x, RH - 1)];
-        t += img.ImageData[IX(x + 1, RH - 1)];
-        *d++ = (unsigned short) (t >> 1);
-    }
-
-    // bottom-right pixel
-    *d = img.ImageData[IX(RW - 1, RH - 1)];
-
-#undef IX
+    NoiseReduction::Mean2x2(tmp.ImageData, img.ImageData, W, RX, RY, RW, RH);
 
     img.SwapImageData(tmp);
     return false;
@@ -159,12 +122,14 @@ bool Median3(usImage& img)
 
     if (img.Subframe.IsEmpty())
     {
-        Median3(tmp.ImageData, img.ImageData, img.Size, wxRect(img.Size));
+        NoiseReduction::Median3(tmp.ImageData, img.ImageData, img.Size.GetWidth(), 0, 0, img.Size.GetWidth(),
+                                img.Size.GetHeight());
     }
     else
     {
         tmp.Clear();
-        Median3(tmp.ImageData, img.ImageData, img.Size, img.Subframe);
+        NoiseReduction::Median3(tmp.ImageData, img.ImageData, img.Size.GetWidth(), img.Subframe.GetX(), img.Subframe.GetY(),
+                                img.Subframe.GetWidth(), img.Subframe.GetHeight());
     }
 
     img.SwapImageData(tmp);
@@ -179,67 +144,6 @@ inline static void swap(unsigned short& a, unsigned short& b)
     b = t;
 }
 
-inline static unsigned short median9(const unsigned short l[9])
-{
-    unsigned short l0 = l[0], l1 = l[1], l2 = l[2], l3 = l[3], l4 = l[4];
-    unsigned short x;
-    x = l[5];
-    if (x < l0)
-        swap(x, l0);
-    if (x < l1)
-        swap(x, l1);
-    if (x < l2)
-        swap(x, l2);
-    if (x < l3)
-        swap(x, l3);
-    if (x < l4)
-        swap(x, l4);
-    x = l[6];
-    if (x < l0)
-        swap(x, l0);
-    if (x < l1)
-        swap(x, l1);
-    if (x < l2)
-        swap(x, l2);
-    if (x < l3)
-        swap(x, l3);
-    if (x < l4)
-        swap(x, l4);
-    x = l[7];
-    if (x < l0)
-        swap(x, l0);
-    if (x < l1)
-        swap(x, l1);
-    if (x < l2)
-        swap(x, l2);
-    if (x < l3)
-        swap(x, l3);
-    if (x < l4)
-        swap(x, l4);
-    x = l[8];
-    if (x < l0)
-        swap(x, l0);
-    if (x < l1)
-        swap(x, l1);
-    if (x < l2)
-        swap(x, l2);
-    if (x < l3)
-        swap(x, l3);
-    if (x < l4)
-        swap(x, l4);
-
-    if (l1 > l0)
-        l0 = l1;
-    if (l2 > l0)
-        l0 = l2;
-    if (l3 > l0)
-        l0 = l3;
-    if (l4 > l0)
-        l0 = l4;
-
-    return l0;
-}
-
 inline static unsigned short median8(const unsigned short l[8])
 {
     unsigned short l0 = l[0], l1 = l[1], l2 = l[2], l3 = l[3], l4 = l[4];
@@ -297,43 +201,6 @@ inline static unsigned short median8(const unsigned short l[8])
     return (unsigned short) (((unsigned int) l0 + (unsigned int) l1) / 2);
 }
 
-inline static unsigned short median6(const unsigned short l[6])
-{
-    unsigned short l0 = l[0], l1 = l[1], l2 = l[2], l3 = l[3];
-    unsigned short x;
-
-    x = l[4];
-    if (x < l0)
-        swap(x, l0);
-    if (x < l1)
-        swap(x, l1);
-    if (x < l2)
-        swap(x, l2);
-    if (x < l3)
-        swap(x, l3);
-    x = l[5];
-    if (x < l0)
-        swap(x, l0);
-    if (x < l1)
-        swap(x, l1);
-    if (x < l2)
-        swap(x, l2);
-    if (x < l3)
-        swap(x, l3);
-
-    if (l2 > l0)
-        swap(l2, l0);
-    if (l2 > l1)
-        swap(l2, l1);
-
-    if (l3 > l0)
-        swap(l3, l0);
-    if (l3 > l1)
-        swap(l3, l1);
-
-    return (unsigned short) (((unsigned int) l0 + (unsigned int) l1) / 2);
-}
-
 inline static unsigned short median5(const unsigned short l[5])
 {
     unsigned short l0 = l[0], l1 = l[1], l2 = l[2];
@@ -361,26 +228,6 @@ inline static unsigned short median5(const unsigned short l[5])
     return l0;
 }
 
-inline static unsigned short median4(const unsigned short l[4])
-{
-    unsigned short l0 = l[0], l1 = l[1], l2 = l[2];
-    unsigned short x;
-    x = l[3];
-    if (x < l0)
-        swap(x, l0);
-    if (x < l1)
-        swap(x, l1);
-    if (x < l2)
-        swap(x, l2);
-
-    if (l2 > l0)
-        swap(l2, l0);
-    if (l2 > l1)
-        swap(l2, l1);
-
-    return (unsigned short) (((unsigned int) l0 + (unsigned int) l1) / 2);
-}
-
 inline static unsigned short median3(const unsigned short l[3])
 {
     unsigned short l0 = l[0], l1 = l[1], l2 = l[2];
@@ -393,117 +240,6 @@ inline static unsigned short median3(const unsigned short l[3])
     return l0;
 }
 
-void Median3(unsigned short *dst, const unsigned short *src, const wxSize& size, const wxRect& rect)
-{
-    int const W = size.GetWidth();
-    int const RX = rect.GetX();
-    int const RY = rect.GetY();
-    int const RW = rect.GetWidth();
-    int const RH = rect.GetHeight();
-
-    unsigned short a[9];
-    unsigned short *d;
-
-#define IX(x_, y_) ((RY + (y_)) * W + RX + (x_))
-
-    // top row
-    d = &dst[IX(0, 0)];
-
-    // top-left corner
-    a[0] = src[IX(0, 0)];
-    a[1] = src[IX(1, 0)];
-    a[2] = src[IX(0, 1)];
-    a[3] = src[IX(1, 1)];
-    *d++ = median4(a);
-
-    // top row middle pixels
-    for (int x = 1; x <= RW - 2; x++)
-    {
-        a[0] = src[IX(x - 1, 0)];
-        a[1] = src[IX(x, 0)];
-        a[2] = src[IX(x + 1, 0)];
-        a[3] = src[IX(x - 1, 1)];
-        a[4] = src[IX(x, 1)];
-        a[5] = src[IX(x + 1, 1)];
-        *d++ = median6(a);
-    }
-
-    // top-right corner
-    a[0] = src[IX(RW - 2, 0)];
-    a[1] = src[IX(RW - 1, 0)];
-    a[2] = src[IX(RW - 2, 1)];
-    a[3] = src[IX(RW - 1, 1)];
-    *d = median4(a);
-
-    for (int y = 1; y <= RH - 2; y++)
-    {
-        d = &dst[IX(0, y)];
-
-        // leftmost pixel
-        a[0] = src[IX(0, y - 1)];
-        a[1] = src[IX(1, y - 1)];
-        a[2] = src[IX(0, y)];
-        a[3] = src[IX(1, y)];
-        a[4] = src[IX(0, y + 1)];
-        a[5] = src[IX(1, y + 1)];
-        *d++ = median6(a);
-
-        for (int x = 1; x <= RW - 2; x++)
-        {
-            a[0] = src[IX(x - 1, y - 1)];
-            a[1] = src[IX(x, y - 1)];
-            a[2] = src[IX(x + 1, y - 1)];
-            a[3] = src[IX(x - 1, y)];
-            a[4] = src[IX(x, y)];
-            a[5] = src[IX(x + 1, y)];
-            a[6] = src[IX(x - 1, y + 1)];
-            a[7] = src[IX(x, y + 1)];
-            a[8] = src[IX(x + 1, y + 1)];
-            *d++ = median9(a);
-        }
-
-        // rightmost pixel
-        a[0] = src[IX(RW - 2, y - 1)];
-        a[1] = src[IX(RW - 1, y - 1)];
-        a[2] = src[IX(RW - 2, y)];
-        a[3] = src[IX(RW - 1, y)];
-        a[4] = src[IX(RW - 2, y + 1)];
-        a[5] = src[IX(RW - 1, y + 1)];
-        *d++ = median6(a);
-    }
-
-    // bottom row
-    d = &dst[IX(0, RH - 1)];
-
-    // bottom-left corner
-    a[0] = src[IX(0, RH - 2)];
-    a[1] = src[IX(1, RH - 2)];
-    a[2] = src[IX(0, RH - 1)];
-    a[3] = src[IX(1, RH - 1)];
-    *d++ = median4(a);
-
-    // bottom row middle pixels
-    for (int x = 1; x <= RW - 2; x++)
-    {
-        a[0] = src[IX(x - 1, RH - 2)];
-        a[1] = src[IX(x, RH - 2)];
-        a[2] = src[IX(x + 1, RH - 2)];
-        a[3] = src[IX(x - 1, RH - 1)];
-        a[4] = src[IX(x, RH - 1)];
-        a[5] = src[IX(x + 1, RH - 1)];
-        *d++ = median6(a);
-    }
-
-    // bottom-right corner
-    a[0] = src[IX(RW - 2, RH - 2)];
-    a[1] = src[IX(RW - 1, RH - 2)];
-    a[2] = src[IX(RW - 2, RH - 1)];
-    a[3] = src[IX(RW - 1, RH - 1)];
-    *d = median4(a);
-
-#undef IX
-}
-
 static unsigned short MedianBorderingPixels(const usImage& img, int x, int y)
 {
     unsigned short array[8];
@@ -646,49 +382,47 @@ bool SquarePixels(usImage& img, float xsize, float ysize)
     return false;
 }
 
+// Median ADU of the dark frame within the given subframe, or of the whole frame if the subframe is
+// empty
+unsigned short DarkMedian(const usImage& dark, const wxRect& subframe)
+{
+    if (subframe.IsEmpty() || !dark.ImageData)
+        return dark.MedianADU; // use the pre-computed full frame median ADU
+
+    unsigned int left = subframe.GetLeft();
+    unsigned int top = subframe.GetTop();
+    unsigned int width = subframe.GetWidth();
+    unsigned int height = subframe.GetHeight();
+
+    unsigned int pixcnt = width * height;
+    unsigned short *tmp = FrameBufferPool::Alloc(pixcnt);
+    const unsigned short *src = dark.ImageData + left + top * dark.Size.GetWidth();
+    unsigned short *dst = tmp;
+    for (unsigned int y = 0; y < height; y++)
+    {
+        memcpy(dst, src, width * sizeof(unsigned short));
+        src += dark.Size.GetWidth();
+        dst += width;
+    }
+    std::nth_element(tmp, tmp + pixcnt / 2, tmp + pixcnt);
+    unsigned short median = tmp[pixcnt / 2];
+    FrameBufferPool::Release(tmp, pixcnt);
+
+    return median;
+}
+
 // Dark subtraction algorithm:
 //     Pedestal = max(median(dark_frame) - median(light_frame), 0) - handles overall gain/gradient differences
 //     Dark_corrected(i) = min(max(light(i) + pedestal - dark(i), 0), 65335)
-bool Subtract(usImage& light, const usImage& dark)
+// median_dark is the median of the dark frame within the light frame's subframe (see DarkMedian)
+bool Subtract(usImage& light, const usImage& dark, unsigned short median_dark)
 {
     if (!light.ImageData || !dark.ImageData)
         return true;
     if (light.Size != dark.Size)
         return true;
 
-    unsigned int left, top, width, height;
-    unsigned short median_light, median_dark;
-    median_light = light.MedianADU; // median of frame or subframe
-
-    if (!light.Subframe.IsEmpty())
-    {
-        left = light.Subframe.GetLeft();
-        width = light.Subframe.GetWidth();
-        top = light.Subframe.GetTop();
-        height = light.Subframe.GetHeight();
-
-        // compute the dark's median ADU within the subframe region
-        unsigned int pixcnt = width * height;
-        unsigned short *tmp = new unsigned short[pixcnt];
-        const unsigned short *src = dark.ImageData + left + top * light.Size.GetWidth();
-        unsigned short *dst = tmp;
-        for (int y = 0; y < height; y++)
-        {
-            memcpy(dst, src, width * sizeof(unsigned short));
-            src += light.Size.GetWidth();
-            dst += width;
-        }
-        std::nth_element(tmp, tmp + pixcnt / 2, tmp + pixcnt);
-        median_dark = tmp[pixcnt / 2];
-        delete[] tmp;
-    }
-    else
-    {
-        left = top = 0;
-        width = light.Size.GetWidth();
-        height = light.Size.GetHeight();
-        median_dark = dark.MedianADU; // use the pre-computed full frame median ADU
-    }
+    unsigned short median_light = light.MedianADU; // median of frame or subframe
 
     if (median_dark > median_light)
     {
@@ -696,27 +430,24 @@ bool Subtract(usImage& light, const usImage& dark)
         light.Pedestal = median_dark - median_light; // Needed for saturation detection in find-star
     }
 
-    unsigned short *pl0 = &light.Pixel(left, top);
-    const unsigned short *pd0 = &dark.Pixel(left, top);
-    for (unsigned int r = 0; r < height; r++, pl0 += light.Size.GetWidth(), pd0 += light.Size.GetWidth())
-    {
-        unsigned short *const endl = pl0 + width;
-        unsigned short *pl;
-        const unsigned short *pd;
-        for (pl = pl0, pd = pd0; pl < endl; pl++, pd++)
-        {
-            int newval = (int) *pl + light.Pedestal - (int) *pd;
-            if (newval < 0)
-                newval = 0; // hot pixel in dark frame isn't present in light frame
-            else if (newval > 65535)
-                newval = 65535;
-            *pl = (unsigned short) newval;
-        }
-    }
+    const wxRect& rect = light.Subframe.IsEmpty() ? wxRect(light.Size) : light.Subframe;
+
+    DarkSubtract::Subtract(light.ImageData, dark.ImageData, light.Size.GetWidth(), rect.x, rect.y, rect.width, rect.height,
+                           light.Pedestal, WorkerPool::Concurrency(), &WorkerPool::ParallelFor);
 
     return false;
 }
 
+bool Subtract(usImage& light, const usImage& dark)
+{
+    if (!light.ImageData || !dark.ImageData)
+        return true;
+    if (light.Size != dark.Size)
+        return true;
+
+    return Subtract(light, dark, DarkMedian(dark, light.Subframe));
+}
+
 inline static unsigned short histo_median(unsigned short histo1[256], unsigned short histo2[65536], int n)
 {
     n /= 2;
@@ -1102,6 +833,7 @@ void DefectMapBuilder::BuildDefectMap(DefectMap& defectMap, bool verbose) const
     defectMap.clear();
     unsigned int nr_cold = emit_defects(defectMap, m_impl->coldPxThresh, m_impl->coldPx.end(), stats.stdev, -1, verbose);
     unsigned int nr_hot = emit_defects(defectMap, m_impl->hotPxThresh, m_impl->hotPx.end(), stats.stdev, +1, verbose);
+    defectMap.BuildIndex();
 
     if (verbose)
         Debug.Write(
@@ -1119,35 +851,14 @@ bool RemoveDefects(usImage& light, const DefectMap& defectMap)
     if (!light.ImageData)
         return true;
 
+    // only the defects within the active subframe need correcting
+    wxRect rect(light.Size);
     if (!light.Subframe.IsEmpty())
-    {
-        // Step over each defect and replace the light value
-        // with the median of the surrounding pixels
-        for (DefectMap::const_iterator it = defectMap.begin(); it != defectMap.end(); ++it)
-        {
-            const wxPoint& pt = *it;
-            // Check to see if we are within the subframe before correcting the defect
-            if (light.Subframe.Contains(pt))
-            {
-                light.Pixel(pt.x, pt.y) = MedianBorderingPixels(light, pt.x, pt.y);
-            }
-        }
-    }
-    else
-    {
-        // Step over each defect and replace the light value
-        // with the median of the surrounding pixels
-        for (DefectMap::const_iterator it = defectMap.begin(); it != defectMap.end(); ++it)
-        {
-            int const x = it->x;
-            int const y = it->y;
+        rect.Intersect(light.Subframe);
 
-            if (x >= 0 && x < light.Size.GetWidth() && y >= 0 && y < light.Size.GetHeight())
-            {
-                light.Pixel(x, y) = MedianBorderingPixels(light, x, y);
-            }
-        }
-    }
+    // Step over each defect in row order and replace the light value
+    // with the median of the surrounding pixels
+    defectMap.VisitDefects(rect, [&light](int x, int y) { light.Pixel(x, y) = MedianBorderingPixels(light, x, y); });
 
     return false;
 }
@@ -1167,6 +878,7 @@ bool DefectMap::ImportFromProfile(int srcId, int destId)
 
     sourceName = DefectMapFileName(srcId);
     destName = DefectMapFileName(destId);
+    DarkCache::Remove(destName);
     rslt = wxCopyFile(sourceName, destName, true);
     if (rslt != 1)
     {
@@ -1266,21 +978,103 @@ void DefectMap::Save(const wxArrayString& info) const
 
     oStream.Close();
     Debug.AddLine(wxString::Format("Saved defect map to %s", filename));
+
+    DarkCache::SaveDefects(filename, *this);
+}
+
+DefectMap::DefectMap() : m_profileId(pConfig->GetCurrentProfileId()), m_indexed(false), m_bitsStride(0) { }
+
+DefectMap::DefectMap(int profileId) : m_profileId(profileId), m_indexed(false), m_bitsStride(0) { }
+
+static bool RowOrder(const wxPoint& a, const wxPoint& b)
+{
+    return a.y < b.y || (a.y == b.y && a.x < b.x);
 }
 
-DefectMap::DefectMap() : m_profileId(pConfig->GetCurrentProfileId()) { }
+// coordinates beyond this cannot belong to any camera frame and are left out of the index
+enum
+{
+    DEFECT_INDEX_MAX_COORD = 65535,
+    DEFECT_BITMAP_MAX_WORDS = 1 << 22, // 32MB
+};
+
+void DefectMap::BuildIndex()
+{
+    std::vector<wxPoint>& list = *this;
+    std::sort(list.begin(), list.end(), RowOrder);
+    list.erase(std::unique(list.begin(), list.end()), list.end());
+
+    int maxX = -1, maxY = -1;
+    for (const_iterator it = begin(); it != end(); ++it)
+    {
+        if (it->x >= 0 && it->x <= DEFECT_INDEX_MAX_COORD && it->y >= 0 && it->y <= DEFECT_INDEX_MAX_COORD)
+        {
+            maxX = std::max(maxX, it->x);
+            maxY = std::max(maxY, it->y);
+        }
+    }
+
+    // row offset table: defects on row y are [m_rowStart[y], m_rowStart[y + 1])
+    m_rowStart.assign(maxY + 2, 0);
+    const_iterator it = begin();
+    while (it != end() && it->y < 0)
+        ++it;
+    for (int y = 0; y <= maxY + 1; y++)
+    {
+        m_rowStart[y] = it - begin();
+        while (it != end() && it->y == y)
+            ++it;
+    }
 
-DefectMap::DefectMap(int profileId) : m_profileId(profileId) { }
+    // membership bitmap, unless it would be unreasonably large for the sensor size implied by the defects
+    m_bitsStride = (maxX + 64) / 64;
+    m_bits.clear();
+    if ((size_t) m_bitsStride * (maxY + 1) <= DEFECT_BITMAP_MAX_WORDS)
+    {
+        m_bits.resize((size_t) m_bitsStride * (maxY + 1), 0);
+        for (const_iterator pt = begin(); pt != end(); ++pt)
+        {
+            if (pt->x >= 0 && pt->x <= maxX && pt->y >= 0 && pt->y <= maxY)
+                m_bits[(size_t) pt->y * m_bitsStride + (pt->x >> 6)] |= 1ULL << (pt->x & 63);
+        }
+    }
+
+    m_indexed = true;
+}
 
 bool DefectMap::FindDefect(const wxPoint& pt) const
 {
-    return std::find(begin(), end(), pt) != end();
+    if (!IsIndexed())
+        return std::find(begin(), end(), pt) != end();
+
+    if (!m_bits.empty() && pt.x >= 0 && pt.x < (int) m_bitsStride * 64 && pt.y >= 0 && pt.y < (int) m_rowStart.size() - 1)
+        return (m_bits[(size_t) pt.y * m_bitsStride + (pt.x >> 6)] >> (pt.x & 63)) & 1;
+
+    return std::binary_search(begin(), end(), pt, RowOrder);
 }
 
 void DefectMap::AddDefect(const wxPoint& pt)
 {
-    // first add the point
-    push_back(pt);
+    // first add the point, in row order
+    if (!IsIndexed())
+        BuildIndex();
+
+    std::vector<wxPoint>& list = *this;
+    std::vector<wxPoint>::iterator pos = std::lower_bound(list.begin(), list.end(), pt, RowOrder);
+    if (pos != list.end() && *pos == pt)
+        return;
+    list.insert(pos, pt);
+
+    // update the index in place if the point lies within it, otherwise it has to grow
+    if (pt.y >= 0 && pt.y < (int) m_rowStart.size() - 1 && pt.x >= 0 && pt.x < (int) m_bitsStride * 64)
+    {
+        for (size_t y = pt.y + 1; y < m_rowStart.size(); y++)
+            ++m_rowStart[y];
+        if (!m_bits.empty())
+            m_bits[(size_t) pt.y * m_bitsStride + (pt.x >> 6)] |= 1ULL << (pt.x & 63);
+    }
+    else
+        BuildIndex();
 
     wxString filename = DefectMapFileName(m_profileId);
     wxFile file(filename, wxFile::write_append);
@@ -1297,6 +1091,9 @@ void DefectMap::AddDefect(const wxPoint& pt)
 
     oStream.Close();
     Debug.AddLine(wxString::Format("Saved defect map to %s", filename));
+
+    // the cache no longer matches the file; it is rebuilt the next time the map is loaded
+    DarkCache::Remove(filename);
 }
 
 DefectMap *DefectMap::LoadDefectMap(int profileId)
@@ -1310,6 +1107,16 @@ DefectMap *DefectMap::LoadDefectMap(int profileId)
         return 0;
     }
 
+    DefectMap *defectMap = new DefectMap(profileId);
+
+    // the cached list is already sorted and does not need to be parsed
+    if (!DarkCache::LoadDefects(filename, defectMap))
+    {
+        defectMap->BuildIndex();
+        Debug.AddLine(wxString::Format("Loaded %d defects from cache", defectMap->size()));
+        return defectMap;
+    }
+
     wxFileInputStream iStream(filename);
     wxTextInputStream inText(iStream);
 
@@ -1317,11 +1124,10 @@ DefectMap *DefectMap::LoadDefectMap(int profileId)
     if (iStream.GetLastError() != wxSTREAM_NO_ERROR)
     {
         Debug.AddLine(wxString::Format("Unexpected eof on defect map file %s", filename));
+        delete defectMap;
         return 0;
     }
 
-    DefectMap *defectMap = new DefectMap(profileId);
-
     int linenum = 0;
     while (!inText.GetInputStream().Eof())
     {
@@ -1347,6 +1153,9 @@ DefectMap *DefectMap::LoadDefectMap(int profileId)
         }
     }
 
+    defectMap->BuildIndex();
+    DarkCache::SaveDefects(filename, *defectMap);
+
     Debug.AddLine(wxString::Format("Loaded %d defects", defectMap->size()));
     return defectMap;
 }
@@ -1359,4 +1168,5 @@ void DefectMap::DeleteDefectMap(int profileId)
         Debug.AddLine("Removing defect map file: " + filename);
         wxRemoveFile(filename);
     }
+    DarkCache::Remove(filename);
 }
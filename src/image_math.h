@@ -36,12 +36,41 @@
 #ifndef IMAGE_MATH_INCLUDED
 #define IMAGE_MATH_INCLUDED
 
-class DefectMap : public std::vector<wxPoint>
+// The defect list is kept sorted by row, then column. BuildIndex() adds a row offset table and a
+// membership bitmap so that FindDefect is O(1) and the defects inside a subframe can be visited
+// without scanning the whole list. The list can only be changed through the members below;
+// push_back() and clear() invalidate the index until BuildIndex() is called, and lookups fall
+// back to a linear scan meanwhile. AddDefect() keeps the list sorted and the index up to date.
+class DefectMap : private std::vector<wxPoint>
 {
     int m_profileId;
+    bool m_indexed; // the index matches the list
+    std::vector<unsigned int> m_rowStart; // defects on row y are [m_rowStart[y], m_rowStart[y + 1])
+    std::vector<unsigned long long> m_bits; // membership bitmap, m_bitsStride words per row
+    unsigned int m_bitsStride;
+
     DefectMap(int profileId);
+    bool IsIndexed() const { return m_indexed; }
 
 public:
+    typedef std::vector<wxPoint>::const_iterator const_iterator;
+
+    const_iterator begin() const { return std::vector<wxPoint>::begin(); }
+    const_iterator end() const { return std::vector<wxPoint>::end(); }
+    size_t size() const { return std::vector<wxPoint>::size(); }
+    bool empty() const { return std::vector<wxPoint>::empty(); }
+
+    void push_back(const wxPoint& pt)
+    {
+        std::vector<wxPoint>::push_back(pt);
+        m_indexed = false;
+    }
+    void clear()
+    {
+        std::vector<wxPoint>::clear();
+        m_indexed = false;
+    }
+
     static void DeleteDefectMap(int profileId);
     static bool DefectMapExists(int profileId, bool showAlert);
     static DefectMap *LoadDefectMap(int profileId);
@@ -51,13 +80,48 @@ public:
     void Save(const wxArrayString& mapInfo) const;
     bool FindDefect(const wxPoint& pt) const;
     void AddDefect(const wxPoint& pt);
+    void BuildIndex();
+
+    // call fn(x, y) for each defect inside rect, in row order
+    template<typename Fn>
+    void VisitDefects(const wxRect& rect, Fn fn) const;
 };
 
+template<typename Fn>
+void DefectMap::VisitDefects(const wxRect& rect, Fn fn) const
+{
+    if (!IsIndexed())
+    {
+        for (const_iterator it = begin(); it != end(); ++it)
+            if (rect.Contains(*it))
+                fn(it->x, it->y);
+        return;
+    }
+
+    int const x0 = rect.GetLeft();
+    int const x1 = rect.GetRight();
+    int const y0 = std::max(rect.GetTop(), 0);
+    int const y1 = std::min(rect.GetBottom(), (int) m_rowStart.size() - 2);
+
+    for (int y = y0; y <= y1; y++)
+    {
+        const_iterator const rowEnd = begin() + m_rowStart[y + 1];
+        const_iterator it = begin() + m_rowStart[y];
+        if (it == rowEnd)
+            continue;
+        if (it->x < x0)
+            it = std::lower_bound(it, rowEnd, x0, [](const wxPoint& pt, int x) { return pt.x < x; });
+        for (; it != rowEnd && it->x <= x1; ++it)
+            fn(it->x, y);
+    }
+}
+
 extern bool QuickLRecon(usImage& img);
-extern void Median3(unsigned short *dst, const unsigned short *src, const wxSize& size, const wxRect& rect);
 extern bool Median3(usImage& img);
 extern bool SquarePixels(usImage& img, float xsize, float ysize);
 extern int dbl_sort_func(double *first, double *second);
+extern unsigned short DarkMedian(const usImage& dark, const wxRect& subframe);
+extern bool Subtract(usImage& light, const usImage& dark, unsigned short darkMedian);
 extern bool Subtract(usImage& light, const usImage& dark);
 extern double CalcSlope(const ArrayOfDbl& y);
 extern bool RemoveDefects(usImage& light, const DefectMap& defectMap);
@@ -65,6 +65,7 @@ struct IL
         settings.logFramesDropped = false;
         settings.logAutoSelectFrames = false;
         settings.logNextNFrames = false;
+        settings.compression = FitsWriter::COMPRESS_NONE;
     }
 
     void Destroy()
@@ -97,7 +98,10 @@ struct IL
             }
         }
 
-        img->Save(wxFileName(subdir, filename).GetFullPath());
+        // the file is written by the FITS writer thread, guiding does not wait for it
+        FITSHdrCards hdr;
+        img->GetFITSHeader(&hdr);
+        FitsWriter::Save(wxFileName(subdir, filename).GetFullPath(), *img, &hdr, settings.compression, "ImageLogger");
     }
 
     void LogImage(const usImage *img)
@@ -162,11 +166,12 @@ void ImageLogger::GetSettings(ImageLoggerSettings *settings)
 void ImageLogger::ApplySettings(const ImageLoggerSettings& settings)
 {
     Debug.Write(wxString::Format(
-        "ImgLogger: Settings LogEnabled=%d Log Rel=%d, %.2f Log Px=%d, %.2f LogFrameDrop=%d LogAutoSel=%d NextN=%d\n",
+        "ImgLogger: Settings LogEnabled=%d Log Rel=%d, %.2f Log Px=%d, %.2f LogFrameDrop=%d LogAutoSel=%d NextN=%d "
+        "Compress=%d\n",
         settings.loggingEnabled, settings.logFramesOverThreshRel,
         settings.logFramesOverThreshRel ? settings.guideErrorThreshRel : 0., settings.logFramesOverThreshPx,
         settings.logFramesOverThreshPx ? settings.guideErrorThreshPx : 0., settings.logFramesDropped,
-        settings.logAutoSelectFrames, settings.logNextNFrames ? settings.logNextNFramesCount : 0));
+        settings.logAutoSelectFrames, settings.logNextNFrames ? settings.logNextNFramesCount : 0, settings.compression));
 
     s_il.settings = settings;
     if (settings.loggingEnabled && settings.logNextNFrames && s_il.imagesToLog < settings.logNextNFramesCount)
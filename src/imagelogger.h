@@ -46,10 +46,11 @@ struct ImageLoggerSettings
     double guideErrorThreshRel; // relative error theshold
     double guideErrorThreshPx; // pixel error theshold
     unsigned int logNextNFramesCount;
+    FitsWriter::Compression compression; // tile compression of the logged FITS files
 
     ImageLoggerSettings()
         : loggingEnabled(false), logFramesOverThreshRel(false), logFramesOverThreshPx(false), logFramesDropped(false),
-          logAutoSelectFrames(false), logNextNFrames(false)
+          logAutoSelectFrames(false), logNextNFrames(false), compression(FitsWriter::COMPRESS_NONE)
     {
     }
 };
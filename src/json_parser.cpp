@@ -54,11 +54,12 @@
  *  THE SOFTWARE.
  */
 
-#include "phd.h"
 #include "json_parser.h"
 
 #include <algorithm>
+#include <limits.h>
 #include <memory.h>
+#include <stdlib.h>
 
 class block_allocator
 {
@@ -156,33 +157,6 @@ void block_allocator::free()
 // true if character represent a digit
 #define IS_DIGIT(c) (c >= '0' && c <= '9')
 
-// convert string to integer
-static char *atoi(char *first, char *last, int *out)
-{
-    int sign = 1;
-    if (first != last)
-    {
-        if (*first == '-')
-        {
-            sign = -1;
-            ++first;
-        }
-        else if (*first == '+')
-        {
-            ++first;
-        }
-    }
-
-    int result = 0;
-    for (; first != last && IS_DIGIT(*first); ++first)
-    {
-        result = 10 * result + (*first - '0');
-    }
-    *out = result * sign;
-
-    return first;
-}
-
 // convert hexadecimal string to unsigned integer
 static char *hatoui(char *first, char *last, unsigned int *out)
 {
@@ -213,91 +187,109 @@ static char *hatoui(char *first, char *last, unsigned int *out)
     return first;
 }
 
-// convert string to floating point
-static char *atof(char *first, char *last, float *out)
+static const double POW10[] = { 1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+// Convert the number in [first, last). Integers that fit in 64 bits become JSON_INT, anything
+// else a correctly rounded JSON_FLOAT. Returns false if the text is not a number.
+static bool parse_number(char *first, char *last, json_value *value)
 {
-    // sign
-    float sign = 1;
-    if (first != last)
+    char *p = first;
+    bool const neg = p != last && *p == '-';
+    if (neg)
+        ++p;
+
+    unsigned long long mant = 0;
+    int digits = 0; // significant digits in mant
+    int exp10 = 0;
+    bool truncated = false; // non-zero digits did not fit in mant
+    bool is_float = false;
+
+    char *const int_first = p;
+    for (; p != last && IS_DIGIT(*p); ++p)
     {
-        if (*first == '-')
+        if (digits < 19)
         {
-            sign = -1;
-            ++first;
+            mant = 10 * mant + (*p - '0');
+            if (mant)
+                ++digits;
         }
-        else if (*first == '+')
+        else
         {
-            ++first;
+            ++exp10;
+            truncated |= *p != '0';
         }
     }
+    if (p == int_first)
+        return false;
 
-    // integer part
-    float result = 0;
-    for (; first != last && IS_DIGIT(*first); ++first)
+    if (p != last && *p == '.')
     {
-        result = 10 * result + (*first - '0');
+        is_float = true;
+        for (++p; p != last && IS_DIGIT(*p); ++p)
+        {
+            if (digits < 19)
+            {
+                mant = 10 * mant + (*p - '0');
+                if (mant)
+                    ++digits;
+                --exp10;
+            }
+            else
+                truncated |= *p != '0';
+        }
     }
 
-    // fraction part
-    if (first != last && *first == '.')
+    if (p != last && (*p == 'e' || *p == 'E'))
     {
-        ++first;
-
-        float inv_base = 0.1f;
-        for (; first != last && IS_DIGIT(*first); ++first)
+        is_float = true;
+        ++p;
+        bool exp_neg = false;
+        if (p != last && (*p == '-' || *p == '+'))
+            exp_neg = *p++ == '-';
+        int exp = 0;
+        for (; p != last && IS_DIGIT(*p); ++p)
         {
-            result += (*first - '0') * inv_base;
-            inv_base *= 0.1f;
+            if (exp < 100000)
+                exp = 10 * exp + (*p - '0');
         }
+        exp10 += exp_neg ? -exp : exp;
     }
 
-    // result w\o exponent
-    result *= sign;
+    if (p != last)
+        return false;
 
-    // exponent
-    bool exponent_negative = false;
-    int exponent = 0;
-    if (first != last && (*first == 'e' || *first == 'E'))
+    if (!is_float && exp10 == 0)
     {
-        ++first;
-
-        if (*first == '-')
-        {
-            exponent_negative = true;
-            ++first;
-        }
-        else if (*first == '+')
+        if (!neg && mant <= (unsigned long long) LLONG_MAX)
         {
-            ++first;
+            value->type = JSON_INT;
+            value->int_value = (long long) mant;
+            return true;
         }
-
-        for (; first != last && IS_DIGIT(*first); ++first)
+        if (neg && mant <= (unsigned long long) LLONG_MAX + 1)
         {
-            exponent = 10 * exponent + (*first - '0');
+            value->type = JSON_INT;
+            value->int_value = mant == (unsigned long long) LLONG_MAX + 1 ? LLONG_MIN : -(long long) mant;
+            return true;
         }
     }
 
-    if (exponent)
-    {
-        float power_of_ten = 10;
-        for (; exponent > 1; exponent--)
-        {
-            power_of_ten *= 10;
-        }
+    value->type = JSON_FLOAT;
 
-        if (exponent_negative)
-        {
-            result /= power_of_ten;
-        }
-        else
-        {
-            result *= power_of_ten;
-        }
+    // the mantissa and the power of ten are both exact, so a single multiplication or division
+    // rounds correctly
+    if (!truncated && mant <= (1ULL << 53) && exp10 >= -22 && exp10 <= 22)
+    {
+        double const d = exp10 < 0 ? (double) mant / POW10[-exp10] : (double) mant * POW10[exp10];
+        value->float_value = neg ? -d : d;
+        return true;
     }
 
-    *out = result;
-
-    return first;
+    // long mantissas and large exponents are rare; let the C library round them (PHD2 runs with
+    // LC_NUMERIC set to "C")
+    value->float_value = strtod(first, nullptr);
+    return true;
 }
 
 static json_value *json_alloc(block_allocator *allocator)
@@ -600,26 +592,16 @@ static json_value *json_parse(char *source, const char **error_pos, const char *
             object->name = name;
             name = 0;
 
-            object->type = JSON_INT;
-
             char *first = it;
-            while (*it != '\x20' && *it != '\x9' && *it != '\xD' && *it != '\xA' && *it != ',' && *it != ']' && *it != '}')
+            while (*it && *it != '\x20' && *it != '\x9' && *it != '\xD' && *it != '\xA' && *it != ',' && *it != ']' &&
+                   *it != '}')
             {
-                if (*it == '.' || *it == 'e' || *it == 'E')
-                {
-                    object->type = JSON_FLOAT;
-                }
                 ++it;
             }
 
-            if (object->type == JSON_INT && atoi(first, it, &object->int_value) != it)
-            {
-                JSON_ERROR(first, "Bad integer number");
-            }
-
-            if (object->type == JSON_FLOAT && atof(first, it, &object->float_value) != it)
+            if (!parse_number(first, it, object))
             {
-                JSON_ERROR(first, "Bad float number");
+                JSON_ERROR(first, "Bad number");
             }
 
             json_append(top, object);
@@ -57,6 +57,8 @@
 #ifndef JSON_PARSER_H
 #define JSON_PARSER_H
 
+#include <string>
+
 enum json_type
 {
     JSON_NULL,
@@ -79,8 +81,8 @@ struct json_value
     union
     {
         char *string_value;
-        int int_value;
-        float float_value;
+        long long int_value; // also holds JSON_BOOL values
+        double float_value;
     };
 
     json_type type;
@@ -99,7 +101,9 @@ public:
     JsonParser();
     ~JsonParser();
 
+    // parse str in place; the string is modified and must outlive the parse result
     bool Parse(char *str);
+    // parse a copy of str
     bool Parse(const std::string& str);
 
     const char *ErrorPos() const;
@@ -0,0 +1,288 @@
+/*
+ *  json_writer.cpp
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "json_writer.h"
+
+#include <cmath>
+#include <stdio.h>
+
+namespace
+{
+const double POW10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+const unsigned long long UPOW10[] = { 1ULL,      10ULL,      100ULL,      1000ULL,      10000ULL,
+                                      100000ULL, 1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL };
+
+// largest scaled value for which the integer part and the fraction are exact
+const double MAX_SCALED = 4503599627370496.0; // 2^52
+
+void append_digits(std::string& out, unsigned long long v, int mindigits)
+{
+    char buf[24];
+    char *const end = buf + sizeof(buf);
+    char *p = end;
+    do
+    {
+        *--p = (char) ('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (end - p < mindigits)
+        *--p = '0';
+    out.append(p, end - p);
+}
+
+void append_printf(std::string& out, const char *fmt, int prec, double v)
+{
+    char buf[512];
+    int n = prec >= 0 ? snprintf(buf, sizeof(buf), fmt, prec, v) : snprintf(buf, sizeof(buf), fmt, v);
+    if (n < 0)
+        return;
+    if ((size_t) n < sizeof(buf))
+    {
+        out.append(buf, n);
+        return;
+    }
+    // only very large numbers with many decimals get here
+    size_t const pos = out.size();
+    out.resize(pos + n + 1);
+    prec >= 0 ? snprintf(&out[pos], n + 1, fmt, prec, v) : snprintf(&out[pos], n + 1, fmt, v);
+    out.resize(pos + n);
+}
+
+// Round scaled (>= 0) to the nearest integer. Returns false when scaled is so close to a tie that
+// the error of the scaling multiplication could change the outcome.
+inline bool round_scaled(double scaled, unsigned long long *r)
+{
+    double const ip = std::floor(scaled);
+    double const frac = scaled - ip;
+    double const margin = 1e-9 + scaled * 4e-16;
+    if (std::fabs(frac - 0.5) <= margin)
+        return false;
+    *r = (unsigned long long) ip + (frac > 0.5 ? 1 : 0);
+    return true;
+}
+
+// integer part, then prec fractional digits with trailing zeros removed if trim is set
+void append_scaled(std::string& out, bool neg, unsigned long long r, int prec, bool trim)
+{
+    if (neg)
+        out += '-';
+    append_digits(out, r / UPOW10[prec], 1);
+    unsigned long long frac = r % UPOW10[prec];
+    if (trim)
+    {
+        if (!frac)
+            return;
+        while (frac % 10 == 0)
+        {
+            frac /= 10;
+            --prec;
+        }
+    }
+    if (prec > 0)
+    {
+        out += '.';
+        append_digits(out, frac, prec);
+    }
+}
+
+inline void append_utf8(std::string& out, unsigned int cp)
+{
+    if (cp < 0x80)
+    {
+        switch (cp)
+        {
+        case '\\':
+            out.append("\\\\", 2);
+            break;
+        case '"':
+            out.append("\\\"", 2);
+            break;
+        case '\r':
+            out.append("\\r", 2);
+            break;
+        case '\n':
+            out.append("\\n", 2);
+            break;
+        default:
+            out += (char) cp;
+            break;
+        }
+        return;
+    }
+
+    char buf[4];
+    int n;
+    if (cp < 0x800)
+    {
+        buf[0] = (char) (0xC0 | (cp >> 6));
+        buf[1] = (char) (0x80 | (cp & 0x3F));
+        n = 2;
+    }
+    else if (cp < 0x10000)
+    {
+        buf[0] = (char) (0xE0 | (cp >> 12));
+        buf[1] = (char) (0x80 | ((cp >> 6) & 0x3F));
+        buf[2] = (char) (0x80 | (cp & 0x3F));
+        n = 3;
+    }
+    else
+    {
+        buf[0] = (char) (0xF0 | (cp >> 18));
+        buf[1] = (char) (0x80 | ((cp >> 12) & 0x3F));
+        buf[2] = (char) (0x80 | ((cp >> 6) & 0x3F));
+        buf[3] = (char) (0x80 | (cp & 0x3F));
+        n = 4;
+    }
+    out.append(buf, n);
+}
+}
+
+namespace JsonWriter
+{
+void AppendInt(std::string& out, long long v)
+{
+    if (v < 0)
+    {
+        out += '-';
+        append_digits(out, 0ULL - (unsigned long long) v, 1);
+    }
+    else
+        append_digits(out, (unsigned long long) v, 1);
+}
+
+void AppendUInt(std::string& out, unsigned long long v)
+{
+    append_digits(out, v, 1);
+}
+
+void AppendFixed(std::string& out, double v, int prec)
+{
+    if (prec >= 0 && prec <= 9 && std::isfinite(v))
+    {
+        double const scaled = std::fabs(v) * POW10[prec];
+        unsigned long long r;
+        if (scaled < MAX_SCALED && round_scaled(scaled, &r))
+        {
+            append_scaled(out, std::signbit(v), r, prec, false);
+            return;
+        }
+    }
+
+    append_printf(out, "%.*f", prec, v);
+}
+
+void AppendGeneral(std::string& out, double v)
+{
+    // %g uses fixed notation with 6 significant digits when the decimal exponent X of the
+    // rounded value satisfies -4 <= X < 6, dropping trailing zeros
+    if (v == 0.)
+    {
+        if (std::signbit(v))
+            out += '-';
+        out += '0';
+        return;
+    }
+
+    double const a = std::fabs(v);
+    if (std::isfinite(a) && a >= 1e-4 && a < 999999.)
+    {
+        int const x = (int) std::floor(std::log10(a));
+        int const prec = 5 - x;
+        if (prec >= 0 && prec <= 9)
+        {
+            double const scaled = a * POW10[prec];
+            unsigned long long r;
+            // log10 may be off by one near powers of ten; check the scaled value instead
+            if (scaled >= 100000. && scaled < 1000000. && round_scaled(scaled, &r))
+            {
+                if (r < 1000000)
+                {
+                    append_scaled(out, v < 0, r, prec, true);
+                    return;
+                }
+                // rounded up to the next power of ten
+                if (prec > 0)
+                {
+                    append_scaled(out, v < 0, r / 10, prec - 1, true);
+                    return;
+                }
+            }
+        }
+    }
+
+    append_printf(out, "%g", -1, v);
+}
+
+void AppendEscaped(std::string& out, const char *s, size_t len)
+{
+    const char *const end = s + len;
+    const char *run = s;
+    for (; s < end; ++s)
+    {
+        char const c = *s;
+        if (c == '\\' || c == '"' || c == '\r' || c == '\n')
+        {
+            out.append(run, s - run);
+            append_utf8(out, (unsigned char) c);
+            run = s + 1;
+        }
+    }
+    out.append(run, s - run);
+}
+
+void AppendEscaped(std::string& out, const wchar_t *s, size_t len)
+{
+    const wchar_t *const end = s + len;
+    while (s < end)
+    {
+        unsigned int cp = (unsigned int) *s++;
+        if (sizeof(wchar_t) == 2)
+            cp &= 0xFFFF;
+        if (cp >= 0xD800 && cp <= 0xDFFF)
+        {
+            unsigned int const lo = s < end ? (unsigned int) *s & 0xFFFF : 0;
+            if (sizeof(wchar_t) == 2 && cp < 0xDC00 && lo >= 0xDC00 && lo <= 0xDFFF)
+            {
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                ++s;
+            }
+            else
+                cp = 0xFFFD;
+        }
+        else if (cp > 0x10FFFF)
+            cp = 0xFFFD;
+        append_utf8(out, cp);
+    }
+}
+}
@@ -0,0 +1,66 @@
+/*
+ *  json_writer.h
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef JSON_WRITER_H_INCLUDED
+#define JSON_WRITER_H_INCLUDED
+
+#include <string>
+
+// Append-only formatting of JSON values into a UTF-8 byte buffer, used by the event server to
+// build messages without intermediate strings.
+//
+// The number formats are byte-for-byte identical to printf in the "C" locale. The common cases
+// are formatted directly; values whose rounding cannot be decided cheaply fall back to snprintf
+// into a stack buffer, so nothing is allocated beyond the growth of the output buffer.
+
+namespace JsonWriter
+{
+// printf("%d") / printf("%llu")
+extern void AppendInt(std::string& out, long long v);
+extern void AppendUInt(std::string& out, unsigned long long v);
+
+// printf("%.*f", prec, v)
+extern void AppendFixed(std::string& out, double v, int prec);
+
+// printf("%g", v)
+extern void AppendGeneral(std::string& out, double v);
+
+// Append a string escaped the way the event server always has: backslash, double quote, CR and
+// LF are escaped, everything else is copied. The wide version converts UTF-16 or UTF-32
+// (depending on the size of wchar_t) to UTF-8; unpaired surrogates become U+FFFD.
+extern void AppendEscaped(std::string& out, const char *s, size_t len);
+extern void AppendEscaped(std::string& out, const wchar_t *s, size_t len);
+}
+
+#endif // JSON_WRITER_H_INCLUDED
@@ -1022,7 +1022,7 @@ static long QueryMaxSize(BgUpload *upload)
                 continue;
             if (strcmp(n->name, "max_file_size") == 0 && n->type == JSON_INT)
             {
-                limit = n->int_value;
+                limit = (long) n->int_value;
                 break;
             }
         }
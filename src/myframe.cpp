@@ -162,6 +162,7 @@ wxBEGIN_EVENT_TABLE(MyFrame, wxFrame)
     EVT_CLOSE(MyFrame::OnClose)
     EVT_THREAD(MYFRAME_WORKER_THREAD_EXPOSE_COMPLETE, MyFrame::OnExposeComplete)
     EVT_THREAD(MYFRAME_WORKER_THREAD_MOVE_COMPLETE, MyFrame::OnMoveComplete)
+    EVT_THREAD(MYFRAME_GUIDE_FRAME_COMPLETE, MyFrame::OnGuideFrameComplete)
 
     EVT_COMMAND(wxID_ANY, REQUEST_EXPOSURE_EVENT, MyFrame::OnRequestExposure)
     EVT_COMMAND(wxID_ANY, WXMESSAGEBOX_PROXY_EVENT, MyFrame::OnMessageBoxProxy)
@@ -216,6 +217,8 @@ MyFrame::MyFrame()
     m_mgr.SetManagedWindow(this);
 
     m_frameCounter = 0;
+    m_pGuideThread = nullptr;
+    StartGuideThread();
     m_pPrimaryWorkerThread = nullptr;
     StartWorkerThread(m_pPrimaryWorkerThread);
     m_pSecondaryWorkerThread = nullptr;
@@ -819,6 +822,8 @@ static void LoadImageLoggerSettings()
     settings.logNextNFramesCount = 1;
     settings.guideErrorThreshRel = pConfig->Profile.GetDouble("/ImageLogger/ErrorThreshRel", 4.0);
     settings.guideErrorThreshPx = pConfig->Profile.GetDouble("/ImageLogger/ErrorThreshPx", 4.0);
+    settings.compression =
+        FitsWriter::CompressionFromInt(pConfig->Profile.GetInt("/ImageLogger/Compression", FitsWriter::COMPRESS_NONE));
 
     ImageLogger::ApplySettings(settings);
 }
@@ -832,6 +837,7 @@ static void SaveImageLoggerSettings(const ImageLoggerSettings& settings)
     pConfig->Profile.SetBoolean("/ImageLogger/LogAutoSelectFrames", settings.logAutoSelectFrames);
     pConfig->Profile.SetDouble("/ImageLogger/ErrorThreshRel", settings.guideErrorThreshRel);
     pConfig->Profile.SetDouble("/ImageLogger/ErrorThreshPx", settings.guideErrorThreshPx);
+    pConfig->Profile.SetInt("/ImageLogger/Compression", settings.compression);
 }
 
 enum
@@ -1659,6 +1665,58 @@ bool MyFrame::StopWorkerThread(WorkerThread *& pWorkerThread)
     return killed;
 }
 
+void MyFrame::StartGuideThread()
+{
+    GuideThread *thread = new GuideThread(this);
+
+    if (thread->Create() != wxTHREAD_NO_ERROR || thread->Run() != wxTHREAD_NO_ERROR)
+    {
+        // frames will be processed on the main thread
+        Debug.Write("Could not start the guide thread\n");
+        delete thread;
+        return;
+    }
+
+    wxCriticalSectionLocker lock(m_CSpGuideThread);
+    m_pGuideThread = thread;
+}
+
+void MyFrame::StopGuideThread()
+{
+    GuideThread *thread;
+    {
+        // from here on the worker thread sends frames straight to the main thread
+        wxCriticalSectionLocker lock(m_CSpGuideThread);
+        thread = m_pGuideThread;
+        m_pGuideThread = nullptr;
+    }
+
+    if (!thread)
+        return;
+
+    Debug.Write("StopGuideThread begins\n");
+
+    // the guide thread never waits for the main thread, so it will finish the frames it has
+    thread->EnqueueTerminateRequest();
+    thread->Wait();
+    delete thread;
+
+    Debug.Write("StopGuideThread ends\n");
+}
+
+// Called on the worker thread when a frame has been captured. Returns false if there is no guide
+// thread to take the frame
+bool MyFrame::EnqueueGuideFrame(usImage *image, FrameMeasurement *measurement)
+{
+    wxCriticalSectionLocker lock(m_CSpGuideThread);
+
+    if (!m_pGuideThread)
+        return false;
+
+    m_pGuideThread->EnqueueFrame(image, measurement);
+    return true;
+}
+
 void MyFrame::OnRequestExposure(wxCommandEvent& evt)
 {
     EXPOSE_REQUEST *req = (EXPOSE_REQUEST *) evt.GetClientData();
@@ -1712,13 +1770,22 @@ void MyFrame::ScheduleExposure()
 
     usImage *img = new usImage();
 
+    FrameMeasurement *measurement = new FrameMeasurement();
+    pGuider->PrepareFrameMeasurement(measurement);
+
     wxCriticalSectionLocker lock(m_CSpWorkerThread);
 
     if (m_pPrimaryWorkerThread) // can be null when app is shutting down (unlikely but possible)
-        m_pPrimaryWorkerThread->EnqueueWorkerThreadExposeRequest(img, exposureDuration, exposureOptions, subframe);
+        m_pPrimaryWorkerThread->EnqueueWorkerThreadExposeRequest(img, exposureDuration, exposureOptions, subframe,
+                                                                 measurement);
+    else
+    {
+        delete img;
+        delete measurement;
+    }
 }
 
-void MyFrame::SchedulePrimaryMove(Mount *mount, const GuiderOffset& ofs, unsigned int moveOptions)
+void MyFrame::SchedulePrimaryMove(Mount *mount, const GuiderOffset& ofs, unsigned int moveOptions, wxLongLong_t frameTime)
 {
     Debug.Write(wxString::Format("SchedulePrimaryMove(%p, x=%.2f, y=%.2f, opts=%u)\n", mount, ofs.cameraOfs.X, ofs.cameraOfs.Y,
                                  moveOptions));
@@ -1732,7 +1799,7 @@ void MyFrame::SchedulePrimaryMove(Mount *mount, const GuiderOffset& ofs, unsigne
         mount->IncrementRequestCount();
 
     assert(m_pPrimaryWorkerThread);
-    m_pPrimaryWorkerThread->EnqueueWorkerThreadMoveRequest(mount, ofs, moveOptions);
+    m_pPrimaryWorkerThread->EnqueueWorkerThreadMoveRequest(mount, ofs, moveOptions, frameTime);
 }
 
 void MyFrame::ScheduleSecondaryMove(Mount *mount, const GuiderOffset& ofs, unsigned int moveOptions)
@@ -1748,7 +1815,8 @@ void MyFrame::ScheduleSecondaryMove(Mount *mount, const GuiderOffset& ofs, unsig
     {
         // some mounts must run on the Primary thread even if the secondary is requested
         // to ensure synchronous ST4 guide / camera exposure
-        SchedulePrimaryMove(mount, ofs, moveOptions);
+        // AO bumps are not computed from a frame, so there is no latency to record
+        SchedulePrimaryMove(mount, ofs, moveOptions, 0);
     }
     else
     {
@@ -2149,6 +2217,9 @@ void MyFrame::OnClose(wxCloseEvent& event)
 
     StopCapturing();
 
+    // stop the guide thread before the worker thread that feeds it
+    StopGuideThread();
+
     bool killed = StopWorkerThread(m_pPrimaryWorkerThread);
     if (StopWorkerThread(m_pSecondaryWorkerThread))
         killed = true;
@@ -2248,6 +2319,7 @@ void MyFrame::NotifyGuidingStarted()
     m_guidingStarted = wxDateTime::UNow();
     m_guidingElapsed.Start();
     m_frameCounter = 0;
+    GuideLatency::Reset();
 
     if (pMount)
         pMount->NotifyGuidingStarted();
@@ -2268,6 +2340,7 @@ void MyFrame::NotifyGuidingStopped()
     if (pSecondaryMount)
         pSecondaryMount->NotifyGuidingStopped();
 
+    GuideLatency::LogSummary();
     EvtServer.NotifyGuidingStopped();
     GuideLog.GuidingStopped();
     PhdController::AbortController("Guiding stopped");
@@ -2387,7 +2460,8 @@ static bool save_multi_darks(const ExposureImgMap& darks, const wxString& fname,
     return bError;
 }
 
-static bool load_multi_darks(GuideCamera *camera, const wxString& fname)
+// loaded receives the frames read, which are owned by the camera
+static bool load_multi_darks(GuideCamera *camera, const wxString& fname, ExposureImgMap *loaded)
 {
     bool bError = false;
     fitsfile *fptr = 0;
@@ -2467,6 +2541,7 @@ static bool load_multi_darks(GuideCamera *camera, const wxString& fname)
 
                 Debug.Write(wxString::Format("loaded dark frame exposure = %d, med = %u\n", img->ImgExpDur, img->MedianADU));
 
+                (*loaded)[img->ImgExpDur] = img.get();
                 camera->AddDark(img.release());
 
                 // if this is the last hdu, we are done
@@ -2523,11 +2598,27 @@ bool MyFrame::DarkLibExists(int profileId, bool showAlert)
     if (wxFileExists(fileName))
     {
         const wxSize& sensorSize = pCamera->DarkFrameSize();
+        wxSize cachedSize;
         if (sensorSize == UNDEFINED_FRAME_SIZE)
         {
             bOk = true;
             Debug.Write("DarkLib check: undefined frame size for current camera\n");
         }
+        else if (!DarkCache::GetDarkFrameSize(fileName, &cachedSize))
+        {
+            // the cache header records the frame size, no need to open the FITS file
+            bOk = cachedSize == sensorSize;
+            if (!bOk)
+            {
+                Debug.Write(wxString::Format("DarkLib check: failed geometry check - cam dimensions = {%d,%d}, "
+                                             " cached dark dimensions = {%d,%d}\n",
+                                             sensorSize.x, sensorSize.y, cachedSize.x, cachedSize.y));
+
+                if (showAlert)
+                    Alert(_("Dark library does not match the camera in this profile. Check that you are "
+                            "connected to the camera you want to use for guiding."));
+            }
+        }
         else
         {
             fitsfile *fptr;
@@ -2630,19 +2721,29 @@ bool MyFrame::LoadDarkLibrary()
         return false;
     }
 
-    if (load_multi_darks(pCamera, filename))
+    // use the binary cache when it is up to date, otherwise read the FITS file and refresh the cache
+    std::vector<usImage *> cached;
+    if (!DarkCache::LoadDarks(filename, &cached))
     {
-        Debug.Write(wxString::Format("failed to load dark frames from %s\n", filename));
-        StatusMsg(_("Darks not loaded"));
-        return false;
+        for (auto it = cached.begin(); it != cached.end(); ++it)
+            pCamera->AddDark(*it);
     }
     else
     {
-        Debug.Write(wxString::Format("loaded dark library from %s\n", filename));
-        pCamera->SelectDark(m_exposureDuration);
-        StatusMsg(_("Darks loaded"));
-        return true;
+        ExposureImgMap loaded;
+        if (load_multi_darks(pCamera, filename, &loaded))
+        {
+            Debug.Write(wxString::Format("failed to load dark frames from %s\n", filename));
+            StatusMsg(_("Darks not loaded"));
+            return false;
+        }
+        DarkCache::SaveDarks(filename, loaded);
     }
+
+    Debug.Write(wxString::Format("loaded dark library from %s\n", filename));
+    pCamera->SelectDark(m_exposureDuration);
+    StatusMsg(_("Darks loaded"));
+    return true;
 }
 
 void MyFrame::SaveDarkLibrary(const wxString& note)
@@ -2654,7 +2755,10 @@ void MyFrame::SaveDarkLibrary(const wxString& note)
     if (save_multi_darks(pCamera->Darks, filename, note))
     {
         Alert(wxString::Format(_("Error saving darks FITS file %s"), filename));
+        DarkCache::Remove(filename);
     }
+    else
+        DarkCache::SaveDarks(filename, pCamera->Darks);
 }
 
 // Delete both the dark library file and any defect map file for this profile
@@ -2667,6 +2771,7 @@ void MyFrame::DeleteDarkLibraryFiles(int profileId)
         Debug.Write(wxString::Format("Removing dark library file: %s\n", filename));
         wxRemoveFile(filename);
     }
+    DarkCache::Remove(filename);
 
     DefectMap::DeleteDefectMap(profileId);
 }
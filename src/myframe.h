@@ -38,6 +38,7 @@
 #define MYFRAME_H_INCLUDED
 
 class WorkerThread;
+class GuideThread;
 class MyFrame;
 class RefineDefMap;
 struct alert_params;
@@ -47,6 +48,7 @@ enum E_MYFRAME_WORKER_THREAD_MESSAGES
 {
     MYFRAME_WORKER_THREAD_EXPOSE_COMPLETE = wxID_HIGHEST + 1,
     MYFRAME_WORKER_THREAD_MOVE_COMPLETE,
+    MYFRAME_GUIDE_FRAME_COMPLETE,
 };
 
 wxDECLARE_EVENT(REQUEST_EXPOSURE_EVENT, wxCommandEvent);
@@ -341,7 +343,8 @@ public:
     void OnImportCamCal(wxCommandEvent& evt);
 
     void OnExposeComplete(wxThreadEvent& evt);
-    void OnExposeComplete(usImage *image, bool err);
+    void OnExposeComplete(usImage *image, bool err, const FrameMeasurement *measurement = nullptr);
+    void OnGuideFrameComplete(wxThreadEvent& evt);
     void OnMoveComplete(wxThreadEvent& evt);
 
     void LoadProfileSettings();
@@ -404,13 +407,14 @@ public:
 
     void ScheduleExposure();
 
-    void SchedulePrimaryMove(Mount *mount, const GuiderOffset& ofs, unsigned int moveOptions);
+    void SchedulePrimaryMove(Mount *mount, const GuiderOffset& ofs, unsigned int moveOptions, wxLongLong_t frameTime);
     void ScheduleSecondaryMove(Mount *mount, const GuiderOffset& ofs, unsigned int moveOptions);
     void ScheduleAxisMove(Mount *mount, const GUIDE_DIRECTION direction, int duration, unsigned int moveOptions);
     void ScheduleManualMove(Mount *mount, const GUIDE_DIRECTION direction, int duration);
 
     void StartCapturing();
     bool StopCapturing();
+    bool EnqueueGuideFrame(usImage *image, FrameMeasurement *measurement);
     bool StartSingleExposure(int duration, const wxRect& subframe);
 
     bool AutoSelectStar(const wxRect& roi = wxRect());
@@ -480,6 +484,8 @@ private:
     wxCriticalSection m_CSpWorkerThread;
     WorkerThread *m_pPrimaryWorkerThread;
     WorkerThread *m_pSecondaryWorkerThread;
+    wxCriticalSection m_CSpGuideThread;
+    GuideThread *m_pGuideThread;
 
     wxSocketServer *SocketServer;
     wxTimer m_statusbarTimer;
@@ -495,6 +501,8 @@ private:
 
     bool StartWorkerThread(WorkerThread *& pWorkerThread);
     bool StopWorkerThread(WorkerThread *& pWorkerThread);
+    void StartGuideThread();
+    void StopGuideThread();
     void OnStatusMsg(wxThreadEvent& event);
     void DoAlert(const alert_params& params);
     void OnAlertButton(wxCommandEvent& evt);
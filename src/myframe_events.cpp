@@ -444,7 +444,7 @@ static void WarnRawImageMode(void)
  * - schedules another exposure if CaptureActive is stil true
  *
  */
-void MyFrame::OnExposeComplete(usImage *pNewFrame, bool err)
+void MyFrame::OnExposeComplete(usImage *pNewFrame, bool err, const FrameMeasurement *measurement)
 {
     try
     {
@@ -501,7 +501,7 @@ void MyFrame::OnExposeComplete(usImage *pNewFrame, bool err)
             CheckDarkFrameGeometry();
         }
 
-        pGuider->UpdateGuideState(pNewFrame, !m_continueCapturing);
+        pGuider->UpdateGuideState(pNewFrame, !m_continueCapturing, measurement);
         pNewFrame = NULL; // the guider owns it now
 
         PhdController::UpdateControllerState();
@@ -534,6 +534,14 @@ void MyFrame::OnExposeComplete(wxThreadEvent& event)
     OnExposeComplete(image, err);
 }
 
+void MyFrame::OnGuideFrameComplete(wxThreadEvent& event_)
+{
+    GuideFrameEvent& event = static_cast<GuideFrameEvent&>(event_);
+    usImage *image = event.image;
+    event.image = nullptr; // OnExposeComplete takes ownership
+    OnExposeComplete(image, false, event.measurement);
+}
+
 void MyFrame::OnMoveComplete(wxThreadEvent& event_)
 {
     try
@@ -0,0 +1,328 @@
+/*
+ *  noise_reduction.cpp
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "noise_reduction.h"
+
+namespace
+{
+inline void swap(unsigned short& a, unsigned short& b)
+{
+    unsigned short const t = a;
+    a = b;
+    b = t;
+}
+
+inline unsigned short median9(const unsigned short l[9])
+{
+    unsigned short l0 = l[0], l1 = l[1], l2 = l[2], l3 = l[3], l4 = l[4];
+    unsigned short x;
+    x = l[5];
+    if (x < l0)
+        swap(x, l0);
+    if (x < l1)
+        swap(x, l1);
+    if (x < l2)
+        swap(x, l2);
+    if (x < l3)
+        swap(x, l3);
+    if (x < l4)
+        swap(x, l4);
+    x = l[6];
+    if (x < l0)
+        swap(x, l0);
+    if (x < l1)
+        swap(x, l1);
+    if (x < l2)
+        swap(x, l2);
+    if (x < l3)
+        swap(x, l3);
+    if (x < l4)
+        swap(x, l4);
+    x = l[7];
+    if (x < l0)
+        swap(x, l0);
+    if (x < l1)
+        swap(x, l1);
+    if (x < l2)
+        swap(x, l2);
+    if (x < l3)
+        swap(x, l3);
+    if (x < l4)
+        swap(x, l4);
+    x = l[8];
+    if (x < l0)
+        swap(x, l0);
+    if (x < l1)
+        swap(x, l1);
+    if (x < l2)
+        swap(x, l2);
+    if (x < l3)
+        swap(x, l3);
+    if (x < l4)
+        swap(x, l4);
+
+    if (l1 > l0)
+        l0 = l1;
+    if (l2 > l0)
+        l0 = l2;
+    if (l3 > l0)
+        l0 = l3;
+    if (l4 > l0)
+        l0 = l4;
+
+    return l0;
+}
+
+inline unsigned short median6(const unsigned short l[6])
+{
+    unsigned short l0 = l[0], l1 = l[1], l2 = l[2], l3 = l[3];
+    unsigned short x;
+
+    x = l[4];
+    if (x < l0)
+        swap(x, l0);
+    if (x < l1)
+        swap(x, l1);
+    if (x < l2)
+        swap(x, l2);
+    if (x < l3)
+        swap(x, l3);
+    x = l[5];
+    if (x < l0)
+        swap(x, l0);
+    if (x < l1)
+        swap(x, l1);
+    if (x < l2)
+        swap(x, l2);
+    if (x < l3)
+        swap(x, l3);
+
+    if (l2 > l0)
+        swap(l2, l0);
+    if (l2 > l1)
+        swap(l2, l1);
+
+    if (l3 > l0)
+        swap(l3, l0);
+    if (l3 > l1)
+        swap(l3, l1);
+
+    return (unsigned short) (((unsigned int) l0 + (unsigned int) l1) / 2);
+}
+
+inline unsigned short median4(const unsigned short l[4])
+{
+    unsigned short l0 = l[0], l1 = l[1], l2 = l[2];
+    unsigned short x;
+    x = l[3];
+    if (x < l0)
+        swap(x, l0);
+    if (x < l1)
+        swap(x, l1);
+    if (x < l2)
+        swap(x, l2);
+
+    if (l2 > l0)
+        swap(l2, l0);
+    if (l2 > l1)
+        swap(l2, l1);
+
+    return (unsigned short) (((unsigned int) l0 + (unsigned int) l1) / 2);
+}
+
+} // namespace
+
+namespace NoiseReduction
+{
+
+void Mean2x2(unsigned short *dst, const unsigned short *src, int width, int rx, int ry, int rw, int rh)
+{
+    int const W = width;
+    int const RX = rx;
+    int const RY = ry;
+    int const RW = rw;
+    int const RH = rh;
+
+#define IX(x_, y_) ((RY + (y_)) * W + RX + (x_))
+
+    unsigned short *d;
+    unsigned int t;
+
+    for (int y = 0; y <= RH - 2; y++)
+    {
+        d = &dst[IX(0, y)];
+
+        for (int x = 0; x <= RW - 2; x++)
+        {
+            t = src[IX(x, y)];
+            t += src[IX(x + 1, y)];
+            t += src[IX(x, y + 1)];
+            t += src[IX(x + 1, y + 1)];
+            *d++ = (unsigned short) (t >> 2);
+        }
+
+        // last col
+        t = src[IX(RW - 1, y)];
+        t += src[IX(RW - 1, y + 1)];
+        *d = (unsigned short) (t >> 1);
+    }
+
+    // last row
+
+    d = &dst[IX(0, RH - 1)];
+
+    for (int x = 0; x <= RW - 2; x++)
+    {
+        t = src[IX(x, RH - 1)];
+        t += src[IX(x + 1, RH - 1)];
+        *d++ = (unsigned short) (t >> 1);
+    }
+
+    // bottom-right pixel
+    *d = src[IX(RW - 1, RH - 1)];
+
+#undef IX
+}
+
+void Median3(unsigned short *dst, const unsigned short *src, int width, int rx, int ry, int rw, int rh)
+{
+    int const W = width;
+    int const RX = rx;
+    int const RY = ry;
+    int const RW = rw;
+    int const RH = rh;
+
+    unsigned short a[9];
+    unsigned short *d;
+
+#define IX(x_, y_) ((RY + (y_)) * W + RX + (x_))
+
+    // top row
+    d = &dst[IX(0, 0)];
+
+    // top-left corner
+    a[0] = src[IX(0, 0)];
+    a[1] = src[IX(1, 0)];
+    a[2] = src[IX(0, 1)];
+    a[3] = src[IX(1, 1)];
+    *d++ = median4(a);
+
+    // top row middle pixels
+    for (int x = 1; x <= RW - 2; x++)
+    {
+        a[0] = src[IX(x - 1, 0)];
+        a[1] = src[IX(x, 0)];
+        a[2] = src[IX(x + 1, 0)];
+        a[3] = src[IX(x - 1, 1)];
+        a[4] = src[IX(x, 1)];
+        a[5] = src[IX(x + 1, 1)];
+        *d++ = median6(a);
+    }
+
+    // top-right corner
+    a[0] = src[IX(RW - 2, 0)];
+    a[1] = src[IX(RW - 1, 0)];
+    a[2] = src[IX(RW - 2, 1)];
+    a[3] = src[IX(RW - 1, 1)];
+    *d = median4(a);
+
+    for (int y = 1; y <= RH - 2; y++)
+    {
+        d = &dst[IX(0, y)];
+
+        // leftmost pixel
+        a[0] = src[IX(0, y - 1)];
+        a[1] = src[IX(1, y - 1)];
+        a[2] = src[IX(0, y)];
+        a[3] = src[IX(1, y)];
+        a[4] = src[IX(0, y + 1)];
+        a[5] = src[IX(1, y + 1)];
+        *d++ = median6(a);
+
+        for (int x = 1; x <= RW - 2; x++)
+        {
+            a[0] = src[IX(x - 1, y - 1)];
+            a[1] = src[IX(x, y - 1)];
+            a[2] = src[IX(x + 1, y - 1)];
+            a[3] = src[IX(x - 1, y)];
+            a[4] = src[IX(x, y)];
+            a[5] = src[IX(x + 1, y)];
+            a[6] = src[IX(x - 1, y + 1)];
+            a[7] = src[IX(x, y + 1)];
+            a[8] = src[IX(x + 1, y + 1)];
+            *d++ = median9(a);
+        }
+
+        // rightmost pixel
+        a[0] = src[IX(RW - 2, y - 1)];
+        a[1] = src[IX(RW - 1, y - 1)];
+        a[2] = src[IX(RW - 2, y)];
+        a[3] = src[IX(RW - 1, y)];
+        a[4] = src[IX(RW - 2, y + 1)];
+        a[5] = src[IX(RW - 1, y + 1)];
+        *d++ = median6(a);
+    }
+
+    // bottom row
+    d = &dst[IX(0, RH - 1)];
+
+    // bottom-left corner
+    a[0] = src[IX(0, RH - 2)];
+    a[1] = src[IX(1, RH - 2)];
+    a[2] = src[IX(0, RH - 1)];
+    a[3] = src[IX(1, RH - 1)];
+    *d++ = median4(a);
+
+    // bottom row middle pixels
+    for (int x = 1; x <= RW - 2; x++)
+    {
+        a[0] = src[IX(x - 1, RH - 2)];
+        a[1] = src[IX(x, RH - 2)];
+        a[2] = src[IX(x + 1, RH - 2)];
+        a[3] = src[IX(x - 1, RH - 1)];
+        a[4] = src[IX(x, RH - 1)];
+        a[5] = src[IX(x + 1, RH - 1)];
+        *d++ = median6(a);
+    }
+
+    // bottom-right corner
+    a[0] = src[IX(RW - 2, RH - 2)];
+    a[1] = src[IX(RW - 1, RH - 2)];
+    a[2] = src[IX(RW - 2, RH - 1)];
+    a[3] = src[IX(RW - 1, RH - 1)];
+    *d = median4(a);
+
+#undef IX
+}
+
+} // namespace NoiseReduction
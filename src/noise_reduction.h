@@ -0,0 +1,51 @@
+/*
+ *  noise_reduction.h
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef NOISE_REDUCTION_H_INCLUDED
+#define NOISE_REDUCTION_H_INCLUDED
+
+// Noise reduction filters applied to camera frames (see QuickLRecon and Median3 in
+// image_math.cpp), on raw pixel buffers so that they do not depend on wxWidgets.
+
+namespace NoiseReduction
+{
+// 2x2 mean of the rectangle (rx, ry, rw, rh) of src, an image of the given width, written to the
+// same rectangle of dst. Pixels in the last row and column average the pixels that are available.
+extern void Mean2x2(unsigned short *dst, const unsigned short *src, int width, int rx, int ry, int rw, int rh);
+
+// 3x3 median of the rectangle, the window being clipped at the edges of the rectangle.
+// rw and rh must be at least 2.
+extern void Median3(unsigned short *dst, const unsigned short *src, int width, int rx, int ry, int rw, int rh);
+}
+
+#endif // NOISE_REDUCTION_H_INCLUDED
@@ -599,6 +599,9 @@ bool PhdApp::OnInit()
     }
     wxSetlocale(LC_NUMERIC, "C");
 
+    // get a chance to write out the queued debug log lines if we crash
+    wxHandleFatalExceptions();
+
     wxTranslations::Get()->SetLanguage((wxLanguage) langid);
     Debug.Write(wxString::Format("locale: wxTranslations language set to %d\n", langid));
 
@@ -609,7 +612,11 @@ bool PhdApp::OnInit()
 
     PhdController::OnAppInit();
 
+    FitsWriter::Init();
     ImageLogger::Init();
+    unsigned int poolThreads = WorkerPool::Init();
+    Debug.Write(wxString::Format("WorkerPool: %d CPUs, started %u of %u threads\n", wxThread::GetCPUCount(), poolThreads,
+                                 WorkerPool::DefaultThreads()));
 
     wxImage::AddHandler(new wxJPEGHandler);
     wxImage::AddHandler(new wxPNGHandler);
@@ -635,6 +642,9 @@ int PhdApp::OnExit()
     assert(!pCamera);
 
     ImageLogger::Destroy();
+    FitsWriter::Destroy();
+    WorkerPool::Destroy();
+    FrameBufferPool::Destroy();
 
     PhdController::OnAppExit();
 
@@ -646,9 +656,18 @@ int PhdApp::OnExit()
     delete m_instanceChecker;
     m_instanceChecker = nullptr;
 
+    // write any queued debug log lines; anything logged after this is written synchronously
+    Debug.StopWriter();
+
     return wxApp::OnExit();
 }
 
+void PhdApp::OnFatalException()
+{
+    // the debug log writer thread may not have written the last lines before the crash
+    Debug.FlushOnCrash();
+}
+
 void PhdApp::OnInitCmdLine(wxCmdLineParser& parser)
 {
     parser.SetDesc(cmdLineDesc);
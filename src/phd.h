@@ -72,6 +72,8 @@
 #include <wx/thread.h>
 #include <wx/utils.h>
 
+#include <algorithm>
+#include <atomic>
 #include <functional>
 #include <map>
 #include <math.h>
@@ -183,11 +185,23 @@ WX_DEFINE_ARRAY_DOUBLE(double, ArrayOfDbl);
 #include "myframe.h"
 #include "debuglog.h"
 #include "worker_thread.h"
+#include "guide_thread.h"
 #include "event_server.h"
 #include "confirm_dialog.h"
 #include "phdcontrol.h"
 #include "runinbg.h"
+#include "worker_pool.h"
+#include "frame_buffer_pool.h"
+#include "frame_stats.h"
+#include "dark_subtract.h"
+#include "dark_model.h"
+#include "dark_stack.h"
+#include "sim_render.h"
+#include "autofind_engine.h"
+#include "guide_latency.h"
 #include "fitsiowrap.h"
+#include "fits_writer.h"
+#include "dark_cache.h"
 #include "imagelogger.h"
 
 class wxSingleInstanceChecker;
@@ -226,6 +240,7 @@ public:
     PhdApp();
     bool OnInit();
     int OnExit();
+    void OnFatalException() override;
     void OnInitCmdLine(wxCmdLineParser& parser);
     bool OnCmdLineParsed(wxCmdLineParser& parser);
     void TerminateApp();
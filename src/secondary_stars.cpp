@@ -0,0 +1,105 @@
+/*
+ *  secondary_stars.cpp
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "secondary_stars.h"
+
+#include <math.h>
+
+// a displacement of more than this many sigmas of the primary star's distance is a miss
+static const double MISS_SIGMAS = 2.5;
+// misses in a row before the reference point is reset
+static const unsigned int MAX_MISSES = 10;
+// displacements with a zero component before the star is dropped
+static const unsigned int MAX_ZERO_COUNT = 5;
+
+SecondaryStars::Use SecondaryStars::Classify(double dX, double dY, double primarySigma, unsigned int *zeroCount,
+                                             unsigned int *missCount)
+{
+    // exactly zero on both axes, probably a hot pixel
+    if (dX == 0. && dY == 0.)
+        return DROP;
+
+    // Handle zero-counting - suspect results of exactly zero movement
+    if (dX == 0. || dY == 0.)
+        ++*zeroCount;
+    else if (*zeroCount > 0)
+        --*zeroCount;
+
+    if (*zeroCount == MAX_ZERO_COUNT)
+        return DROP;
+
+    // Handle suspicious excursions - counted as "misses"
+    if (hypot(dX, dY) > MISS_SIGMAS * primarySigma)
+    {
+        if (++*missCount > MAX_MISSES)
+        {
+            *missCount = 0;
+            return RESET;
+        }
+        return MISS;
+    }
+    else if (*missCount > 0)
+        --*missCount;
+
+    return USE;
+}
+
+SecondaryStars::StabilityChange SecondaryStars::UpdateStabilizing(bool *stabilizing, double distance, unsigned int count,
+                                                                  double sigma, double sigmaX)
+{
+    if (count <= 5)
+    {
+        // get some data for primary star movement
+        *stabilizing = true;
+        return STABILITY_UNCHANGED;
+    }
+
+    if (!*stabilizing && distance > sigmaX * sigma)
+    {
+        *stabilizing = true;
+        return STABILIZING_STARTED;
+    }
+
+    if (*stabilizing && distance <= 2 * sigma)
+    {
+        *stabilizing = false;
+        return STABILIZING_ENDED;
+    }
+
+    return STABILITY_UNCHANGED;
+}
+
+bool SecondaryStars::WeightedOffset::Refines() const
+{
+    return m_count > 0 && hypot(X(), Y()) < hypot(m_primaryX, m_primaryY);
+}
@@ -0,0 +1,118 @@
+/*
+ *  secondary_stars.h
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef SECONDARY_STARS_H_INCLUDED
+#define SECONDARY_STARS_H_INCLUDED
+
+// The decisions GuiderMultiStar::RefineOffset makes about the secondary stars: where to look for
+// each star, whether its displacement from its reference point can be used, whether the primary
+// star is steady enough for the secondary stars to be used at all, and the SNR-weighted average
+// of the usable displacements. It does not depend on wxWidgets so that
+// tests/guide_loop_benchmark.cpp runs the same code.
+
+namespace SecondaryStars
+{
+// Where to search for a secondary star: where it was last found, or at its original offset from
+// the primary star if it was lost
+inline void SearchPos(double *x, double *y, bool wasLost, double lastX, double lastY, double primaryX, double primaryY,
+                      double offsetX, double offsetY)
+{
+    *x = wasLost ? primaryX + offsetX : lastX;
+    *y = wasLost ? primaryY + offsetY : lastY;
+}
+
+enum Use
+{
+    USE, // include the displacement in the average
+    DROP, // remove the star, it is probably a hot pixel
+    MISS, // suspicious excursion, ignore the star this time
+    RESET, // too many misses in a row, make its current position the reference point
+};
+
+// Classify the displacement (dX, dY) of a found secondary star from its reference point, given the
+// sigma of the primary star's distance from the lock position. Updates the star's counts of zero
+// displacements and misses
+extern Use Classify(double dX, double dY, double primarySigma, unsigned int *zeroCount, unsigned int *missCount);
+
+enum StabilityChange
+{
+    STABILITY_UNCHANGED,
+    STABILIZING_STARTED,
+    STABILIZING_ENDED,
+};
+
+// The secondary stars are not used while stabilizing: until the primary star has more than 5
+// distances to go by, and after a distance of more than sigmaX sigmas until it is back within 2
+// sigmas. count and sigma describe the distances so far, including this one
+extern StabilityChange UpdateStabilizing(bool *stabilizing, double distance, unsigned int count, double sigma,
+                                         double sigmaX);
+
+// SNR-weighted mean of the primary star's offset, with weight 1, and the usable secondary star
+// displacements, each weighted by its SNR relative to the primary star's
+class WeightedOffset
+{
+    double m_primaryX;
+    double m_primaryY;
+    double m_sumX;
+    double m_sumY;
+    double m_sumWeights;
+    unsigned int m_count;
+
+public:
+    WeightedOffset(double primaryX, double primaryY)
+        : m_primaryX(primaryX), m_primaryY(primaryY), m_sumX(primaryX), m_sumY(primaryY), m_sumWeights(1.), m_count(0)
+    {
+    }
+
+    // returns the weight given to the star
+    double Add(double dX, double dY, double snr, double primarySNR)
+    {
+        double wt = snr / primarySNR;
+        m_sumX += wt * dX;
+        m_sumY += wt * dY;
+        m_sumWeights += wt;
+        ++m_count;
+        return wt;
+    }
+
+    unsigned int Count() const { return m_count; }
+    double X() const { return m_sumX / m_sumWeights; }
+    double Y() const { return m_sumY / m_sumWeights; }
+
+    // the average is only applied if it includes a secondary star and is smaller than the
+    // primary star's offset
+    bool Refines() const;
+};
+}
+
+#endif // SECONDARY_STARS_H_INCLUDED
@@ -0,0 +1,288 @@
+/*
+ *  sim_render.cpp
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "sim_render.h"
+
+#include <algorithm>
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define SIM_RENDER_X86 1
+# if defined(_MSC_VER)
+#  include <intrin.h>
+#  define AVX2_TARGET
+# else
+#  define AVX2_TARGET __attribute__((target("avx2")))
+# endif
+#endif
+
+namespace
+{
+// regions smaller than this are not worth splitting
+const unsigned int MIN_PARALLEL_PIXELS = 256 * 1024;
+const int MIN_BAND_ROWS = 16;
+
+// the star image, in 1/256ths of the star's intensity
+const double STAR[5][5] = {
+    { 0.0, 0.8, 2.2, 0.8, 0.0 },
+    { 0.8, 16.6, 46.1, 16.6, 0.8 },
+    { 2.2, 46.1, 128.0, 46.1, 2.2 },
+    { 0.8, 16.6, 46.1, 16.6, 0.8 },
+    { 0.0, 0.8, 2.2, 0.8, 0.0 },
+};
+
+// call fn(y0, y1) for bands of rows covering [0, rh)
+template<typename F>
+void ForEachBand(int rw, int rh, unsigned int concurrency, SimRender::ParallelForFn pfor, const F& fn)
+{
+    unsigned int nbands = 1;
+    if (pfor && concurrency > 1 && (unsigned int) rw * (unsigned int) rh >= MIN_PARALLEL_PIXELS)
+        nbands = std::min(concurrency * 4, (unsigned int) std::max(rh / MIN_BAND_ROWS, 1));
+
+    if (nbands > 1)
+    {
+        (*pfor)(nbands,
+                [&](unsigned int i)
+                {
+                    int y0 = (int) ((long long) rh * i / nbands);
+                    int y1 = (int) ((long long) rh * (i + 1) / nbands);
+                    fn(y0, y1);
+                });
+    }
+    else
+        fn(0, rh);
+}
+
+// Each random value provides the noise of two pixels: pixel i uses half i & 1 of value i / 2.
+// npairs values are generated starting at pair number pc0; range must not exceed 65536.
+inline void random_pairs_impl(unsigned int *u, int npairs, unsigned int key, unsigned int pc0, unsigned int range)
+{
+    for (int i = 0; i < npairs; i++)
+    {
+        unsigned int const h = SimRender::Random(key, pc0 + i);
+        u[2 * i] = ((h & 0xffff) * range) >> 16;
+        u[2 * i + 1] = ((h >> 16) * range) >> 16;
+    }
+}
+
+void random_pairs(unsigned int *u, int npairs, unsigned int key, unsigned int pc0, unsigned int range)
+{
+    random_pairs_impl(u, npairs, key, pc0, range);
+}
+
+#if defined(SIM_RENDER_X86)
+
+AVX2_TARGET void random_pairs_avx2(unsigned int *u, int npairs, unsigned int key, unsigned int pc0, unsigned int range)
+{
+    // the same code, vectorized by the compiler for AVX2
+    random_pairs_impl(u, npairs, key, pc0, range);
+}
+
+bool HaveAVX2()
+{
+# if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    if (!osxsave || (_xgetbv(0) & 6) != 6) // OS saves the YMM registers
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+# else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+# endif
+}
+
+#endif // SIM_RENDER_X86
+
+typedef void (*RandomPairsFn)(unsigned int *u, int npairs, unsigned int key, unsigned int pc0, unsigned int range);
+
+RandomPairsFn SelectRandomPairs()
+{
+#if defined(SIM_RENDER_X86)
+    if (HaveAVX2())
+        return random_pairs_avx2;
+#endif
+    return random_pairs;
+}
+
+// random integers in [0, range) for the n pixels of a row starting at pixel number idx; buf
+// must hold n + 2 values. Returns a pointer to the first value.
+inline const unsigned int *random_row(unsigned int *buf, int n, unsigned int key, unsigned int idx, unsigned int range)
+{
+    static const RandomPairsFn s_randomPairs = SelectRandomPairs();
+
+    unsigned int const pc0 = idx >> 1;
+    unsigned int const pc1 = (idx + n + 1) >> 1;
+    (*s_randomPairs)(buf, (int) (pc1 - pc0), key, pc0, range);
+    return buf + (idx & 1);
+}
+
+const int ROW_CHUNK = 1024;
+} // namespace
+
+void SimRender::Rng::Normal(double r[2])
+{
+    // Box-Muller
+    double const u = Uniform();
+    double const v = Uniform();
+    double const a = sqrt(-2.0 * log(u));
+    double const p = 6.283185307179586 * v; // 2 pi, M_PI is not standard
+    r[0] = a * cos(p);
+    r[1] = a * sin(p);
+}
+
+void SimRender::FillNoise(unsigned short *data, int width, int rx, int ry, int rw, int rh, double base, double scale,
+                          unsigned int range, unsigned int key, unsigned int concurrency, ParallelForFn pfor)
+{
+    if (rw <= 0 || rh <= 0 || range == 0 || range > 65536)
+        return;
+
+    float const b = (float) (base * scale);
+    float const s = (float) scale;
+
+    ForEachBand(rw, rh, concurrency, pfor,
+                [&](int y0, int y1)
+                {
+                    unsigned int buf[ROW_CHUNK + 2];
+                    for (int y = ry + y0; y < ry + y1; y++)
+                    {
+                        unsigned short *row = data + (size_t) y * width;
+                        for (int x0 = rx; x0 < rx + rw; x0 += ROW_CHUNK)
+                        {
+                            int const n = std::min(ROW_CHUNK, rx + rw - x0);
+                            unsigned int const idx = (unsigned int) y * (unsigned int) width + x0;
+                            const unsigned int *u = random_row(buf, n, key, idx, range);
+                            unsigned short *p = row + x0;
+                            for (int i = 0; i < n; i++)
+                            {
+                                float const v = b + s * (float) u[i];
+                                p[i] = (unsigned short) std::min(v, 65535.f);
+                            }
+                        }
+                    }
+                });
+}
+
+void SimRender::BlendClouds(unsigned short *data, int width, int rx, int ry, int rw, int rh, double inten, double base,
+                            unsigned int range, double opacity, unsigned int key, unsigned int concurrency, ParallelForFn pfor)
+{
+    if (rw <= 0 || rh <= 0 || range == 0 || range > 65536)
+        return;
+
+    float const cb = (float) (inten * base);
+    float const cs = (float) (inten / 30.0);
+    float const op = (float) opacity;
+
+    ForEachBand(rw, rh, concurrency, pfor,
+                [&](int y0, int y1)
+                {
+                    unsigned int buf[ROW_CHUNK + 2];
+                    for (int y = ry + y0; y < ry + y1; y++)
+                    {
+                        unsigned short *row = data + (size_t) y * width;
+                        for (int x0 = rx; x0 < rx + rw; x0 += ROW_CHUNK)
+                        {
+                            int const n = std::min(ROW_CHUNK, rx + rw - x0);
+                            unsigned int const idx = (unsigned int) y * (unsigned int) width + x0;
+                            const unsigned int *u = random_row(buf, n, key, idx, range);
+                            unsigned short *p = row + x0;
+                            for (int i = 0; i < n; i++)
+                            {
+                                float const cloud = (float) (unsigned short) std::min(cb + cs * (float) u[i], 65535.f);
+                                p[i] = (unsigned short) (op * cloud + (1.f - op) * (float) p[i]);
+                            }
+                        }
+                    }
+                });
+}
+
+void SimRender::AddStar(unsigned short *data, int width, int height, int x0, int y0, int x1, int y1, double x, double y,
+                        double inten)
+{
+    enum
+    {
+        WIDTH = 5
+    };
+
+    double ix, iy;
+    double fx = modf(x, &ix);
+    double fy = modf(y, &iy);
+    double f00 = (1.0 - fx) * (1.0 - fy);
+    double f01 = (1.0 - fx) * fy;
+    double f10 = fx * (1.0 - fy);
+    double f11 = fx * fy;
+
+    // shift the stamp by the sub-pixel offset
+    double d[WIDTH + 1][WIDTH + 1] = { { 0.0 } };
+    for (unsigned int i = 0; i < WIDTH; i++)
+        for (unsigned int j = 0; j < WIDTH; j++)
+        {
+            double s = STAR[i][j];
+            if (s > 0.0)
+            {
+                s *= inten / 256.0;
+                d[i][j] += f00 * s;
+                d[i + 1][j] += f10 * s;
+                d[i][j + 1] += f01 * s;
+                d[i + 1][j + 1] += f11 * s;
+            }
+        }
+
+    int const cx0 = (int) ix - (WIDTH - 1) / 2;
+    int const cy0 = (int) iy - (WIDTH - 1) / 2;
+
+    for (unsigned int i = 0; i < WIDTH + 1; i++)
+    {
+        int const cx = cx0 + i;
+        if (cx < x0 || cx > x1 || cx < 0 || cx >= width)
+            continue;
+        for (unsigned int j = 0; j < WIDTH + 1; j++)
+        {
+            int const cy = cy0 + j;
+            if (cy < y0 || cy > y1 || cy < 0 || cy >= height)
+                continue;
+            int incr = (int) d[i][j];
+            if (incr > 65535)
+                incr = 65535;
+            unsigned short *p = data + (size_t) cy * width + cx;
+            unsigned int t = *p + (unsigned int) incr;
+            *p = (unsigned short) std::min(t, 65535U);
+        }
+    }
+}
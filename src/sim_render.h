@@ -0,0 +1,110 @@
+/*
+ *  sim_render.h
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef SIM_RENDER_H_INCLUDED
+#define SIM_RENDER_H_INCLUDED
+
+#include <functional>
+
+// Image rendering for the camera simulator.
+//
+// Random values come from a counter-based generator: the value for a given key and counter is a
+// fixed function (a keyed integer hash) of the two. The noise of each pixel is computed from its
+// position, so the frame can be filled a band of rows at a time on several threads, or a
+// subframe at a time, and a given key always produces the same image.
+
+namespace SimRender
+{
+typedef void (*ParallelForFn)(unsigned int count, const std::function<void(unsigned int)>& fn);
+
+inline unsigned int Hash(unsigned int x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+// the random value number counter of the sequence identified by key
+inline unsigned int Random(unsigned int key, unsigned int counter)
+{
+    return Hash(Hash(counter) ^ key);
+}
+
+// key of one of the independent sequences (stream) of a frame
+inline unsigned int Key(unsigned int seed, unsigned int frame, unsigned int stream)
+{
+    return Hash(Hash(Hash(seed) ^ frame) + stream);
+}
+
+// a sequence of random values
+class Rng
+{
+    unsigned int m_key;
+    unsigned int m_counter;
+
+public:
+    Rng(unsigned int key) : m_key(key), m_counter(0) { }
+
+    unsigned int Next() { return Random(m_key, m_counter++); }
+    // uniform integer in [0, n)
+    unsigned int Below(unsigned int n) { return (unsigned int) (((unsigned long long) Next() * n) >> 32); }
+    // uniform in (0, 1]
+    double Uniform() { return ((double) Next() + 1.) / 4294967296.; }
+    // a pair of independent normally distributed values, sigma = 1
+    void Normal(double r[2]);
+};
+
+// Set each pixel of the rectangle (rx, ry, rw, rh) of an image of the given width to
+// scale * (base + u), where u is a random integer in [0, range), range <= 65536. pfor (may be
+// null) is used to process up to concurrency bands of rows at once.
+extern void FillNoise(unsigned short *data, int width, int rx, int ry, int rw, int rh, double base, double scale,
+                      unsigned int range, unsigned int key, unsigned int concurrency = 1, ParallelForFn pfor = nullptr);
+
+// Blend clouds over the rectangle: each pixel becomes opacity * inten * (base + u / 30) +
+// (1 - opacity) * pixel, with u a random integer in [0, range), range <= 65536
+extern void BlendClouds(unsigned short *data, int width, int rx, int ry, int rw, int rh, double inten, double base,
+                        unsigned int range, double opacity, unsigned int key, unsigned int concurrency = 1,
+                        ParallelForFn pfor = nullptr);
+
+// Add a star of the given intensity centered at (x, y) to an image of the given size, using a
+// 5x5 PSF stamp shifted by the sub-pixel part of the position. Only pixels with x0 <= x <= x1 and
+// y0 <= y <= y1 are changed.
+extern void AddStar(unsigned short *data, int width, int height, int x0, int y0, int x1, int y1, double x, double y,
+                    double inten);
+}
+
+#endif // SIM_RENDER_H_INCLUDED
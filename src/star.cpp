@@ -36,6 +36,8 @@
  */
 
 #include "phd.h"
+#include "star_kernels.h"
+#include "star_measure.h"
 #include <algorithm>
 
 Star::Star()
@@ -69,58 +71,15 @@ void Star::SetError(FindResult error)
     m_lastFindResult = error;
 }
 
-// helper struct for HFR calculation
-struct R2M
+// the kernels used by StarMeasure are selected for the CPU on first use
+static void LogStarKernels()
 {
-    double r2;
-    wxPoint p;
-    double m;
-    R2M() { }
-    R2M(int x, int y, double m_) : p(x, y), m(m_) { }
-    bool operator<(const R2M& rhs) const { return r2 < rhs.r2; }
-};
-
-static double hfr(std::vector<R2M>& vec, double cx, double cy, double mass)
-{
-    if (vec.size() == 1) // hot pixel?
-        return 0.25;
-
-    // compute Half Flux Radius (HFR)
-    for (auto it = vec.begin(); it != vec.end(); ++it)
+    static const bool s_logged = []()
     {
-        double dx = (double) it->p.x - cx;
-        double dy = (double) it->p.y - cy;
-        it->r2 = dx * dx + dy * dy;
-    }
-    std::sort(vec.begin(), vec.end()); // sort by ascending radius^2
-
-    // find radius of half-mass
-    double r20, r21, m0, m1;
-    r20 = r21 = m0 = m1 = 0.0;
-    double halfm = 0.5 * mass;
-    for (auto it = vec.begin(); it != vec.end(); ++it)
-    {
-        const R2M& rm = *it;
-        r20 = r21;
-        m0 = m1;
-        r21 = rm.r2;
-        m1 += rm.m;
-        if (m1 > halfm)
-            break;
-    }
-
-    // interpolate
-    double hfr;
-    if (m1 > m0)
-    {
-        double r0 = sqrt(r20), r1 = sqrt(r21);
-        double s = (r1 - r0) / (m1 - m0);
-        hfr = r0 + s * (halfm - m0);
-    }
-    else
-        hfr = 0.25;
-
-    return hfr;
+        Debug.Write(wxString::Format("Star::Find using %s kernels\n", StarKernels::Get().name));
+        return true;
+    }();
+    POSSIBLY_UNUSED(s_logged);
 }
 
 bool Star::Find(const usImage *pImg, int searchRegion, int base_x, int base_y, FindMode mode, double minHFD, double maxHFD,
@@ -153,247 +112,47 @@ bool Star::Find(const usImage *pImg, int searchRegion, int base_x, int base_y, F
             maxy = pImg->Subframe.GetBottom();
         }
 
-        // search region bounds
-        int start_x = wxMax(base_x - searchRegion, minx);
-        int end_x = wxMin(base_x + searchRegion, maxx);
-        int start_y = wxMax(base_y - searchRegion, miny);
-        int end_y = wxMin(base_y + searchRegion, maxy);
+        LogStarKernels();
 
-        if (end_x <= start_x || end_y <= start_y)
+        StarMeasure::Result m;
+        if (StarMeasure::Measure(&m, pImg->ImageData, pImg->Size.GetWidth(), minx, miny, maxx, maxy, base_x, base_y,
+                                 searchRegion, mode == FIND_PEAK ? StarMeasure::MODE_PEAK : StarMeasure::MODE_CENTROID))
         {
             throw ERROR_INFO("coordinates are invalid");
         }
 
-        const unsigned short *imgdata = pImg->ImageData;
-        int rowsize = pImg->Size.GetWidth();
-
-        int peak_x = 0, peak_y = 0;
-        unsigned int peak_val = 0;
-        unsigned short max3[3] = { 0, 0, 0 };
-
-        if (mode == FIND_PEAK)
-        {
-            for (int y = start_y; y <= end_y; y++)
-            {
-                for (int x = start_x; x <= end_x; x++)
-                {
-                    unsigned short val = imgdata[y * rowsize + x];
-
-                    if (val > peak_val)
-                    {
-                        peak_val = val;
-                        peak_x = x;
-                        peak_y = y;
-                    }
-                }
-            }
-
-            PeakVal = peak_val;
-        }
-        else
-        {
-            // find the peak value within the search region using a smoothing function
-            // also check for saturation
-
-            for (int y = start_y + 1; y <= end_y - 1; y++)
-            {
-                for (int x = start_x + 1; x <= end_x - 1; x++)
-                {
-                    unsigned short p = imgdata[y * rowsize + x];
-                    unsigned int val = 4 * (unsigned int) p + imgdata[(y - 1) * rowsize + (x - 1)] +
-                        imgdata[(y - 1) * rowsize + (x + 1)] + imgdata[(y + 1) * rowsize + (x - 1)] +
-                        imgdata[(y + 1) * rowsize + (x + 1)] + 2 * imgdata[(y - 1) * rowsize + (x + 0)] +
-                        2 * imgdata[(y + 0) * rowsize + (x - 1)] + 2 * imgdata[(y + 0) * rowsize + (x + 1)] +
-                        2 * imgdata[(y + 1) * rowsize + (x + 0)];
-
-                    if (val > peak_val)
-                    {
-                        peak_val = val;
-                        peak_x = x;
-                        peak_y = y;
-                    }
-
-                    if (p > max3[0])
-                        std::swap(p, max3[0]);
-                    if (p > max3[1])
-                        std::swap(p, max3[1]);
-                    if (p > max3[2])
-                        std::swap(p, max3[2]);
-                }
-            }
-
-            PeakVal = max3[0]; // raw peak val
-            peak_val /= 16; // smoothed peak value
-        }
-
-        // measure noise in the annulus with inner radius A and outer radius B
-        int const A = 7; // inner radius
-        int const B = 12; // outer radius
-        int const A2 = A * A;
-        int const B2 = B * B;
+        if (m.tooFewBackground)
+            Debug.Write(wxString::Format("Star::Find: too few background points! nbg=%u mean=%.1f sigma=%.1f\n", m.nbg,
+                                         m.meanBg, m.sigmaBg));
 
-        // center window around peak value
-        start_x = wxMax(peak_x - B, minx);
-        end_x = wxMin(peak_x + B, maxx);
-        start_y = wxMax(peak_y - B, miny);
-        end_y = wxMin(peak_y + B, maxy);
+        PeakVal = m.peakVal;
+        Mass = m.mass;
+        SNR = m.snr;
 
-        // find the mean and stdev of the background
-
-        unsigned int nbg;
-        double mean_bg = 0., prev_mean_bg;
-        double sigma2_bg = 0.;
-        double sigma_bg = 0.;
-
-        for (int iter = 0; iter < 9; iter++)
+        if (m.falseStar)
         {
-            double sum = 0.0;
-            double a = 0.0;
-            double q = 0.0;
-            nbg = 0;
-
-            const unsigned short *row = imgdata + rowsize * start_y;
-            for (int y = start_y; y <= end_y; y++, row += rowsize)
-            {
-                int dy = y - peak_y;
-                int dy2 = dy * dy;
-                for (int x = start_x; x <= end_x; x++)
-                {
-                    int dx = x - peak_x;
-                    int r2 = dx * dx + dy2;
-
-                    // exclude points not in annulus
-                    if (r2 <= A2 || r2 > B2)
-                        continue;
-
-                    double const val = (double) row[x];
-
-                    if (iter > 0 && (val < mean_bg - 2.0 * sigma_bg || val > mean_bg + 2.0 * sigma_bg))
-                        continue;
-
-                    sum += val;
-                    ++nbg;
-                    double const k = (double) nbg;
-                    double const a0 = a;
-                    a += (val - a) / k;
-                    q += (val - a0) * (val - a);
-                }
-            }
-
-            if (nbg < 10) // only possible after the first iteration
-            {
-                Debug.Write(wxString::Format("Star::Find: too few background points! nbg=%u mean=%.1f sigma=%.1f\n", nbg,
-                                             mean_bg, sigma_bg));
-                break;
-            }
-
-            prev_mean_bg = mean_bg;
-            mean_bg = sum / (double) nbg;
-            sigma2_bg = q / (double) (nbg - 1);
-            sigma_bg = sqrt(sigma2_bg);
-
-            if (iter > 0 && fabs(mean_bg - prev_mean_bg) < 0.5)
-                break;
+            Debug.Write(wxString::Format("Star::Find false star n=%u nbg=%u bg=%.1f sigma=%.1f thresh=%u peak=%u\n", m.n, m.nbg,
+                                         m.meanBg, m.sigmaBg, m.thresh, m.smoothedPeak));
         }
 
-        unsigned short thresh;
-
-        double cx = 0.0;
-        double cy = 0.0;
-        double mass = 0.0;
-        unsigned int n;
-
-        std::vector<R2M> hfrvec;
-
-        if (mode == FIND_PEAK)
-        {
-            mass = peak_val;
-            n = 1;
-            thresh = 0;
-        }
-        else
-        {
-            thresh = (unsigned short) (mean_bg + 3.0 * sigma_bg + 0.5);
-
-            // find pixels over threshold within aperture; compute mass and centroid
-
-            start_x = wxMax(peak_x - A, minx);
-            end_x = wxMin(peak_x + A, maxx);
-            start_y = wxMax(peak_y - A, miny);
-            end_y = wxMin(peak_y + A, maxy);
-
-            n = 0;
-
-            const unsigned short *row = imgdata + rowsize * start_y;
-            for (int y = start_y; y <= end_y; y++, row += rowsize)
-            {
-                int dy = y - peak_y;
-                int dy2 = dy * dy;
-                if (dy2 > A2)
-                    continue;
-
-                for (int x = start_x; x <= end_x; x++)
-                {
-                    int dx = x - peak_x;
-
-                    // exclude points outside aperture
-                    if (dx * dx + dy2 > A2)
-                        continue;
-
-                    // exclude points below threshold
-                    unsigned short val = row[x];
-                    if (val < thresh)
-                        continue;
-
-                    double const d = (double) val - mean_bg;
-
-                    cx += dx * d;
-                    cy += dy * d;
-                    mass += d;
-                    ++n;
-
-                    hfrvec.push_back(R2M(x, y, d));
-                }
-            }
-        }
-
-        Mass = mass;
-
-        // SNR estimate from: Measuring the Signal-to-Noise Ratio S/N of the CCD Image of a Star or Nebula, J.H.Simonetti, 2004
-        // January 8
-        //     http://www.phys.vt.edu/~jhs/phys3154/snr20040108.pdf
-        double const gain = .5; // electrons per ADU, nominal
-        SNR = n > 0 ? mass / sqrt(mass / gain + sigma2_bg * (double) n * (1.0 + 1.0 / (double) nbg)) : 0.0;
-
-        double const LOW_SNR = 3.0;
-
-        // a few scattered pixels over threshold can give a false positive
-        // avoid this by requiring the smoothed peak value to be above the threshold
-        if (peak_val <= thresh && SNR >= LOW_SNR)
-        {
-            Debug.Write(wxString::Format("Star::Find false star n=%u nbg=%u bg=%.1f sigma=%.1f thresh=%u peak=%u\n", n, nbg,
-                                         mean_bg, sigma_bg, thresh, peak_val));
-            SNR = LOW_SNR - 0.1;
-        }
-
-        if (mass < 10.0)
+        if (m.mass < StarMeasure::MIN_MASS)
         {
             HFD = 0.;
             Result = STAR_LOWMASS;
             goto done;
         }
 
-        if (SNR < LOW_SNR)
+        if (m.snr < StarMeasure::LOW_SNR)
         {
             HFD = 0.;
             Result = STAR_LOWSNR;
             goto done;
         }
 
-        newX = peak_x + cx / mass;
-        newY = peak_y + cy / mass;
+        newX = m.x;
+        newY = m.y;
 
-        HFD = 2.0 * hfr(hfrvec, newX, newY, mass);
+        HFD = m.hfd;
         // Check for constraints on HFD value
         if (mode != FIND_PEAK)
         {
@@ -411,7 +170,7 @@ bool Star::Find(const usImage *pImg, int searchRegion, int base_x, int base_y, F
 
         // check for saturation
 
-        unsigned int mx = (unsigned int) max3[0];
+        unsigned int mx = (unsigned int) m.max3[0];
 
         // remove pedestal
         if (mx >= pImg->Pedestal)
@@ -432,7 +191,7 @@ bool Star::Find(const usImage *pImg, int searchRegion, int base_x, int base_y, F
         // even at saturation, the max values may vary a bit due to noise
         // Call it saturated if the the top three values are within 32 parts per 65535 of max for 16-bit cameras,
         // or within 1 part per 191 for 8-bit cameras
-        unsigned int d = (unsigned int) (max3[0] - max3[2]);
+        unsigned int d = (unsigned int) (m.max3[0] - m.max3[2]);
 
         if (pImg->BitsPerPixel < 12)
         {
@@ -571,90 +330,6 @@ static void SaveImage(const FloatImg& img, const char *name)
 #endif // SAVE_AUTOFIND_IMG
 }
 
-static void psf_conv(FloatImg& dst, const FloatImg& src)
-{
-    dst.Init(src.Size);
-
-    //                       A      B1     B2    C1     C2    C3     D1     D2     D3
-    const double PSF[] = { 0.906, 0.584, 0.365, .117, .049, -0.05, -.064, -.074, -.094 };
-
-    int const width = src.Size.GetWidth();
-    int const height = src.Size.GetHeight();
-
-    memset(dst.px, 0, src.NPixels * sizeof(float));
-
-    /* PSF Grid is:
-    D3 D3 D3 D3 D3 D3 D3 D3 D3
-    D3 D3 D3 D2 D1 D2 D3 D3 D3
-    D3 D3 C3 C2 C1 C2 C3 D3 D3
-    D3 D2 C2 B2 B1 B2 C2 D2 D3
-    D3 D1 C1 B1 A  B1 C1 D1 D3
-    D3 D2 C2 B2 B1 B2 C2 D2 D3
-    D3 D3 C3 C2 C1 C2 C3 D3 D3
-    D3 D3 D3 D2 D1 D2 D3 D3 D3
-    D3 D3 D3 D3 D3 D3 D3 D3 D3
-
-    1@A
-    4@B1, B2, C1, C3, D1
-    8@C2, D2
-    44 * D3
-    */
-
-    int psf_size = 4;
-
-    for (int y = psf_size; y < height - psf_size; y++)
-    {
-        for (int x = psf_size; x < width - psf_size; x++)
-        {
-            float A, B1, B2, C1, C2, C3, D1, D2, D3;
-
-#define PX(dx, dy) *(src.px + width * (y + (dy)) + x + (dx))
-            A = PX(+0, +0);
-            B1 = PX(+0, -1) + PX(+0, +1) + PX(+1, +0) + PX(-1, +0);
-            B2 = PX(-1, -1) + PX(+1, -1) + PX(-1, +1) + PX(+1, +1);
-            C1 = PX(+0, -2) + PX(-2, +0) + PX(+2, +0) + PX(+0, +2);
-            C2 = PX(-1, -2) + PX(+1, -2) + PX(-2, -1) + PX(+2, -1) + PX(-2, +1) + PX(+2, +1) + PX(-1, +2) + PX(+1, +2);
-            C3 = PX(-2, -2) + PX(+2, -2) + PX(-2, +2) + PX(+2, +2);
-            D1 = PX(+0, -3) + PX(-3, +0) + PX(+3, +0) + PX(+0, +3);
-            D2 = PX(-1, -3) + PX(+1, -3) + PX(-3, -1) + PX(+3, -1) + PX(-3, +1) + PX(+3, +1) + PX(-1, +3) + PX(+1, +3);
-            D3 = PX(-4, -2) + PX(-3, -2) + PX(+3, -2) + PX(+4, -2) + PX(-4, -1) + PX(+4, -1) + PX(-4, +0) + PX(+4, +0) +
-                PX(-4, +1) + PX(+4, +1) + PX(-4, +2) + PX(-3, +2) + PX(+3, +2) + PX(+4, +2);
-#undef PX
-            int i;
-            const float *uptr;
-
-            uptr = src.px + width * (y - 4) + (x - 4);
-            for (i = 0; i < 9; i++)
-                D3 += *uptr++;
-
-            uptr = src.px + width * (y - 3) + (x - 4);
-            for (i = 0; i < 3; i++)
-                D3 += *uptr++;
-            uptr += 3;
-            for (i = 0; i < 3; i++)
-                D3 += *uptr++;
-
-            uptr = src.px + width * (y + 3) + (x - 4);
-            for (i = 0; i < 3; i++)
-                D3 += *uptr++;
-            uptr += 3;
-            for (i = 0; i < 3; i++)
-                D3 += *uptr++;
-
-            uptr = src.px + width * (y + 4) + (x - 4);
-            for (i = 0; i < 9; i++)
-                D3 += *uptr++;
-
-            double mean = (A + B1 + B2 + C1 + C2 + C3 + D1 + D2 + D3) / 81.0;
-            double PSF_fit = PSF[0] * (A - mean) + PSF[1] * (B1 - 4.0 * mean) + PSF[2] * (B2 - 4.0 * mean) +
-                PSF[3] * (C1 - 4.0 * mean) + PSF[4] * (C2 - 8.0 * mean) + PSF[5] * (C3 - 4.0 * mean) +
-                PSF[6] * (D1 - 4.0 * mean) + PSF[7] * (D2 - 8.0 * mean) + PSF[8] * (D3 - 44.0 * mean);
-
-            dst.px[width * y + x] = (float) PSF_fit;
-        }
-    }
-}
-
 static void Downsample(FloatImg& dst, const FloatImg& src, int downsample)
 {
     int width = src.Size.GetWidth();
@@ -778,14 +453,15 @@ bool GuideStar::AutoFind(const usImage& image, int extraEdgeAllowance, int searc
 
     // run the PSF convolution
     {
-        FloatImg tmp;
-        psf_conv(tmp, conv);
+        FloatImg tmp(conv.Size);
+        AutoFindEngine::PsfConv(tmp.px, conv.px, conv.Size.GetWidth(), conv.Size.GetHeight(), WorkerPool::Concurrency(),
+                                &WorkerPool::ParallelFor);
         conv.Swap(tmp);
     }
 
     enum
     {
-        CONV_RADIUS = 4
+        CONV_RADIUS = AutoFindEngine::CONV_RADIUS
     };
     int dw = conv.Size.GetWidth(); // width of the downsampled image
     int dh = conv.Size.GetHeight(); // height of the downsampled image
@@ -808,57 +484,19 @@ bool GuideStar::AutoFind(const usImage& image, int extraEdgeAllowance, int searc
     Debug.Write(wxString::Format("AutoFind: using threshold = %.1f\n", threshold));
 
     // find each local maximum
-    int srch = 4;
-    for (int y = convRect.GetTop() + srch; y <= convRect.GetBottom() - srch; y++)
-    {
-        for (int x = convRect.GetLeft() + srch; x <= convRect.GetRight() - srch; x++)
-        {
-            float val = conv.px[dw * y + x];
-            bool ismax = false;
-            if (val > 0.0)
-            {
-                ismax = true;
-                for (int j = -srch; j <= srch; j++)
-                {
-                    for (int i = -srch; i <= srch; i++)
-                    {
-                        if (i == 0 && j == 0)
-                            continue;
-                        if (conv.px[dw * (y + j) + (x + i)] > val)
-                        {
-                            ismax = false;
-                            break;
-                        }
-                    }
-                }
-            }
-            if (!ismax)
-                continue;
+    std::vector<AutoFindEngine::Candidate> candidates;
+    AutoFindEngine::FindPeaks(&candidates, conv.px, dw, convRect.x, convRect.y, convRect.width, convRect.height, global_stdev,
+                              threshold, WorkerPool::Concurrency(), &WorkerPool::ParallelFor);
 
-            // compare local maximum to mean value of surrounding pixels
-            const int local = 7;
-            double local_mean, local_stdev;
-            wxRect localRect(x - local, y - local, 2 * local + 1, 2 * local + 1);
-            localRect.Intersect(convRect);
-            GetStats(&local_mean, &local_stdev, conv, localRect);
-
-            // this is our measure of star intensity
-            double h = (val - local_mean) / global_stdev;
-
-            if (h < threshold)
-            {
-                //  Debug.Write(wxString::Format("AG: local max REJECT [%d, %d] PSF %.1f SNR %.1f\n", imgx, imgy, val, SNR));
-                continue;
-            }
-
-            // coordinates on the original image
-            int imgx = x * downsample + downsample / 2;
-            int imgy = y * downsample + downsample / 2;
+    for (std::vector<AutoFindEngine::Candidate>::const_iterator it = candidates.begin(); it != candidates.end(); ++it)
+    {
+        // coordinates on the original image
+        int imgx = it->x * downsample + downsample / 2;
+        int imgy = it->y * downsample + downsample / 2;
 
-            stars.insert(Peak(imgx, imgy, h));
-            if (stars.size() > TOP_N)
-                stars.erase(stars.begin());
-        }
+        stars.insert(Peak(imgx, imgy, it->h));
+        if (stars.size() > TOP_N)
+            stars.erase(stars.begin());
     }
 
     for (std::set<Peak>::const_reverse_iterator it = stars.rbegin(); it != stars.rend(); ++it)
@@ -0,0 +1,523 @@
+/*
+ *  star_kernels.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "star_kernels.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define STAR_KERNELS_X86 1
+# include <emmintrin.h>
+# include <immintrin.h>
+# if defined(_MSC_VER)
+#  include <intrin.h>
+#  define AVX2_TARGET
+# else
+#  define AVX2_TARGET __attribute__((target("avx2")))
+# endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+# define STAR_KERNELS_NEON 1
+# include <arm_neon.h>
+#endif
+
+namespace StarKernels
+{
+
+//
+// scalar reference kernels
+//
+
+static unsigned int SmoothRowScalar(const unsigned short *r0, const unsigned short *r1, const unsigned short *r2, int n,
+                                    unsigned int *tmp, unsigned int *out)
+{
+    if (n < 3)
+        return 0;
+
+    // the kernel is separable: [1 2 1] vertically, then [1 2 1] horizontally
+    for (int i = 0; i < n; i++)
+        tmp[i] = (unsigned int) r0[i] + 2U * r1[i] + r2[i];
+
+    unsigned int mx = 0;
+    for (int i = 1; i < n - 1; i++)
+    {
+        unsigned int val = tmp[i - 1] + 2U * tmp[i] + tmp[i + 1];
+        out[i] = val;
+        if (val > mx)
+            mx = val;
+    }
+    return mx;
+}
+
+static unsigned short RowMaxScalar(const unsigned short *p, int n)
+{
+    unsigned short mx = 0;
+    for (int i = 0; i < n; i++)
+        if (p[i] > mx)
+            mx = p[i];
+    return mx;
+}
+
+static void AccumSpanScalar(const unsigned short *p, int n, unsigned short lo, unsigned short hi, SpanStats *acc)
+{
+    unsigned int count = 0;
+    unsigned long long sum = 0;
+    unsigned long long sumsq = 0;
+    for (int i = 0; i < n; i++)
+    {
+        unsigned int val = p[i];
+        if (val < lo || val > hi)
+            continue;
+        ++count;
+        sum += val;
+        sumsq += (unsigned long long) (val * val);
+    }
+    acc->count += count;
+    acc->sum += sum;
+    acc->sumsq += sumsq;
+}
+
+static const Kernels s_scalar = { "scalar", SmoothRowScalar, RowMaxScalar, AccumSpanScalar };
+
+#if defined(STAR_KERNELS_X86)
+
+//
+// SSE2 kernels
+//
+
+// smoothed values are at most 16 * 65535 so the signed 32-bit compare is safe
+static inline __m128i max_epi32_sse2(__m128i a, __m128i b)
+{
+    __m128i gt = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(gt, a), _mm_andnot_si128(gt, b));
+}
+
+static unsigned int SmoothRowSSE2(const unsigned short *r0, const unsigned short *r1, const unsigned short *r2, int n,
+                                  unsigned int *tmp, unsigned int *out)
+{
+    if (n < 3)
+        return 0;
+
+    const __m128i zero = _mm_setzero_si128();
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *) (r0 + i));
+        __m128i b = _mm_loadu_si128((const __m128i *) (r1 + i));
+        __m128i c = _mm_loadu_si128((const __m128i *) (r2 + i));
+        __m128i lo = _mm_add_epi32(_mm_add_epi32(_mm_unpacklo_epi16(a, zero), _mm_unpacklo_epi16(c, zero)),
+                                   _mm_slli_epi32(_mm_unpacklo_epi16(b, zero), 1));
+        __m128i hi = _mm_add_epi32(_mm_add_epi32(_mm_unpackhi_epi16(a, zero), _mm_unpackhi_epi16(c, zero)),
+                                   _mm_slli_epi32(_mm_unpackhi_epi16(b, zero), 1));
+        _mm_storeu_si128((__m128i *) (tmp + i), lo);
+        _mm_storeu_si128((__m128i *) (tmp + i + 4), hi);
+    }
+    for (; i < n; i++)
+        tmp[i] = (unsigned int) r0[i] + 2U * r1[i] + r2[i];
+
+    __m128i vmax = zero;
+    i = 1;
+    for (; i + 4 <= n - 1; i += 4)
+    {
+        __m128i l = _mm_loadu_si128((const __m128i *) (tmp + i - 1));
+        __m128i m = _mm_loadu_si128((const __m128i *) (tmp + i));
+        __m128i r = _mm_loadu_si128((const __m128i *) (tmp + i + 1));
+        __m128i val = _mm_add_epi32(_mm_add_epi32(l, r), _mm_slli_epi32(m, 1));
+        _mm_storeu_si128((__m128i *) (out + i), val);
+        vmax = max_epi32_sse2(vmax, val);
+    }
+    vmax = max_epi32_sse2(vmax, _mm_shuffle_epi32(vmax, _MM_SHUFFLE(1, 0, 3, 2)));
+    vmax = max_epi32_sse2(vmax, _mm_shuffle_epi32(vmax, _MM_SHUFFLE(2, 3, 0, 1)));
+    unsigned int mx = (unsigned int) _mm_cvtsi128_si32(vmax);
+
+    for (; i < n - 1; i++)
+    {
+        unsigned int val = tmp[i - 1] + 2U * tmp[i] + tmp[i + 1];
+        out[i] = val;
+        if (val > mx)
+            mx = val;
+    }
+    return mx;
+}
+
+static unsigned short RowMaxSSE2(const unsigned short *p, int n)
+{
+    // SSE2 only has a signed 16-bit max; flip the sign bit to order unsigned values
+    const __m128i bias = _mm_set1_epi16((short) 0x8000);
+    __m128i vmax = bias;
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+        vmax = _mm_max_epi16(vmax, _mm_xor_si128(_mm_loadu_si128((const __m128i *) (p + i)), bias));
+    vmax = _mm_max_epi16(vmax, _mm_shuffle_epi32(vmax, _MM_SHUFFLE(1, 0, 3, 2)));
+    vmax = _mm_max_epi16(vmax, _mm_shuffle_epi32(vmax, _MM_SHUFFLE(2, 3, 0, 1)));
+    vmax = _mm_max_epi16(vmax, _mm_shufflelo_epi16(vmax, _MM_SHUFFLE(2, 3, 0, 1)));
+    unsigned short mx = (unsigned short) (_mm_extract_epi16(vmax, 0) ^ 0x8000);
+
+    for (; i < n; i++)
+        if (p[i] > mx)
+            mx = p[i];
+    return mx;
+}
+
+static inline unsigned long long hsum_epi64(__m128i v)
+{
+    unsigned long long lanes[2];
+    _mm_storeu_si128((__m128i *) lanes, v);
+    return lanes[0] + lanes[1];
+}
+
+static inline unsigned int hsum_epi32(__m128i v)
+{
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (unsigned int) _mm_cvtsi128_si32(v);
+}
+
+static void AccumSpanSSE2(const unsigned short *p, int n, unsigned short lo, unsigned short hi, SpanStats *acc)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16((short) 0x8000);
+    const __m128i vlo = _mm_xor_si128(_mm_set1_epi16((short) lo), bias);
+    const __m128i vhi = _mm_xor_si128(_mm_set1_epi16((short) hi), bias);
+
+    __m128i vcount = zero; // 16-bit lanes, n < 65536
+    __m128i vsum = zero; // 32-bit lanes, cannot overflow for n < 65536
+    __m128i vsumsq = zero; // 64-bit lanes
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i px = _mm_loadu_si128((const __m128i *) (p + i));
+        __m128i spx = _mm_xor_si128(px, bias);
+        __m128i reject = _mm_or_si128(_mm_cmplt_epi16(spx, vlo), _mm_cmpgt_epi16(spx, vhi));
+        __m128i keep = _mm_andnot_si128(reject, px);
+
+        // the keep mask is -1 for selected lanes
+        vcount = _mm_sub_epi16(vcount, _mm_andnot_si128(reject, _mm_cmpeq_epi16(zero, zero)));
+        vsum = _mm_add_epi32(vsum, _mm_add_epi32(_mm_unpacklo_epi16(keep, zero), _mm_unpackhi_epi16(keep, zero)));
+
+        __m128i sqlo = _mm_mullo_epi16(keep, keep);
+        __m128i sqhi = _mm_mulhi_epu16(keep, keep);
+        __m128i sq0 = _mm_unpacklo_epi16(sqlo, sqhi); // 4 x 32-bit squares
+        __m128i sq1 = _mm_unpackhi_epi16(sqlo, sqhi);
+        vsumsq = _mm_add_epi64(vsumsq, _mm_unpacklo_epi32(sq0, zero));
+        vsumsq = _mm_add_epi64(vsumsq, _mm_unpackhi_epi32(sq0, zero));
+        vsumsq = _mm_add_epi64(vsumsq, _mm_unpacklo_epi32(sq1, zero));
+        vsumsq = _mm_add_epi64(vsumsq, _mm_unpackhi_epi32(sq1, zero));
+    }
+
+    vcount = _mm_add_epi32(_mm_unpacklo_epi16(vcount, zero), _mm_unpackhi_epi16(vcount, zero));
+    acc->count += hsum_epi32(vcount);
+    acc->sum += hsum_epi32(vsum);
+    acc->sumsq += hsum_epi64(vsumsq);
+
+    if (i < n)
+        AccumSpanScalar(p + i, n - i, lo, hi, acc);
+}
+
+static const Kernels s_sse2 = { "SSE2", SmoothRowSSE2, RowMaxSSE2, AccumSpanSSE2 };
+
+//
+// AVX2 kernels
+//
+
+AVX2_TARGET static unsigned int SmoothRowAVX2(const unsigned short *r0, const unsigned short *r1, const unsigned short *r2,
+                                              int n, unsigned int *tmp, unsigned int *out)
+{
+    if (n < 3)
+        return 0;
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i a = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) (r0 + i)));
+        __m256i b = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) (r1 + i)));
+        __m256i c = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) (r2 + i)));
+        _mm256_storeu_si256((__m256i *) (tmp + i), _mm256_add_epi32(_mm256_add_epi32(a, c), _mm256_slli_epi32(b, 1)));
+    }
+    for (; i < n; i++)
+        tmp[i] = (unsigned int) r0[i] + 2U * r1[i] + r2[i];
+
+    __m256i vmax = _mm256_setzero_si256();
+    i = 1;
+    for (; i + 8 <= n - 1; i += 8)
+    {
+        __m256i l = _mm256_loadu_si256((const __m256i *) (tmp + i - 1));
+        __m256i m = _mm256_loadu_si256((const __m256i *) (tmp + i));
+        __m256i r = _mm256_loadu_si256((const __m256i *) (tmp + i + 1));
+        __m256i val = _mm256_add_epi32(_mm256_add_epi32(l, r), _mm256_slli_epi32(m, 1));
+        _mm256_storeu_si256((__m256i *) (out + i), val);
+        vmax = _mm256_max_epu32(vmax, val);
+    }
+    __m128i m4 = _mm_max_epu32(_mm256_castsi256_si128(vmax), _mm256_extracti128_si256(vmax, 1));
+    m4 = _mm_max_epu32(m4, _mm_shuffle_epi32(m4, _MM_SHUFFLE(1, 0, 3, 2)));
+    m4 = _mm_max_epu32(m4, _mm_shuffle_epi32(m4, _MM_SHUFFLE(2, 3, 0, 1)));
+    unsigned int mx = (unsigned int) _mm_cvtsi128_si32(m4);
+
+    for (; i < n - 1; i++)
+    {
+        unsigned int val = tmp[i - 1] + 2U * tmp[i] + tmp[i + 1];
+        out[i] = val;
+        if (val > mx)
+            mx = val;
+    }
+    return mx;
+}
+
+AVX2_TARGET static unsigned short RowMaxAVX2(const unsigned short *p, int n)
+{
+    __m256i vmax = _mm256_setzero_si256();
+
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+        vmax = _mm256_max_epu16(vmax, _mm256_loadu_si256((const __m256i *) (p + i)));
+    __m128i m8 = _mm_max_epu16(_mm256_castsi256_si128(vmax), _mm256_extracti128_si256(vmax, 1));
+    // the minpos instruction finds the minimum, so search the complement
+    m8 = _mm_minpos_epu16(_mm_xor_si128(m8, _mm_set1_epi16(-1)));
+    unsigned short mx = (unsigned short) ~_mm_extract_epi16(m8, 0);
+
+    for (; i < n; i++)
+        if (p[i] > mx)
+            mx = p[i];
+    return mx;
+}
+
+AVX2_TARGET static void AccumSpanAVX2(const unsigned short *p, int n, unsigned short lo, unsigned short hi, SpanStats *acc)
+{
+    const __m256i vlo = _mm256_set1_epi32(lo);
+    const __m256i vhi = _mm256_set1_epi32(hi);
+    const __m256i one = _mm256_set1_epi32(1);
+
+    __m256i vcount = _mm256_setzero_si256();
+    __m256i vsum = _mm256_setzero_si256();
+    __m256i vsumsq = _mm256_setzero_si256(); // 64-bit lanes
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i px = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) (p + i)));
+        __m256i reject = _mm256_or_si256(_mm256_cmpgt_epi32(vlo, px), _mm256_cmpgt_epi32(px, vhi));
+        __m256i keep = _mm256_andnot_si256(reject, px);
+
+        vcount = _mm256_add_epi32(vcount, _mm256_andnot_si256(reject, one));
+        vsum = _mm256_add_epi32(vsum, keep);
+        // squares of the even and odd 32-bit lanes as 64-bit products
+        vsumsq = _mm256_add_epi64(vsumsq, _mm256_mul_epu32(keep, keep));
+        __m256i odd = _mm256_srli_epi64(keep, 32);
+        vsumsq = _mm256_add_epi64(vsumsq, _mm256_mul_epu32(odd, odd));
+    }
+
+    unsigned int c[8], s[8];
+    unsigned long long q[4];
+    _mm256_storeu_si256((__m256i *) c, vcount);
+    _mm256_storeu_si256((__m256i *) s, vsum);
+    _mm256_storeu_si256((__m256i *) q, vsumsq);
+    for (int k = 0; k < 8; k++)
+    {
+        acc->count += c[k];
+        acc->sum += s[k];
+    }
+    acc->sumsq += q[0] + q[1] + q[2] + q[3];
+
+    if (i < n)
+        AccumSpanScalar(p + i, n - i, lo, hi, acc);
+}
+
+static const Kernels s_avx2 = { "AVX2", SmoothRowAVX2, RowMaxAVX2, AccumSpanAVX2 };
+
+static bool HaveAVX2()
+{
+# if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    if (!osxsave || (_xgetbv(0) & 6) != 6) // OS saves the YMM registers
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+# else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+# endif
+}
+
+#endif // STAR_KERNELS_X86
+
+#if defined(STAR_KERNELS_NEON)
+
+//
+// NEON kernels
+//
+
+static unsigned int SmoothRowNEON(const unsigned short *r0, const unsigned short *r1, const unsigned short *r2, int n,
+                                  unsigned int *tmp, unsigned int *out)
+{
+    if (n < 3)
+        return 0;
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        uint16x8_t a = vld1q_u16(r0 + i);
+        uint16x8_t b = vld1q_u16(r1 + i);
+        uint16x8_t c = vld1q_u16(r2 + i);
+        uint32x4_t lo = vaddl_u16(vget_low_u16(a), vget_low_u16(c));
+        uint32x4_t hi = vaddl_u16(vget_high_u16(a), vget_high_u16(c));
+        lo = vaddq_u32(lo, vshll_n_u16(vget_low_u16(b), 1));
+        hi = vaddq_u32(hi, vshll_n_u16(vget_high_u16(b), 1));
+        vst1q_u32(tmp + i, lo);
+        vst1q_u32(tmp + i + 4, hi);
+    }
+    for (; i < n; i++)
+        tmp[i] = (unsigned int) r0[i] + 2U * r1[i] + r2[i];
+
+    uint32x4_t vmax = vdupq_n_u32(0);
+    i = 1;
+    for (; i + 4 <= n - 1; i += 4)
+    {
+        uint32x4_t l = vld1q_u32(tmp + i - 1);
+        uint32x4_t m = vld1q_u32(tmp + i);
+        uint32x4_t r = vld1q_u32(tmp + i + 1);
+        uint32x4_t val = vaddq_u32(vaddq_u32(l, r), vshlq_n_u32(m, 1));
+        vst1q_u32(out + i, val);
+        vmax = vmaxq_u32(vmax, val);
+    }
+    unsigned int mx = vmaxvq_u32(vmax);
+
+    for (; i < n - 1; i++)
+    {
+        unsigned int val = tmp[i - 1] + 2U * tmp[i] + tmp[i + 1];
+        out[i] = val;
+        if (val > mx)
+            mx = val;
+    }
+    return mx;
+}
+
+static unsigned short RowMaxNEON(const unsigned short *p, int n)
+{
+    uint16x8_t vmax = vdupq_n_u16(0);
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+        vmax = vmaxq_u16(vmax, vld1q_u16(p + i));
+    unsigned short mx = vmaxvq_u16(vmax);
+
+    for (; i < n; i++)
+        if (p[i] > mx)
+            mx = p[i];
+    return mx;
+}
+
+static void AccumSpanNEON(const unsigned short *p, int n, unsigned short lo, unsigned short hi, SpanStats *acc)
+{
+    const uint16x8_t vlo = vdupq_n_u16(lo);
+    const uint16x8_t vhi = vdupq_n_u16(hi);
+
+    uint16x8_t vcount = vdupq_n_u16(0); // n < 65536
+    uint32x4_t vsum = vdupq_n_u32(0);
+    uint64x2_t vsumsq = vdupq_n_u64(0);
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        uint16x8_t px = vld1q_u16(p + i);
+        uint16x8_t mask = vandq_u16(vcgeq_u16(px, vlo), vcleq_u16(px, vhi));
+        uint16x8_t keep = vandq_u16(px, mask);
+
+        vcount = vsubq_u16(vcount, mask);
+        vsum = vpadalq_u16(vsum, keep);
+        vsumsq = vpadalq_u32(vsumsq, vmull_u16(vget_low_u16(keep), vget_low_u16(keep)));
+        vsumsq = vpadalq_u32(vsumsq, vmull_u16(vget_high_u16(keep), vget_high_u16(keep)));
+    }
+
+    acc->count += vaddlvq_u16(vcount);
+    acc->sum += vaddlvq_u32(vsum);
+    acc->sumsq += vaddvq_u64(vsumsq);
+
+    if (i < n)
+        AccumSpanScalar(p + i, n - i, lo, hi, acc);
+}
+
+static const Kernels s_neon = { "NEON", SmoothRowNEON, RowMaxNEON, AccumSpanNEON };
+
+#endif // STAR_KERNELS_NEON
+
+static const Kernels *SelectKernels()
+{
+    const Kernels *k = &s_scalar;
+
+#if defined(STAR_KERNELS_X86)
+    k = HaveAVX2() ? &s_avx2 : &s_sse2;
+#elif defined(STAR_KERNELS_NEON)
+    k = &s_neon;
+#endif
+
+    return k;
+}
+
+const Kernels& Get()
+{
+    static const Kernels *s_kernels = SelectKernels();
+    return *s_kernels;
+}
+
+const Kernels& Scalar()
+{
+    return s_scalar;
+}
+
+int Supported(const Kernels **list, int maxCount)
+{
+    int count = 0;
+    auto add = [&](const Kernels *k)
+    {
+        if (count < maxCount)
+            list[count++] = k;
+    };
+
+    add(&s_scalar);
+#if defined(STAR_KERNELS_X86)
+    add(&s_sse2);
+    if (HaveAVX2())
+        add(&s_avx2);
+#elif defined(STAR_KERNELS_NEON)
+    add(&s_neon);
+#endif
+
+    return count;
+}
+
+} // namespace StarKernels
@@ -0,0 +1,86 @@
+/*
+ *  star_kernels.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef STAR_KERNELS_H_INCLUDED
+#define STAR_KERNELS_H_INCLUDED
+
+// Pixel kernels used by Star::Find. The best implementation for the host CPU (AVX2, SSE2 or
+// NEON) is selected at runtime; the scalar versions are always available and serve as the
+// reference.
+//
+// Tolerance: the peak location, PeakVal and the saturation test are identical to the scalar
+// reference. The background mean and sigma are now derived from exact integer sums rather than a
+// running double-precision estimate, so they agree with the previous implementation to a relative
+// error below 1e-12; the centroid agrees to better than 1e-9 pixel. The star threshold can only
+// differ (by 1 ADU) when mean + 3 * sigma falls within that error of a half-integer.
+
+namespace StarKernels
+{
+// accumulated statistics of the pixels of one or more row segments
+struct SpanStats
+{
+    unsigned int count;
+    unsigned long long sum;
+    unsigned long long sumsq;
+};
+
+// 3x3 smoothing [1 2 1; 2 4 2; 1 2 1] of row r1 using the rows above (r0) and below (r2).
+// out[i] receives the smoothed value of pixel i for 1 <= i <= n - 2; tmp must hold n values.
+// Returns the maximum smoothed value, or 0 if n < 3
+typedef unsigned int (*SmoothRowFn)(const unsigned short *r0, const unsigned short *r1, const unsigned short *r2, int n,
+                                    unsigned int *tmp, unsigned int *out);
+
+// maximum of n pixels, 0 if n == 0
+typedef unsigned short (*RowMaxFn)(const unsigned short *p, int n);
+
+// add the n pixels of p that lie in [lo, hi] to acc; n must be less than 65536
+typedef void (*AccumSpanFn)(const unsigned short *p, int n, unsigned short lo, unsigned short hi, SpanStats *acc);
+
+struct Kernels
+{
+    const char *name;
+    SmoothRowFn SmoothRow;
+    RowMaxFn RowMax;
+    AccumSpanFn AccumSpan;
+};
+
+// the fastest kernels supported by this CPU
+extern const Kernels& Get();
+// the portable reference kernels
+extern const Kernels& Scalar();
+// all the kernels this CPU can run, starting with the reference; stores at most maxCount entries
+// in list and returns their number
+extern int Supported(const Kernels **list, int maxCount);
+}
+
+#endif // STAR_KERNELS_H_INCLUDED
@@ -0,0 +1,405 @@
+/*
+ *  star_measure.cpp
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "star_measure.h"
+#include "star_kernels.h"
+
+#include <algorithm>
+#include <math.h>
+#include <vector>
+
+namespace
+{
+// helper struct for HFR calculation
+struct R2M
+{
+    double r2;
+    int x;
+    int y;
+    double m;
+    R2M() { }
+    R2M(int x_, int y_, double m_) : x(x_), y(y_), m(m_) { }
+    bool operator<(const R2M& rhs) const { return r2 < rhs.r2; }
+};
+
+double hfr(std::vector<R2M>& vec, double cx, double cy, double mass)
+{
+    if (vec.size() == 1) // hot pixel?
+        return 0.25;
+
+    // compute Half Flux Radius (HFR)
+    for (auto it = vec.begin(); it != vec.end(); ++it)
+    {
+        double dx = (double) it->x - cx;
+        double dy = (double) it->y - cy;
+        it->r2 = dx * dx + dy * dy;
+    }
+    std::sort(vec.begin(), vec.end()); // sort by ascending radius^2
+
+    // find radius of half-mass
+    double r20, r21, m0, m1;
+    r20 = r21 = m0 = m1 = 0.0;
+    double halfm = 0.5 * mass;
+    for (auto it = vec.begin(); it != vec.end(); ++it)
+    {
+        const R2M& rm = *it;
+        r20 = r21;
+        m0 = m1;
+        r21 = rm.r2;
+        m1 += rm.m;
+        if (m1 > halfm)
+            break;
+    }
+
+    // interpolate
+    double hfr;
+    if (m1 > m0)
+    {
+        double r0 = sqrt(r20), r1 = sqrt(r21);
+        double s = (r1 - r0) / (m1 - m0);
+        hfr = r0 + s * (halfm - m0);
+    }
+    else
+        hfr = 0.25;
+
+    return hfr;
+}
+
+// Row extents of the centroid aperture (radius A) and of the background annulus (A < r <= B)
+// around the peak, indexed by dy + B. For a row dy, pixels with |dx| <= inner are in the aperture
+// and pixels with inner < |dx| <= outer are in the annulus. inner is -1 for rows that do not
+// intersect the aperture. Precomputing these replaces the per-pixel r^2 tests.
+struct ApertureMask
+{
+    enum
+    {
+        A = 7, // inner radius
+        B = 12, // outer radius
+    };
+
+    int inner[2 * B + 1];
+    int outer[2 * B + 1];
+
+    ApertureMask()
+    {
+        for (int dy = -B; dy <= B; dy++)
+        {
+            inner[dy + B] = HalfWidth(A * A, dy);
+            outer[dy + B] = HalfWidth(B * B, dy);
+        }
+    }
+
+    static int HalfWidth(int r2, int dy)
+    {
+        int w = -1;
+        while ((w + 1) * (w + 1) + dy * dy <= r2)
+            ++w;
+        return w;
+    }
+};
+
+const ApertureMask s_apertureMask;
+
+} // namespace
+
+namespace StarMeasure
+{
+
+bool Measure(Result *result, const unsigned short *imgdata, int rowsize, int minx, int miny, int maxx, int maxy, int base_x,
+             int base_y, int searchRegion, Mode mode)
+{
+    Result& r = *result;
+
+    // search region bounds
+    int start_x = std::max(base_x - searchRegion, minx);
+    int end_x = std::min(base_x + searchRegion, maxx);
+    int start_y = std::max(base_y - searchRegion, miny);
+    int end_y = std::min(base_y + searchRegion, maxy);
+
+    if (end_x <= start_x || end_y <= start_y)
+        return true;
+
+    const StarKernels::Kernels& kern = StarKernels::Get();
+
+    int peak_x = 0, peak_y = 0;
+    unsigned int peak_val = 0;
+    unsigned short max3[3] = { 0, 0, 0 };
+
+    int const width = end_x - start_x + 1;
+
+    if (mode == MODE_PEAK)
+    {
+        for (int y = start_y; y <= end_y; y++)
+        {
+            const unsigned short *row = imgdata + y * rowsize + start_x;
+            unsigned short rowmax = kern.RowMax(row, width);
+
+            if (rowmax > peak_val)
+            {
+                int i = 0;
+                while (row[i] != rowmax)
+                    ++i;
+                peak_val = rowmax;
+                peak_x = start_x + i;
+                peak_y = y;
+            }
+        }
+
+        r.peakVal = (unsigned short) peak_val;
+    }
+    else
+    {
+        // find the peak value within the search region using a smoothing function
+        // also check for saturation
+
+        std::vector<unsigned int> buf(2 * width);
+        unsigned int *tmp = &buf[0];
+        unsigned int *smoothed = &buf[width];
+
+        for (int y = start_y + 1; y <= end_y - 1; y++)
+        {
+            const unsigned short *row = imgdata + y * rowsize + start_x;
+
+            unsigned int rowpeak = kern.SmoothRow(row - rowsize, row, row + rowsize, width, tmp, smoothed);
+            if (rowpeak > peak_val)
+            {
+                // first occurrence, as in a raster scan
+                int i = 1;
+                while (smoothed[i] != rowpeak)
+                    ++i;
+                peak_val = rowpeak;
+                peak_x = start_x + i;
+                peak_y = y;
+            }
+
+            // track the top 3 raw values; a row can only contribute if its max exceeds the 3rd value
+            const unsigned short *interior = row + 1;
+            int const n = width - 2;
+            if (n > 0 && kern.RowMax(interior, n) > max3[2])
+            {
+                for (int i = 0; i < n; i++)
+                {
+                    unsigned short p = interior[i];
+                    if (p > max3[0])
+                        std::swap(p, max3[0]);
+                    if (p > max3[1])
+                        std::swap(p, max3[1]);
+                    if (p > max3[2])
+                        std::swap(p, max3[2]);
+                }
+            }
+        }
+
+        r.peakVal = max3[0]; // raw peak val
+        peak_val /= 16; // smoothed peak value
+    }
+
+    r.peakX = peak_x;
+    r.peakY = peak_y;
+    r.smoothedPeak = peak_val;
+    std::copy(max3, max3 + 3, r.max3);
+
+    // measure noise in the annulus with inner radius A and outer radius B
+    int const A = ApertureMask::A;
+    int const B = ApertureMask::B;
+
+    // center window around peak value
+    start_x = std::max(peak_x - B, minx);
+    end_x = std::min(peak_x + B, maxx);
+    start_y = std::max(peak_y - B, miny);
+    end_y = std::min(peak_y + B, maxy);
+
+    // find the mean and stdev of the background
+
+    unsigned int nbg = 0;
+    double mean_bg = 0., prev_mean_bg;
+    double sigma2_bg = 0.;
+    double sigma_bg = 0.;
+
+    unsigned short lo = 0, hi = 65535; // sigma-clipping bounds, inclusive
+
+    // add the pixels of row y in [x0, x1], clipped to the window, to the stats
+    auto accumSpan = [&](int y, int x0, int x1, StarKernels::SpanStats *acc)
+    {
+        x0 = std::max(x0, start_x);
+        x1 = std::min(x1, end_x);
+        if (x1 >= x0)
+            kern.AccumSpan(imgdata + y * rowsize + x0, x1 - x0 + 1, lo, hi, acc);
+    };
+
+    r.tooFewBackground = false;
+
+    for (int iter = 0; iter < 9; iter++)
+    {
+        StarKernels::SpanStats acc = { 0, 0, 0 };
+
+        for (int y = start_y; y <= end_y; y++)
+        {
+            int dy = y - peak_y;
+            int wi = s_apertureMask.inner[dy + B];
+            int wo = s_apertureMask.outer[dy + B];
+
+            if (wi < 0)
+                accumSpan(y, peak_x - wo, peak_x + wo, &acc);
+            else
+            {
+                accumSpan(y, peak_x - wo, peak_x - wi - 1, &acc);
+                accumSpan(y, peak_x + wi + 1, peak_x + wo, &acc);
+            }
+        }
+
+        nbg = acc.count;
+
+        if (nbg < 10) // only possible after the first iteration
+        {
+            r.tooFewBackground = true;
+            break;
+        }
+
+        // the integer sums are exact, so the variance numerator n*sum(x^2) - sum(x)^2 is exact too
+        unsigned long long const nbg64 = nbg;
+        prev_mean_bg = mean_bg;
+        mean_bg = (double) acc.sum / (double) nbg;
+        sigma2_bg = (double) (nbg64 * acc.sumsq - acc.sum * acc.sum) / ((double) nbg * (double) (nbg - 1));
+        sigma_bg = sqrt(sigma2_bg);
+
+        if (iter > 0 && fabs(mean_bg - prev_mean_bg) < 0.5)
+            break;
+
+        // exclude values outside mean +/- 2 sigma on the next pass; pixel values are integers so the
+        // bounds can be rounded inwards
+        double const lo_bg = ceil(mean_bg - 2.0 * sigma_bg);
+        double const hi_bg = floor(mean_bg + 2.0 * sigma_bg);
+        lo = (unsigned short) std::max(lo_bg, 0.0);
+        hi = (unsigned short) std::min(hi_bg, 65535.0);
+    }
+
+    r.nbg = nbg;
+    r.meanBg = mean_bg;
+    r.sigmaBg = sigma_bg;
+
+    unsigned short thresh;
+
+    double cx = 0.0;
+    double cy = 0.0;
+    double mass = 0.0;
+    unsigned int n;
+
+    std::vector<R2M> hfrvec;
+
+    if (mode == MODE_PEAK)
+    {
+        mass = peak_val;
+        n = 1;
+        thresh = 0;
+    }
+    else
+    {
+        thresh = (unsigned short) (mean_bg + 3.0 * sigma_bg + 0.5);
+
+        // find pixels over threshold within aperture; compute mass and centroid
+
+        start_y = std::max(peak_y - A, miny);
+        end_y = std::min(peak_y + A, maxy);
+
+        hfrvec.reserve((2 * A + 1) * (2 * A + 1));
+
+        // accumulate in integers and remove the background once at the end
+        long long sum = 0, sumdx = 0, sumdy = 0, sumx = 0, sumy = 0;
+        n = 0;
+
+        for (int y = start_y; y <= end_y; y++)
+        {
+            int dy = y - peak_y;
+            int wi = s_apertureMask.inner[dy + B];
+            int x0 = std::max(peak_x - wi, minx);
+            int x1 = std::min(peak_x + wi, maxx);
+
+            const unsigned short *row = imgdata + rowsize * y;
+            for (int x = x0; x <= x1; x++)
+            {
+                // exclude points below threshold
+                unsigned short val = row[x];
+                if (val < thresh)
+                    continue;
+
+                int dx = x - peak_x;
+
+                sum += val;
+                sumx += dx * val;
+                sumy += dy * val;
+                sumdx += dx;
+                sumdy += dy;
+                ++n;
+
+                hfrvec.push_back(R2M(x, y, (double) val - mean_bg));
+            }
+        }
+
+        mass = (double) sum - mean_bg * (double) n;
+        cx = (double) sumx - mean_bg * (double) sumdx;
+        cy = (double) sumy - mean_bg * (double) sumdy;
+    }
+
+    r.thresh = thresh;
+    r.n = n;
+    r.mass = mass;
+
+    // SNR estimate from: Measuring the Signal-to-Noise Ratio S/N of the CCD Image of a Star or Nebula, J.H.Simonetti, 2004
+    // January 8
+    //     http://www.phys.vt.edu/~jhs/phys3154/snr20040108.pdf
+    double const gain = .5; // electrons per ADU, nominal
+    r.snr = n > 0 ? mass / sqrt(mass / gain + sigma2_bg * (double) n * (1.0 + 1.0 / (double) nbg)) : 0.0;
+
+    // a few scattered pixels over threshold can give a false positive
+    // avoid this by requiring the smoothed peak value to be above the threshold
+    r.falseStar = peak_val <= thresh && r.snr >= LOW_SNR;
+    if (r.falseStar)
+        r.snr = LOW_SNR - 0.1;
+
+    if (mass < MIN_MASS || r.snr < LOW_SNR)
+    {
+        r.x = base_x;
+        r.y = base_y;
+        r.hfd = 0.;
+        return false;
+    }
+
+    r.x = peak_x + cx / mass;
+    r.y = peak_y + cy / mass;
+    r.hfd = 2.0 * hfr(hfrvec, r.x, r.y, mass);
+
+    return false;
+}
+
+} // namespace StarMeasure
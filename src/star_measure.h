@@ -0,0 +1,82 @@
+/*
+ *  star_measure.h
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef STAR_MEASURE_H_INCLUDED
+#define STAR_MEASURE_H_INCLUDED
+
+// Pixel level part of Star::Find: locate the peak in the search region, estimate the background
+// in an annulus around it and compute the centroid, mass, SNR and HFD of the star. It does not
+// depend on wxWidgets so that it can be exercised outside of the application (see
+// tests/guide_loop_benchmark.cpp); Star::Find applies the HFD limits and the saturation test.
+
+namespace StarMeasure
+{
+enum Mode
+{
+    MODE_CENTROID,
+    MODE_PEAK,
+};
+
+// a star with less mass or a lower SNR is not found; its position and HFD are not computed
+const double MIN_MASS = 10.0;
+const double LOW_SNR = 3.0;
+
+struct Result
+{
+    int peakX;
+    int peakY;
+    unsigned int smoothedPeak; // peak of the smoothed image (centroid mode), or raw peak (peak mode)
+    unsigned short peakVal; // raw peak value
+    unsigned short max3[3]; // the three largest raw values in the search region (centroid mode only)
+    unsigned int nbg; // number of background pixels
+    double meanBg;
+    double sigmaBg;
+    bool tooFewBackground; // background estimation stopped because of too few pixels
+    unsigned short thresh; // pixels below this are excluded from the centroid
+    unsigned int n; // number of pixels in the centroid
+    double mass;
+    double snr;
+    bool falseStar; // the SNR was lowered because the smoothed peak was not above the threshold
+    double x; // position and HFD, valid when mass >= MIN_MASS and snr >= LOW_SNR
+    double y;
+    double hfd;
+};
+
+// Measure the star within searchRegion pixels of (baseX, baseY) in an image of the given width,
+// considering only pixels in [minx, maxx] x [miny, maxy]. Returns true if the search region is
+// empty.
+extern bool Measure(Result *result, const unsigned short *data, int width, int minx, int miny, int maxx, int maxy,
+                    int baseX, int baseY, int searchRegion, Mode mode);
+}
+
+#endif // STAR_MEASURE_H_INCLUDED
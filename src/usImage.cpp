@@ -36,75 +36,12 @@
 #include "image_math.h"
 
 #include <algorithm>
+#include <vector>
 
-class HistogramBuilder
+usImage::~usImage()
 {
-public:
-    int *histo;
-    unsigned short MinADU, MaxADU;
-    int pixCount;
-
-    HistogramBuilder()
-    {
-        histo = new int[65536];
-        MinADU = 0;
-        MaxADU = 0;
-        pixCount = 0;
-    }
-
-    ~HistogramBuilder() { delete[] histo; }
-
-    unsigned short median() const
-    {
-        int pixelLeft = pixCount / 2;
-
-        for (int i = MinADU; i < MaxADU; ++i)
-        {
-            if (histo[i] > pixelLeft)
-            {
-                return i;
-            }
-            pixelLeft -= histo[i];
-        }
-        return MaxADU;
-    }
-
-    void scan(const unsigned short *t, int len)
-    {
-        if (pixCount == 0)
-        {
-            unsigned short v = t[0];
-            // Initialization
-            MinADU = t[0];
-            MaxADU = t[0];
-            histo[t[0]] = 0;
-        }
-
-        for (int i = 0; i < len; ++i)
-        {
-            unsigned short v = t[i];
-            if (v < MinADU)
-            {
-                for (int k = v; k < MinADU; ++k)
-                {
-                    histo[k] = 0;
-                }
-                MinADU = v;
-            }
-            if (v > MaxADU)
-            {
-                for (int k = MaxADU + 1; k <= v; ++k)
-                {
-                    histo[k] = 0;
-                }
-                MaxADU = v;
-            }
-            histo[v]++;
-        }
-
-        pixCount += len;
-    }
-};
+    FrameBufferPool::Release(ImageData, NPixels);
+}
 
 bool usImage::Init(const wxSize& size)
 {
@@ -119,11 +56,11 @@ bool usImage::Init(const wxSize& size)
 
     if (NPixels != prev)
     {
-        delete[] ImageData;
+        FrameBufferPool::Release(ImageData, prev);
 
         if (NPixels)
         {
-            ImageData = new unsigned short[NPixels];
+            ImageData = FrameBufferPool::Alloc(NPixels);
             if (!ImageData)
             {
                 NPixels = 0;
@@ -139,9 +76,9 @@ bool usImage::Init(const wxSize& size)
 
 void usImage::SwapImageData(usImage& other)
 {
-    unsigned short *t = ImageData;
-    ImageData = other.ImageData;
-    other.ImageData = t;
+    // the pixel count goes with the buffer, it is the size the buffer is released to the pool with
+    std::swap(ImageData, other.ImageData);
+    std::swap(NPixels, other.NPixels);
 }
 
 void usImage::CalcStats()
@@ -149,86 +86,28 @@ void usImage::CalcStats()
     if (!ImageData || !NPixels)
         return;
 
-    MinADU = 65535;
-    MaxADU = 0;
-    FiltMin = 65535;
-    FiltMax = 0;
-
-    if (Subframe.IsEmpty())
-    {
-        // full frame, no subframe
-
-        HistogramBuilder hb;
-        hb.scan(ImageData, NPixels);
-        MinADU = hb.MinADU;
-        MaxADU = hb.MaxADU;
-        MedianADU = hb.median();
-
-        unsigned short *tmpdata = new unsigned short[NPixels];
+    const wxRect& rect = Subframe.IsEmpty() ? wxRect(Size) : Subframe;
 
-        Median3(tmpdata, ImageData, Size, wxRect(Size));
+    FrameStats::Result stats;
+    FrameStats::Calc(&stats, ImageData, Size.GetWidth(), rect.x, rect.y, rect.width, rect.height, WorkerPool::Concurrency(),
+                     &WorkerPool::ParallelFor);
 
-        const unsigned short *src = tmpdata;
-        for (unsigned int i = 0; i < NPixels; i++)
-        {
-            unsigned short d = *src++;
-            if (d < FiltMin)
-                FiltMin = d;
-            if (d > FiltMax)
-                FiltMax = d;
-        }
-
-        delete[] tmpdata;
-    }
-    else
-    {
-        // Subframe
-
-        unsigned int pixcnt = Subframe.width * Subframe.height;
-        unsigned short *tmpdata = new unsigned short[pixcnt];
-
-        unsigned short *dst;
-
-        dst = tmpdata;
-        for (int y = 0; y < Subframe.height; y++)
-        {
-            const unsigned short *src = ImageData + Subframe.x + (Subframe.y + y) * Size.GetWidth();
-            for (int x = 0; x < Subframe.width; x++)
-            {
-                unsigned short d = *src;
-                *dst++ = *src++;
-            }
-        }
-
-        HistogramBuilder hb;
-        hb.scan(tmpdata, pixcnt);
-        MinADU = hb.MinADU;
-        MaxADU = hb.MaxADU;
-        MedianADU = hb.median();
-
-        dst = new unsigned short[pixcnt];
+    MinADU = stats.MinADU;
+    MaxADU = stats.MaxADU;
+    MedianADU = stats.MedianADU;
+    FiltMin = stats.FiltMin;
+    FiltMax = stats.FiltMax;
+}
 
-        Median3(dst, tmpdata, Subframe.GetSize(), wxRect(Subframe.GetSize()));
+DisplayStretch::DisplayStretch() : m_lut(nullptr), m_blevel(-1), m_wlevel(-1), m_power(0.0) { }
 
-        const unsigned short *src = dst;
-        for (unsigned int i = 0; i < pixcnt; i++)
-        {
-            unsigned short d = *src++;
-            if (d < FiltMin)
-                FiltMin = d;
-            if (d > FiltMax)
-                FiltMax = d;
-        }
-
-        delete[] dst;
-        delete[] tmpdata;
-    }
+DisplayStretch::~DisplayStretch()
+{
+    delete[] m_lut;
 }
 
-static unsigned char *buildGammaLookupTable(int blevel, int wlevel, double power)
+const unsigned char *DisplayStretch::Lut(int blevel, int wlevel, double power)
 {
-    unsigned char *result = new unsigned char[0x10000];
-
     if (blevel < 0)
         blevel = 0;
     if (wlevel < 0)
@@ -236,52 +115,175 @@ static unsigned char *buildGammaLookupTable(int blevel, int wlevel, double power
     if (blevel > 0xffff)
         blevel = 0xffff;
     if (wlevel > 0xffff)
-        blevel = 0xffff;
+        wlevel = 0xffff;
+
+    if (m_lut && blevel == m_blevel && wlevel == m_wlevel && power == m_power)
+        return m_lut;
+
+    if (!m_lut)
+        m_lut = new unsigned char[0x10000];
 
     for (int i = 0; i <= blevel; ++i)
-        result[i] = 0;
+        m_lut[i] = 0;
 
     float range = wlevel - blevel;
     for (int i = blevel + 1; i < wlevel; ++i)
     {
         float d = (i - blevel) / range;
-        result[i] = pow(d, (float) power) * 255.0;
+        m_lut[i] = pow(d, (float) power) * 255.0;
     }
 
     for (int i = wlevel; i < 0x10000; ++i)
-        result[i] = 255;
+        m_lut[i] = 255;
 
-    return result;
+    m_blevel = blevel;
+    m_wlevel = wlevel;
+    m_power = power;
+
+    return m_lut;
 }
 
 bool usImage::CopyToImage(wxImage **rawimg, int blevel, int wlevel, double power)
 {
+    DisplayStretch stretch;
+    return CopyToImage(rawimg, Size, stretch, blevel, wlevel, power);
+}
+
+namespace
+{
+// the source pixels contributing to one display pixel along one axis
+struct AxisTap
+{
+    int first; // first source pixel
+    int count; // reducing: number of source pixels averaged, enlarging: 0
+    unsigned int frac; // enlarging: weight of the next source pixel in 1/256ths
+};
+}
+
+static void BuildAxisTaps(std::vector<AxisTap> *taps, int src, int dst)
+{
+    taps->resize(dst);
+
+    if (src >= dst)
+    {
+        // reducing: average all the source pixels covered by the display pixel
+        for (int i = 0; i < dst; i++)
+        {
+            int a = (int) ((long long) i * src / dst);
+            int b = (int) ((long long) (i + 1) * src / dst);
+            (*taps)[i] = { a, std::max(b - a, 1), 0 };
+        }
+    }
+    else
+    {
+        // enlarging: interpolate between the two nearest source pixels
+        for (int i = 0; i < dst; i++)
+        {
+            double p = std::max((i + 0.5) * src / dst - 0.5, 0.0);
+            int a = std::min((int) p, src - 1);
+            unsigned int frac = a < src - 1 ? (unsigned int) ((p - a) * 256.0 + 0.5) : 0;
+            (*taps)[i] = { a, 0, frac };
+        }
+    }
+}
+
+bool usImage::CopyToImage(wxImage **rawimg, const wxSize& dispSize, DisplayStretch& stretch, int blevel, int wlevel,
+                          double power) const
+{
+    const int dw = dispSize.GetWidth();
+    const int dh = dispSize.GetHeight();
+    const int sw = Size.GetWidth();
+    const int sh = Size.GetHeight();
+
     wxImage *img = *rawimg;
 
-    if (!img || !img->Ok() || (img->GetWidth() != Size.GetWidth()) ||
-        (img->GetHeight() != Size.GetHeight())) // can't reuse bitmap
+    if (!img || !img->Ok() || img->GetWidth() != dw || img->GetHeight() != dh) // can't reuse bitmap
     {
         delete img;
-        img = new wxImage(Size.GetWidth(), Size.GetHeight(), false);
+        img = new wxImage(dw, dh, false);
     }
+    *rawimg = img;
 
     unsigned char *ImgPtr = img->GetData();
-    unsigned short *RawPtr = ImageData;
+    const unsigned char *lutTable = stretch.Lut(blevel, wlevel, power);
 
-    unsigned char *lutTable = buildGammaLookupTable(blevel, wlevel, power);
-
-    for (unsigned int i = 0; i < NPixels; i++, RawPtr++)
+    if (dw == sw && dh == sh)
     {
-        unsigned short v = *RawPtr;
-        unsigned char d = lutTable[v];
-        *ImgPtr++ = d;
-        *ImgPtr++ = d;
-        *ImgPtr++ = d;
+        const unsigned short *RawPtr = ImageData;
+        for (unsigned int i = 0; i < NPixels; i++, RawPtr++)
+        {
+            unsigned char d = lutTable[*RawPtr];
+            *ImgPtr++ = d;
+            *ImgPtr++ = d;
+            *ImgPtr++ = d;
+        }
+        return false;
     }
 
-    delete[] lutTable;
+    // Resample the raw pixels first so that only the display pixels need to be stretched. The
+    // resampling is separable: each display row is formed from the source rows it covers, then
+    // each display pixel from the columns of that row.
+
+    std::vector<AxisTap> xtaps, ytaps;
+    BuildAxisTaps(&xtaps, sw, dw);
+    BuildAxisTaps(&ytaps, sh, dh);
+
+    std::vector<unsigned int> acc(sw);
+
+    for (int y = 0; y < dh; y++)
+    {
+        const AxisTap& ty = ytaps[y];
+        const unsigned short *row = ImageData + (size_t) ty.first * sw;
+        unsigned long long vdiv;
+
+        if (ty.count)
+        {
+            for (int x = 0; x < sw; x++)
+                acc[x] = row[x];
+            for (int k = 1; k < ty.count; k++)
+            {
+                row += sw;
+                for (int x = 0; x < sw; x++)
+                    acc[x] += row[x];
+            }
+            vdiv = ty.count;
+        }
+        else
+        {
+            const unsigned short *next = ty.frac ? row + sw : row;
+            unsigned int w0 = 256 - ty.frac;
+            unsigned int w1 = ty.frac;
+            for (int x = 0; x < sw; x++)
+                acc[x] = row[x] * w0 + next[x] * w1;
+            vdiv = 256;
+        }
+
+        for (int x = 0; x < dw; x++)
+        {
+            const AxisTap& tx = xtaps[x];
+            unsigned long long sum, div;
+
+            if (tx.count)
+            {
+                sum = 0;
+                for (int k = 0; k < tx.count; k++)
+                    sum += acc[tx.first + k];
+                div = vdiv * tx.count;
+            }
+            else
+            {
+                unsigned int next = tx.frac ? acc[tx.first + 1] : 0;
+                sum = (unsigned long long) acc[tx.first] * (256 - tx.frac) + (unsigned long long) next * tx.frac;
+                div = vdiv * 256;
+            }
+
+            unsigned char d = lutTable[(sum + div / 2) / div];
+            *ImgPtr++ = d;
+            *ImgPtr++ = d;
+            *ImgPtr++ = d;
+        }
+    }
 
-    *rawimg = img;
     return false;
 }
 
@@ -290,130 +292,107 @@ void usImage::InitImgStartTime()
     ImgStartTime = wxDateTime::UNow();
 }
 
-bool usImage::Save(const wxString& fname, const wxString& hdrNote) const
+void usImage::GetFITSHeader(FITSHdrCards *phdr, const wxString& hdrNote) const
 {
-    bool bError = false;
-
-    try
-    {
-        fitsfile *fptr; // FITS file pointer
-        int status = 0; // CFITSIO status value MUST be initialized to zero!
-
-        PHD_fits_create_file(&fptr, fname, true, &status);
-
-        long fsize[] = {
-            (long) Size.GetWidth(),
-            (long) Size.GetHeight(),
-        };
-        fits_create_img(fptr, USHORT_IMG, 2, fsize, &status);
+    FITSHdrCards& hdr = *phdr;
 
-        FITSHdrWriter hdr(fptr, &status);
+    float exposure = (float) ImgExpDur / 1000.0;
+    hdr.write("EXPOSURE", exposure, "Exposure time in seconds");
 
-        float exposure = (float) ImgExpDur / 1000.0;
-        hdr.write("EXPOSURE", exposure, "Exposure time in seconds");
+    if (ImgStackCnt > 1)
+        hdr.write("STACKCNT", (unsigned int) ImgStackCnt, "Stacked frame count");
 
-        if (ImgStackCnt > 1)
-            hdr.write("STACKCNT", (unsigned int) ImgStackCnt, "Stacked frame count");
+    if (!hdrNote.IsEmpty())
+        hdr.write("USERNOTE", hdrNote.utf8_str(), 0);
 
-        if (!hdrNote.IsEmpty())
-            hdr.write("USERNOTE", hdrNote.utf8_str(), 0);
+    hdr.write("DATE", wxDateTime::UNow(), wxDateTime::UTC, "file creation time, UTC");
+    hdr.write("DATE-OBS", ImgStartTime, wxDateTime::UTC, "Image capture start time, UTC");
+    hdr.write("CREATOR", wxString(APPNAME _T(" ") FULLVER).c_str(), "Capture software");
+    hdr.write("PHDPROFI", pConfig->GetCurrentProfile().c_str(), "PHD2 Equipment Profile");
 
-        hdr.write("DATE", wxDateTime::UNow(), wxDateTime::UTC, "file creation time, UTC");
-        hdr.write("DATE-OBS", ImgStartTime, wxDateTime::UTC, "Image capture start time, UTC");
-        hdr.write("CREATOR", wxString(APPNAME _T(" ") FULLVER).c_str(), "Capture software");
-        hdr.write("PHDPROFI", pConfig->GetCurrentProfile().c_str(), "PHD2 Equipment Profile");
+    if (pCamera)
+    {
+        hdr.write("INSTRUME", pCamera->Name.c_str(), "Instrument name");
+        unsigned int b = pCamera->Binning;
+        hdr.write("XBINNING", b, "Camera X Bin");
+        hdr.write("YBINNING", b, "Camera Y Bin");
+        hdr.write("CCDXBIN", b, "Camera X Bin");
+        hdr.write("CCDYBIN", b, "Camera Y Bin");
+        float sz = b * pCamera->GetCameraPixelSize();
+        hdr.write("XPIXSZ", sz, "pixel size in microns (with binning)");
+        hdr.write("YPIXSZ", sz, "pixel size in microns (with binning)");
+        unsigned int g = (unsigned int) pCamera->GuideCameraGain;
+        hdr.write("GAIN", g, "PHD Gain Value (0-100)");
+        unsigned int bpp = pCamera->BitsPerPixel();
+        hdr.write("CAMBPP", bpp, "Camera resolution, bits per pixel");
+    }
 
-        if (pCamera)
+    if (pPointingSource)
+    {
+        double ra, dec, st;
+        bool err = pPointingSource->GetCoordinates(&ra, &dec, &st);
+        if (!err)
         {
-            hdr.write("INSTRUME", pCamera->Name.c_str(), "Instrument name");
-            unsigned int b = pCamera->Binning;
-            hdr.write("XBINNING", b, "Camera X Bin");
-            hdr.write("YBINNING", b, "Camera Y Bin");
-            hdr.write("CCDXBIN", b, "Camera X Bin");
-            hdr.write("CCDYBIN", b, "Camera Y Bin");
-            float sz = b * pCamera->GetCameraPixelSize();
-            hdr.write("XPIXSZ", sz, "pixel size in microns (with binning)");
-            hdr.write("YPIXSZ", sz, "pixel size in microns (with binning)");
-            unsigned int g = (unsigned int) pCamera->GuideCameraGain;
-            hdr.write("GAIN", g, "PHD Gain Value (0-100)");
-            unsigned int bpp = pCamera->BitsPerPixel();
-            hdr.write("CAMBPP", bpp, "Camera resolution, bits per pixel");
-        }
+            hdr.write("RA", (float) (ra * 360.0 / 24.0), "Object Right Ascension in degrees");
+            hdr.write("DEC", (float) dec, "Object Declination in degrees");
 
-        if (pPointingSource)
-        {
-            double ra, dec, st;
-            bool err = pPointingSource->GetCoordinates(&ra, &dec, &st);
-            if (!err)
             {
-                hdr.write("RA", (float) (ra * 360.0 / 24.0), "Object Right Ascension in degrees");
-                hdr.write("DEC", (float) dec, "Object Declination in degrees");
-
-                {
-                    int h = (int) ra;
-                    ra -= h;
-                    ra *= 60.0;
-                    int m = (int) ra;
-                    ra -= m;
-                    ra *= 60.0;
-                    hdr.write("OBJCTRA", wxString::Format("%02d %02d %06.3f", h, m, ra).c_str(),
-                              "Object Right Ascension in hms");
-                }
-
-                {
-                    int sign = dec < 0.0 ? -1 : +1;
-                    dec *= sign;
-                    int d = (int) dec;
-                    dec -= d;
-                    dec *= 60.0;
-                    int m = (int) dec;
-                    dec -= m;
-                    dec *= 60.0;
-                    hdr.write("OBJCTDEC", wxString::Format("%c%d %02d %06.3f", sign < 0 ? '-' : '+', d, m, dec).c_str(),
-                              "Object Declination in dms");
-                }
+                int h = (int) ra;
+                ra -= h;
+                ra *= 60.0;
+                int m = (int) ra;
+                ra -= m;
+                ra *= 60.0;
+                hdr.write("OBJCTRA", wxString::Format("%02d %02d %06.3f", h, m, ra).c_str(), "Object Right Ascension in hms");
             }
 
-            PierSide p = pPointingSource->SideOfPier();
-            if (p != PierSide::PIER_SIDE_UNKNOWN)
-                hdr.write("PIERSIDE", (unsigned int) p, "Side of Pier 0=East 1=West");
-        }
-
-        float sc = (float) pFrame->GetCameraPixelScale();
-        hdr.write("SCALE", sc, "Image scale (arcsec / pixel)");
-        hdr.write("PIXSCALE", sc, "Image scale (arcsec / pixel)");
-        hdr.write("PEDESTAL", (unsigned int) Pedestal, "dark subtraction bias value");
-        hdr.write("SATURATE", (1U << BitsPerPixel) - 1, "Data value at which saturation occurs");
-
-        const PHD_Point& lockPos = pFrame->pGuider->LockPosition();
-        if (lockPos.IsValid())
-        {
-            hdr.write("PHDLOCKX", (float) lockPos.X, "PHD2 lock position x");
-            hdr.write("PHDLOCKY", (float) lockPos.Y, "PHD2 lock position y");
-        }
-
-        if (!Subframe.IsEmpty())
-        {
-            hdr.write("PHDSUBFX", (unsigned int) Subframe.x, "PHD2 subframe x");
-            hdr.write("PHDSUBFY", (unsigned int) Subframe.y, "PHD2 subframe y");
-            hdr.write("PHDSUBFW", (unsigned int) Subframe.width, "PHD2 subframe width");
-            hdr.write("PHDSUBFH", (unsigned int) Subframe.height, "PHD2 subframe height");
+            {
+                int sign = dec < 0.0 ? -1 : +1;
+                dec *= sign;
+                int d = (int) dec;
+                dec -= d;
+                dec *= 60.0;
+                int m = (int) dec;
+                dec -= m;
+                dec *= 60.0;
+                hdr.write("OBJCTDEC", wxString::Format("%c%d %02d %06.3f", sign < 0 ? '-' : '+', d, m, dec).c_str(),
+                          "Object Declination in dms");
+            }
         }
 
-        long fpixel[3] = { 1, 1, 1 };
-        fits_write_pix(fptr, TUSHORT, fpixel, NPixels, ImageData, &status);
+        PierSide p = pPointingSource->SideOfPier();
+        if (p != PierSide::PIER_SIDE_UNKNOWN)
+            hdr.write("PIERSIDE", (unsigned int) p, "Side of Pier 0=East 1=West");
+    }
 
-        PHD_fits_close_file(fptr);
+    float sc = (float) pFrame->GetCameraPixelScale();
+    hdr.write("SCALE", sc, "Image scale (arcsec / pixel)");
+    hdr.write("PIXSCALE", sc, "Image scale (arcsec / pixel)");
+    hdr.write("PEDESTAL", (unsigned int) Pedestal, "dark subtraction bias value");
+    hdr.write("SATURATE", (1U << BitsPerPixel) - 1, "Data value at which saturation occurs");
 
-        bError = status ? true : false;
+    const PHD_Point& lockPos = pFrame->pGuider->LockPosition();
+    if (lockPos.IsValid())
+    {
+        hdr.write("PHDLOCKX", (float) lockPos.X, "PHD2 lock position x");
+        hdr.write("PHDLOCKY", (float) lockPos.Y, "PHD2 lock position y");
     }
-    catch (const wxString& Msg)
+
+    if (!Subframe.IsEmpty())
     {
-        POSSIBLY_UNUSED(Msg);
-        bError = true;
+        hdr.write("PHDSUBFX", (unsigned int) Subframe.x, "PHD2 subframe x");
+        hdr.write("PHDSUBFY", (unsigned int) Subframe.y, "PHD2 subframe y");
+        hdr.write("PHDSUBFW", (unsigned int) Subframe.width, "PHD2 subframe width");
+        hdr.write("PHDSUBFH", (unsigned int) Subframe.height, "PHD2 subframe height");
     }
+}
 
-    return bError;
+bool usImage::Save(const wxString& fname, const wxString& hdrNote) const
+{
+    FITSHdrCards hdr;
+    GetFITSHeader(&hdr, hdrNote);
+
+    return FitsWriter::WriteFile(fname, ImageData, Size, hdr, FitsWriter::COMPRESS_NONE);
 }
 
 static bool fhdr_int(fitsfile *fptr, const char *key, int *val)
@@ -450,10 +429,19 @@ bool usImage::Load(const wxString& fname)
             // Get HDUs and size
             int naxis = 0;
             fits_get_img_dim(fptr, &naxis, &status);
-            long fsize[3];
-            fits_get_img_size(fptr, 2, fsize, &status);
             int nhdus = 0;
             fits_get_num_hdus(fptr, &nhdus, &status);
+            if (naxis == 0 && nhdus == 2)
+            {
+                // a tile-compressed image is stored in the extension following an empty primary HDU
+                if (!fits_movabs_hdu(fptr, 2, &hdutype, &status) && fits_is_compressed_image(fptr, &status))
+                {
+                    fits_get_img_dim(fptr, &naxis, &status);
+                    nhdus = 1;
+                }
+            }
+            long fsize[3];
+            fits_get_img_size(fptr, 2, fsize, &status);
             if ((nhdus != 1) || (naxis != 2))
             {
                 pFrame->Alert(wxString::Format(_("Unsupported type or read error loading FITS file %s"), fname));
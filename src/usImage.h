@@ -35,6 +35,25 @@
 #ifndef USIMAGECLASS
 #define USIMAGECLASS
 
+class FITSHdrCards;
+
+// Lookup table mapping 16-bit pixel values to 8-bit display values for a given black level, white
+// level and gamma. The table is only rebuilt when the stretch parameters change.
+class DisplayStretch
+{
+    unsigned char *m_lut;
+    int m_blevel;
+    int m_wlevel;
+    double m_power;
+
+public:
+    DisplayStretch();
+    ~DisplayStretch();
+    DisplayStretch(const DisplayStretch&) = delete;
+    DisplayStretch& operator=(const DisplayStretch&) = delete;
+    const unsigned char *Lut(int blevel, int wlevel, double power);
+};
+
 class usImage
 {
 public:
@@ -53,24 +72,31 @@ public:
     wxByte BitsPerPixel;
     unsigned short Pedestal;
     unsigned int FrameNum;
+    wxLongLong_t CaptureCompleteTime; // GuideLatency::Now() when the capture finished, 0 if not captured
 
     usImage()
         : ImageData(nullptr), NPixels(0), MinADU(0), MaxADU(0), MedianADU(0), FiltMin(0), FiltMax(0), ImgExpDur(0),
-          ImgStackCnt(1), BitsPerPixel(0), Pedestal(0), FrameNum(0)
+          ImgStackCnt(1), BitsPerPixel(0), Pedestal(0), FrameNum(0), CaptureCompleteTime(0)
     {
     }
-    ~usImage() { delete[] ImageData; }
+    ~usImage();
 
     bool Init(const wxSize& size);
     bool Init(int width, int height) { return Init(wxSize(width, height)); }
+    // exchange the pixel buffers (and their pixel counts) of two images
     void SwapImageData(usImage& other);
     void CalcStats();
     void InitImgStartTime();
     bool CopyFrom(const usImage& src);
     bool CopyToImage(wxImage **img, int blevel, int wlevel, double power);
+    // resample the image to dispSize and stretch the result into an RGB image of that size
+    bool CopyToImage(wxImage **img, const wxSize& dispSize, DisplayStretch& stretch, int blevel, int wlevel,
+                     double power) const;
     bool CopyFromImage(const wxImage& img);
     bool Load(const wxString& fname);
     bool Save(const wxString& fname, const wxString& hdrComment = wxEmptyString) const;
+    // collect the FITS header keywords describing the image; must be called on the main thread
+    void GetFITSHeader(FITSHdrCards *hdr, const wxString& hdrComment = wxEmptyString) const;
     bool Rotate(double theta, bool mirror = false);
     unsigned short& Pixel(int x, int y) { return ImageData[y * Size.x + x]; }
     const unsigned short& Pixel(int x, int y) const { return ImageData[y * Size.x + x]; }
@@ -0,0 +1,203 @@
+/*
+ *  worker_pool.cpp
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+// The pool does not depend on wxWidgets so that tests/guide_loop_benchmark.cpp can run the
+// image processing on the same pool as the app.
+
+// the pool is meant for short, latency-sensitive work; there is no benefit to more threads
+// than this for the amount of per-frame work we have
+static const unsigned int MAX_POOL_THREADS = 8;
+
+struct PoolImpl
+{
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_callLock; // serializes ParallelFor callers
+    std::mutex m_lock; // protects the job state below
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    bool m_stop;
+    unsigned int m_generation;
+    unsigned int m_active; // pool threads working on the current job
+    const std::function<void(unsigned int)> *m_fn;
+    unsigned int m_count;
+    std::atomic<unsigned int> m_next;
+
+    PoolImpl() : m_stop(false), m_generation(0), m_active(0), m_fn(nullptr), m_count(0) { m_next = 0; }
+
+    void RunItems(const std::function<void(unsigned int)>& fn, unsigned int count)
+    {
+        unsigned int i;
+        while ((i = m_next.fetch_add(1)) < count)
+            fn(i);
+    }
+
+    void ThreadLoop()
+    {
+        unsigned int seen = 0;
+
+        while (true)
+        {
+            const std::function<void(unsigned int)> *fn;
+            unsigned int count;
+
+            {
+                std::unique_lock<std::mutex> lck(m_lock);
+                while (!m_stop && (m_generation == seen || !m_fn))
+                    m_wake.wait(lck);
+                if (m_stop)
+                    return;
+                seen = m_generation;
+                fn = m_fn;
+                count = m_count;
+                ++m_active;
+            }
+
+            RunItems(*fn, count);
+
+            {
+                std::lock_guard<std::mutex> lck(m_lock);
+                if (--m_active == 0)
+                    m_done.notify_one();
+            }
+        }
+    }
+
+    void ParallelFor(unsigned int count, const std::function<void(unsigned int)>& fn)
+    {
+        std::lock_guard<std::mutex> call(m_callLock);
+
+        {
+            std::lock_guard<std::mutex> lck(m_lock);
+            m_fn = &fn;
+            m_count = count;
+            m_next = 0;
+            ++m_generation;
+            m_wake.notify_all();
+        }
+
+        RunItems(fn, count);
+
+        // wait for any pool threads that picked up the job, then retire it so that late
+        // wakers do not see it
+        std::unique_lock<std::mutex> lck(m_lock);
+        while (m_active > 0)
+            m_done.wait(lck);
+        m_fn = nullptr;
+    }
+};
+
+static PoolImpl *s_pool;
+
+unsigned int WorkerPool::DefaultThreads()
+{
+    unsigned int ncpu = std::thread::hardware_concurrency();
+    return ncpu > 1 ? std::min(ncpu - 1, MAX_POOL_THREADS) : 0;
+}
+
+unsigned int WorkerPool::Init(unsigned int nthreads)
+{
+    if (s_pool || nthreads == 0)
+        return 0;
+
+    PoolImpl *pool = new PoolImpl();
+
+    for (unsigned int i = 0; i < nthreads; i++)
+    {
+        try
+        {
+            pool->m_threads.emplace_back(&PoolImpl::ThreadLoop, pool);
+        }
+        catch (const std::system_error&)
+        {
+            // could not start the thread, make do with the ones we have
+            break;
+        }
+    }
+
+    if (pool->m_threads.empty())
+    {
+        delete pool;
+        return 0;
+    }
+
+    s_pool = pool;
+    return (unsigned int) pool->m_threads.size();
+}
+
+void WorkerPool::Destroy()
+{
+    PoolImpl *pool = s_pool;
+    if (!pool)
+        return;
+
+    s_pool = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lck(pool->m_lock);
+        pool->m_stop = true;
+        pool->m_wake.notify_all();
+    }
+
+    for (auto& thread : pool->m_threads)
+        thread.join();
+
+    delete pool;
+}
+
+unsigned int WorkerPool::Concurrency()
+{
+    return s_pool ? s_pool->m_threads.size() + 1 : 1;
+}
+
+void WorkerPool::ParallelFor(unsigned int count, const std::function<void(unsigned int)>& fn)
+{
+    if (!s_pool || count < 2)
+    {
+        for (unsigned int i = 0; i < count; i++)
+            fn(i);
+        return;
+    }
+
+    s_pool->ParallelFor(count, fn);
+}
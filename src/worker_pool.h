@@ -0,0 +1,61 @@
+/*
+ *  worker_pool.h
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WORKER_POOL_INCLUDED
+#define WORKER_POOL_INCLUDED
+
+#include <functional>
+
+// A small fixed pool of threads for splitting per-frame image processing work. The calling
+// thread participates in the work, so with a single CPU (or before Init() / after Destroy())
+// everything simply runs serially on the caller.
+class WorkerPool
+{
+public:
+    // the number of pool threads worth starting on this machine: one fewer than the number of
+    // CPUs, up to a small limit
+    static unsigned int DefaultThreads();
+
+    // start the pool threads; returns the number of threads started
+    static unsigned int Init(unsigned int nthreads = DefaultThreads());
+    static void Destroy();
+
+    // number of threads that share the work, including the calling thread
+    static unsigned int Concurrency();
+
+    // Call fn(i) for 0 <= i < count and wait for all the calls to complete. The calls may run
+    // concurrently and in any order; fn must not throw. Must not be called from within a pool task.
+    static void ParallelFor(unsigned int count, const std::function<void(unsigned int)>& fn);
+};
+
+#endif // WORKER_POOL_INCLUDED
@@ -83,7 +83,7 @@ void WorkerThread::EnqueueWorkerThreadTerminateRequest(void)
 /*************      Expose      **************************/
 
 void WorkerThread::EnqueueWorkerThreadExposeRequest(usImage *pImage, int exposureDuration, int exposureOptions,
-                                                    const wxRect& subframe)
+                                                    const wxRect& subframe, FrameMeasurement *pMeasurement)
 {
     m_interruptRequested &= ~INT_STOP;
 
@@ -94,6 +94,7 @@ void WorkerThread::EnqueueWorkerThreadExposeRequest(usImage *pImage, int exposur
 
     message.request = REQUEST_EXPOSE;
     message.args.expose.pImage = pImage;
+    message.args.expose.pMeasurement = pMeasurement;
     message.args.expose.exposureDuration = exposureDuration;
     message.args.expose.options = exposureOptions;
     message.args.expose.subframe = subframe;
@@ -219,6 +220,9 @@ bool WorkerThread::HandleExpose(EXPOSE_REQUEST *req)
 
         if (!bError)
         {
+            req->pImage->CaptureCompleteTime = GuideLatency::Now();
+            FrameBufferPool::NotifyFrame();
+
             CameraROITest(req->pImage);
 
             switch (m_pFrame->GetNoiseReductionMethod())
@@ -255,7 +259,8 @@ void WorkerThread::SendWorkerThreadExposeComplete(usImage *pImage, bool bError)
 
 /*************      Move       **************************/
 
-void WorkerThread::EnqueueWorkerThreadMoveRequest(Mount *mount, const GuiderOffset& ofs, unsigned int moveOptions)
+void WorkerThread::EnqueueWorkerThreadMoveRequest(Mount *mount, const GuiderOffset& ofs, unsigned int moveOptions,
+                                                  wxLongLong_t frameTime)
 {
     m_interruptRequested &= ~INT_STOP;
 
@@ -270,6 +275,7 @@ void WorkerThread::EnqueueWorkerThreadMoveRequest(Mount *mount, const GuiderOffs
     message.args.move.axisMove = false;
     message.args.move.ofs = ofs;
     message.args.move.moveOptions = moveOptions;
+    message.args.move.frameTime = frameTime;
     message.args.move.semaphore = nullptr;
 
     EnqueueMessage(message);
@@ -327,6 +333,8 @@ void WorkerThread::HandleMove(MOVE_REQUEST *req)
                 {
                     throw ERROR_INFO("Move failed");
                 }
+
+                GuideLatency::Record(req->frameTime);
             }
         }
         else
@@ -353,6 +361,8 @@ void WorkerThread::HandleMove(MOVE_REQUEST *req)
             {
                 throw ERROR_INFO("myFrame handled move failed");
             }
+
+            GuideLatency::Record(req->frameTime);
         }
     }
     catch (const wxString& Msg)
@@ -429,10 +439,15 @@ wxThread::ExitCode WorkerThread::Entry()
                 Debug.Write("worker thread skipping SendWorkerThreadExposeComplete\n");
                 delete message.args.expose.pImage; // should be null though
                 message.args.expose.pImage = 0;
+                delete message.args.expose.pMeasurement;
                 m_skipSendExposeComplete = false;
             }
-            else
+            else if (bError || !m_pFrame->EnqueueGuideFrame(message.args.expose.pImage, message.args.expose.pMeasurement))
+            {
+                // the main thread will measure the frame itself
+                delete message.args.expose.pMeasurement;
                 SendWorkerThreadExposeComplete(message.args.expose.pImage, bError);
+            }
             break;
 
         case REQUEST_MOVE:
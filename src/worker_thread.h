@@ -59,6 +59,7 @@ class MyFrame;
 struct EXPOSE_REQUEST
 {
     usImage *pImage;
+    FrameMeasurement *pMeasurement; // passed to the guide thread with the frame
     int exposureDuration;
     int options;
     wxRect subframe;
@@ -75,6 +76,7 @@ struct MOVE_REQUEST
     unsigned int moveOptions;
     Mount::MOVE_RESULT moveResult;
     GuiderOffset ofs;
+    wxLongLong_t frameTime; // capture completion time of the frame the move was computed from, 0 if none
     wxSemaphore *semaphore;
 };
 
@@ -180,7 +182,8 @@ protected:
 
     /*************      Expose      **************************/
 public:
-    void EnqueueWorkerThreadExposeRequest(usImage *pImage, int exposureDuration, int exposureOptions, const wxRect& subframe);
+    void EnqueueWorkerThreadExposeRequest(usImage *pImage, int exposureDuration, int exposureOptions, const wxRect& subframe,
+                                          FrameMeasurement *pMeasurement);
     void SetSkipExposeComplete();
 
 protected:
@@ -190,7 +193,8 @@ protected:
 
     /*************      Guide       **************************/
 public:
-    void EnqueueWorkerThreadMoveRequest(Mount *mount, const GuiderOffset& ofs, unsigned int moveOptions);
+    void EnqueueWorkerThreadMoveRequest(Mount *mount, const GuiderOffset& ofs, unsigned int moveOptions,
+                                         wxLongLong_t frameTime = 0);
     void EnqueueWorkerThreadAxisMove(Mount *mount, const GUIDE_DIRECTION direction, int duration, unsigned int moveOptions);
 
 protected:
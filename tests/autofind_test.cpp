@@ -0,0 +1,500 @@
+/*
+ *  autofind_test.cpp
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+
+// Checks that AutoFindEngine selects the same stars as the previous implementation of
+// GuideStar::AutoFind on simimage.fit and on synthetic star fields, and compares their speed.
+
+#include "autofind_engine.h"
+#include "sample_image.h"
+#include "test_timing.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+// the previous implementation, from star.cpp
+
+struct FloatImg
+{
+    int width;
+    int height;
+    std::vector<float> px;
+};
+
+FloatImg ToFloat(const Image& img)
+{
+    FloatImg f;
+    f.width = img.width;
+    f.height = img.height;
+    f.px.assign(img.px.begin(), img.px.end());
+    return f;
+}
+
+void GetStats(double *mean, double *stdev, const FloatImg& img, int rx, int ry, int rw, int rh)
+{
+    // Determine the mean and standard deviation
+    double sum = 0.0;
+    double a = 0.0;
+    double q = 0.0;
+    double k = 1.0;
+    double km1 = 0.0;
+
+    const int width = img.width;
+    const float *p0 = &img.px[ry * width + rx];
+    for (int y = 0; y < rh; y++)
+    {
+        const float *end = p0 + rw;
+        for (const float *p = p0; p < end; p++)
+        {
+            double const x = (double) *p;
+            sum += x;
+            double const a0 = a;
+            a += (x - a) / k;
+            q += (x - a0) * (x - a);
+            km1 = k;
+            k += 1.0;
+        }
+        p0 += width;
+    }
+
+    *mean = sum / km1;
+    *stdev = sqrt(q / km1);
+}
+
+void psf_conv(FloatImg& dst, const FloatImg& src)
+{
+    dst.width = src.width;
+    dst.height = src.height;
+    dst.px.assign(src.px.size(), 0.f);
+
+    //                       A      B1     B2    C1     C2    C3     D1     D2     D3
+    const double PSF[] = { 0.906, 0.584, 0.365, .117, .049, -0.05, -.064, -.074, -.094 };
+
+    int const width = src.width;
+    int const height = src.height;
+
+    int psf_size = 4;
+
+    for (int y = psf_size; y < height - psf_size; y++)
+    {
+        for (int x = psf_size; x < width - psf_size; x++)
+        {
+            float A, B1, B2, C1, C2, C3, D1, D2, D3;
+
+#define PX(dx, dy) *(src.px.data() + width * (y + (dy)) + x + (dx))
+            A = PX(+0, +0);
+            B1 = PX(+0, -1) + PX(+0, +1) + PX(+1, +0) + PX(-1, +0);
+            B2 = PX(-1, -1) + PX(+1, -1) + PX(-1, +1) + PX(+1, +1);
+            C1 = PX(+0, -2) + PX(-2, +0) + PX(+2, +0) + PX(+0, +2);
+            C2 = PX(-1, -2) + PX(+1, -2) + PX(-2, -1) + PX(+2, -1) + PX(-2, +1) + PX(+2, +1) + PX(-1, +2) + PX(+1, +2);
+            C3 = PX(-2, -2) + PX(+2, -2) + PX(-2, +2) + PX(+2, +2);
+            D1 = PX(+0, -3) + PX(-3, +0) + PX(+3, +0) + PX(+0, +3);
+            D2 = PX(-1, -3) + PX(+1, -3) + PX(-3, -1) + PX(+3, -1) + PX(-3, +1) + PX(+3, +1) + PX(-1, +3) + PX(+1, +3);
+            D3 = PX(-4, -2) + PX(-3, -2) + PX(+3, -2) + PX(+4, -2) + PX(-4, -1) + PX(+4, -1) + PX(-4, +0) + PX(+4, +0) +
+                PX(-4, +1) + PX(+4, +1) + PX(-4, +2) + PX(-3, +2) + PX(+3, +2) + PX(+4, +2);
+#undef PX
+            int i;
+            const float *uptr;
+
+            uptr = src.px.data() + width * (y - 4) + (x - 4);
+            for (i = 0; i < 9; i++)
+                D3 += *uptr++;
+
+            uptr = src.px.data() + width * (y - 3) + (x - 4);
+            for (i = 0; i < 3; i++)
+                D3 += *uptr++;
+            uptr += 3;
+            for (i = 0; i < 3; i++)
+                D3 += *uptr++;
+
+            uptr = src.px.data() + width * (y + 3) + (x - 4);
+            for (i = 0; i < 3; i++)
+                D3 += *uptr++;
+            uptr += 3;
+            for (i = 0; i < 3; i++)
+                D3 += *uptr++;
+
+            uptr = src.px.data() + width * (y + 4) + (x - 4);
+            for (i = 0; i < 9; i++)
+                D3 += *uptr++;
+
+            double mean = (A + B1 + B2 + C1 + C2 + C3 + D1 + D2 + D3) / 81.0;
+            double PSF_fit = PSF[0] * (A - mean) + PSF[1] * (B1 - 4.0 * mean) + PSF[2] * (B2 - 4.0 * mean) +
+                PSF[3] * (C1 - 4.0 * mean) + PSF[4] * (C2 - 8.0 * mean) + PSF[5] * (C3 - 4.0 * mean) +
+                PSF[6] * (D1 - 4.0 * mean) + PSF[7] * (D2 - 8.0 * mean) + PSF[8] * (D3 - 44.0 * mean);
+
+            dst.px[width * y + x] = (float) PSF_fit;
+        }
+    }
+}
+
+void Downsample(FloatImg& dst, const FloatImg& src, int downsample)
+{
+    int width = src.width;
+    int dw = src.width / downsample;
+    int dh = src.height / downsample;
+
+    dst.width = dw;
+    dst.height = dh;
+    dst.px.resize((size_t) dw * dh);
+
+    float const d2 = downsample * downsample;
+
+    for (int yy = 0; yy < dh; yy++)
+    {
+        for (int xx = 0; xx < dw; xx++)
+        {
+            float sum = 0.0;
+            for (int j = 0; j < downsample; j++)
+                for (int i = 0; i < downsample; i++)
+                    sum += src.px[(yy * downsample + j) * width + xx * downsample + i];
+            float val = sum / d2;
+            dst.px[yy * dw + xx] = val;
+        }
+    }
+}
+
+struct Peak
+{
+    int x;
+    int y;
+    float val;
+
+    Peak() { }
+    Peak(int x_, int y_, float val_) : x(x_), y(y_), val(val_) { }
+    bool operator<(const Peak& rhs) const { return val < rhs.val; }
+};
+
+enum
+{
+    CONV_RADIUS = 4,
+    TOP_N = 100,
+};
+const double THRESHOLD = 0.1;
+
+// the local maxima search of AutoFind, returning all candidates in the order they were found
+std::vector<AutoFindEngine::Candidate> ReferencePeaks(const FloatImg& conv, double global_stdev)
+{
+    std::vector<AutoFindEngine::Candidate> found;
+
+    int dw = conv.width;
+    int dh = conv.height;
+    int cl = CONV_RADIUS, ct = CONV_RADIUS, cw = dw - 2 * CONV_RADIUS, ch = dh - 2 * CONV_RADIUS;
+
+    int srch = 4;
+    for (int y = ct + srch; y <= ct + ch - 1 - srch; y++)
+    {
+        for (int x = cl + srch; x <= cl + cw - 1 - srch; x++)
+        {
+            float val = conv.px[dw * y + x];
+            bool ismax = false;
+            if (val > 0.0)
+            {
+                ismax = true;
+                for (int j = -srch; j <= srch; j++)
+                {
+                    for (int i = -srch; i <= srch; i++)
+                    {
+                        if (i == 0 && j == 0)
+                            continue;
+                        if (conv.px[dw * (y + j) + (x + i)] > val)
+                        {
+                            ismax = false;
+                            break;
+                        }
+                    }
+                }
+            }
+            if (!ismax)
+                continue;
+
+            // compare local maximum to mean value of surrounding pixels
+            const int local = 7;
+            double local_mean, local_stdev;
+            int l = std::max(x - local, cl), t = std::max(y - local, ct);
+            int r = std::min(x + local, cl + cw - 1), b = std::min(y + local, ct + ch - 1);
+            GetStats(&local_mean, &local_stdev, conv, l, t, r - l + 1, b - t + 1);
+
+            // this is our measure of star intensity
+            double h = (val - local_mean) / global_stdev;
+
+            if (h < THRESHOLD)
+                continue;
+
+            AutoFindEngine::Candidate c;
+            c.x = x;
+            c.y = y;
+            c.val = val;
+            c.h = h;
+            found.push_back(c);
+        }
+    }
+
+    return found;
+}
+
+// the brightest candidates, as AutoFind keeps them
+std::set<Peak> TopN(const std::vector<AutoFindEngine::Candidate>& candidates, int downsample)
+{
+    std::set<Peak> stars;
+    for (const auto& c : candidates)
+    {
+        stars.insert(Peak(c.x * downsample + downsample / 2, c.y * downsample + downsample / 2, c.h));
+        if (stars.size() > TOP_N)
+            stars.erase(stars.begin());
+    }
+    return stars;
+}
+
+void ThreadParallelFor(unsigned int count, const std::function<void(unsigned int)>& fn)
+{
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < count; i++)
+        threads.emplace_back(fn, i);
+    fn(0);
+    for (auto& t : threads)
+        t.join();
+}
+
+const unsigned int CONCURRENCY = 4;
+
+struct Result
+{
+    std::vector<AutoFindEngine::Candidate> candidates;
+    std::set<Peak> stars;
+};
+
+FloatImg Prepare(const Image& img, int downsample)
+{
+    FloatImg f = ToFloat(img);
+    if (downsample > 1)
+    {
+        FloatImg tmp;
+        Downsample(tmp, f, downsample);
+        f = tmp;
+    }
+    return f;
+}
+
+bool TooSmall(const FloatImg& img)
+{
+    return img.width <= 2 * CONV_RADIUS || img.height <= 2 * CONV_RADIUS;
+}
+
+Result RunReference(const FloatImg& src, int downsample)
+{
+    if (TooSmall(src))
+        return Result();
+
+    FloatImg conv;
+    psf_conv(conv, src);
+
+    double mean, stdev;
+    GetStats(&mean, &stdev, conv, CONV_RADIUS, CONV_RADIUS, conv.width - 2 * CONV_RADIUS, conv.height - 2 * CONV_RADIUS);
+
+    Result r;
+    r.candidates = ReferencePeaks(conv, stdev);
+    r.stars = TopN(r.candidates, downsample);
+    return r;
+}
+
+Result RunEngine(const FloatImg& src, int downsample, unsigned int concurrency, FloatImg *convOut = nullptr)
+{
+    if (TooSmall(src))
+        return Result();
+
+    FloatImg conv;
+    conv.width = src.width;
+    conv.height = src.height;
+    conv.px.resize(src.px.size());
+    AutoFindEngine::PsfConv(conv.px.data(), src.px.data(), src.width, src.height, concurrency, &ThreadParallelFor);
+
+    int const cw = conv.width - 2 * CONV_RADIUS, ch = conv.height - 2 * CONV_RADIUS;
+    double mean, stdev;
+    GetStats(&mean, &stdev, conv, CONV_RADIUS, CONV_RADIUS, cw, ch);
+
+    Result r;
+    AutoFindEngine::FindPeaks(&r.candidates, conv.px.data(), conv.width, CONV_RADIUS, CONV_RADIUS, cw, ch, stdev, THRESHOLD,
+                              concurrency, &ThreadParallelFor);
+    r.stars = TopN(r.candidates, downsample);
+
+    if (convOut)
+        *convOut = conv;
+    return r;
+}
+
+void ExpectSameSelection(const Result& expected, const Result& actual, const std::string& what)
+{
+    ASSERT_EQ(expected.candidates.size(), actual.candidates.size()) << what;
+    for (size_t i = 0; i < expected.candidates.size(); i++)
+    {
+        const auto& e = expected.candidates[i];
+        const auto& a = actual.candidates[i];
+        ASSERT_EQ(e.x, a.x) << what << " candidate " << i;
+        ASSERT_EQ(e.y, a.y) << what << " candidate " << i;
+        EXPECT_EQ(e.val, a.val) << what << " candidate " << i;
+        EXPECT_NEAR(e.h, a.h, 1e-9 * std::max(1.0, std::fabs(e.h))) << what << " candidate " << i;
+    }
+
+    ASSERT_EQ(expected.stars.size(), actual.stars.size()) << what;
+    auto a = actual.stars.begin();
+    for (auto e = expected.stars.begin(); e != expected.stars.end(); ++e, ++a)
+    {
+        EXPECT_EQ(e->x, a->x) << what;
+        EXPECT_EQ(e->y, a->y) << what;
+        EXPECT_EQ(e->val, a->val) << what;
+    }
+}
+
+void CheckImage(const Image& img, const std::string& name)
+{
+    for (int downsample = 1; downsample <= 2; downsample++)
+    {
+        std::string what = name + " downsample " + std::to_string(downsample);
+        FloatImg src = Prepare(img, downsample);
+
+        Result expected = RunReference(src, downsample);
+
+        FloatImg refConv;
+        psf_conv(refConv, src);
+
+        for (unsigned int concurrency : { 1u, CONCURRENCY })
+        {
+            FloatImg conv;
+            Result actual = RunEngine(src, downsample, concurrency, &conv);
+            EXPECT_TRUE(refConv.px == conv.px) << what << " x" << concurrency << ": filtered image differs";
+            ExpectSameSelection(expected, actual, what + " x" + std::to_string(concurrency));
+        }
+    }
+}
+
+// background with noise, a gradient and gaussian stars
+Image StarField(int width, int height, int nstars, unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> noise(0.0, 12.0);
+    std::uniform_real_distribution<double> uni(0.0, 1.0);
+
+    std::vector<double> v((size_t) width * height);
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+            v[(size_t) y * width + x] = 1000.0 + 0.05 * x + 0.02 * y + noise(rng);
+
+    for (int i = 0; i < nstars; i++)
+    {
+        double cx = uni(rng) * width, cy = uni(rng) * height;
+        double amp = 50.0 + uni(rng) * uni(rng) * 60000.0;
+        double sigma = 1.0 + uni(rng) * 2.0;
+        int r = (int) (4 * sigma) + 1;
+        for (int y = std::max(0, (int) cy - r); y < std::min(height, (int) cy + r + 1); y++)
+            for (int x = std::max(0, (int) cx - r); x < std::min(width, (int) cx + r + 1); x++)
+            {
+                double d2 = (x - cx) * (x - cx) + (y - cy) * (y - cy);
+                v[(size_t) y * width + x] += amp * exp(-d2 / (2 * sigma * sigma));
+            }
+    }
+
+    Image img;
+    img.width = width;
+    img.height = height;
+    img.px.resize(v.size());
+    for (size_t i = 0; i < v.size(); i++)
+        img.px[i] = (unsigned short) std::min(std::max(v[i], 0.0), 65535.0);
+    return img;
+}
+} // namespace
+
+TEST(AutoFindTest, SimImageSelectionUnchanged)
+{
+    Image img;
+    ASSERT_TRUE(LoadFits("simimage.fit", &img));
+    CheckImage(img, "simimage.fit");
+
+    // the simulator image has plenty of stars to choose from
+    Result r = RunEngine(Prepare(img, 1), 1, 1);
+    EXPECT_GT(r.stars.size(), 5u);
+}
+
+TEST(AutoFindTest, StarFieldsSelectionUnchanged)
+{
+    CheckImage(StarField(640, 480, 60, 1), "star field 640x480");
+    CheckImage(StarField(123, 77, 10, 2), "star field 123x77");
+    CheckImage(StarField(1500, 1100, 400, 3), "star field 1500x1100");
+}
+
+TEST(AutoFindTest, TinyImages)
+{
+    // images too small to search must not crash and find nothing
+    for (int size : { 1, 8, 9, 16, 17, 18 })
+    {
+        Image img = StarField(size, size, 1, size);
+        FloatImg src = Prepare(img, 1);
+        Result r = RunEngine(src, 1, CONCURRENCY);
+        Result e = RunReference(src, 1);
+        EXPECT_EQ(e.candidates.size(), r.candidates.size()) << size;
+    }
+}
+
+TEST(AutoFindTest, DISABLED_Benchmark)
+{
+    Image img;
+    ASSERT_TRUE(LoadFits("simimage.fit", &img));
+    Image big = Tile(img, 5472, 3648); // 20 MP
+
+    FloatImg src = Prepare(big, 1);
+    Result r;
+    double tref = TimeMs(1, [&] { r = RunReference(src, 1); });
+    double tser = TimeMs(1, [&] { r = RunEngine(src, 1, 1); });
+    double tpar = TimeMs(1, [&] { r = RunEngine(src, 1, CONCURRENCY); });
+
+    std::cout << "AutoFind " << big.width << "x" << big.height << ": previous " << tref << " ms, engine " << tser
+              << " ms, engine x" << CONCURRENCY << " " << tpar << " ms" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,222 @@
+/*
+ *  client_output_queue_test.cpp
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Checks the admission rules of the event server's per-client output queue, in particular that a
+// client whose socket is backed up with events still gets the replies to its requests.
+
+#include "client_output_queue.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+typedef ClientOutputQueue<std::string> Queue;
+
+// a socket that takes at most `room` more bytes
+struct Socket
+{
+    std::string received;
+    size_t room;
+
+    Socket() : room(0) { }
+
+    size_t Write(const char *p, size_t len)
+    {
+        size_t const n = std::min(len, room);
+        received.append(p, n);
+        room -= n;
+        return n;
+    }
+};
+
+struct Client
+{
+    Queue q;
+    Socket sock;
+    std::vector<Queue::Kind> sent;
+
+    unsigned long long Flush(size_t highWater)
+    {
+        return q.Flush([this](const char *p, size_t len) { return sock.Write(p, len); },
+                       [this](const Queue::Msg& msg) { sent.push_back(msg.kind); }, highWater);
+    }
+};
+
+std::string Event(int n)
+{
+    std::ostringstream os;
+    os << "{\"Event\":\"GuideStep\",\"Frame\":" << n << ",\"RADistanceRaw\":0.123456,\"DECDistanceRaw\":-0.654321}\r\n";
+    return os.str();
+}
+
+std::vector<std::string> Lines(const std::string& s)
+{
+    std::vector<std::string> lines;
+    size_t pos = 0;
+    for (size_t end; (end = s.find("\r\n", pos)) != std::string::npos; pos = end + 2)
+        lines.push_back(s.substr(pos, end + 2 - pos));
+    EXPECT_EQ(s.size(), pos) << "incomplete message at the end of the stream";
+    return lines;
+}
+
+const size_t HighWater = 4096;
+// longer than an event, so that it does not fit in the room the events leave below the mark
+const std::string Response = "{\"jsonrpc\":\"2.0\",\"result\":[\"Simulator\",\"Simulator 2\",\"Main scope\","
+                             "\"Guide scope with OAG\",\"Mount only\",\"Test profile\"],\"id\":1}\r\n";
+} // namespace
+
+TEST(ClientOutputQueueTest, EventsDroppedOverHighWater)
+{
+    Client c;
+
+    int queued = 0, dropped = 0;
+    for (int i = 0; i < 1000; i++)
+    {
+        Queue::EventResult res = c.q.PushEvent(Event(i), i, HighWater);
+        if (res == Queue::QUEUED)
+            ++queued;
+        else
+        {
+            EXPECT_EQ(dropped == 0 ? Queue::STARTED_DROPPING : Queue::DROPPED, res);
+            ++dropped;
+        }
+    }
+    EXPECT_EQ(1000, queued + dropped);
+    EXPECT_GT(dropped, 0);
+    EXPECT_LE(c.q.EventBytes(), HighWater);
+    EXPECT_TRUE(c.q.Dropping());
+
+    // still dropping while the client has only caught up a little
+    c.sock.room = Event(0).size();
+    EXPECT_EQ(0u, c.Flush(HighWater));
+    EXPECT_EQ(Queue::DROPPED, c.q.PushEvent(Event(1000), 1000, HighWater));
+    ++dropped;
+
+    c.sock.room = std::string::npos;
+    EXPECT_EQ((unsigned long long) dropped, c.Flush(HighWater));
+    EXPECT_FALSE(c.q.Dropping());
+    EXPECT_TRUE(c.q.Empty());
+    EXPECT_EQ(0u, c.q.Bytes());
+    EXPECT_EQ((size_t) queued, Lines(c.sock.received).size());
+
+    EXPECT_EQ(Queue::QUEUED, c.q.PushEvent(Event(1001), 1001, HighWater));
+}
+
+TEST(ClientOutputQueueTest, FloodedClientGetsResponse)
+{
+    Client c;
+
+    // the client's socket is backed up and the guide loop keeps sending events
+    for (int i = 0; i < 1000; i++)
+        c.q.PushEvent(Event(i), i, HighWater);
+    ASSERT_TRUE(c.q.Dropping());
+
+    // part of the oldest event has been written
+    c.sock.room = 10;
+    c.Flush(HighWater);
+    size_t const eventsAhead = c.q.Count();
+
+    // the client's request is answered while events are being dropped
+    EXPECT_GT(c.q.PushResponse(Response, 1000, HighWater), 0u);
+    EXPECT_LE(c.q.EventBytes() + Response.size(), HighWater);
+    EXPECT_LT(c.q.Count(), eventsAhead + 1);
+
+    // more events keep arriving after the reply
+    for (int i = 1001; i < 1100; i++)
+        c.q.PushEvent(Event(i), i, HighWater);
+
+    c.sock.room = std::string::npos;
+    c.Flush(HighWater);
+    EXPECT_TRUE(c.q.Empty());
+    ASSERT_EQ(1, std::count(c.sent.begin(), c.sent.end(), Queue::RESPONSE));
+
+    // the partly written event was completed, and the stream holds whole messages only
+    std::vector<std::string> lines = Lines(c.sock.received);
+    EXPECT_EQ(Event(0), lines[0]);
+    EXPECT_EQ(1, std::count(lines.begin(), lines.end(), Response));
+    for (const std::string& line : lines)
+        EXPECT_TRUE(line == Response || line.compare(0, 9, "{\"Event\":") == 0) << line;
+}
+
+TEST(ClientOutputQueueTest, ResponseQueuedWithoutEventsToEvict)
+{
+    Client c;
+
+    // a reply larger than the high-water mark is queued behind a partly written event
+    c.q.PushEvent(Event(0), 0, HighWater);
+    c.sock.room = 10;
+    c.Flush(HighWater);
+
+    std::string const big = "{\"jsonrpc\":\"2.0\",\"result\":\"" + std::string(2 * HighWater, 'x') + "\",\"id\":2}\r\n";
+    EXPECT_EQ(0u, c.q.PushResponse(big, 1, HighWater));
+    EXPECT_EQ(2u, c.q.Count());
+    EXPECT_FALSE(c.q.Dropping());
+
+    // replies do not count towards the high-water mark
+    EXPECT_EQ(Queue::QUEUED, c.q.PushEvent(Event(1), 2, HighWater));
+
+    c.sock.room = std::string::npos;
+    c.Flush(HighWater);
+    EXPECT_EQ(Event(0) + big + Event(1), c.sock.received);
+}
+
+TEST(ClientOutputQueueTest, OneImageQueued)
+{
+    Client c;
+    std::string const img(3 * HighWater, '\0');
+
+    EXPECT_TRUE(c.q.PushImage(img, 0));
+    EXPECT_FALSE(c.q.PushImage(img, 1));
+
+    // images do not count towards the high-water mark
+    EXPECT_EQ(Queue::QUEUED, c.q.PushEvent(Event(0), 2, HighWater));
+    EXPECT_EQ(Queue::QUEUED, c.q.PushEvent(Event(1), 3, HighWater));
+
+    c.sock.room = std::string::npos;
+    c.Flush(HighWater);
+    EXPECT_EQ(img.size() + 2 * Event(0).size(), c.sock.received.size());
+    EXPECT_EQ(3 * HighWater + 2 * Event(0).size(), c.q.PeakBytes());
+
+    EXPECT_TRUE(c.q.PushImage(img, 4));
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
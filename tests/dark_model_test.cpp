@@ -0,0 +1,245 @@
+/*
+ *  dark_model_test.cpp
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+// Checks the dark frames DarkModel synthesizes from a library of darks against the known bias and
+// dark current they were generated from, compares their error with that of the library dark
+// GuideCamera::SelectDark used to choose, and benchmarks the synthesis.
+
+#include "dark_model.h"
+#include "test_timing.h"
+
+#include <gtest/gtest.h>
+
+#include <iostream>
+#include <math.h>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+// a sensor with per-pixel bias and dark current, plus some hot pixels
+struct Sensor
+{
+    std::vector<double> bias;
+    std::vector<double> rate; // ADU per ms
+
+    Sensor(size_t npixels, std::mt19937& rng) : bias(npixels), rate(npixels)
+    {
+        std::normal_distribution<double> b(500., 20.);
+        std::exponential_distribution<double> r(1. / 0.01);
+        std::uniform_int_distribution<int> hot(0, 999);
+        for (size_t i = 0; i < npixels; i++)
+        {
+            bias[i] = b(rng);
+            rate[i] = r(rng);
+            if (hot(rng) == 0)
+                rate[i] *= 200.; // saturates at long exposures
+        }
+    }
+
+    double Value(size_t i, double t) const { return bias[i] + rate[i] * t; }
+
+    std::vector<unsigned short> Dark(double t, std::mt19937& rng, double noise) const
+    {
+        std::normal_distribution<double> n(0., noise);
+        std::vector<unsigned short> v(bias.size());
+        for (size_t i = 0; i < v.size(); i++)
+            v[i] = (unsigned short) std::min(std::max(lround(Value(i, t) + (noise > 0. ? n(rng) : 0.)), 0L), 65535L);
+        return v;
+    }
+};
+
+void ThreadParallelFor(unsigned int count, const std::function<void(unsigned int)>& fn)
+{
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < count; i++)
+        threads.emplace_back(fn, i);
+    fn(0);
+    for (auto& t : threads)
+        t.join();
+}
+
+const unsigned int CONCURRENCY = 4;
+
+struct Library
+{
+    std::vector<double> exposures;
+    std::vector<std::vector<unsigned short>> darks;
+    std::vector<const unsigned short *> pixels;
+
+    Library(const Sensor& sensor, const std::vector<double>& exp, std::mt19937& rng, double noise) : exposures(exp)
+    {
+        for (double t : exposures)
+            darks.push_back(sensor.Dark(t, rng, noise));
+        for (const auto& d : darks)
+            pixels.push_back(d.data());
+    }
+
+    std::vector<unsigned short> Synthesize(double t, unsigned int concurrency = 1,
+                                           DarkModel::ParallelForFn pfor = nullptr) const
+    {
+        std::vector<double> w(exposures.size());
+        EXPECT_FALSE(DarkModel::Weights(w.data(), exposures.data(), (int) exposures.size(), t));
+        std::vector<unsigned short> out(darks[0].size());
+        DarkModel::Synthesize(out.data(), pixels.data(), w.data(), (int) w.size(), out.size(), concurrency, pfor);
+        return out;
+    }
+
+    // the dark SelectDark used to choose: the smallest exposure >= t, else the longest
+    const std::vector<unsigned short>& Nearest(double t) const
+    {
+        for (size_t i = 0; i < exposures.size(); i++)
+            if (exposures[i] >= t)
+                return darks[i];
+        return darks.back();
+    }
+};
+
+// mean absolute error against the noise-free sensor model, ignoring saturated pixels
+double MeanError(const Sensor& sensor, const std::vector<unsigned short>& dark, double t)
+{
+    double sum = 0.;
+    size_t n = 0;
+    for (size_t i = 0; i < dark.size(); i++)
+    {
+        double v = sensor.Value(i, t);
+        if (v >= 65535.)
+            continue;
+        sum += fabs(dark[i] - v);
+        ++n;
+    }
+    return sum / n;
+}
+} // namespace
+
+TEST(DarkModelTest, Weights)
+{
+    double exposures[] = { 1000., 2000., 4000. };
+    double w[3];
+
+    // the weights reproduce any linear function of the exposure exactly
+    for (double t : { 0., 500., 1000., 1500., 3000., 4000., 10000. })
+    {
+        ASSERT_FALSE(DarkModel::Weights(w, exposures, 3, t));
+        EXPECT_NEAR(1., w[0] + w[1] + w[2], 1e-12) << t;
+        EXPECT_NEAR(t, w[0] * exposures[0] + w[1] * exposures[1] + w[2] * exposures[2], 1e-9) << t;
+    }
+
+    // two darks interpolate linearly between them
+    ASSERT_FALSE(DarkModel::Weights(w, exposures, 2, 1250.));
+    EXPECT_NEAR(0.75, w[0], 1e-12);
+    EXPECT_NEAR(0.25, w[1], 1e-12);
+
+    double same[] = { 2000., 2000. };
+    EXPECT_TRUE(DarkModel::Weights(w, same, 2, 1000.));
+    EXPECT_TRUE(DarkModel::Weights(w, exposures, 1, 1000.));
+}
+
+TEST(DarkModelTest, OnlyExposuresWithinLibraryAreSynthesized)
+{
+    double exposures[] = { 1000., 2000., 4000. };
+
+    for (double t : { 1000., 1500., 3000., 4000. })
+        EXPECT_TRUE(DarkModel::CanSynthesize(exposures, 3, t)) << t;
+
+    // outside the library range SelectDark keeps the nearest library dark
+    for (double t : { 0., 500., 999., 4001., 10000. })
+        EXPECT_FALSE(DarkModel::CanSynthesize(exposures, 3, t)) << t;
+
+    double same[] = { 2000., 2000. };
+    EXPECT_FALSE(DarkModel::CanSynthesize(same, 2, 2000.));
+    EXPECT_FALSE(DarkModel::CanSynthesize(exposures, 1, 1000.));
+}
+
+TEST(DarkModelTest, NoiseFreeLibraryIsReproduced)
+{
+    std::mt19937 rng(1);
+    Sensor sensor(640 * 480, rng);
+    // keep the hot pixels below saturation at the longest exposure so the model is exactly linear
+    for (double& r : sensor.rate)
+        r = std::min(r, 5.);
+    Library lib(sensor, { 500., 1000., 2000., 4000., 8000. }, rng, 0.);
+
+    for (double t : { 500., 750., 1500., 3000., 6000. })
+    {
+        std::vector<unsigned short> dark = lib.Synthesize(t);
+        std::vector<unsigned short> parallel = lib.Synthesize(t, CONCURRENCY, &ThreadParallelFor);
+        EXPECT_TRUE(dark == parallel) << t;
+
+        // only the rounding of the library darks remains
+        int maxErr = 0;
+        for (size_t i = 0; i < dark.size(); i++)
+            maxErr = std::max(maxErr, (int) labs(lround(sensor.Value(i, t)) - dark[i]));
+        EXPECT_LE(maxErr, 1) << t;
+    }
+}
+
+TEST(DarkModelTest, BetterThanNearestLibraryDark)
+{
+    std::mt19937 rng(2);
+    Sensor sensor(640 * 480, rng);
+    // a sparse library of master darks with a little residual noise
+    Library lib(sensor, { 1000., 3000., 6000. }, rng, 2.);
+
+    for (double t : { 1250., 1500., 2000., 2500., 4000., 5000. })
+    {
+        double scaled = MeanError(sensor, lib.Synthesize(t), t);
+        double nearest = MeanError(sensor, lib.Nearest(t), t);
+        std::cout << t << " ms: mean error of synthesized dark " << scaled << " ADU, nearest library dark " << nearest
+                  << " ADU" << std::endl;
+        EXPECT_LT(scaled, nearest) << t;
+        EXPECT_LT(scaled, 2.) << t;
+    }
+}
+
+TEST(DarkModelTest, DISABLED_Benchmark)
+{
+    std::mt19937 rng(3);
+    const int w = 3072, h = 2048;
+    Sensor sensor((size_t) w * h, rng);
+    Library lib(sensor, { 500., 1000., 2000., 4000., 8000. }, rng, 2.);
+
+    double tser = TimeMs(3, [&] { lib.Synthesize(2500.); });
+    double tpar = TimeMs(3, [&] { lib.Synthesize(2500., CONCURRENCY, &ThreadParallelFor); });
+
+    std::cout << w << "x" << h << " from " << lib.darks.size() << " darks: " << tser << " ms, x" << CONCURRENCY << " " << tpar
+              << " ms" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,247 @@
+/*
+ *  dark_stack_test.cpp
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+// Checks DarkStack's sigma-clipped stacking on simulated dark frames with cosmic ray hits against
+// the plain average DarksDialog used to compute, and benchmarks stacking.
+
+#include "dark_stack.h"
+#include "test_timing.h"
+
+#include <gtest/gtest.h>
+
+#include <iostream>
+#include <math.h>
+#include <random>
+#include <vector>
+
+namespace
+{
+// the previous implementation, from darks_dialog.cpp
+void ReferenceAverage(unsigned short *out, const std::vector<std::vector<unsigned short>>& frames)
+{
+    size_t const n = frames[0].size();
+    std::vector<unsigned int> avgimg(n, 0);
+    for (const auto& f : frames)
+        for (size_t i = 0; i < n; i++)
+            avgimg[i] += f[i];
+    for (size_t i = 0; i < n; i++)
+        out[i] = (unsigned short) (avgimg[i] / frames.size());
+}
+
+struct Darks
+{
+    std::vector<double> truth; // noise free dark level
+    std::vector<std::vector<unsigned short>> frames;
+    size_t hits = 0;
+
+    Darks(size_t npixels, int nframes, double noise, double hitRate, std::mt19937& rng) : truth(npixels)
+    {
+        std::normal_distribution<double> level(800., 30.);
+        std::normal_distribution<double> n(0., noise);
+        std::uniform_real_distribution<double> u(0., 1.);
+        std::uniform_int_distribution<int> hit(2000, 60000);
+
+        for (double& t : truth)
+            t = level(rng);
+
+        for (int f = 0; f < nframes; f++)
+        {
+            std::vector<unsigned short> frame(npixels);
+            for (size_t i = 0; i < npixels; i++)
+            {
+                double v = truth[i] + n(rng);
+                if (u(rng) < hitRate)
+                {
+                    v += hit(rng); // cosmic ray or other transient
+                    ++hits;
+                }
+                frame[i] = (unsigned short) std::min(std::max(lround(v), 0L), 65535L);
+            }
+            frames.push_back(std::move(frame));
+        }
+    }
+};
+
+// mean absolute error, and the number of pixels with an error of more than maxErr
+double MeanError(const std::vector<unsigned short>& img, const std::vector<double>& truth, double maxErr, size_t *bad)
+{
+    double sum = 0.;
+    *bad = 0;
+    for (size_t i = 0; i < img.size(); i++)
+    {
+        double e = fabs(img[i] - truth[i]);
+        sum += e;
+        if (e > maxErr)
+            ++*bad;
+    }
+    return sum / img.size();
+}
+} // namespace
+
+TEST(DarkStackTest, IdenticalFrames)
+{
+    std::vector<unsigned short> frame = { 0, 1, 500, 32768, 65534, 65535 };
+    for (unsigned int n : { 1, 2, 3, 5, 20 })
+    {
+        DarkStack stack;
+        stack.Reset(frame.size());
+        for (unsigned int i = 0; i < n; i++)
+            stack.Add(frame.data());
+        EXPECT_EQ(n, stack.Count());
+
+        std::vector<unsigned short> out(frame.size());
+        EXPECT_EQ(0u, stack.Result(out.data()));
+        EXPECT_EQ(frame, out) << n;
+    }
+}
+
+// stack frames of quiet pixels where pixel 0 takes the given values in turn; returns the value of
+// pixel 0 and sets *rejected to the number of values rejected from it
+unsigned short StackPixel(const std::vector<unsigned short>& vals, size_t *rejected)
+{
+    std::mt19937 rng(3);
+    std::normal_distribution<double> noise(500., 2.);
+
+    // the quiet pixels are identical in every frame so that none of their values are rejected
+    std::vector<unsigned short> frame(1000);
+    for (auto& px : frame)
+        px = (unsigned short) lround(noise(rng));
+
+    DarkStack stack;
+    stack.Reset(frame.size());
+    for (unsigned short v : vals)
+    {
+        frame[0] = v;
+        stack.Add(frame.data());
+    }
+
+    std::vector<unsigned short> out(frame.size());
+    *rejected = stack.Result(out.data());
+    return out[0];
+}
+
+TEST(DarkStackTest, FewFramesAreAveraged)
+{
+    size_t rejected;
+
+    // nothing is rejected with fewer than four frames
+    EXPECT_EQ(13400, StackPixel({ 100, 100, 40000 }, &rejected));
+    EXPECT_EQ(0u, rejected);
+
+    // with four, the outlier goes
+    EXPECT_EQ(100, StackPixel({ 100, 100, 40000, 101 }, &rejected));
+    EXPECT_EQ(1u, rejected);
+}
+
+TEST(DarkStackTest, OutliersAreRejected)
+{
+    size_t rejected;
+
+    // up to two high and one low outlier per pixel
+    EXPECT_EQ(500, StackPixel({ 500, 503, 498, 501, 60000, 499, 502, 0, 40000, 500 }, &rejected));
+    EXPECT_EQ(3u, rejected);
+
+    // values within the noise are kept
+    EXPECT_EQ(501, StackPixel({ 500, 503, 498, 501, 505, 499, 502, 497, 504, 500 }, &rejected));
+    EXPECT_EQ(0u, rejected);
+}
+
+TEST(DarkStackTest, CosmicRays)
+{
+    std::mt19937 rng(1);
+
+    for (int nframes : { 5, 10, 20 })
+    {
+        Darks darks(320 * 240, nframes, 8., 0.002, rng);
+
+        DarkStack stack;
+        stack.Reset(darks.truth.size());
+        for (const auto& f : darks.frames)
+            stack.Add(f.data());
+
+        std::vector<unsigned short> clipped(darks.truth.size());
+        size_t rejected = stack.Result(clipped.data());
+
+        std::vector<unsigned short> avg(darks.truth.size());
+        ReferenceAverage(avg.data(), darks.frames);
+
+        size_t badClipped, badAvg;
+        double errClipped = MeanError(clipped, darks.truth, 40., &badClipped);
+        double errAvg = MeanError(avg, darks.truth, 40., &badAvg);
+
+        std::cout << nframes << " frames, " << darks.hits << " hits, " << rejected << " values rejected: mean error "
+                  << errClipped << " ADU (" << badClipped << " pixels off by > 40), average " << errAvg << " ADU ("
+                  << badAvg << " pixels)" << std::endl;
+
+        EXPECT_LT(errClipped, errAvg / 10.);
+        // only pixels hit three times or more (about one in these images) keep a hit
+        EXPECT_LE(badClipped, 3u);
+        EXPECT_GT(badAvg, 500u);
+        // few good values are rejected
+        EXPECT_LT(rejected, darks.hits + darks.truth.size() * nframes / 100);
+    }
+}
+
+TEST(DarkStackTest, DISABLED_Benchmark)
+{
+    std::mt19937 rng(2);
+    const size_t npixels = 3072 * 2048;
+    Darks darks(npixels, 2, 8., 0.001, rng);
+    const int nframes = 10;
+
+    std::vector<unsigned short> out(npixels);
+
+    std::vector<std::vector<unsigned short>> frames;
+    for (int i = 0; i < nframes; i++)
+        frames.push_back(darks.frames[i % 2]);
+    double tref = TimeMs(1, [&] { ReferenceAverage(out.data(), frames); });
+
+    DarkStack stack;
+    double tadd = TimeMs(1,
+                         [&] {
+                             stack.Reset(npixels);
+                             for (const auto& f : frames)
+                                 stack.Add(f.data());
+                         });
+    double tres = TimeMs(1, [&] { stack.Result(out.data()); });
+
+    std::cout << npixels << " pixels, " << nframes << " frames: previous average " << tref << " ms, clipped stack "
+              << tadd / nframes << " ms per frame + " << tres << " ms to finish" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,214 @@
+/*
+ *  dark_subtract_test.cpp
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+// Checks DarkSubtract against the previous per-pixel implementation from image_math.cpp, including
+// saturation at both ends and odd row lengths, and compares the speed of the two.
+
+#include "dark_subtract.h"
+#include "test_timing.h"
+
+#include <gtest/gtest.h>
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+// the previous implementation, from image_math.cpp
+void ReferenceSubtract(unsigned short *light, const unsigned short *dark, int width, int rx, int ry, int rw, int rh,
+                       unsigned short pedestal)
+{
+    unsigned short *pl0 = light + ry * width + rx;
+    const unsigned short *pd0 = dark + ry * width + rx;
+    for (int r = 0; r < rh; r++, pl0 += width, pd0 += width)
+    {
+        unsigned short *const endl = pl0 + rw;
+        unsigned short *pl;
+        const unsigned short *pd;
+        for (pl = pl0, pd = pd0; pl < endl; pl++, pd++)
+        {
+            int newval = (int) *pl + pedestal - (int) *pd;
+            if (newval < 0)
+                newval = 0;
+            else if (newval > 65535)
+                newval = 65535;
+            *pl = (unsigned short) newval;
+        }
+    }
+}
+
+void ThreadParallelFor(unsigned int count, const std::function<void(unsigned int)>& fn)
+{
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < count; i++)
+        threads.emplace_back(fn, i);
+    fn(0);
+    for (auto& t : threads)
+        t.join();
+}
+
+const unsigned int CONCURRENCY = 4;
+
+std::vector<unsigned short> RandomFrame(std::mt19937& rng, size_t n, unsigned int lo, unsigned int hi)
+{
+    std::uniform_int_distribution<unsigned int> dist(lo, hi);
+    std::vector<unsigned short> v(n);
+    for (auto& px : v)
+        px = (unsigned short) dist(rng);
+    return v;
+}
+} // namespace
+
+TEST(DarkSubtractTest, ExtremeValues)
+{
+    const unsigned short vals[] = { 0, 1, 2, 100, 1000, 32767, 32768, 32769, 60000, 65533, 65534, 65535 };
+    const int NV = sizeof(vals) / sizeof(vals[0]);
+
+    // every combination of light and dark, with the pixels at every position within a vector
+    std::vector<unsigned short> light, dark;
+    for (int i = 0; i < NV; i++)
+        for (int j = 0; j < NV; j++)
+        {
+            light.push_back(vals[i]);
+            dark.push_back(vals[j]);
+        }
+
+    for (unsigned short pedestal : vals)
+    {
+        std::vector<unsigned short> expected = light;
+        DarkSubtract::SubtractRowScalar(expected.data(), dark.data(), (int) expected.size(), pedestal);
+
+        std::vector<unsigned short> reference = light;
+        ReferenceSubtract(reference.data(), dark.data(), (int) reference.size(), 0, 0, (int) reference.size(), 1, pedestal);
+        ASSERT_EQ(reference, expected) << "pedestal " << pedestal;
+
+        for (int n = 0; n <= 40 && n <= (int) light.size(); n++)
+        {
+            std::vector<unsigned short> actual = light;
+            DarkSubtract::SubtractRow(actual.data(), dark.data(), n, pedestal);
+            std::vector<unsigned short> want = light;
+            DarkSubtract::SubtractRowScalar(want.data(), dark.data(), n, pedestal);
+            ASSERT_EQ(want, actual) << "pedestal " << pedestal << " n " << n;
+        }
+
+        std::vector<unsigned short> actual = light;
+        DarkSubtract::SubtractRow(actual.data(), dark.data(), (int) actual.size(), pedestal);
+        ASSERT_EQ(expected, actual) << "pedestal " << pedestal;
+    }
+}
+
+TEST(DarkSubtractTest, RandomRegionsMatchReference)
+{
+    std::mt19937 rng(1);
+
+    struct Region
+    {
+        int w, h, rx, ry, rw, rh;
+    };
+    const Region regions[] = {
+        { 640, 480, 0, 0, 640, 480 },     // full frame
+        { 1280, 960, 600, 400, 57, 41 },  // guiding subframe
+        { 2048, 2048, 0, 0, 2048, 2048 }, // large enough to split into bands
+        { 2047, 1031, 3, 5, 2041, 1025 }, // odd sizes
+        { 100, 100, 99, 99, 1, 1 },
+    };
+
+    for (const Region& r : regions)
+    {
+        std::vector<unsigned short> light = RandomFrame(rng, (size_t) r.w * r.h, 0, 65535);
+        std::vector<unsigned short> dark = RandomFrame(rng, (size_t) r.w * r.h, 0, 65535);
+        unsigned short pedestal = (unsigned short) (rng() % 2000);
+
+        std::string what =
+            std::to_string(r.w) + "x" + std::to_string(r.h) + " (" + std::to_string(r.rx) + "," + std::to_string(r.ry) + ")";
+
+        std::vector<unsigned short> expected = light;
+        ReferenceSubtract(expected.data(), dark.data(), r.w, r.rx, r.ry, r.rw, r.rh, pedestal);
+
+        std::vector<unsigned short> serial = light;
+        DarkSubtract::Subtract(serial.data(), dark.data(), r.w, r.rx, r.ry, r.rw, r.rh, pedestal);
+        EXPECT_TRUE(expected == serial) << what << " serial";
+
+        std::vector<unsigned short> parallel = light;
+        DarkSubtract::Subtract(parallel.data(), dark.data(), r.w, r.rx, r.ry, r.rw, r.rh, pedestal, CONCURRENCY,
+                               &ThreadParallelFor);
+        EXPECT_TRUE(expected == parallel) << what << " parallel";
+    }
+}
+
+TEST(DarkSubtractTest, DISABLED_Benchmark)
+{
+    std::mt19937 rng(2);
+
+    const int sizes[][2] = { { 1280, 960 }, { 4096, 4096 } };
+    for (const auto& sz : sizes)
+    {
+        int const w = sz[0], h = sz[1];
+        std::vector<unsigned short> light0 = RandomFrame(rng, (size_t) w * h, 500, 4000);
+        std::vector<unsigned short> dark = RandomFrame(rng, (size_t) w * h, 300, 700);
+        std::vector<unsigned short> light = light0;
+        int const reps = w * h > 4000000 ? 10 : 100;
+
+        // restoring the light frame is included in every timing
+        double tref = TimeMs(reps,
+                             [&] {
+                                 light = light0;
+                                 ReferenceSubtract(light.data(), dark.data(), w, 0, 0, w, h, 100);
+                             });
+        double tser = TimeMs(reps,
+                             [&] {
+                                 light = light0;
+                                 DarkSubtract::Subtract(light.data(), dark.data(), w, 0, 0, w, h, 100);
+                             });
+        double tpar = TimeMs(reps,
+                             [&] {
+                                 light = light0;
+                                 DarkSubtract::Subtract(light.data(), dark.data(), w, 0, 0, w, h, 100, CONCURRENCY,
+                                                        &ThreadParallelFor);
+                             });
+        double tcopy = TimeMs(reps, [&] { light = light0; });
+
+        std::cout << w << "x" << h << ": previous " << tref - tcopy << " ms, saturating " << tser - tcopy << " ms, saturating x"
+                  << CONCURRENCY << " " << tpar - tcopy << " ms" << std::endl;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
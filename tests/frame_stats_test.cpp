@@ -0,0 +1,448 @@
+/*
+ *  frame_stats_test.cpp
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+// Checks FrameStats against the way usImage::CalcStats used to compute the image statistics (a
+// histogram of a copy of the region plus a 3x3 median filtered copy) on the sample images and on
+// random images, and compares the speed of the two.
+
+#include "frame_stats.h"
+#include "sample_image.h"
+#include "test_timing.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+// the previous implementation, from image_math.cpp and usImage.cpp
+
+inline void swap(unsigned short& a, unsigned short& b)
+{
+    unsigned short const t = a;
+    a = b;
+    b = t;
+}
+
+inline unsigned short median9(const unsigned short l[9])
+{
+    unsigned short l0 = l[0], l1 = l[1], l2 = l[2], l3 = l[3], l4 = l[4];
+    unsigned short x;
+    x = l[5];
+    if (x < l0)
+        swap(x, l0);
+    if (x < l1)
+        swap(x, l1);
+    if (x < l2)
+        swap(x, l2);
+    if (x < l3)
+        swap(x, l3);
+    if (x < l4)
+        swap(x, l4);
+    x = l[6];
+    if (x < l0)
+        swap(x, l0);
+    if (x < l1)
+        swap(x, l1);
+    if (x < l2)
+        swap(x, l2);
+    if (x < l3)
+        swap(x, l3);
+    if (x < l4)
+        swap(x, l4);
+    x = l[7];
+    if (x < l0)
+        swap(x, l0);
+    if (x < l1)
+        swap(x, l1);
+    if (x < l2)
+        swap(x, l2);
+    if (x < l3)
+        swap(x, l3);
+    if (x < l4)
+        swap(x, l4);
+    x = l[8];
+    if (x < l0)
+        swap(x, l0);
+    if (x < l1)
+        swap(x, l1);
+    if (x < l2)
+        swap(x, l2);
+    if (x < l3)
+        swap(x, l3);
+    if (x < l4)
+        swap(x, l4);
+
+    if (l1 > l0)
+        l0 = l1;
+    if (l2 > l0)
+        l0 = l2;
+    if (l3 > l0)
+        l0 = l3;
+    if (l4 > l0)
+        l0 = l4;
+
+    return l0;
+}
+
+inline unsigned short median6(const unsigned short l[6])
+{
+    unsigned short l0 = l[0], l1 = l[1], l2 = l[2], l3 = l[3];
+    unsigned short x;
+
+    x = l[4];
+    if (x < l0)
+        swap(x, l0);
+    if (x < l1)
+        swap(x, l1);
+    if (x < l2)
+        swap(x, l2);
+    if (x < l3)
+        swap(x, l3);
+    x = l[5];
+    if (x < l0)
+        swap(x, l0);
+    if (x < l1)
+        swap(x, l1);
+    if (x < l2)
+        swap(x, l2);
+    if (x < l3)
+        swap(x, l3);
+
+    if (l2 > l0)
+        swap(l2, l0);
+    if (l2 > l1)
+        swap(l2, l1);
+
+    if (l3 > l0)
+        swap(l3, l0);
+    if (l3 > l1)
+        swap(l3, l1);
+
+    return (unsigned short) (((unsigned int) l0 + (unsigned int) l1) / 2);
+}
+
+inline unsigned short median4(const unsigned short l[4])
+{
+    unsigned short l0 = l[0], l1 = l[1], l2 = l[2];
+    unsigned short x;
+    x = l[3];
+    if (x < l0)
+        swap(x, l0);
+    if (x < l1)
+        swap(x, l1);
+    if (x < l2)
+        swap(x, l2);
+
+    if (l2 > l0)
+        swap(l2, l0);
+    if (l2 > l1)
+        swap(l2, l1);
+
+    return (unsigned short) (((unsigned int) l0 + (unsigned int) l1) / 2);
+}
+
+void Median3(unsigned short *dst, const unsigned short *src, int W, int RX, int RY, int RW, int RH)
+{
+
+    unsigned short a[9];
+    unsigned short *d;
+
+#define IX(x_, y_) ((RY + (y_)) * W + RX + (x_))
+
+    // top row
+    d = &dst[IX(0, 0)];
+
+    // top-left corner
+    a[0] = src[IX(0, 0)];
+    a[1] = src[IX(1, 0)];
+    a[2] = src[IX(0, 1)];
+    a[3] = src[IX(1, 1)];
+    *d++ = median4(a);
+
+    // top row middle pixels
+    for (int x = 1; x <= RW - 2; x++)
+    {
+        a[0] = src[IX(x - 1, 0)];
+        a[1] = src[IX(x, 0)];
+        a[2] = src[IX(x + 1, 0)];
+        a[3] = src[IX(x - 1, 1)];
+        a[4] = src[IX(x, 1)];
+        a[5] = src[IX(x + 1, 1)];
+        *d++ = median6(a);
+    }
+
+    // top-right corner
+    a[0] = src[IX(RW - 2, 0)];
+    a[1] = src[IX(RW - 1, 0)];
+    a[2] = src[IX(RW - 2, 1)];
+    a[3] = src[IX(RW - 1, 1)];
+    *d = median4(a);
+
+    for (int y = 1; y <= RH - 2; y++)
+    {
+        d = &dst[IX(0, y)];
+
+        // leftmost pixel
+        a[0] = src[IX(0, y - 1)];
+        a[1] = src[IX(1, y - 1)];
+        a[2] = src[IX(0, y)];
+        a[3] = src[IX(1, y)];
+        a[4] = src[IX(0, y + 1)];
+        a[5] = src[IX(1, y + 1)];
+        *d++ = median6(a);
+
+        for (int x = 1; x <= RW - 2; x++)
+        {
+            a[0] = src[IX(x - 1, y - 1)];
+            a[1] = src[IX(x, y - 1)];
+            a[2] = src[IX(x + 1, y - 1)];
+            a[3] = src[IX(x - 1, y)];
+            a[4] = src[IX(x, y)];
+            a[5] = src[IX(x + 1, y)];
+            a[6] = src[IX(x - 1, y + 1)];
+            a[7] = src[IX(x, y + 1)];
+            a[8] = src[IX(x + 1, y + 1)];
+            *d++ = median9(a);
+        }
+
+        // rightmost pixel
+        a[0] = src[IX(RW - 2, y - 1)];
+        a[1] = src[IX(RW - 1, y - 1)];
+        a[2] = src[IX(RW - 2, y)];
+        a[3] = src[IX(RW - 1, y)];
+        a[4] = src[IX(RW - 2, y + 1)];
+        a[5] = src[IX(RW - 1, y + 1)];
+        *d++ = median6(a);
+    }
+
+    // bottom row
+    d = &dst[IX(0, RH - 1)];
+
+    // bottom-left corner
+    a[0] = src[IX(0, RH - 2)];
+    a[1] = src[IX(1, RH - 2)];
+    a[2] = src[IX(0, RH - 1)];
+    a[3] = src[IX(1, RH - 1)];
+    *d++ = median4(a);
+
+    // bottom row middle pixels
+    for (int x = 1; x <= RW - 2; x++)
+    {
+        a[0] = src[IX(x - 1, RH - 2)];
+        a[1] = src[IX(x, RH - 2)];
+        a[2] = src[IX(x + 1, RH - 2)];
+        a[3] = src[IX(x - 1, RH - 1)];
+        a[4] = src[IX(x, RH - 1)];
+        a[5] = src[IX(x + 1, RH - 1)];
+        *d++ = median6(a);
+    }
+
+    // bottom-right corner
+    a[0] = src[IX(RW - 2, RH - 2)];
+    a[1] = src[IX(RW - 1, RH - 2)];
+    a[2] = src[IX(RW - 2, RH - 1)];
+    a[3] = src[IX(RW - 1, RH - 1)];
+    *d = median4(a);
+
+#undef IX
+}
+
+// usImage::CalcStats before FrameStats
+FrameStats::Result ReferenceStats(const Image& img, int rx, int ry, int rw, int rh)
+{
+    unsigned int pixcnt = rw * rh;
+    std::vector<unsigned short> tmp(pixcnt);
+    for (int y = 0; y < rh; y++)
+        std::copy_n(&img.px[(size_t) (ry + y) * img.width + rx], rw, &tmp[(size_t) y * rw]);
+
+    std::vector<int> histo(65536);
+    unsigned short mn = 65535, mx = 0;
+    for (unsigned short v : tmp)
+    {
+        ++histo[v];
+        mn = std::min(mn, v);
+        mx = std::max(mx, v);
+    }
+
+    FrameStats::Result r;
+    r.MinADU = mn;
+    r.MaxADU = mx;
+    r.MedianADU = mx;
+    int pixelLeft = pixcnt / 2;
+    for (int i = mn; i < mx; ++i)
+    {
+        if (histo[i] > pixelLeft)
+        {
+            r.MedianADU = i;
+            break;
+        }
+        pixelLeft -= histo[i];
+    }
+
+    std::vector<unsigned short> filt(pixcnt);
+    Median3(filt.data(), tmp.data(), rw, 0, 0, rw, rh);
+    r.FiltMin = *std::min_element(filt.begin(), filt.end());
+    r.FiltMax = *std::max_element(filt.begin(), filt.end());
+    return r;
+}
+
+void ThreadParallelFor(unsigned int count, const std::function<void(unsigned int)>& fn)
+{
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < count; i++)
+        threads.emplace_back(fn, i);
+    fn(0);
+    for (auto& t : threads)
+        t.join();
+}
+
+const unsigned int CONCURRENCY = 4;
+
+void ExpectSame(const FrameStats::Result& expected, const FrameStats::Result& actual, const std::string& what)
+{
+    EXPECT_EQ(expected.MinADU, actual.MinADU) << what;
+    EXPECT_EQ(expected.MaxADU, actual.MaxADU) << what;
+    EXPECT_EQ(expected.MedianADU, actual.MedianADU) << what;
+    EXPECT_EQ(expected.FiltMin, actual.FiltMin) << what;
+    EXPECT_EQ(expected.FiltMax, actual.FiltMax) << what;
+}
+
+void CheckRegion(const Image& img, int rx, int ry, int rw, int rh, const std::string& name)
+{
+    std::string what = name + " (" + std::to_string(rx) + "," + std::to_string(ry) + "," + std::to_string(rw) + "," +
+        std::to_string(rh) + ")";
+
+    FrameStats::Result expected = ReferenceStats(img, rx, ry, rw, rh);
+
+    FrameStats::Result serial;
+    FrameStats::Calc(&serial, img.px.data(), img.width, rx, ry, rw, rh);
+    ExpectSame(expected, serial, what + " serial");
+
+    FrameStats::Result parallel;
+    FrameStats::Calc(&parallel, img.px.data(), img.width, rx, ry, rw, rh, CONCURRENCY, &ThreadParallelFor);
+    ExpectSame(expected, parallel, what + " parallel");
+}
+
+void Benchmark(const Image& img, const std::string& name, int reps)
+{
+    FrameStats::Result r;
+    double tref = TimeMs(reps, [&] { r = ReferenceStats(img, 0, 0, img.width, img.height); });
+    double tser = TimeMs(reps, [&] { FrameStats::Calc(&r, img.px.data(), img.width, 0, 0, img.width, img.height); });
+    double tpar = TimeMs(reps,
+                         [&] {
+                             FrameStats::Calc(&r, img.px.data(), img.width, 0, 0, img.width, img.height, CONCURRENCY,
+                                              &ThreadParallelFor);
+                         });
+
+    std::cout << name << " " << img.width << "x" << img.height << ": previous " << tref << " ms, fused " << tser
+              << " ms, fused x" << CONCURRENCY << " " << tpar << " ms" << std::endl;
+}
+
+const char *const SAMPLE_IMAGES[] = { "savetest.fit", "simimage.fit" };
+} // namespace
+
+TEST(FrameStatsTest, SampleImagesMatchReference)
+{
+    for (const char *name : SAMPLE_IMAGES)
+    {
+        Image img;
+        ASSERT_TRUE(LoadFits(name, &img)) << name;
+
+        CheckRegion(img, 0, 0, img.width, img.height, name);
+        CheckRegion(img, 100, 80, 120, 90, name); // typical guiding subframe
+        CheckRegion(img, 0, 0, 2, 2, name);
+        CheckRegion(img, img.width - 3, img.height - 7, 3, 7, name);
+    }
+}
+
+TEST(FrameStatsTest, RandomImagesMatchReference)
+{
+    std::mt19937 rng(12345);
+
+    for (int iter = 0; iter < 300; iter++)
+    {
+        Image img;
+        img.width = 2 + rng() % 60;
+        img.height = 2 + rng() % 60;
+        img.px.resize((size_t) img.width * img.height);
+
+        // mix of narrow-range noise, full-range values and saturated pixels
+        unsigned short base = rng() % 60000;
+        for (auto& p : img.px)
+        {
+            unsigned int k = rng() % 100;
+            p = k < 3 ? 65535 : k < 6 ? (unsigned short) rng() : (unsigned short) (base + rng() % 64);
+        }
+
+        int rw = 2 + rng() % (img.width - 1);
+        int rh = 2 + rng() % (img.height - 1);
+        int rx = rng() % (img.width - rw + 1);
+        int ry = rng() % (img.height - rh + 1);
+
+        CheckRegion(img, rx, ry, rw, rh, "random " + std::to_string(iter));
+    }
+}
+
+TEST(FrameStatsTest, LargeFrameMatchesReference)
+{
+    Image src;
+    ASSERT_TRUE(LoadFits("simimage.fit", &src));
+    Image img = Tile(src, 2048, 1536);
+
+    CheckRegion(img, 0, 0, img.width, img.height, "tiled");
+    CheckRegion(img, 17, 5, 1800, 1400, "tiled");
+}
+
+TEST(FrameStatsTest, DISABLED_Benchmark)
+{
+    for (const char *name : SAMPLE_IMAGES)
+    {
+        Image img;
+        ASSERT_TRUE(LoadFits(name, &img)) << name;
+        Benchmark(img, name, 50);
+        Benchmark(Tile(img, 4096, 4096), std::string(name) + " tiled", 3);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,556 @@
+/*
+ *  guide_loop_benchmark.cpp
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Headless benchmark of the per-frame work of the guide loop. Frames of a simulated star field
+// are rendered with the camera simulator's renderer and taken through the same code PHD2 runs on
+// each frame: dark subtraction, noise reduction, the frame statistics of usImage::CalcStats, the
+// Star::Find measurement of the guide stars, the GuiderMultiStar treatment of the secondary stars
+// and a guide algorithm, with the image processing shared by the app's WorkerPool. A simulated
+// mount with periodic error, drift and seeing applies the guide corrections, so the stars move
+// the way they do while guiding.
+//
+// The latency percentiles of each stage and the frame throughput are printed; the process exits
+// with status 1 if the primary star is lost too often. Run with --help for the options.
+
+#include "dark_subtract.h"
+#include "frame_stats.h"
+#include "gaussian_process_guider.h"
+#include "guide_hysteresis.h"
+#include "guiding_stats.h"
+#include "noise_reduction.h"
+#include "secondary_stars.h"
+#include "sim_render.h"
+#include "star_measure.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <math.h>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+struct Options
+{
+    int width = 1936;
+    int height = 1096;
+    int stars = 20; // stars in the field
+    int guideStars = 9; // stars used for guiding, 1 for single-star guiding
+    int frames = 500;
+    int warmup = 10; // frames excluded from the statistics
+    int exposureMs = 2000; // simulated exposure, sets the pace of the simulated mount
+    int searchRegion = 15;
+    unsigned int threads = WorkerPool::DefaultThreads() + 1; // as many as the app uses
+    unsigned int seed = 1;
+    bool dark = true;
+    std::string noiseReduction = "none"; // none, mean, median
+    std::string algorithm = "hysteresis"; // none, hysteresis, gp
+};
+
+void Usage()
+{
+    Options o;
+    printf("usage: GuideLoopBenchmark [options]\n"
+           "  --width=N --height=N   frame size (default %dx%d)\n"
+           "  --stars=N              stars in the field (default %d)\n"
+           "  --guide-stars=N        stars used for guiding, 1 for single-star (default %d)\n"
+           "  --frames=N             frames to measure (default %d) after --warmup=N frames (default %d)\n"
+           "  --exposure=MS          simulated exposure duration (default %d)\n"
+           "  --search=N             search region (default %d)\n"
+           "  --threads=N            threads sharing the image processing (default %u)\n"
+           "  --seed=N               seed of the simulated sky and mount (default %u)\n"
+           "  --no-dark              skip dark subtraction\n"
+           "  --nr=none|mean|median  noise reduction (default %s)\n"
+           "  --algo=none|hysteresis|gp  RA guide algorithm, dec uses hysteresis (default %s)\n",
+           o.width, o.height, o.stars, o.guideStars, o.frames, o.warmup, o.exposureMs, o.searchRegion, o.threads, o.seed,
+           o.noiseReduction.c_str(), o.algorithm.c_str());
+}
+
+// returns true on error
+bool ParseOptions(Options *o, int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg(argv[i]);
+        std::string val;
+        size_t eq = arg.find('=');
+        if (eq != std::string::npos)
+        {
+            val = arg.substr(eq + 1);
+            arg = arg.substr(0, eq);
+        }
+
+        auto num = [&](int lo, int hi) -> int
+        {
+            char *end;
+            long n = strtol(val.c_str(), &end, 10);
+            if (val.empty() || *end || n < lo || n > hi)
+                throw arg;
+            return (int) n;
+        };
+
+        if (arg == "--help")
+        {
+            Usage();
+            exit(0);
+        }
+
+        try
+        {
+            if (arg == "--width")
+                o->width = num(64, 16384);
+            else if (arg == "--height")
+                o->height = num(64, 16384);
+            else if (arg == "--stars")
+                o->stars = num(1, 1000);
+            else if (arg == "--guide-stars")
+                o->guideStars = num(1, 100);
+            else if (arg == "--frames")
+                o->frames = num(1, 10000000);
+            else if (arg == "--warmup")
+                o->warmup = num(0, 10000000);
+            else if (arg == "--exposure")
+                o->exposureMs = num(1, 600000);
+            else if (arg == "--search")
+                o->searchRegion = num(7, 50);
+            else if (arg == "--threads")
+                o->threads = num(1, 256);
+            else if (arg == "--seed")
+                o->seed = num(0, 0x7fffffff);
+            else if (arg == "--no-dark")
+                o->dark = false;
+            else if (arg == "--nr" && (val == "none" || val == "mean" || val == "median"))
+                o->noiseReduction = val;
+            else if (arg == "--algo" && (val == "none" || val == "hysteresis" || val == "gp"))
+                o->algorithm = val;
+            else
+                throw arg;
+        }
+        catch (const std::string&)
+        {
+            fprintf(stderr, "invalid option: %s\n", argv[i]);
+            return true;
+        }
+    }
+    return false;
+}
+
+// GuideAlgorithmHysteresis with its default settings
+struct Hysteresis
+{
+    double lastMove = 0.0;
+
+    double result(double input)
+    {
+        lastMove = GuideHysteresis::Result(input, lastMove, GuideHysteresis::DEFAULT_MIN_MOVE,
+                                           GuideHysteresis::DEFAULT_HYSTERESIS, GuideHysteresis::DEFAULT_AGGRESSION);
+        return lastMove;
+    }
+};
+
+// the default settings of GuideAlgorithmGaussianProcess
+GaussianProcessGuider *MakeGPGuider()
+{
+    GaussianProcessGuider::guide_parameters p;
+    p.control_gain_ = 0.6;
+    p.min_periods_for_inference_ = 2.0;
+    p.min_move_ = 0.2;
+    p.SE0KLengthScale_ = 700.0;
+    p.SE0KSignalVariance_ = 20.0;
+    p.PKLengthScale_ = 10.0;
+    p.PKPeriodLength_ = 200.0;
+    p.PKSignalVariance_ = 20.0;
+    p.SE1KLengthScale_ = 25.0;
+    p.SE1KSignalVariance_ = 10.0;
+    p.min_periods_for_period_estimation_ = 2.0;
+    p.points_for_approximation_ = 100;
+    p.prediction_gain_ = 0.5;
+    p.compute_period_ = true;
+    return new GaussianProcessGuider(p);
+}
+
+enum Stage
+{
+    STAGE_CAPTURE,
+    STAGE_DARK,
+    STAGE_NR,
+    STAGE_STATS,
+    STAGE_FIND,
+    STAGE_MULTISTAR,
+    STAGE_ALGORITHM,
+    STAGE_PROCESS, // everything after the capture
+    NUM_STAGES
+};
+
+const char *const STAGE_NAMES[NUM_STAGES] = {
+    "capture (simulator)", "dark subtraction", "noise reduction", "frame statistics",
+    "star find",           "multi-star",       "guide algorithm", "total processing",
+};
+
+struct SimStar
+{
+    double x;
+    double y;
+    double inten;
+};
+
+// the state GuiderMultiStar keeps for each guide star
+struct GuideStar
+{
+    double refX; // reference point, the lock position of the primary star
+    double refY;
+    double x; // where the star was last found
+    double y;
+    double offsetX; // offset from the primary star when the stars were selected
+    double offsetY;
+    double snr;
+    bool wasLost;
+    unsigned int zeroCount;
+    unsigned int missCount;
+    StarMeasure::Result m; // this frame's measurement
+    bool found;
+};
+
+// GuiderMultiStar::DEFAULT_STABILITY_SIGMAX
+const double STABILITY_SIGMAX = 5.0;
+
+// Star::Find, without the HFD limits and the saturation test
+bool FindStar(StarMeasure::Result *m, const std::vector<unsigned short>& frame, int W, int H, double x, double y,
+              int searchRegion)
+{
+    StarMeasure::Measure(m, frame.data(), W, 0, 0, W - 1, H - 1, (int) (x + 0.5), (int) (y + 0.5), searchRegion,
+                         StarMeasure::MODE_CENTROID);
+    return m->mass >= StarMeasure::MIN_MASS && m->snr >= StarMeasure::LOW_SNR;
+}
+
+double Percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty())
+        return 0.0;
+    size_t i = (size_t) (p * (double) (sorted.size() - 1) + 0.5);
+    return sorted[i];
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Options opt;
+    if (ParseOptions(&opt, argc, argv))
+    {
+        Usage();
+        return 2;
+    }
+
+    WorkerPool::Init(opt.threads - 1);
+    unsigned int const concurrency = WorkerPool::Concurrency();
+
+    int const W = opt.width;
+    int const H = opt.height;
+    size_t const npix = (size_t) W * H;
+    int const border = 32;
+
+    // the sky: stars at random positions, the brightest first so that it becomes the primary star
+    SimRender::Rng rng(SimRender::Key(opt.seed, 0, 0));
+    std::vector<SimStar> stars(opt.stars);
+    for (auto& s : stars)
+    {
+        s.x = border + rng.Below(W - 2 * border);
+        s.y = border + rng.Below(H - 2 * border);
+        s.inten = 4000.0 + rng.Below(36000);
+    }
+    std::sort(stars.begin(), stars.end(), [](const SimStar& a, const SimStar& b) { return a.inten > b.inten; });
+
+    // dark frame with hot pixels, which the light frames share
+    unsigned int const BG = 1000, BG_RANGE = 200, DARK = 200, DARK_RANGE = 20;
+    std::vector<unsigned short> dark(npix);
+    SimRender::FillNoise(dark.data(), W, 0, 0, W, H, DARK, 1.0, DARK_RANGE, SimRender::Key(opt.seed, 0, 1), concurrency,
+                         &WorkerPool::ParallelFor);
+    std::vector<size_t> hotPixels(std::max(8, (int) (npix / 100000)));
+    for (auto& p : hotPixels)
+    {
+        p = (size_t) rng.Below(H) * W + rng.Below(W);
+        dark[p] = 65535;
+    }
+
+    std::vector<unsigned short> frame(npix), tmp(npix);
+
+    // simulated mount: periodic error and drift in pixels, corrected by the guide pulses
+    double const pePeriod = 480.0, peAmp = 2.0, decDrift = 0.01, seeing = 0.25;
+    double corrRA = 0.0, corrDec = 0.0;
+
+    std::unique_ptr<GaussianProcessGuider> gp;
+    if (opt.algorithm == "gp")
+        gp.reset(MakeGPGuider());
+    Hysteresis raHyst, decHyst;
+
+    std::vector<GuideStar> guide(std::min(opt.guideStars, opt.stars));
+    int const guideStars = (int) guide.size(); // stars can be dropped while guiding
+    DescriptiveStats primaryDist; // distances of the primary star from the lock position
+    double primarySigma = 0.0;
+    bool stabilizing = false;
+    std::vector<std::vector<double>> samples(NUM_STAGES);
+    for (auto& s : samples)
+        s.reserve(opt.frames);
+
+    int lost = 0;
+    double sumRA2 = 0.0, sumDec2 = 0.0;
+    int const total = opt.warmup + opt.frames;
+
+    typedef std::chrono::steady_clock clock;
+    auto usSince = [](clock::time_point t0) { return std::chrono::duration<double, std::micro>(clock::now() - t0).count(); };
+    clock::time_point runStart;
+    double stageUs[NUM_STAGES];
+
+    for (int f = 0; f < total; f++)
+    {
+        if (f == opt.warmup)
+            runStart = clock::now();
+
+        double const t = f * opt.exposureMs / 1000.0;
+        SimRender::Rng mrng(SimRender::Key(opt.seed, f, 2));
+        double sx[2];
+        mrng.Normal(sx);
+        double const errRA = peAmp * sin(6.283185307179586 * t / pePeriod) + seeing * sx[0] - corrRA;
+        double const errDec = decDrift * t + seeing * sx[1] - corrDec;
+
+        // capture
+        auto t0 = clock::now();
+        SimRender::FillNoise(frame.data(), W, 0, 0, W, H, BG + (opt.dark ? DARK : 0), 1.0, BG_RANGE,
+                             SimRender::Key(opt.seed, f, 0), concurrency, &WorkerPool::ParallelFor);
+        for (const auto& s : stars)
+            SimRender::AddStar(frame.data(), W, H, 0, 0, W - 1, H - 1, s.x + errRA, s.y + errDec, s.inten);
+        for (size_t p : hotPixels)
+            frame[p] = 65535;
+        stageUs[STAGE_CAPTURE] = usSince(t0);
+
+        auto tp = clock::now();
+
+        // dark subtraction
+        t0 = clock::now();
+        if (opt.dark)
+            DarkSubtract::Subtract(frame.data(), dark.data(), W, 0, 0, W, H, 0, concurrency, &WorkerPool::ParallelFor);
+        stageUs[STAGE_DARK] = usSince(t0);
+
+        // noise reduction
+        t0 = clock::now();
+        if (opt.noiseReduction == "mean")
+        {
+            NoiseReduction::Mean2x2(tmp.data(), frame.data(), W, 0, 0, W, H);
+            frame.swap(tmp);
+        }
+        else if (opt.noiseReduction == "median")
+        {
+            NoiseReduction::Median3(tmp.data(), frame.data(), W, 0, 0, W, H);
+            frame.swap(tmp);
+        }
+        stageUs[STAGE_NR] = usSince(t0);
+
+        // frame statistics
+        t0 = clock::now();
+        FrameStats::Result stats;
+        FrameStats::Calc(&stats, frame.data(), W, 0, 0, W, H, concurrency, &WorkerPool::ParallelFor);
+        stageUs[STAGE_STATS] = usSince(t0);
+
+        // measure the primary star where it was last found
+        t0 = clock::now();
+        if (f == 0)
+        {
+            // select the guide stars in the first frame, as AutoFind does
+            for (size_t i = 0; i < guide.size(); i++)
+            {
+                GuideStar& g = guide[i];
+                g.found = FindStar(&g.m, frame, W, H, stars[i].x, stars[i].y, opt.searchRegion);
+                g.refX = g.x = g.found ? g.m.x : stars[i].x;
+                g.refY = g.y = g.found ? g.m.y : stars[i].y;
+                g.offsetX = g.refX - guide[0].refX;
+                g.offsetY = g.refY - guide[0].refY;
+                g.snr = g.m.snr;
+                g.wasLost = false;
+                g.zeroCount = g.missCount = 0;
+            }
+        }
+
+        GuideStar& primary = guide[0];
+        primary.found = FindStar(&primary.m, frame, W, H, primary.x, primary.y, opt.searchRegion);
+        double dx = 0.0, dy = 0.0;
+        if (primary.found)
+        {
+            primary.x = primary.m.x;
+            primary.y = primary.m.y;
+            primary.snr = primary.m.snr;
+            dx = primary.x - primary.refX;
+            dy = primary.y - primary.refY;
+        }
+        else if (f >= opt.warmup)
+            ++lost;
+
+        // GuiderMultiStar::RefineOffset: measure the secondary stars concurrently unless the
+        // primary star is stabilizing
+        bool useSecondaries = false;
+        if (primary.found && guide.size() > 1)
+        {
+            double const dist = hypot(dx, dy);
+            primaryDist.AddValue(dist);
+            unsigned int const count = primaryDist.GetCount();
+            primarySigma = count > 5 ? primaryDist.GetSigma() : 0.0;
+            SecondaryStars::UpdateStabilizing(&stabilizing, dist, count, primarySigma, STABILITY_SIGMAX);
+            useSecondaries = !stabilizing && (dx != 0.0 || dy != 0.0);
+        }
+        if (useSecondaries)
+        {
+            WorkerPool::ParallelFor((unsigned int) guide.size() - 1,
+                                    [&](unsigned int i)
+                                    {
+                                        GuideStar& g = guide[i + 1];
+                                        double x, y;
+                                        SecondaryStars::SearchPos(&x, &y, g.wasLost, g.x, g.y, primary.x, primary.y,
+                                                                  g.offsetX, g.offsetY);
+                                        g.found = FindStar(&g.m, frame, W, H, x, y, opt.searchRegion);
+                                    });
+        }
+        stageUs[STAGE_FIND] = usSince(t0);
+
+        // SNR-weighted mean of the usable star displacements
+        t0 = clock::now();
+        if (useSecondaries)
+        {
+            SecondaryStars::WeightedOffset avg(dx, dy);
+            for (auto g = guide.begin() + 1; g != guide.end();)
+            {
+                if (!g->found)
+                {
+                    g->wasLost = true;
+                    ++g;
+                    continue;
+                }
+
+                g->x = g->m.x;
+                g->y = g->m.y;
+                g->snr = g->m.snr;
+                g->wasLost = false;
+
+                double const sx = g->x - g->refX;
+                double const sy = g->y - g->refY;
+                switch (SecondaryStars::Classify(sx, sy, primarySigma, &g->zeroCount, &g->missCount))
+                {
+                case SecondaryStars::DROP:
+                    g = guide.erase(g);
+                    continue;
+                case SecondaryStars::RESET:
+                    g->refX = g->x;
+                    g->refY = g->y;
+                    break;
+                case SecondaryStars::MISS:
+                    break;
+                case SecondaryStars::USE:
+                    avg.Add(sx, sy, g->snr, primary.snr);
+                    break;
+                }
+                ++g;
+            }
+            if (avg.Refines())
+            {
+                dx = avg.X();
+                dy = avg.Y();
+            }
+        }
+        stageUs[STAGE_MULTISTAR] = usSince(t0);
+
+        // guide algorithms; the mount moves the stars back by the amount of the correction
+        t0 = clock::now();
+        double moveRA = 0.0, moveDec = 0.0;
+        if (guide[0].found && f > 0)
+        {
+            if (opt.algorithm == "hysteresis")
+                moveRA = raHyst.result(dx);
+            else if (opt.algorithm == "gp")
+                moveRA = gp->result(dx, guide[0].m.snr, opt.exposureMs / 1000.0);
+            if (opt.algorithm != "none")
+                moveDec = decHyst.result(dy);
+        }
+        stageUs[STAGE_ALGORITHM] = usSince(t0);
+        stageUs[STAGE_PROCESS] = usSince(tp);
+
+        corrRA += moveRA;
+        corrDec += moveDec;
+
+        if (f >= opt.warmup)
+        {
+            for (int s = 0; s < NUM_STAGES; s++)
+                samples[s].push_back(stageUs[s]);
+            sumRA2 += dx * dx;
+            sumDec2 += dy * dy;
+        }
+    }
+
+    double const elapsedUs = usSince(runStart);
+
+    printf("Guide loop benchmark: %dx%d, %d stars, %d guide stars, algorithm %s, noise reduction %s, dark %s, %u threads, "
+           "%d frames\n\n",
+           W, H, opt.stars, guideStars, opt.algorithm.c_str(), opt.noiseReduction.c_str(), opt.dark ? "on" : "off",
+           concurrency, opt.frames);
+    printf("%-20s %10s %10s %10s %10s %10s   (microseconds)\n", "stage", "mean", "p50", "p90", "p99", "max");
+
+    double processUs = 0.0;
+    for (int s = 0; s < NUM_STAGES; s++)
+    {
+        std::vector<double>& v = samples[s];
+        double sum = 0.0;
+        for (double x : v)
+            sum += x;
+        std::sort(v.begin(), v.end());
+        double const mean = sum / v.size();
+        if (s == STAGE_PROCESS)
+            processUs = mean;
+        printf("%-20s %10.1f %10.1f %10.1f %10.1f %10.1f\n", STAGE_NAMES[s], mean, Percentile(v, 0.5), Percentile(v, 0.9),
+               Percentile(v, 0.99), v.back());
+    }
+
+    printf("\nthroughput: %.1f frames/s processing only, %.1f frames/s including the simulated capture\n", 1e6 / processUs,
+           opt.frames * 1e6 / elapsedUs);
+    printf("guide error RMS: RA %.3f px, dec %.3f px; primary star lost in %d frames\n", sqrt(sumRA2 / opt.frames),
+           sqrt(sumDec2 / opt.frames), lost);
+
+    WorkerPool::Destroy();
+
+    // a working guide loop keeps the primary star
+    return lost > opt.frames / 20 ? 1 : 0;
+}
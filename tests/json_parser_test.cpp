@@ -0,0 +1,248 @@
+/*
+ *  json_parser_test.cpp
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+// Checks JsonParser's number conversion and error handling, and benchmarks it on a sample of the
+// requests imaging sequencers send to the event server.
+
+#include "json_parser.h"
+#include "test_timing.h"
+
+#include <gtest/gtest.h>
+
+#include <limits.h>
+#include <math.h>
+#include <iostream>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+// requests as sent by sequencers during an imaging session: frequent polling, guiding and
+// dithering with settle parameters, and the occasional configuration call
+const char *const SEQUENCER_TRAFFIC[] = {
+    R"({"method": "get_app_state", "id": 1})",
+    R"({"method": "get_connected", "id": 2})",
+    R"({"method":"get_profile","id":3})",
+    R"({"method": "set_exposure", "params": [2000], "id": 4})",
+    R"({"method": "get_exposure", "id": 5})",
+    R"({"method": "loop", "id": 6})",
+    R"({"method": "find_star", "params": {"roi": [420, 310, 64, 64]}, "id": 7})",
+    R"({"method": "guide", "params": {"settle": {"pixels": 1.5, "time": 10, "timeout": 60}, "recalibrate": false}, "id": 8})",
+    R"({"method": "get_lock_position", "id": 9})",
+    R"({"method": "get_star_image", "params": {"size": 31}, "id": 10})",
+    R"({"method": "get_pixel_scale", "id": 11})",
+    R"({"method": "dither", "params": {"amount": 5.0, "raOnly": false, "settle": {"pixels": 1.2, "time": 8, "timeout": 40}}, "id": 12})",
+    R"({"method": "set_lock_position", "params": {"x": 1234.5678912345, "y": 987.6543210987, "exact": true}, "id": 13})",
+    R"({"method": "set_paused", "params": [true, "full"], "id": 14})",
+    R"({"method": "set_paused", "params": [false], "id": 15})",
+    R"({"jsonrpc": "2.0", "method": "get_calibration_data", "params": {"which": "Mount"}, "id": 16})",
+    R"({"method": "set_algo_param", "params": ["ra", "Aggressiveness", 0.7], "id": 17})",
+    R"({"method": "guide_pulse", "params": [250, "N", "Mount"], "id": 18})",
+    R"({"method": "get_search_region", "id": 19})",
+    R"({"method": "get_settling", "id": 20})",
+    R"({"method": "stop_capture", "id": 21})",
+    R"([{"method": "get_app_state", "id": 22}, {"method": "get_lock_position", "id": 23}])",
+};
+
+bool ParseCopy(JsonParser& parser, const std::string& s)
+{
+    return parser.Parse(s);
+}
+
+const json_value *Child(const json_value *v, const char *name)
+{
+    json_for_each(c, v)
+    {
+        if (c->name && strcmp(c->name, name) == 0)
+            return c;
+    }
+    return nullptr;
+}
+} // namespace
+
+TEST(JsonParserTest, Integers)
+{
+    JsonParser parser;
+    ASSERT_TRUE(ParseCopy(parser, "[0, -7, 2147483648, 9223372036854775807, -9223372036854775808, 9223372036854775808]"));
+
+    std::vector<const json_value *> v;
+    json_for_each(c, parser.Root()) v.push_back(c);
+    ASSERT_EQ(6u, v.size());
+
+    EXPECT_EQ(JSON_INT, v[0]->type);
+    EXPECT_EQ(0, v[0]->int_value);
+    EXPECT_EQ(-7, v[1]->int_value);
+    EXPECT_EQ(2147483648LL, v[2]->int_value);
+    EXPECT_EQ(LLONG_MAX, v[3]->int_value);
+    EXPECT_EQ(JSON_INT, v[4]->type);
+    EXPECT_EQ(LLONG_MIN, v[4]->int_value);
+
+    // too large for 64 bits
+    EXPECT_EQ(JSON_FLOAT, v[5]->type);
+    EXPECT_EQ(9223372036854775808.0, v[5]->float_value);
+}
+
+TEST(JsonParserTest, DoublesAreCorrectlyRounded)
+{
+    std::vector<std::string> texts = { "0.0",
+                                       "-0.0",
+                                       "1.5",
+                                       "123.456",
+                                       "1e3",
+                                       "1E-3",
+                                       "2.5e+2",
+                                       "1700000000.123",
+                                       "83.63308333333333",
+                                       "-5.391111111111111",
+                                       "0.1",
+                                       "3.141592653589793238462643383279",
+                                       "1e-310",
+                                       "1.7976931348623157e308",
+                                       "123456789012345678901234567890",
+                                       "0.000000000000000000000000000001234" };
+
+    std::mt19937_64 rng(7);
+    std::uniform_real_distribution<double> u(-1., 1.);
+    for (int i = 0; i < 20000; i++)
+    {
+        char buf[64];
+        double const v = u(rng) * pow(10., (int) (rng() % 40) - 20);
+        snprintf(buf, sizeof(buf), i % 2 ? "%.17g" : "%.6f", v);
+        texts.push_back(buf);
+    }
+
+    for (const std::string& t : texts)
+    {
+        JsonParser parser;
+        ASSERT_TRUE(ParseCopy(parser, "[" + t + "]")) << t;
+        const json_value *v = parser.Root()->first_child;
+        double const expected = strtod(t.c_str(), nullptr);
+        if (v->type == JSON_INT)
+            EXPECT_EQ(expected, (double) v->int_value) << t;
+        else
+        {
+            ASSERT_EQ(JSON_FLOAT, v->type) << t;
+            EXPECT_EQ(expected, v->float_value) << t;
+            EXPECT_EQ(std::signbit(expected), std::signbit(v->float_value)) << t;
+        }
+    }
+}
+
+TEST(JsonParserTest, ParsesInPlace)
+{
+    char text[] = R"({"method": "set_lock_position", "params": {"x": 1234.5678912345, "y": 987.6543210987}, "id": 13})";
+    JsonParser parser;
+    ASSERT_TRUE(parser.Parse(text));
+
+    const json_value *method = Child(parser.Root(), "method");
+    ASSERT_NE(nullptr, method);
+    EXPECT_STREQ("set_lock_position", method->string_value);
+    // names and strings point into the parsed text
+    EXPECT_GE(method->string_value, text);
+    EXPECT_LT(method->string_value, text + sizeof(text));
+
+    const json_value *params = Child(parser.Root(), "params");
+    ASSERT_NE(nullptr, params);
+    EXPECT_EQ(1234.5678912345, Child(params, "x")->float_value);
+    EXPECT_EQ(987.6543210987, Child(params, "y")->float_value);
+}
+
+TEST(JsonParserTest, Errors)
+{
+    const char *const bad[] = { "", "[", "[5", "[-]", "[1.2.3]", "[1e5x]", "[1]]", "[\"abc]", "[nul]" };
+    for (const char *t : bad)
+    {
+        JsonParser parser;
+        EXPECT_FALSE(ParseCopy(parser, t)) << t;
+        EXPECT_NE(nullptr, parser.ErrorDesc()) << t;
+    }
+}
+
+TEST(JsonParserTest, ParserReuse)
+{
+    // a parser keeps its memory between requests; results must not leak from one to the next
+    JsonParser parser;
+    for (int i = 0; i < 1000; i++)
+    {
+        for (const char *req : SEQUENCER_TRAFFIC)
+            ASSERT_TRUE(ParseCopy(parser, req)) << req;
+        const json_value *id = Child(parser.Root()->first_child->next_sibling, "id");
+        ASSERT_NE(nullptr, id);
+        EXPECT_EQ(23, id->int_value);
+    }
+}
+
+TEST(JsonParserTest, DISABLED_Benchmark)
+{
+    // the event server parses each line in place in its read buffer, so copy the traffic into
+    // a buffer once and restore it before each pass
+    std::vector<std::string> lines(std::begin(SEQUENCER_TRAFFIC), std::end(SEQUENCER_TRAFFIC));
+    size_t bytes = 0;
+    for (const std::string& l : lines)
+        bytes += l.size() + 1;
+
+    std::vector<char> pristine;
+    for (const std::string& l : lines)
+        pristine.insert(pristine.end(), l.c_str(), l.c_str() + l.size() + 1);
+    std::vector<char> work(pristine.size());
+
+    int const PASSES = 20000;
+    JsonParser parser;
+    size_t ok = 0;
+
+    double const ms = TimeMs(1, [&] {
+        for (int pass = 0; pass < PASSES; pass++)
+        {
+            memcpy(work.data(), pristine.data(), pristine.size());
+            for (char *p = work.data(); p < work.data() + work.size(); p += strlen(p) + 1)
+                ok += parser.Parse(p);
+        }
+    });
+
+    EXPECT_EQ(lines.size() * PASSES, ok);
+
+    double const reqs = (double) lines.size() * PASSES;
+    std::cout << "parsed " << reqs << " requests (" << bytes * PASSES / 1e6 << " MB) in " << ms << " ms: " << ms * 1e6 / reqs
+              << " ns per request" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,209 @@
+/*
+ *  json_writer_test.cpp
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+// Checks that JsonWriter formats numbers exactly like printf, which the event server used
+// before, and compares their speed.
+
+#include "json_writer.h"
+#include "test_timing.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <stdio.h>
+#include <string>
+#include <wchar.h>
+
+namespace
+{
+std::string Printf(const char *fmt, double v)
+{
+    char buf[512];
+    snprintf(buf, sizeof(buf), fmt, v);
+    return buf;
+}
+
+std::string PrintfPrec(int prec, double v)
+{
+    char buf[512];
+    snprintf(buf, sizeof(buf), "%.*f", prec, v);
+    return buf;
+}
+
+std::string Fixed(double v, int prec)
+{
+    std::string s;
+    JsonWriter::AppendFixed(s, v, prec);
+    return s;
+}
+
+std::string General(double v)
+{
+    std::string s;
+    JsonWriter::AppendGeneral(s, v);
+    return s;
+}
+
+// random values spread over many orders of magnitude
+std::vector<double> RandomValues(size_t count)
+{
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> mant(-1., 1.);
+    std::vector<double> v(count);
+    for (size_t i = 0; i < count; i++)
+        v[i] = mant(rng) * std::pow(10., (int) (rng() % 24) - 8);
+    return v;
+}
+} // namespace
+
+TEST(JsonWriterTest, Integers)
+{
+    for (long long v : { 0LL, 7LL, -7LL, 1234567890123LL, std::numeric_limits<long long>::min(),
+                         std::numeric_limits<long long>::max() })
+    {
+        std::string s;
+        JsonWriter::AppendInt(s, v);
+        EXPECT_EQ(std::to_string(v), s);
+    }
+
+    std::string s;
+    JsonWriter::AppendUInt(s, std::numeric_limits<unsigned long long>::max());
+    EXPECT_EQ("18446744073709551615", s);
+}
+
+TEST(JsonWriterTest, SpecialValues)
+{
+    // ties, negative zero, rounding into the next decade, and values that need the fallback
+    const double inf = std::numeric_limits<double>::infinity();
+    const double vals[] = { 0., -0., 0.5, 1.5, 2.5, -0.5, 0.125, -0.0004, 1e-4, 9.99995e-5, 999999., 999999.5, 1e6,
+                            9.9999949999, 9.9999950001, 1e300, -1e-300, 1700000000.1235, inf, -inf,
+                            std::numeric_limits<double>::quiet_NaN() };
+
+    for (double v : vals)
+    {
+        for (int prec = 0; prec <= 10; prec++)
+            EXPECT_EQ(PrintfPrec(prec, v), Fixed(v, prec)) << v << " prec " << prec;
+        EXPECT_EQ(Printf("%g", v), General(v)) << v;
+    }
+}
+
+TEST(JsonWriterTest, MatchesPrintf)
+{
+    std::vector<double> vals = RandomValues(200000);
+    for (int i = -20000; i < 20000; i++)
+    {
+        vals.push_back(i / 1000.);
+        vals.push_back(i * 0.0005);
+        vals.push_back(i / 8.);
+        vals.push_back(i * 1e-7);
+    }
+
+    for (double v : vals)
+    {
+        for (int prec = 0; prec <= 9; prec++)
+            ASSERT_EQ(PrintfPrec(prec, v), Fixed(v, prec)) << v << " prec " << prec;
+        ASSERT_EQ(Printf("%g", v), General(v)) << v;
+    }
+}
+
+TEST(JsonWriterTest, Escaping)
+{
+    std::string s;
+    const char narrow[] = "a\"b\\c\r\nd\t\xc3\xa9";
+    JsonWriter::AppendEscaped(s, narrow, sizeof(narrow) - 1);
+    EXPECT_EQ("a\\\"b\\\\c\\r\\nd\t\xc3\xa9", s);
+
+    s.clear();
+    const wchar_t wide[] = { L'x', L'"', 0xE9, 0x20AC, 0 };
+    JsonWriter::AppendEscaped(s, wide, wcslen(wide));
+    EXPECT_EQ("x\\\"\xc3\xa9\xe2\x82\xac", s);
+
+    // a character outside the BMP, as a surrogate pair where wchar_t is 16 bits
+    s.clear();
+    if (sizeof(wchar_t) == 2)
+    {
+        const wchar_t pair[] = { (wchar_t) 0xD83D, (wchar_t) 0xDE00 };
+        JsonWriter::AppendEscaped(s, pair, 2);
+    }
+    else
+    {
+        const wchar_t cp[] = { (wchar_t) 0x1F600 };
+        JsonWriter::AppendEscaped(s, cp, 1);
+    }
+    EXPECT_EQ("\xf0\x9f\x98\x80", s);
+
+    // unpaired surrogate
+    s.clear();
+    const wchar_t lone[] = { (wchar_t) 0xD800, L'a' };
+    JsonWriter::AppendEscaped(s, lone, 2);
+    EXPECT_EQ("\xef\xbf\xbd" "a", s);
+}
+
+TEST(JsonWriterTest, DISABLED_Benchmark)
+{
+    std::vector<double> vals = RandomValues(200000);
+    std::string out;
+    out.reserve(64);
+    char buf[64];
+    size_t total = 0;
+
+    double tprintf = TimeMs(1, [&] {
+        for (double v : vals)
+        {
+            total += snprintf(buf, sizeof(buf), "%.3f", v);
+            total += snprintf(buf, sizeof(buf), "%g", v);
+        }
+    });
+    double twriter = TimeMs(1, [&] {
+        for (double v : vals)
+        {
+            out.clear();
+            JsonWriter::AppendFixed(out, v, 3);
+            JsonWriter::AppendGeneral(out, v);
+            total += out.size();
+        }
+    });
+
+    std::cout << "format " << vals.size() << " doubles as %.3f and %g: snprintf " << tprintf << " ms, JsonWriter "
+              << twriter << " ms (" << total << ")" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
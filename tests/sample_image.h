@@ -0,0 +1,113 @@
+/*
+ *  sample_image.h
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef SAMPLE_IMAGE_H_INCLUDED
+#define SAMPLE_IMAGE_H_INCLUDED
+
+// Loading of the 16-bit sample images (savetest.fit, simimage.fit) for the unit tests
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+struct Image
+{
+    int width;
+    int height;
+    std::vector<unsigned short> px;
+};
+
+// minimal reader for the 16-bit sample images
+inline bool LoadFits(const std::string& path, Image *img)
+{
+    std::ifstream f(path, std::ios::binary);
+    if (!f)
+        return false;
+
+    int bitpix = 0;
+    double bzero = 0.;
+    img->width = img->height = 0;
+
+    char card[81] = { 0 };
+    bool end = false;
+    long long headerBytes = 0;
+    while (!end && f.read(card, 80))
+    {
+        headerBytes += 80;
+        std::string key(card, 8);
+        std::string val(card + 10, 70);
+        if (key == "END     ")
+            end = true;
+        else if (key == "BITPIX  ")
+            bitpix = std::stoi(val);
+        else if (key == "NAXIS1  ")
+            img->width = std::stoi(val);
+        else if (key == "NAXIS2  ")
+            img->height = std::stoi(val);
+        else if (key == "BZERO   ")
+            bzero = std::stod(val);
+    }
+    if (!end || bitpix != 16 || img->width <= 0 || img->height <= 0)
+        return false;
+
+    f.seekg((headerBytes + 2879) / 2880 * 2880);
+
+    size_t n = (size_t) img->width * img->height;
+    std::vector<unsigned char> raw(n * 2);
+    if (!f.read(reinterpret_cast<char *>(raw.data()), raw.size()))
+        return false;
+
+    img->px.resize(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        short v = (short) ((raw[2 * i] << 8) | raw[2 * i + 1]);
+        img->px[i] = (unsigned short) (v + (int) bzero);
+    }
+    return true;
+}
+
+// tile a sample image to make a large frame
+inline Image Tile(const Image& src, int width, int height)
+{
+    Image img;
+    img.width = width;
+    img.height = height;
+    img.px.resize((size_t) width * height);
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+            img.px[(size_t) y * width + x] = src.px[(size_t) (y % src.height) * src.width + x % src.width];
+    return img;
+}
+
+#endif // SAMPLE_IMAGE_H_INCLUDED
@@ -0,0 +1,268 @@
+/*
+ *  sim_render_test.cpp
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+// Checks the camera simulator's noise and star rendering (reproducibility, independence of how
+// the frame is split, the distribution of the noise, and stars identical to the previous
+// renderer), and compares its speed with the previous rand() based noise fill.
+
+#include "sim_render.h"
+#include "test_timing.h"
+
+#include <gtest/gtest.h>
+
+#include <iostream>
+#include <math.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+namespace
+{
+// the previous implementation, from gear_simulator.cpp
+void ReferenceFillNoise(unsigned short *data, int width, int rx, int ry, int rw, int rh, double base, double scale,
+                        unsigned int range)
+{
+    unsigned short *p0 = data + ry * width + rx;
+    for (int r = 0; r < rh; r++, p0 += width)
+    {
+        unsigned short *const end = p0 + rw;
+        for (unsigned short *p = p0; p < end; p++)
+            *p = (unsigned short) (scale * (base + (rand() % range)));
+    }
+}
+
+void ReferenceRenderStar(unsigned short *data, int width, int height, int x0, int y0, int x1, int y1, double px, double py,
+                         double inten)
+{
+    enum
+    {
+        WIDTH = 5
+    };
+    double STAR[][WIDTH] = {
+        { 0.0, 0.8, 2.2, 0.8, 0.0 },     { 0.8, 16.6, 46.1, 16.6, 0.8 }, { 2.2, 46.1, 128.0, 46.1, 2.2 },
+        { 0.8, 16.6, 46.1, 16.6, 0.8 }, { 0.0, 0.8, 2.2, 0.8, 0.0 },
+    };
+
+    double ix, iy;
+    double fx = modf(px, &ix);
+    double fy = modf(py, &iy);
+    double f00 = (1.0 - fx) * (1.0 - fy);
+    double f01 = (1.0 - fx) * fy;
+    double f10 = fx * (1.0 - fy);
+    double f11 = fx * fy;
+
+    double d[WIDTH + 1][WIDTH + 1] = { { 0.0 } };
+    for (unsigned int i = 0; i < WIDTH; i++)
+        for (unsigned int j = 0; j < WIDTH; j++)
+        {
+            double s = STAR[i][j];
+            if (s > 0.0)
+            {
+                s *= inten / 256.0;
+                d[i][j] += f00 * s;
+                d[i + 1][j] += f10 * s;
+                d[i][j + 1] += f01 * s;
+                d[i + 1][j + 1] += f11 * s;
+            }
+        }
+
+    int cx0 = (int) ix - (WIDTH - 1) / 2, cy0 = (int) iy - (WIDTH - 1) / 2;
+
+    for (unsigned int i = 0; i < WIDTH + 1; i++)
+    {
+        int const cx = cx0 + i;
+        if (cx < x0 || cx > x1)
+            continue;
+        for (unsigned int j = 0; j < WIDTH + 1; j++)
+        {
+            int const cy = cy0 + j;
+            if (cy < y0 || cy > y1)
+                continue;
+            int incr = (int) d[i][j];
+            if (incr > (unsigned short) -1)
+                incr = (unsigned short) -1;
+            if (cx < 0 || cx >= width || cy < 0 || cy >= height)
+                continue;
+            unsigned int t = data[cy * width + cx];
+            t += incr;
+            data[cy * width + cx] = t > 65535 ? 65535 : (unsigned short) t;
+        }
+    }
+}
+
+void ThreadParallelFor(unsigned int count, const std::function<void(unsigned int)>& fn)
+{
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < count; i++)
+        threads.emplace_back(fn, i);
+    fn(0);
+    for (auto& t : threads)
+        t.join();
+}
+
+const unsigned int CONCURRENCY = 4;
+
+// the simulator's noise parameters
+const double BASE = 3.0 / 10.0 * 100 * 2000 / 100.0;
+const double SCALE = 2.0;
+const unsigned int RANGE = 30 * 100;
+} // namespace
+
+TEST(SimRenderTest, NoiseIsReproducible)
+{
+    const int w = 1000, h = 700;
+    unsigned int const key = SimRender::Key(42, 7, 0);
+
+    std::vector<unsigned short> a(w * h), b(w * h), c(w * h, 0);
+    SimRender::FillNoise(a.data(), w, 0, 0, w, h, BASE, SCALE, RANGE, key);
+    SimRender::FillNoise(b.data(), w, 0, 0, w, h, BASE, SCALE, RANGE, key, CONCURRENCY, &ThreadParallelFor);
+    EXPECT_TRUE(a == b);
+
+    // a subframe gets the same pixels as the full frame, whatever its alignment
+    SimRender::FillNoise(c.data(), w, 301, 200, 51, 40, BASE, SCALE, RANGE, key);
+    for (int y = 200; y < 240; y++)
+        for (int x = 301; x < 352; x++)
+            ASSERT_EQ(a[y * w + x], c[y * w + x]) << x << "," << y;
+    EXPECT_EQ(0, c[0]);
+
+    // another frame or seed differs
+    SimRender::FillNoise(b.data(), w, 0, 0, w, h, BASE, SCALE, RANGE, SimRender::Key(42, 8, 0));
+    size_t same = 0;
+    for (size_t i = 0; i < a.size(); i++)
+        same += a[i] == b[i];
+    EXPECT_LT(same, a.size() / 100);
+}
+
+TEST(SimRenderTest, NoiseDistribution)
+{
+    const int w = 1024, h = 1024;
+    unsigned int const range = 16;
+
+    std::vector<unsigned short> a(w * h);
+    SimRender::FillNoise(a.data(), w, 0, 0, w, h, 0., 1., range, SimRender::Key(1, 0, 0));
+
+    // uniform over [0, range)
+    std::vector<double> counts(range, 0.);
+    for (unsigned short v : a)
+    {
+        ASSERT_LT(v, range);
+        counts[v] += 1.;
+    }
+    double const expected = (double) a.size() / range;
+    double chi2 = 0.;
+    for (double c : counts)
+        chi2 += (c - expected) * (c - expected) / expected;
+    EXPECT_LT(chi2, 45.) << "chi-square with 15 degrees of freedom";
+
+    // neighbouring pixels are uncorrelated
+    double sxy = 0., sx = 0., sxx = 0.;
+    for (int i = 0; i + 1 < w * h; i++)
+    {
+        sx += a[i];
+        sxx += (double) a[i] * a[i];
+        sxy += (double) a[i] * a[i + 1];
+    }
+    double n = w * h - 1;
+    double mean = sx / n;
+    double corr = (sxy / n - mean * mean) / (sxx / n - mean * mean);
+    EXPECT_LT(fabs(corr), 0.01);
+
+    // normal values
+    SimRender::Rng rng(SimRender::Key(1, 0, 1));
+    double s = 0., ss = 0.;
+    const int N = 200000;
+    for (int i = 0; i < N / 2; i++)
+    {
+        double r[2];
+        rng.Normal(r);
+        s += r[0] + r[1];
+        ss += r[0] * r[0] + r[1] * r[1];
+    }
+    EXPECT_NEAR(0., s / N, 0.01);
+    EXPECT_NEAR(1., ss / N, 0.01);
+}
+
+TEST(SimRenderTest, StarsMatchPreviousRenderer)
+{
+    const int w = 200, h = 150;
+    SimRender::Rng rng(SimRender::Key(5, 0, 0));
+
+    for (int i = 0; i < 2000; i++)
+    {
+        double x = rng.Uniform() * (w + 10) - 5;
+        double y = rng.Uniform() * (h + 10) - 5;
+        double inten = rng.Uniform() * 100000.;
+        int x0 = rng.Below(w), y0 = rng.Below(h);
+        int x1 = x0 + rng.Below(w - x0), y1 = y0 + rng.Below(h - y0);
+        if (i % 2)
+        {
+            x0 = y0 = 0;
+            x1 = w - 1;
+            y1 = h - 1;
+        }
+
+        std::vector<unsigned short> a(w * h, 1000), b(w * h, 1000);
+        SimRender::AddStar(a.data(), w, h, x0, y0, x1, y1, x, y, inten);
+        ReferenceRenderStar(b.data(), w, h, x0, y0, x1, y1, x, y, inten);
+        ASSERT_TRUE(a == b) << x << "," << y << " " << inten;
+    }
+}
+
+TEST(SimRenderTest, DISABLED_Benchmark)
+{
+    const int w = 8192, h = 6144;
+    std::vector<unsigned short> img(w * h);
+    unsigned int frame = 0;
+
+    double tref = TimeMs(1, [&] { ReferenceFillNoise(img.data(), w, 0, 0, w, h, BASE, SCALE, RANGE); });
+    double tser = TimeMs(3,
+                         [&] {
+                             SimRender::FillNoise(img.data(), w, 0, 0, w, h, BASE, SCALE, RANGE,
+                                                  SimRender::Key(1, ++frame, 0));
+                         });
+    double tpar = TimeMs(3,
+                         [&] {
+                             SimRender::FillNoise(img.data(), w, 0, 0, w, h, BASE, SCALE, RANGE,
+                                                  SimRender::Key(1, ++frame, 0), CONCURRENCY, &ThreadParallelFor);
+                         });
+
+    std::cout << w << "x" << h << " noise: rand() " << tref << " ms, counter-based " << tser << " ms (" << 1000. / tser
+              << " fps), x" << CONCURRENCY << " " << tpar << " ms (" << 1000. / tpar << " fps)" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
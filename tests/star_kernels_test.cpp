@@ -0,0 +1,668 @@
+/*
+ *  star_kernels_test.cpp
+ *  PHD2 Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of OpenPHDGuiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Checks the SIMD pixel kernels of Star::Find against the scalar reference kernels, and the star
+// measurement against the previous double-precision implementation of Star::Find, within the
+// tolerances documented in star_kernels.h. Also compares the speed of the two measurements.
+
+#include "star_kernels.h"
+#include "star_measure.h"
+#include "sample_image.h"
+#include "test_timing.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+// the previous implementation, from star.cpp
+
+struct R2M
+{
+    double r2;
+    int x;
+    int y;
+    double m;
+    R2M() { }
+    R2M(int x_, int y_, double m_) : x(x_), y(y_), m(m_) { }
+    bool operator<(const R2M& rhs) const { return r2 < rhs.r2; }
+};
+
+double hfr(std::vector<R2M>& vec, double cx, double cy, double mass)
+{
+    if (vec.size() == 1) // hot pixel?
+        return 0.25;
+
+    // compute Half Flux Radius (HFR)
+    for (auto it = vec.begin(); it != vec.end(); ++it)
+    {
+        double dx = (double) it->x - cx;
+        double dy = (double) it->y - cy;
+        it->r2 = dx * dx + dy * dy;
+    }
+    std::sort(vec.begin(), vec.end()); // sort by ascending radius^2
+
+    // find radius of half-mass
+    double r20, r21, m0, m1;
+    r20 = r21 = m0 = m1 = 0.0;
+    double halfm = 0.5 * mass;
+    for (auto it = vec.begin(); it != vec.end(); ++it)
+    {
+        const R2M& rm = *it;
+        r20 = r21;
+        m0 = m1;
+        r21 = rm.r2;
+        m1 += rm.m;
+        if (m1 > halfm)
+            break;
+    }
+
+    // interpolate
+    double hfr;
+    if (m1 > m0)
+    {
+        double r0 = sqrt(r20), r1 = sqrt(r21);
+        double s = (r1 - r0) / (m1 - m0);
+        hfr = r0 + s * (halfm - m0);
+    }
+    else
+        hfr = 0.25;
+
+    return hfr;
+}
+
+bool ReferenceMeasure(StarMeasure::Result *result, const unsigned short *imgdata, int rowsize, int minx, int miny, int maxx,
+                      int maxy, int base_x, int base_y, int searchRegion, StarMeasure::Mode mode)
+{
+    StarMeasure::Result& r = *result;
+
+    // search region bounds
+    int start_x = std::max(base_x - searchRegion, minx);
+    int end_x = std::min(base_x + searchRegion, maxx);
+    int start_y = std::max(base_y - searchRegion, miny);
+    int end_y = std::min(base_y + searchRegion, maxy);
+
+    if (end_x <= start_x || end_y <= start_y)
+        return true;
+
+    int peak_x = 0, peak_y = 0;
+    unsigned int peak_val = 0;
+    unsigned short max3[3] = { 0, 0, 0 };
+
+    if (mode == StarMeasure::MODE_PEAK)
+    {
+        for (int y = start_y; y <= end_y; y++)
+        {
+            for (int x = start_x; x <= end_x; x++)
+            {
+                unsigned short val = imgdata[y * rowsize + x];
+
+                if (val > peak_val)
+                {
+                    peak_val = val;
+                    peak_x = x;
+                    peak_y = y;
+                }
+            }
+        }
+
+        r.peakVal = (unsigned short) peak_val;
+    }
+    else
+    {
+        for (int y = start_y + 1; y <= end_y - 1; y++)
+        {
+            for (int x = start_x + 1; x <= end_x - 1; x++)
+            {
+                unsigned short p = imgdata[y * rowsize + x];
+                unsigned int val = 4 * (unsigned int) p + imgdata[(y - 1) * rowsize + (x - 1)] +
+                    imgdata[(y - 1) * rowsize + (x + 1)] + imgdata[(y + 1) * rowsize + (x - 1)] +
+                    imgdata[(y + 1) * rowsize + (x + 1)] + 2 * imgdata[(y - 1) * rowsize + (x + 0)] +
+                    2 * imgdata[(y + 0) * rowsize + (x - 1)] + 2 * imgdata[(y + 0) * rowsize + (x + 1)] +
+                    2 * imgdata[(y + 1) * rowsize + (x + 0)];
+
+                if (val > peak_val)
+                {
+                    peak_val = val;
+                    peak_x = x;
+                    peak_y = y;
+                }
+
+                if (p > max3[0])
+                    std::swap(p, max3[0]);
+                if (p > max3[1])
+                    std::swap(p, max3[1]);
+                if (p > max3[2])
+                    std::swap(p, max3[2]);
+            }
+        }
+
+        r.peakVal = max3[0]; // raw peak val
+        peak_val /= 16; // smoothed peak value
+    }
+
+    r.peakX = peak_x;
+    r.peakY = peak_y;
+    r.smoothedPeak = peak_val;
+    std::copy(max3, max3 + 3, r.max3);
+
+    // measure noise in the annulus with inner radius A and outer radius B
+    int const A = 7; // inner radius
+    int const B = 12; // outer radius
+    int const A2 = A * A;
+    int const B2 = B * B;
+
+    // center window around peak value
+    start_x = std::max(peak_x - B, minx);
+    end_x = std::min(peak_x + B, maxx);
+    start_y = std::max(peak_y - B, miny);
+    end_y = std::min(peak_y + B, maxy);
+
+    // find the mean and stdev of the background
+
+    unsigned int nbg = 0;
+    double mean_bg = 0., prev_mean_bg;
+    double sigma2_bg = 0.;
+    double sigma_bg = 0.;
+
+    r.tooFewBackground = false;
+
+    for (int iter = 0; iter < 9; iter++)
+    {
+        double sum = 0.0;
+        double a = 0.0;
+        double q = 0.0;
+        nbg = 0;
+
+        const unsigned short *row = imgdata + rowsize * start_y;
+        for (int y = start_y; y <= end_y; y++, row += rowsize)
+        {
+            int dy = y - peak_y;
+            int dy2 = dy * dy;
+            for (int x = start_x; x <= end_x; x++)
+            {
+                int dx = x - peak_x;
+                int r2 = dx * dx + dy2;
+
+                // exclude points not in annulus
+                if (r2 <= A2 || r2 > B2)
+                    continue;
+
+                double const val = (double) row[x];
+
+                if (iter > 0 && (val < mean_bg - 2.0 * sigma_bg || val > mean_bg + 2.0 * sigma_bg))
+                    continue;
+
+                sum += val;
+                ++nbg;
+                double const k = (double) nbg;
+                double const a0 = a;
+                a += (val - a) / k;
+                q += (val - a0) * (val - a);
+            }
+        }
+
+        if (nbg < 10) // only possible after the first iteration
+        {
+            r.tooFewBackground = true;
+            break;
+        }
+
+        prev_mean_bg = mean_bg;
+        mean_bg = sum / (double) nbg;
+        sigma2_bg = q / (double) (nbg - 1);
+        sigma_bg = sqrt(sigma2_bg);
+
+        if (iter > 0 && fabs(mean_bg - prev_mean_bg) < 0.5)
+            break;
+    }
+
+    r.nbg = nbg;
+    r.meanBg = mean_bg;
+    r.sigmaBg = sigma_bg;
+
+    unsigned short thresh;
+
+    double cx = 0.0;
+    double cy = 0.0;
+    double mass = 0.0;
+    unsigned int n;
+
+    std::vector<R2M> hfrvec;
+
+    if (mode == StarMeasure::MODE_PEAK)
+    {
+        mass = peak_val;
+        n = 1;
+        thresh = 0;
+    }
+    else
+    {
+        thresh = (unsigned short) (mean_bg + 3.0 * sigma_bg + 0.5);
+
+        // find pixels over threshold within aperture; compute mass and centroid
+
+        start_x = std::max(peak_x - A, minx);
+        end_x = std::min(peak_x + A, maxx);
+        start_y = std::max(peak_y - A, miny);
+        end_y = std::min(peak_y + A, maxy);
+
+        n = 0;
+
+        const unsigned short *row = imgdata + rowsize * start_y;
+        for (int y = start_y; y <= end_y; y++, row += rowsize)
+        {
+            int dy = y - peak_y;
+            int dy2 = dy * dy;
+            if (dy2 > A2)
+                continue;
+
+            for (int x = start_x; x <= end_x; x++)
+            {
+                int dx = x - peak_x;
+
+                // exclude points outside aperture
+                if (dx * dx + dy2 > A2)
+                    continue;
+
+                // exclude points below threshold
+                unsigned short val = row[x];
+                if (val < thresh)
+                    continue;
+
+                double const d = (double) val - mean_bg;
+
+                cx += dx * d;
+                cy += dy * d;
+                mass += d;
+                ++n;
+
+                hfrvec.push_back(R2M(x, y, d));
+            }
+        }
+    }
+
+    r.thresh = thresh;
+    r.n = n;
+    r.mass = mass;
+
+    double const gain = .5; // electrons per ADU, nominal
+    r.snr = n > 0 ? mass / sqrt(mass / gain + sigma2_bg * (double) n * (1.0 + 1.0 / (double) nbg)) : 0.0;
+
+    r.falseStar = peak_val <= thresh && r.snr >= StarMeasure::LOW_SNR;
+    if (r.falseStar)
+        r.snr = StarMeasure::LOW_SNR - 0.1;
+
+    if (mass < StarMeasure::MIN_MASS || r.snr < StarMeasure::LOW_SNR)
+    {
+        r.x = base_x;
+        r.y = base_y;
+        r.hfd = 0.;
+        return false;
+    }
+
+    r.x = peak_x + cx / mass;
+    r.y = peak_y + cy / mass;
+    r.hfd = 2.0 * hfr(hfrvec, r.x, r.y, mass);
+
+    return false;
+}
+
+// tolerances documented in star_kernels.h
+const double BACKGROUND_REL_TOL = 1e-12;
+const double CENTROID_TOL = 1e-9;
+
+void ExpectNearRel(double expected, double actual, double tol, const std::string& what)
+{
+    // a flat background gives 0 / 0 in both implementations
+    if (std::isnan(expected))
+    {
+        EXPECT_TRUE(std::isnan(actual)) << what;
+        return;
+    }
+    EXPECT_LE(fabs(actual - expected), tol * std::max(fabs(expected), 1.0)) << what;
+}
+
+struct Frame
+{
+    int width;
+    int height;
+    std::vector<unsigned short> px;
+};
+
+// add a Gaussian star of the given peak amplitude, clipped at saturation
+void AddStar(Frame *f, double cx, double cy, double amplitude, double sigma)
+{
+    for (int y = 0; y < f->height; y++)
+        for (int x = 0; x < f->width; x++)
+        {
+            double dx = x - cx, dy = y - cy;
+            double v = f->px[y * f->width + x] + amplitude * exp(-(dx * dx + dy * dy) / (2.0 * sigma * sigma));
+            f->px[y * f->width + x] = (unsigned short) std::min(v + 0.5, 65535.0);
+        }
+}
+
+Frame NoiseFrame(std::mt19937& rng, int width, int height, double background, double noise)
+{
+    Frame f;
+    f.width = width;
+    f.height = height;
+    f.px.resize((size_t) width * height);
+    std::normal_distribution<double> dist(background, noise);
+    for (auto& p : f.px)
+        p = (unsigned short) std::min(std::max(dist(rng) + 0.5, 0.0), 65535.0);
+    return f;
+}
+
+void CheckMeasure(const Frame& f, int minx, int miny, int maxx, int maxy, int baseX, int baseY, int searchRegion,
+                  StarMeasure::Mode mode, const std::string& name)
+{
+    std::string what = name + " base=(" + std::to_string(baseX) + "," + std::to_string(baseY) + ") region=(" +
+        std::to_string(minx) + "," + std::to_string(miny) + "," + std::to_string(maxx) + "," + std::to_string(maxy) +
+        ") search=" + std::to_string(searchRegion) + (mode == StarMeasure::MODE_PEAK ? " peak" : " centroid");
+
+    StarMeasure::Result expected, actual;
+    bool expectedErr =
+        ReferenceMeasure(&expected, f.px.data(), f.width, minx, miny, maxx, maxy, baseX, baseY, searchRegion, mode);
+    bool actualErr =
+        StarMeasure::Measure(&actual, f.px.data(), f.width, minx, miny, maxx, maxy, baseX, baseY, searchRegion, mode);
+
+    ASSERT_EQ(expectedErr, actualErr) << what;
+    if (expectedErr)
+        return;
+
+    // the peak search and the saturation inputs are exact
+    EXPECT_EQ(expected.peakX, actual.peakX) << what;
+    EXPECT_EQ(expected.peakY, actual.peakY) << what;
+    EXPECT_EQ(expected.smoothedPeak, actual.smoothedPeak) << what;
+    EXPECT_EQ(expected.peakVal, actual.peakVal) << what;
+    if (mode == StarMeasure::MODE_CENTROID)
+    {
+        EXPECT_EQ(expected.max3[0], actual.max3[0]) << what;
+        EXPECT_EQ(expected.max3[1], actual.max3[1]) << what;
+        EXPECT_EQ(expected.max3[2], actual.max3[2]) << what;
+    }
+
+    EXPECT_EQ(expected.nbg, actual.nbg) << what;
+    EXPECT_EQ(expected.tooFewBackground, actual.tooFewBackground) << what;
+    ExpectNearRel(expected.meanBg, actual.meanBg, BACKGROUND_REL_TOL, what + " meanBg");
+    ExpectNearRel(expected.sigmaBg, actual.sigmaBg, BACKGROUND_REL_TOL, what + " sigmaBg");
+
+    if (expected.thresh != actual.thresh)
+    {
+        // only allowed when mean + 3 sigma is within the background tolerance of a half-integer
+        double t = expected.meanBg + 3.0 * expected.sigmaBg + 0.5;
+        EXPECT_LE(fabs(t - std::round(t)), 4.0 * BACKGROUND_REL_TOL * std::max(t, 1.0)) << what << " thresh";
+        return;
+    }
+
+    EXPECT_EQ(expected.n, actual.n) << what;
+    EXPECT_EQ(expected.falseStar, actual.falseStar) << what;
+    ExpectNearRel(expected.mass, actual.mass, BACKGROUND_REL_TOL, what + " mass");
+    ExpectNearRel(expected.snr, actual.snr, BACKGROUND_REL_TOL, what + " snr");
+    EXPECT_NEAR(expected.x, actual.x, CENTROID_TOL) << what;
+    EXPECT_NEAR(expected.y, actual.y, CENTROID_TOL) << what;
+    EXPECT_NEAR(expected.hfd, actual.hfd, CENTROID_TOL) << what;
+}
+
+void CheckBothModes(const Frame& f, int minx, int miny, int maxx, int maxy, int baseX, int baseY, int searchRegion,
+                    const std::string& name)
+{
+    CheckMeasure(f, minx, miny, maxx, maxy, baseX, baseY, searchRegion, StarMeasure::MODE_CENTROID, name);
+    CheckMeasure(f, minx, miny, maxx, maxy, baseX, baseY, searchRegion, StarMeasure::MODE_PEAK, name);
+}
+
+std::vector<const StarKernels::Kernels *> SupportedKernels()
+{
+    const StarKernels::Kernels *list[8];
+    int n = StarKernels::Supported(list, 8);
+    return std::vector<const StarKernels::Kernels *>(list, list + n);
+}
+} // namespace
+
+TEST(StarKernelsTest, KernelsMatchScalar)
+{
+    const StarKernels::Kernels& ref = StarKernels::Scalar();
+    std::vector<const StarKernels::Kernels *> kernels = SupportedKernels();
+    ASSERT_GE(kernels.size(), 1U);
+    EXPECT_EQ(&ref, kernels[0]);
+
+    bool selected = false;
+    for (const StarKernels::Kernels *k : kernels)
+        selected = selected || k == &StarKernels::Get();
+    EXPECT_TRUE(selected) << StarKernels::Get().name;
+
+    std::mt19937 rng(4242);
+
+    for (const StarKernels::Kernels *k : kernels)
+    {
+        for (int iter = 0; iter < 2000; iter++)
+        {
+            // odd and even widths, unaligned starts, and rows mixing noise, full-range and saturated values
+            int n = rng() % 80;
+            int offset = rng() % 8;
+            std::string what = std::string(k->name) + " n=" + std::to_string(n) + " offset=" + std::to_string(offset);
+
+            std::vector<unsigned short> rows(3 * (n + 8));
+            unsigned short base = rng() % 60000;
+            for (auto& p : rows)
+            {
+                unsigned int c = rng() % 100;
+                p = c < 5 ? 65535 : c < 10 ? 0 : c < 20 ? (unsigned short) rng() : (unsigned short) (base + rng() % 512);
+            }
+            const unsigned short *r0 = &rows[offset];
+            const unsigned short *r1 = r0 + n + 8;
+            const unsigned short *r2 = r1 + n + 8;
+
+            std::vector<unsigned int> tmp(n + 1), refOut(n + 1, 0), out(n + 1, 0);
+            unsigned int refMax = ref.SmoothRow(r0, r1, r2, n, tmp.data(), refOut.data());
+            unsigned int mx = k->SmoothRow(r0, r1, r2, n, tmp.data(), out.data());
+            ASSERT_EQ(refMax, mx) << what << " SmoothRow";
+            for (int i = 1; i < n - 1; i++)
+                ASSERT_EQ(refOut[i], out[i]) << what << " SmoothRow i=" << i;
+
+            ASSERT_EQ(ref.RowMax(r1, n), k->RowMax(r1, n)) << what << " RowMax";
+
+            unsigned short lo, hi;
+            switch (iter % 4)
+            {
+            case 0:
+                lo = 0, hi = 65535;
+                break;
+            case 1:
+                lo = base, hi = base + 255;
+                break;
+            case 2:
+                lo = 65535, hi = 65535;
+                break;
+            default:
+                lo = rng(), hi = rng();
+                break;
+            }
+
+            // the sums accumulate into what is already there
+            StarKernels::SpanStats refAcc = { 3, 1000, 100000 }, acc = refAcc;
+            ref.AccumSpan(r1, n, lo, hi, &refAcc);
+            k->AccumSpan(r1, n, lo, hi, &acc);
+            ASSERT_EQ(refAcc.count, acc.count) << what << " AccumSpan lo=" << lo << " hi=" << hi;
+            ASSERT_EQ(refAcc.sum, acc.sum) << what << " AccumSpan lo=" << lo << " hi=" << hi;
+            ASSERT_EQ(refAcc.sumsq, acc.sumsq) << what << " AccumSpan lo=" << lo << " hi=" << hi;
+        }
+
+        // a long saturated span, the worst case for the sum of squares
+        std::vector<unsigned short> sat(65535, 65535);
+        StarKernels::SpanStats refAcc = { 0, 0, 0 }, acc = refAcc;
+        ref.AccumSpan(sat.data(), (int) sat.size(), 0, 65535, &refAcc);
+        k->AccumSpan(sat.data(), (int) sat.size(), 0, 65535, &acc);
+        EXPECT_EQ(refAcc.count, acc.count) << k->name << " saturated span";
+        EXPECT_EQ(refAcc.sum, acc.sum) << k->name << " saturated span";
+        EXPECT_EQ(refAcc.sumsq, acc.sumsq) << k->name << " saturated span";
+    }
+}
+
+TEST(StarKernelsTest, RandomStarsMatchReference)
+{
+    std::mt19937 rng(777);
+    std::uniform_real_distribution<double> unif(0.0, 1.0);
+
+    for (int iter = 0; iter < 400; iter++)
+    {
+        int width = 31 + rng() % 70;
+        int height = 31 + rng() % 70;
+        Frame f = NoiseFrame(rng, width, height, 200.0 + 3000.0 * unif(rng), 2.0 + 30.0 * unif(rng));
+
+        double cx = 2.0 + (width - 4) * unif(rng);
+        double cy = 2.0 + (height - 4) * unif(rng);
+        double amplitude = iter % 5 == 0 ? 0.0 : 20.0 * pow(10.0, 3.0 * unif(rng)); // some frames have no star
+        AddStar(&f, cx, cy, amplitude, 0.8 + 2.5 * unif(rng));
+
+        int baseX = (int) (cx + 0.5) + (int) (rng() % 7) - 3;
+        int baseY = (int) (cy + 0.5) + (int) (rng() % 7) - 3;
+        int searchRegion = 5 + rng() % 20;
+
+        CheckBothModes(f, 0, 0, width - 1, height - 1, baseX, baseY, searchRegion, "random " + std::to_string(iter));
+    }
+}
+
+TEST(StarKernelsTest, EdgeCasesMatchReference)
+{
+    std::mt19937 rng(31337);
+
+    // saturated stars with flat tops, where the peak location depends on the raster order
+    for (int iter = 0; iter < 50; iter++)
+    {
+        Frame f = NoiseFrame(rng, 61, 47, 1000.0, 15.0);
+        AddStar(&f, 30.3, 22.7, 200000.0 + 10000.0 * iter, 2.5);
+        CheckBothModes(f, 0, 0, f.width - 1, f.height - 1, 30, 23, 15, "saturated " + std::to_string(iter));
+    }
+
+    // stars at and near the frame border, so that the search region, annulus and aperture are clipped
+    for (int iter = 0; iter < 200; iter++)
+    {
+        int width = 25 + 2 * (rng() % 20); // odd widths
+        int height = 25 + rng() % 40;
+        Frame f = NoiseFrame(rng, width, height, 500.0, 10.0);
+
+        int edge = iter % 4;
+        double along = (double) (rng() % 1000) / 1000.0;
+        double off = (double) (rng() % 300) / 100.0;
+        double cx = edge == 0 ? off : edge == 1 ? width - 1 - off : along * (width - 1);
+        double cy = edge == 2 ? off : edge == 3 ? height - 1 - off : along * (height - 1);
+        AddStar(&f, cx, cy, 3000.0 + 100.0 * iter, 1.5);
+
+        CheckBothModes(f, 0, 0, width - 1, height - 1, (int) cx, (int) cy, 10, "border " + std::to_string(iter));
+    }
+
+    // stars at the border of a subframe inside a larger frame
+    for (int iter = 0; iter < 100; iter++)
+    {
+        Frame f = NoiseFrame(rng, 120, 90, 800.0, 12.0);
+        int minx = 20 + rng() % 10, miny = 15 + rng() % 10;
+        int maxx = minx + 30 + rng() % 21, maxy = miny + 30 + rng() % 21;
+        double cx = iter % 2 == 0 ? minx + 1.2 : maxx - 0.7;
+        double cy = iter % 3 == 0 ? miny + 0.4 : (miny + maxy) / 2.0;
+        AddStar(&f, cx, cy, 5000.0, 2.0);
+
+        CheckBothModes(f, minx, miny, maxx, maxy, (int) cx, (int) cy, 12, "subframe " + std::to_string(iter));
+    }
+
+    // degenerate frames: constant background, a single hot pixel, a tiny search region
+    Frame flat;
+    flat.width = 41;
+    flat.height = 33;
+    flat.px.assign((size_t) flat.width * flat.height, 1234);
+    CheckBothModes(flat, 0, 0, flat.width - 1, flat.height - 1, 20, 16, 10, "flat");
+
+    Frame hot = flat;
+    hot.px[16 * hot.width + 20] = 65535;
+    CheckBothModes(hot, 0, 0, hot.width - 1, hot.height - 1, 20, 16, 10, "hot pixel");
+
+    Frame small = NoiseFrame(rng, 3, 3, 100.0, 5.0);
+    CheckBothModes(small, 0, 0, 2, 2, 1, 1, 1, "3x3");
+    CheckBothModes(small, 0, 0, 2, 2, 1, 1, 0, "empty search region");
+}
+
+TEST(StarKernelsTest, SampleImageMatchesReference)
+{
+    Image img;
+    ASSERT_TRUE(LoadFits("simimage.fit", &img));
+
+    Frame f;
+    f.width = img.width;
+    f.height = img.height;
+    f.px = img.px;
+
+    // search on a grid over the frame, so that some searches find the stars and some only noise
+    int count = 0;
+    for (int y = 0; y < f.height && count < 300; y += 7)
+        for (int x = 0; x < f.width && count < 300; x += 7)
+        {
+            CheckBothModes(f, 0, 0, f.width - 1, f.height - 1, x, y, 15, "simimage.fit");
+            ++count;
+        }
+}
+
+TEST(StarKernelsTest, DISABLED_Benchmark)
+{
+    std::mt19937 rng(99);
+    Frame f = NoiseFrame(rng, 200, 200, 1000.0, 20.0);
+    AddStar(&f, 100.4, 99.6, 8000.0, 2.0);
+
+    const StarKernels::Kernels& kern = StarKernels::Get();
+    for (int searchRegion : { 15, 50 })
+    {
+        StarMeasure::Result r;
+        double tref = TimeUs(2000, [&] {
+            ReferenceMeasure(&r, f.px.data(), f.width, 0, 0, f.width - 1, f.height - 1, 100, 100, searchRegion,
+                             StarMeasure::MODE_CENTROID);
+        });
+        double tnew = TimeUs(2000, [&] {
+            StarMeasure::Measure(&r, f.px.data(), f.width, 0, 0, f.width - 1, f.height - 1, 100, 100, searchRegion,
+                                 StarMeasure::MODE_CENTROID);
+        });
+        std::cout << "search region " << searchRegion << ": previous " << tref << " us, " << kern.name << " " << tnew
+                  << " us" << std::endl;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}